@@ -77,6 +77,8 @@ using CalibInitPoseMap =
 
 class CalibHelper {
  public:
+  // Reads the images in timestamp order and detects the corners of batches
+  // of frames in parallel
   static void detectCorners(const VioDatasetPtr& vio_data,
                             CalibCornerMap& calib_corners,
                             CalibCornerMap& calib_corners_rejected);
@@ -101,6 +101,13 @@ class CamCalib {
 
   void setOptIntrinsics(bool opt) { opt_intr = opt; }
 
+  // Images of the dataset loaded next are loaded ahead on num_load_threads
+  // threads (0 loads them on the reading thread)
+  void setImageLoading(size_t num_load_threads, size_t load_lookahead) {
+    this->num_load_threads = num_load_threads;
+    this->load_lookahead = load_lookahead;
+  }
+
  private:
   static constexpr int UI_WIDTH = 300;
 
@@ -133,6 +140,9 @@ class CamCalib {
 
   int skip_images;
 
+  size_t num_load_threads = 0;
+  size_t load_lookahead = 0;
+
   std::vector<std::string> cam_types;
 
   bool show_gui;
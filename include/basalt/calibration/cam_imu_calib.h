@@ -105,6 +105,13 @@ class CamImuCalib {
 
   void setOptIntrinsics(bool opt) { opt_intr = opt; }
 
+  // Images of the dataset loaded next are loaded ahead on num_load_threads
+  // threads (0 loads them on the reading thread)
+  void setImageLoading(size_t num_load_threads, size_t load_lookahead) {
+    this->num_load_threads = num_load_threads;
+    this->load_lookahead = load_lookahead;
+  }
+
  private:
   static constexpr int UI_WIDTH = 300;
 
@@ -130,6 +137,9 @@ class CamImuCalib {
 
   int skip_images;
 
+  size_t num_load_threads = 0;
+  size_t load_lookahead = 0;
+
   bool show_gui;
 
   const size_t MIN_CORNERS = 15;
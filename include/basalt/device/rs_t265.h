@@ -93,8 +93,14 @@ class RsT265Device {
   tbb::concurrent_bounded_queue<OpticalFlowInput::Ptr>* image_data_queue =
       nullptr;
   tbb::concurrent_bounded_queue<ImuData<double>::Ptr>* imu_data_queue = nullptr;
+  tbb::concurrent_bounded_queue<ImuData<double>::Ptr>* flow_imu_data_queue =
+      nullptr;
   tbb::concurrent_bounded_queue<RsPoseData>* pose_data_queue = nullptr;
 
+  // Output the camera images in ImageData::img_u8 instead of converting them
+  // to 16 bit
+  bool native_8bit_images = false;
+
  private:
   bool manual_exposure;
   int skip_frames;
@@ -101,6 +101,21 @@ class HashBow {
     }
   }
 
+  // All N descriptor bits in the order of the random bit permutation. The
+  // hash uses the first num_bits of them.
+  constexpr static std::array<size_t, N> descriptor_bit_permutation() {
+    std::array<size_t, N> res{};
+    size_t j = 0;
+    for (size_t i = 0; i < 512 && j < N; ++i) {
+      if (random_bit_permutation[i] < N) {
+        res[j] = random_bit_permutation[i];
+        j++;
+      }
+    }
+
+    return res;
+  }
+
  protected:
   constexpr static const size_t random_bit_permutation[512] = {
       484, 458, 288, 170, 215, 424, 41,  38,  293, 96,  172, 428, 508, 52,  370,
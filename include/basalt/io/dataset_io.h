@@ -40,6 +40,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <iomanip>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <cereal/archives/binary.hpp>
@@ -66,11 +67,81 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace basalt {
 
+// Converts an 8 bit image to 16 bit or the other way around by shifting the
+// pixel values by 8 bits.
+template <typename T, typename S>
+typename ManagedImage<T>::Ptr convertImageDepth(const ManagedImage<S> &src) {
+  static_assert(sizeof(T) == 2 * sizeof(S) || 2 * sizeof(T) == sizeof(S));
+
+  typename ManagedImage<T>::Ptr res(new ManagedImage<T>(src.w, src.h));
+
+  for (size_t y = 0; y < src.h; y++) {
+    const S *data_in = src.RowPtr(y);
+    T *data_out = res->RowPtr(y);
+
+    for (size_t x = 0; x < src.w; x++) {
+      if constexpr (sizeof(T) > sizeof(S)) {
+        data_out[x] = T(data_in[x]) << 8;
+      } else {
+        data_out[x] = data_in[x] >> 8;
+      }
+    }
+  }
+
+  return res;
+}
+
 struct ImageData {
   ImageData() : exposure(0) {}
 
+  // 16 bit image. Datasets with native_8bit_images set return images of 8 bit
+  // sensors as img_u8 instead, only one of the two is set.
   ManagedImage<uint16_t>::Ptr img;
+  ManagedImage<uint8_t>::Ptr img_u8;
   double exposure;
+
+  bool empty() const { return !img && !img_u8; }
+
+  // Image with pixel type T (uint8_t or uint16_t), converted if it is stored
+  // with the other pixel type.
+  template <typename T>
+  typename ManagedImage<T>::Ptr getImage() const {
+    if constexpr (std::is_same_v<T, uint16_t>) {
+      if (img || !img_u8) return img;
+      return convertImageDepth<uint16_t>(*img_u8);
+    } else {
+      static_assert(std::is_same_v<T, uint8_t>);
+      if (img_u8 || !img) return img_u8;
+      return convertImageDepth<uint8_t>(*img);
+    }
+  }
+
+  // Sets the image from the first channel of an 8 bit image with
+  // num_channels interleaved channels, as img_u8 if native_8bit is set and
+  // shifted to 16 bit otherwise.
+  void setFrom8Bit(const uint8_t *data, size_t w, size_t h,
+                   size_t num_channels, bool native_8bit) {
+    img.reset();
+    img_u8.reset();
+
+    const size_t full_size = w * h;
+
+    if (native_8bit) {
+      img_u8.reset(new ManagedImage<uint8_t>(w, h));
+      uint8_t *data_out = img_u8->ptr;
+      for (size_t i = 0; i < full_size; i++) {
+        data_out[i] = data[i * num_channels];
+      }
+    } else {
+      img.reset(new ManagedImage<uint16_t>(w, h));
+      uint16_t *data_out = img->ptr;
+      for (size_t i = 0; i < full_size; i++) {
+        int val = data[i * num_channels];
+        val = val << 8;
+        data_out[i] = val;
+      }
+    }
+  }
 };
 
 struct Observations {
@@ -126,6 +197,10 @@ class VioDataset {
   virtual int64_t get_mocap_to_imu_offset_ns() const = 0;
   virtual std::vector<ImageData> get_image_data(int64_t t_ns) = 0;
 
+  // Return images of 8 bit sensors in ImageData::img_u8 instead of converting
+  // them to 16 bit
+  bool native_8bit_images = false;
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
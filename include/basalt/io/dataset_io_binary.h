@@ -0,0 +1,129 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <basalt/io/dataset_io.h>
+
+namespace basalt {
+
+// Basalt binary dataset: one file per sequence with the images of all
+// cameras, IMU, ground truth and exposure times, written by
+// saveBinaryDataset() and read with dataset type "basalt". The file is
+// memory mapped; uncompressed images are returned without copying them and
+// LZ4 compressed images are decompressed on access.
+//
+// Layout (native byte order of the writer, files with another byte order
+// are rejected; see dataset_io_binary.cpp for the record types):
+//   header
+//   image data, each image starting at a 64 byte boundary
+//   frame timestamps (num_frames x int64)
+//   image index (num_frames x num_cams records)
+//   accelerometer, gyroscope and ground truth records
+class BinaryVioDataset : public VioDataset {
+ public:
+  ~BinaryVioDataset(){};
+
+  size_t get_num_cams() const { return num_cams; }
+
+  std::vector<int64_t> &get_image_timestamps() { return image_timestamps; }
+
+  const Eigen::aligned_vector<AccelData> &get_accel_data() const {
+    return accel_data;
+  }
+  const Eigen::aligned_vector<GyroData> &get_gyro_data() const {
+    return gyro_data;
+  }
+  const std::vector<int64_t> &get_gt_timestamps() const {
+    return gt_timestamps;
+  }
+  const Eigen::aligned_vector<Sophus::SE3d> &get_gt_pose_data() const {
+    return gt_pose_data;
+  }
+
+  int64_t get_mocap_to_imu_offset_ns() const { return mocap_to_imu_offset_ns; }
+
+  std::vector<ImageData> get_image_data(int64_t t_ns);
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  friend class BinaryIO;
+
+ private:
+  size_t num_cams = 0;
+
+  // Mapped file, unmapped when the dataset and all images returned by it
+  // are destroyed. Mapped copy-on-write, so writing to the images does not
+  // change the file.
+  std::shared_ptr<char> file_data;
+  size_t file_size = 0;
+
+  // Sorted frame timestamps and image records in the mapped file
+  const int64_t *frame_timestamps = nullptr;
+  const char *image_index = nullptr;
+  size_t num_frames = 0;
+
+  std::vector<int64_t> image_timestamps;
+
+  Eigen::aligned_vector<AccelData> accel_data;
+  Eigen::aligned_vector<GyroData> gyro_data;
+
+  std::vector<int64_t> gt_timestamps;
+  Eigen::aligned_vector<Sophus::SE3d> gt_pose_data;
+
+  int64_t mocap_to_imu_offset_ns = 0;
+};
+
+class BinaryIO : public DatasetIoInterface {
+ public:
+  BinaryIO() {}
+
+  void read(const std::string &path);
+
+  void reset() { data.reset(); }
+
+  VioDatasetPtr get_data() { return data; }
+
+ private:
+  std::shared_ptr<BinaryVioDataset> data;
+};
+
+// Writes all data of the dataset to a binary dataset file, with LZ4
+// compressed images if compress is set. Images are stored with the pixel
+// type they are returned with, so 8 bit images are only kept as 8 bit if
+// native_8bit_images is set on the dataset.
+void saveBinaryDataset(VioDataset &dataset, const std::string &path,
+                       bool compress);
+
+}  // namespace basalt
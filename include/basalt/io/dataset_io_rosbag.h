@@ -35,9 +35,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef DATASET_IO_ROSBAG_H
 #define DATASET_IO_ROSBAG_H
 
+#include <algorithm>
 #include <mutex>
 #include <optional>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 #include <basalt/io/dataset_io.h>
 
 // Hack to access private functions
@@ -51,14 +55,25 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <geometry_msgs/TransformStamped.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/Imu.h>
+#include <std_msgs/Header.h>
 
 #include <basalt/utils/filesystem.h>
 
 namespace basalt {
 
 class RosbagVioDataset : public VioDataset {
-  std::shared_ptr<rosbag::Bag> bag;
-  std::mutex m;
+  std::string path;
+
+  // Bag opened with rosbag::Bag::open, which parses the index of the whole
+  // file. It owns the connection infos shared by all handles.
+  std::shared_ptr<rosbag::Bag> index_bag;
+
+  // Open bag handles that are currently not used by any thread. Every handle
+  // keeps its own file position and decompressed chunk, so reads through
+  // different handles decompress chunks in parallel. Declared after
+  // index_bag, so the handles are closed before it.
+  std::vector<std::shared_ptr<rosbag::Bag>> free_bags;
+  std::mutex bags_mutex;
 
   size_t num_cams;
 
@@ -106,23 +121,18 @@ class RosbagVioDataset : public VioDataset {
 
     auto it = image_data_idx.find(t_ns);
 
-    if (it != image_data_idx.end())
+    if (it == image_data_idx.end()) return res;
+
+    // Images of one timestamp are usually stored in the same chunk, so all
+    // cameras are read through one handle that caches the decompressed chunk.
+    withBag([&](rosbag::Bag &bag) {
       for (size_t i = 0; i < num_cams; i++) {
         ImageData &id = res[i];
 
         if (!it->second[i].has_value()) continue;
 
-        m.lock();
         sensor_msgs::ImageConstPtr img_msg =
-            bag->instantiateBuffer<sensor_msgs::Image>(*it->second[i]);
-        m.unlock();
-
-        //        std::cerr << "img_msg->width " << img_msg->width << "
-        //        img_msg->height "
-        //                  << img_msg->height << std::endl;
-
-        id.img.reset(
-            new ManagedImage<uint16_t>(img_msg->width, img_msg->height));
+            bag.instantiateBuffer<sensor_msgs::Image>(*it->second[i]);
 
         if (!img_msg->header.frame_id.empty() &&
             std::isdigit(img_msg->header.frame_id[0])) {
@@ -132,16 +142,11 @@ class RosbagVioDataset : public VioDataset {
         }
 
         if (img_msg->encoding == "mono8") {
-          const uint8_t *data_in = img_msg->data.data();
-          uint16_t *data_out = id.img->ptr;
-
-          for (size_t i = 0; i < img_msg->data.size(); i++) {
-            int val = data_in[i];
-            val = val << 8;
-            data_out[i] = val;
-          }
-
+          id.setFrom8Bit(img_msg->data.data(), img_msg->width,
+                         img_msg->height, 1, native_8bit_images);
         } else if (img_msg->encoding == "mono16") {
+          id.img.reset(
+              new ManagedImage<uint16_t>(img_msg->width, img_msg->height));
           std::memcpy(id.img->ptr, img_msg->data.data(), img_msg->data.size());
         } else {
           std::cerr << "Encoding " << img_msg->encoding << " is not supported."
@@ -149,12 +154,56 @@ class RosbagVioDataset : public VioDataset {
           std::abort();
         }
       }
+    });
 
     return res;
   }
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+ private:
+  // Runs func with a bag handle that is exclusively owned by the calling
+  // thread for the duration of the call. Handles are opened on demand, so
+  // their number is bounded by the number of concurrent readers (e.g. the
+  // loader threads of PrefetchingVioDataset).
+  template <typename Func>
+  void withBag(Func &&func) {
+    std::shared_ptr<rosbag::Bag> bag;
+    {
+      std::lock_guard<std::mutex> lock(bags_mutex);
+      if (!free_bags.empty()) {
+        bag = free_bags.back();
+        free_bags.pop_back();
+      }
+    }
+
+    if (!bag) bag = openHandle();
+
+    func(*bag);
+
+    std::lock_guard<std::mutex> lock(bags_mutex);
+    free_bags.emplace_back(std::move(bag));
+  }
+
+  // Additional handle for reading messages by their index entry. Only the
+  // file is opened; instead of parsing the index again, which reads the index
+  // records of every chunk, the handle uses the connections of index_bag,
+  // which is all instantiateBuffer needs.
+  std::shared_ptr<rosbag::Bag> openHandle() const {
+    std::shared_ptr<rosbag::Bag> bag(new rosbag::Bag, [](rosbag::Bag *b) {
+      // owned by index_bag, would be deleted by Bag::close
+      b->connections_.clear();
+      delete b;
+    });
+
+    bag->file_.openRead(path);
+    bag->mode_ = rosbag::bagmode::Read;
+    bag->version_ = index_bag->version_;
+    bag->connections_ = index_bag->connections_;
+
+    return bag;
+  }
+
   friend class RosbagIO;
 };
 
@@ -167,11 +216,25 @@ class RosbagIO : public DatasetIoInterface {
       std::cerr << "No dataset found in " << path << std::endl;
 
     data.reset(new RosbagVioDataset);
-
-    data->bag.reset(new rosbag::Bag);
-    data->bag->open(path, rosbag::bagmode::Read);
-
-    rosbag::View view(*data->bag);
+    data->path = path;
+
+    // Startup cost: opening the bag parses its index, which reads the index
+    // records of every chunk but no message data. The IMU, mocap and image
+    // header messages are then deserialized below, which decompresses every
+    // chunk that stores one of them once; for typical recordings with IMU
+    // messages in every chunk this is the whole bag. The image pixels are
+    // only deserialized in get_image_data.
+    //
+    // The bag is kept as the index of the dataset, the additional handles of
+    // the loader threads share its connections instead of parsing the index
+    // again.
+    std::shared_ptr<rosbag::Bag> bag(new rosbag::Bag);
+    bag->open(path, rosbag::bagmode::Read);
+
+    data->index_bag = bag;
+    data->free_bags.emplace_back(bag);
+
+    rosbag::View view(*bag);
 
     // get topics
     std::vector<const rosbag::ConnectionInfo *> connection_infos =
@@ -236,26 +299,114 @@ class RosbagIO : public DatasetIoInterface {
 
     std::set<int64_t> image_timestamps;
 
-    for (const rosbag::MessageInstance &m : view) {
-      const std::string &topic = m.getTopic();
+    // Index entries of the messages on the selected topics. The messages are
+    // deserialized in parallel below, grouped by the chunk that stores them,
+    // so that every chunk is decompressed only once and by a single thread.
+    // Image messages are not instantiated, only their header is
+    // deserialized to get the timestamp; the pixels are read on demand in
+    // get_image_data.
+    struct MessageRef {
+      const rosbag::ConnectionInfo *info;
+      const rosbag::IndexEntry *entry;
 
-      if (cam_topics.find(topic) != cam_topics.end()) {
-        sensor_msgs::ImageConstPtr img_msg =
-            m.instantiate<sensor_msgs::Image>();
-        int64_t timestamp_ns = img_msg->header.stamp.toNSec();
+      std_msgs::HeaderConstPtr img_header;
+      sensor_msgs::ImuConstPtr imu_msg;
+      geometry_msgs::TransformStampedConstPtr mocap_msg;
+      geometry_msgs::PointStampedConstPtr point_msg;
+    };
+
+    std::vector<MessageRef> msgs;
+
+    for (const rosbag::ConnectionInfo *info : connection_infos) {
+      if (cam_topics.count(info->topic) == 0 && info->topic != imu_topic &&
+          info->topic != mocap_topic && info->topic != point_topic)
+        continue;
+
+      auto it = bag->connection_indexes_.find(info->id);
+      if (it == bag->connection_indexes_.end()) continue;
+
+      for (const rosbag::IndexEntry &entry : it->second) {
+        msgs.push_back({info, &entry, nullptr, nullptr, nullptr, nullptr});
+      }
+    }
+
+    // same order as iterating a view over the whole bag
+    std::stable_sort(msgs.begin(), msgs.end(),
+                     [](const MessageRef &a, const MessageRef &b) {
+                       return a.entry->time < b.entry->time;
+                     });
+
+    std::map<uint64_t, std::vector<size_t>> chunk_to_msgs;
+    for (size_t i = 0; i < msgs.size(); i++) {
+      chunk_to_msgs[msgs[i].entry->chunk_pos].push_back(i);
+    }
+
+    std::vector<const std::vector<size_t> *> chunks;
+    for (const auto &kv : chunk_to_msgs) chunks.push_back(&kv.second);
+
+    auto read_message = [](rosbag::Bag &b, MessageRef &m) {
+      const std::string &datatype = m.info->datatype;
+
+      if (datatype == "sensor_msgs/Image") {
+        // sensor_msgs/Image starts with its header, so the header can be
+        // deserialized without touching the pixel data
+        m.img_header = b.instantiateBuffer<std_msgs::Header>(*m.entry);
+      } else if (datatype == "sensor_msgs/Imu") {
+        m.imu_msg = b.instantiateBuffer<sensor_msgs::Imu>(*m.entry);
+      } else if (datatype == "geometry_msgs/TransformStamped") {
+        m.mocap_msg =
+            b.instantiateBuffer<geometry_msgs::TransformStamped>(*m.entry);
+      } else if (datatype == "geometry_msgs/PoseStamped") {
+        geometry_msgs::PoseStampedConstPtr mocap_pose_msg =
+            b.instantiateBuffer<geometry_msgs::PoseStamped>(*m.entry);
+
+        geometry_msgs::TransformStampedPtr mocap_new_msg(
+            new geometry_msgs::TransformStamped);
+        mocap_new_msg->header = mocap_pose_msg->header;
+        mocap_new_msg->transform.rotation = mocap_pose_msg->pose.orientation;
+        mocap_new_msg->transform.translation.x =
+            mocap_pose_msg->pose.position.x;
+        mocap_new_msg->transform.translation.y =
+            mocap_pose_msg->pose.position.y;
+        mocap_new_msg->transform.translation.z =
+            mocap_pose_msg->pose.position.z;
+
+        m.mocap_msg = mocap_new_msg;
+      } else if (datatype == "geometry_msgs/PointStamped") {
+        m.point_msg =
+            b.instantiateBuffer<geometry_msgs::PointStamped>(*m.entry);
+      }
+    };
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, chunks.size()),
+        [&](const tbb::blocked_range<size_t> &r) {
+          data->withBag([&](rosbag::Bag &b) {
+            for (size_t c = r.begin(); c != r.end(); ++c) {
+              for (size_t i : *chunks[c]) read_message(b, msgs[i]);
+            }
+          });
+        });
+
+    for (const MessageRef &m : msgs) {
+      const std::string &topic = m.info->topic;
+      const int64_t msg_arrival_time = m.entry->time.toNSec();
+
+      if (m.img_header) {
+        int64_t timestamp_ns = m.img_header->stamp.toNSec();
 
         auto &img_vec = data->image_data_idx[timestamp_ns];
         if (img_vec.size() == 0) img_vec.resize(data->num_cams);
 
-        img_vec[topic_to_id.at(topic)] = m.index_entry_;
+        img_vec[topic_to_id.at(topic)] = *m.entry;
         image_timestamps.insert(timestamp_ns);
 
         min_time = std::min(min_time, timestamp_ns);
         max_time = std::max(max_time, timestamp_ns);
       }
 
-      if (imu_topic == topic) {
-        sensor_msgs::ImuConstPtr imu_msg = m.instantiate<sensor_msgs::Imu>();
+      if (m.imu_msg) {
+        const sensor_msgs::ImuConstPtr &imu_msg = m.imu_msg;
         int64_t time = imu_msg->header.stamp.toNSec();
 
         data->accel_data.emplace_back();
@@ -273,50 +424,22 @@ class RosbagIO : public DatasetIoInterface {
         min_time = std::min(min_time, time);
         max_time = std::max(max_time, time);
 
-        int64_t msg_arrival_time = m.getTime().toNSec();
         system_to_imu_offset_vec.push_back(time - msg_arrival_time);
       }
 
-      if (mocap_topic == topic) {
-        geometry_msgs::TransformStampedConstPtr mocap_msg =
-            m.instantiate<geometry_msgs::TransformStamped>();
-
-        // Try different message type if instantiate did not work
-        if (!mocap_msg) {
-          geometry_msgs::PoseStampedConstPtr mocap_pose_msg =
-              m.instantiate<geometry_msgs::PoseStamped>();
-
-          geometry_msgs::TransformStampedPtr mocap_new_msg(
-              new geometry_msgs::TransformStamped);
-          mocap_new_msg->header = mocap_pose_msg->header;
-          mocap_new_msg->transform.rotation = mocap_pose_msg->pose.orientation;
-          mocap_new_msg->transform.translation.x =
-              mocap_pose_msg->pose.position.x;
-          mocap_new_msg->transform.translation.y =
-              mocap_pose_msg->pose.position.y;
-          mocap_new_msg->transform.translation.z =
-              mocap_pose_msg->pose.position.z;
-
-          mocap_msg = mocap_new_msg;
-        }
-
-        int64_t time = mocap_msg->header.stamp.toNSec();
+      if (m.mocap_msg) {
+        int64_t time = m.mocap_msg->header.stamp.toNSec();
 
-        mocap_msgs.push_back(mocap_msg);
+        mocap_msgs.push_back(m.mocap_msg);
 
-        int64_t msg_arrival_time = m.getTime().toNSec();
         system_to_mocap_offset_vec.push_back(time - msg_arrival_time);
       }
 
-      if (point_topic == topic) {
-        geometry_msgs::PointStampedConstPtr mocap_msg =
-            m.instantiate<geometry_msgs::PointStamped>();
-
-        int64_t time = mocap_msg->header.stamp.toNSec();
+      if (m.point_msg) {
+        int64_t time = m.point_msg->header.stamp.toNSec();
 
-        point_msgs.push_back(mocap_msg);
+        point_msgs.push_back(m.point_msg);
 
-        int64_t msg_arrival_time = m.getTime().toNSec();
         system_to_mocap_offset_vec.push_back(time - msg_arrival_time);
       }
 
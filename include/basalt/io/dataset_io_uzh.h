@@ -101,29 +101,11 @@ class UzhVioDataset : public VioDataset {
         cv::Mat img = cv::imread(full_image_path, cv::IMREAD_UNCHANGED);
 
         if (img.type() == CV_8UC1) {
-          res[i].img.reset(new ManagedImage<uint16_t>(img.cols, img.rows));
-
-          const uint8_t *data_in = img.ptr();
-          uint16_t *data_out = res[i].img->ptr;
-
-          size_t full_size = img.cols * img.rows;
-          for (size_t i = 0; i < full_size; i++) {
-            int val = data_in[i];
-            val = val << 8;
-            data_out[i] = val;
-          }
+          res[i].setFrom8Bit(img.ptr(), img.cols, img.rows, 1,
+                             native_8bit_images);
         } else if (img.type() == CV_8UC3) {
-          res[i].img.reset(new ManagedImage<uint16_t>(img.cols, img.rows));
-
-          const uint8_t *data_in = img.ptr();
-          uint16_t *data_out = res[i].img->ptr;
-
-          size_t full_size = img.cols * img.rows;
-          for (size_t i = 0; i < full_size; i++) {
-            int val = data_in[i * 3];
-            val = val << 8;
-            data_out[i] = val;
-          }
+          res[i].setFrom8Bit(img.ptr(), img.cols, img.rows, 3,
+                             native_8bit_images);
         } else if (img.type() == CV_16UC1) {
           res[i].img.reset(new ManagedImage<uint16_t>(img.cols, img.rows));
           std::memcpy(res[i].img->ptr, img.ptr(),
@@ -63,7 +63,9 @@ class MargDataLoader {
  public:
   using Ptr = std::shared_ptr<MargDataLoader>;
 
-  MargDataLoader();
+  // The stored optical flow results with the images are deserialized on
+  // num_load_threads threads, 0 loads them on the loader thread
+  explicit MargDataLoader(size_t num_load_threads = 0);
 
   void start(const std::string& path);
   ~MargDataLoader() {
@@ -74,5 +76,7 @@ class MargDataLoader {
 
  private:
   std::shared_ptr<std::thread> processing_thread;
+
+  size_t num_load_threads;
 };
 }  // namespace basalt
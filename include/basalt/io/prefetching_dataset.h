@@ -0,0 +1,130 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <basalt/io/dataset_io.h>
+
+namespace basalt {
+
+// VioDataset that loads the images of the frames following the last
+// requested one in the background. Wraps another dataset and forwards all
+// other data to it.
+//
+// A call to get_image_data(t_ns) for a timestamp of get_image_timestamps()
+// schedules the next lookahead frames for decoding on num_threads threads
+// and returns the images of t_ns as soon as they are ready. Frames before
+// t_ns are dropped, so memory use is bounded by lookahead + 1 frames.
+// Reading the frames in timestamp order, as done when feeding the optical
+// flow, hits the prefetched frames. Frames before the window are loaded on
+// the calling thread without moving the window, so a second reader lagging
+// behind, like the GUI, doesn't discard the prefetched frames. A jump ahead
+// restarts the prefetching at the new position. With num_threads 0 the
+// images are loaded on the calling thread.
+//
+// The images are loaded with the native_8bit_images setting of the wrapped
+// dataset at the time the wrapper is created. get_image_timestamps() must
+// not be modified while images are being loaded.
+class PrefetchingVioDataset : public VioDataset {
+ public:
+  PrefetchingVioDataset(const VioDatasetPtr &dataset, size_t num_threads,
+                        size_t lookahead);
+
+  ~PrefetchingVioDataset() override;
+
+  size_t get_num_cams() const override { return dataset->get_num_cams(); }
+
+  std::vector<int64_t> &get_image_timestamps() override {
+    return dataset->get_image_timestamps();
+  }
+
+  const Eigen::aligned_vector<AccelData> &get_accel_data() const override {
+    return dataset->get_accel_data();
+  }
+  const Eigen::aligned_vector<GyroData> &get_gyro_data() const override {
+    return dataset->get_gyro_data();
+  }
+  const std::vector<int64_t> &get_gt_timestamps() const override {
+    return dataset->get_gt_timestamps();
+  }
+  const Eigen::aligned_vector<Sophus::SE3d> &get_gt_pose_data()
+      const override {
+    return dataset->get_gt_pose_data();
+  }
+  int64_t get_mocap_to_imu_offset_ns() const override {
+    return dataset->get_mocap_to_imu_offset_ns();
+  }
+
+  std::vector<ImageData> get_image_data(int64_t t_ns) override;
+
+  // Number of get_image_data() calls that found the frame already loaded
+  // or being loaded, and that had to start loading it.
+  size_t numPrefetchHits() const;
+  size_t numPrefetchMisses() const;
+
+ private:
+  struct Frame {
+    using Ptr = std::shared_ptr<Frame>;
+
+    int64_t t_ns = 0;
+    bool done = false;
+    std::vector<ImageData> img_data;
+  };
+
+  void decodeLoop();
+
+  VioDatasetPtr dataset;
+  size_t lookahead;
+
+  mutable std::mutex mutex;
+  std::condition_variable cv_queue, cv_done;
+
+  // Frames of the current window by timestamp, and frames waiting for a
+  // decode thread in timestamp order
+  std::map<int64_t, Frame::Ptr> window;
+  std::deque<Frame::Ptr> queue;
+  bool stop = false;
+
+  size_t num_hits = 0, num_misses = 0;
+
+  std::vector<std::thread> threads;
+};
+
+}  // namespace basalt
@@ -16,11 +16,21 @@ class ImuBlock {
 
   using MatX = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
 
+  // Jacobian and residual of the start and end state, fixed-size so that a
+  // block does not allocate
+  using MatJ =
+      Eigen::Matrix<Scalar, POSE_VEL_BIAS_SIZE, 2 * POSE_VEL_BIAS_SIZE>;
+  using VecR = Eigen::Matrix<Scalar, POSE_VEL_BIAS_SIZE, 1>;
+
   ImuBlock(const IntegratedImuMeasurement<Scalar>* meas,
            const ImuLinData<Scalar>* imu_lin_data, const AbsOrderMap& aom)
-      : imu_meas(meas), imu_lin_data(imu_lin_data), aom(aom) {
-    Jp.resize(POSE_VEL_BIAS_SIZE, 2 * POSE_VEL_BIAS_SIZE);
-    r.resize(POSE_VEL_BIAS_SIZE);
+      : imu_meas(meas), imu_lin_data(imu_lin_data), aom(aom) {}
+
+  // Reuses the block for another measurement with the same order
+  void setMeasurement(const IntegratedImuMeasurement<Scalar>* meas,
+                      const ImuLinData<Scalar>* imu_lin_data) {
+    this->imu_meas = meas;
+    this->imu_lin_data = imu_lin_data;
   }
 
   Scalar linearizeImu(
@@ -125,15 +135,18 @@ class ImuBlock {
     Q2r.template segment<POSE_VEL_BIAS_SIZE>(row_start_idx) += r;
   }
 
-  void add_dense_H_b(DenseAccumulator<Scalar>& accum) const {
+  template <class AccumT>
+  void add_dense_H_b(AccumT& accum) const {
     int64_t start_t = imu_meas->get_start_t_ns();
     int64_t end_t = imu_meas->get_start_t_ns() + imu_meas->get_dt_ns();
 
     const size_t start_idx = aom.abs_order_map.at(start_t).first;
     const size_t end_idx = aom.abs_order_map.at(end_t).first;
 
-    const MatX H = Jp.transpose() * Jp;
-    const VecX b = Jp.transpose() * r;
+    const Eigen::Matrix<Scalar, 2 * POSE_VEL_BIAS_SIZE, 2 * POSE_VEL_BIAS_SIZE>
+        H = Jp.transpose() * Jp;
+    const Eigen::Matrix<Scalar, 2 * POSE_VEL_BIAS_SIZE, 1> b =
+        Jp.transpose() * r;
 
     accum.template addH<POSE_VEL_BIAS_SIZE, POSE_VEL_BIAS_SIZE>(
         start_idx, start_idx,
@@ -201,7 +214,7 @@ class ImuBlock {
     const size_t start_idx = aom.abs_order_map.at(start_t).first;
     const size_t end_idx = aom.abs_order_map.at(end_t).first;
 
-    VecX pose_inc_reduced(2 * POSE_VEL_BIAS_SIZE);
+    Eigen::Matrix<Scalar, 2 * POSE_VEL_BIAS_SIZE, 1> pose_inc_reduced;
     pose_inc_reduced.template head<POSE_VEL_BIAS_SIZE>() =
         pose_inc.template segment<POSE_VEL_BIAS_SIZE>(start_idx);
     pose_inc_reduced.template tail<POSE_VEL_BIAS_SIZE>() =
@@ -218,14 +231,16 @@ class ImuBlock {
     //            = - incT JT (r + 0.5 J inc)
     //            = - (J inc)T (r + 0.5 (J inc))
 
-    VecX Jinc = Jp * pose_inc_reduced;
+    const VecR Jinc = Jp * pose_inc_reduced;
     l_diff -= Jinc.transpose() * (Scalar(0.5) * Jinc + r);
   }
 
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
  protected:
   std::array<FrameId, 2> frame_ids;
-  MatX Jp;
-  VecX r;
+  MatJ Jp;
+  VecR r;
 
   const IntegratedImuMeasurement<Scalar>* imu_meas;
   const ImuLinData<Scalar>* imu_lin_data;
@@ -65,6 +65,19 @@ class LandmarkBlock {
 
   using RowMat3 = Eigen::Matrix<Scalar, 3, 3, Eigen::RowMajor>;
 
+  // Landmarks with this many observations get a block with the number of
+  // storage rows fixed at compile time, others a fully dynamic one
+  static constexpr size_t MIN_FIXED_SIZE_OBS = 2;
+  static constexpr size_t MAX_FIXED_SIZE_OBS = 8;
+
+  // Type of the block created for a landmark with num_obs observations: the
+  // number of observations for fixed-size blocks and 0 for dynamic blocks
+  static inline size_t blockType(size_t num_obs) {
+    return num_obs >= MIN_FIXED_SIZE_OBS && num_obs <= MAX_FIXED_SIZE_OBS
+               ? num_obs
+               : 0;
+  }
+
   virtual ~LandmarkBlock(){};
 
   virtual bool isNumericalFailure() const = 0;
@@ -74,7 +87,14 @@ class LandmarkBlock {
                                          RelPoseLin<Scalar>>& relative_pose_lin,
       const Calibration<Scalar>& calib, const AbsOrderMap& aom,
       const Options& options,
-      const std::map<TimeCamId, size_t>* rel_order = nullptr) = 0;
+      const std::map<TimeCamId, size_t>* rel_order = nullptr,
+      Scalar* storage_data = nullptr) = 0;
+
+  // Number of scalars of the dense storage for the landmark. If storage_data
+  // is given to allocateLandmark, it has to point to that many scalars,
+  // aligned to EIGEN_MAX_ALIGN_BYTES. Otherwise the block allocates its own.
+  virtual size_t storageSize(const Keypoint<Scalar>& lm,
+                             const AbsOrderMap& aom) const = 0;
 
   // may set state to NumericalFailure --> linearization at this state is
   // unusable. Numeric check is only performed for residuals that were
@@ -116,6 +136,10 @@ class LandmarkBlock {
 
   virtual void add_dense_H_b(MatX& H, VecX& b) const = 0;
 
+  // Adds only the blocks of the poses the landmark is observed in
+  virtual void add_block_sparse_H_b(
+      BlockSparseAccumulator<Scalar>& accum) const = 0;
+
   virtual void add_dense_H_b_rel(
       MatX& H_rel, VecX& b_rel,
       const std::map<TimeCamId, size_t>& rel_order) const = 0;
@@ -132,9 +156,14 @@ class LandmarkBlock {
 
   virtual size_t numQ2rows() const = 0;
 
-  // factory method
+  // Type of the block as returned by blockType(). Fixed-size blocks can only
+  // be allocated for landmarks of their type, dynamic blocks for any.
+  virtual size_t getBlockType() const = 0;
+
+  // factory method, the block is specialized for num_obs observations
   template <int POSE_SIZE>
-  static std::unique_ptr<LandmarkBlock<Scalar>> createLandmarkBlock();
+  static std::unique_ptr<LandmarkBlock<Scalar>> createLandmarkBlock(
+      size_t num_obs);
 };
 
 }  // namespace basalt
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
 #include <mutex>
 
 #include <basalt/utils/ba_utils.h>
+#include <basalt/utils/camera_batch.h>
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include <basalt/linearization/landmark_block.hpp>
@@ -11,7 +13,11 @@
 
 namespace basalt {
 
-template <typename Scalar, int POSE_SIZE>
+// Landmark block with absolute pose Jacobians. The number of columns always
+// depends on the window size. If NUM_OBS is given, the block only holds
+// landmarks with that many observations and the number of rows is known at
+// compile time, so the QR and the products over the rows are fixed-size.
+template <typename Scalar, int POSE_SIZE, int NUM_OBS = Eigen::Dynamic>
 class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
  public:
   using Options = typename LandmarkBlock<Scalar>::Options;
@@ -33,18 +39,31 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
   using RowMatX =
       Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
 
+  // rows of the storage and rows without the landmark damping
+  static constexpr int ROWS =
+      NUM_OBS == Eigen::Dynamic ? Eigen::Dynamic : 2 * NUM_OBS + 3;
+  static constexpr int Q_ROWS =
+      NUM_OBS == Eigen::Dynamic ? Eigen::Dynamic : 2 * NUM_OBS;
+
+  using VecQ = Eigen::Matrix<Scalar, Q_ROWS, 1>;
+
   virtual inline void allocateLandmark(
       Keypoint<Scalar>& lm,
       const Eigen::aligned_unordered_map<std::pair<TimeCamId, TimeCamId>,
                                          RelPoseLin<Scalar>>& relative_pose_lin,
       const Calibration<Scalar>& calib, const AbsOrderMap& aom,
       const Options& options,
-      const std::map<TimeCamId, size_t>* rel_order = nullptr) override {
-    // some of the logic assumes the members are at their initial values
-    BASALT_ASSERT(state == State::Uninitialized);
-
+      const std::map<TimeCamId, size_t>* rel_order = nullptr,
+      Scalar* storage_data = nullptr) override {
+    // The block can be allocated again for another landmark or after the
+    // observations of the landmark changed. The containers keep their
+    // capacity, so this does not allocate for landmarks of similar size.
     UNUSED(rel_order);
 
+    // Fixed-size blocks only fit their number of observations
+    BASALT_ASSERT(NUM_OBS == Eigen::Dynamic ||
+                  lm.obs.size() == size_t(NUM_OBS));
+
     lm_ptr = &lm;
     options_ = &options;
     calib_ = &calib;
@@ -57,8 +76,22 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
 
     pose_lin_vec.clear();
     pose_lin_vec.reserve(lm.obs.size());
+    pose_col_idx.clear();
+    pose_col_idx.reserve(lm.obs.size() + 1);
+    pose_col_idx.push_back(aom.abs_order_map.at(lm.host_kf_id.frame_id).first);
     pose_tcid_vec.clear();
     pose_tcid_vec.reserve(lm.obs.size());
+    obs_batch_row.clear();
+    obs_batch_row.reserve(lm.obs.size());
+
+    // one batch per camera, empty if the camera does not observe the landmark
+    projection_batches.resize(calib.intrinsics.size());
+    for (size_t cam_id = 0; cam_id < projection_batches.size(); cam_id++) {
+      projection_batches[cam_id].cam_id = cam_id;
+      projection_batches[cam_id].obs_idx.clear();
+    }
+
+    Jl_col_scale.setOnes();
 
     // LMBs without host frame should not be created
     BASALT_ASSERT(aom.abs_order_map.count(lm.host_kf_id.frame_id) > 0);
@@ -69,27 +102,32 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
       auto it = relative_pose_lin.find(std::make_pair(lm.host_kf_id, tcid_t));
       BASALT_ASSERT(it != relative_pose_lin.end());
 
-      if (aom.abs_order_map.count(tcid_t.frame_id) > 0) {
+      auto it_t = aom.abs_order_map.find(tcid_t.frame_id);
+      if (it_t != aom.abs_order_map.end()) {
         pose_lin_vec.push_back(&it->second);
+        pose_col_idx.push_back(it_t->second.first);
       } else {
         // Observation droped for marginalization
         pose_lin_vec.push_back(nullptr);
       }
       pose_tcid_vec.push_back(&it->first);
 
-      res_idx_by_abs_pose_[it->first.first.frame_id].insert(i);   // host
-      res_idx_by_abs_pose_[it->first.second.frame_id].insert(i);  // target
+      ProjectionBatch& batch = projection_batches[tcid_t.cam_id];
+      obs_batch_row.emplace_back(tcid_t.cam_id, batch.obs_idx.size());
+      batch.obs_idx.push_back(i);
     }
 
+    std::sort(pose_col_idx.begin(), pose_col_idx.end());
+    pose_col_idx.erase(std::unique(pose_col_idx.begin(), pose_col_idx.end()),
+                       pose_col_idx.end());
+
     // number of pose-jacobian columns is determined by oam
     padding_idx = aom_->total_size;
 
-    num_rows = pose_lin_vec.size() * 2 + 3;  // residuals and lm damping
+    num_rows = numRows(lm);
 
     size_t pad = padding_idx % 4;
-    if (pad != 0) {
-      padding_size = 4 - pad;
-    }
+    padding_size = pad != 0 ? 4 - pad : 0;
 
     lm_idx = padding_idx + padding_size;
     res_idx = lm_idx + 3;
@@ -98,8 +136,31 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
     // number of columns should now be multiple of 4 for good memory alignment
     // TODO: test extending this to 8 --> 32byte alignment for float?
     BASALT_ASSERT(num_cols % 4 == 0);
-
-    storage.resize(num_rows, num_cols);
+    BASALT_ASSERT(num_cols == numCols(aom));
+
+    if (!storage_data) {
+      // The buffer grows by half its size when it is too small, so that the
+      // block keeps its memory while the landmark gains observations.
+      const Eigen::Index storage_size = num_rows * num_cols;
+      if (storage_buffer.size() < storage_size) {
+        storage_buffer.resize(
+            std::max(storage_size, storage_buffer.size() * 3 / 2));
+      }
+      storage_data = storage_buffer.data();
+    }
+    new (&storage) StorageMap(storage_data, num_rows, num_cols);
+
+    // Sized here so that linearizeLandmark does not resize them. Blocks with
+    // a fixed number of observations have batches of fixed capacity, the
+    // others only reallocate when the number of observations of a camera
+    // changes.
+    for (ProjectionBatch& batch : projection_batches) {
+      const Eigen::Index n = batch.obs_idx.size();
+      batch.p3d.resize(n, 4);
+      batch.proj.resize(n, 2);
+      batch.d_proj_d_p3d.resize(n, 8);
+      batch.valid.resize(n);
+    }
 
     damping_rotations.clear();
     damping_rotations.reserve(6);
@@ -107,6 +168,11 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
     state = State::Allocated;
   }
 
+  virtual inline size_t storageSize(const Keypoint<Scalar>& lm,
+                                    const AbsOrderMap& aom) const override {
+    return numRows(lm) * numCols(aom);
+  }
+
   // may set state to NumericalFailure --> linearization at this state is
   // unusable. Numeric check is only performed for residuals that were
   // considered to be used (valid), which depends on
@@ -125,70 +191,97 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
 
     Scalar error_sum = 0;
 
+    // The landmark point in the host frame is shared by all observations
+    Eigen::Matrix<Scalar, 4, 2> Jup;
+    Vec4 p_h_3d =
+        StereographicParam<Scalar>::unproject(lm_ptr->direction, &Jup);
+    p_h_3d[3] = lm_ptr->inv_dist;
+
+    // Project the points in the target frames in one batch per camera. Rows
+    // of dropped observations are projected as well, but not used.
+    for (ProjectionBatch& batch : projection_batches) {
+      if (batch.obs_idx.empty()) continue;
+
+      for (size_t k = 0; k < batch.obs_idx.size(); k++) {
+        const RelPoseLin<Scalar>* pose_lin = pose_lin_vec[batch.obs_idx[k]];
+        if (pose_lin) {
+          batch.p3d.row(k) = (pose_lin->T_t_h * p_h_3d).transpose();
+        } else {
+          batch.p3d.row(k) = p_h_3d.transpose();
+        }
+      }
+
+      projectBatch(calib_->intrinsics[batch.cam_id], batch.p3d, batch.proj,
+                   batch.valid, &batch.d_proj_d_p3d);
+    }
+
     size_t i = 0;
     for (const auto& [tcid_t, obs] : lm_ptr->obs) {
-      std::visit(
-          [&, obs = obs](const auto& cam) {
-            // TODO: The pose_lin_vec[i] == nullptr is intended to deal with
-            // dropped measurements during marginalization. However, dropped
-            // measurements should only occur for the remaining frames, not for
-            // the marginalized frames. Maybe these are observations bewtween
-            // two marginalized frames, if more than one is marginalized at the
-            // same time? But those we would not have to drop... Double check if
-            // and when this happens and possibly resolve by fixing handling
-            // here, or else updating the measurements in lmdb before calling
-            // linearization. Otherwise, check where else we need a `if
-            // (pose_lin_vec[i])` check or `pose_lin_vec[i] != nullptr` assert
-            // in this class.
-
-            if (pose_lin_vec[i]) {
-              size_t obs_idx = i * 2;
-              size_t abs_h_idx =
-                  aom_->abs_order_map.at(pose_tcid_vec[i]->first.frame_id)
-                      .first;
-              size_t abs_t_idx =
-                  aom_->abs_order_map.at(pose_tcid_vec[i]->second.frame_id)
-                      .first;
-
-              Vec2 res;
-              Eigen::Matrix<Scalar, 2, POSE_SIZE> d_res_d_xi;
-              Eigen::Matrix<Scalar, 2, 3> d_res_d_p;
-
-              using CamT = std::decay_t<decltype(cam)>;
-              bool valid = linearizePoint<Scalar, CamT>(
-                  obs, *lm_ptr, pose_lin_vec[i]->T_t_h, cam, res, &d_res_d_xi,
-                  &d_res_d_p);
-
-              if (!options_->use_valid_projections_only || valid) {
-                numerically_valid = numerically_valid &&
-                                    d_res_d_xi.array().isFinite().all() &&
-                                    d_res_d_p.array().isFinite().all();
-
-                const Scalar res_squared = res.squaredNorm();
-                const auto [weighted_error, weight] =
-                    compute_error_weight(res_squared);
-                const Scalar sqrt_weight =
-                    std::sqrt(weight) / options_->obs_std_dev;
-
-                error_sum += weighted_error /
-                             (options_->obs_std_dev * options_->obs_std_dev);
-
-                storage.template block<2, 3>(obs_idx, lm_idx) =
-                    sqrt_weight * d_res_d_p;
-                storage.template block<2, 1>(obs_idx, res_idx) =
-                    sqrt_weight * res;
-
-                d_res_d_xi *= sqrt_weight;
-                storage.template block<2, 6>(obs_idx, abs_h_idx) +=
-                    d_res_d_xi * pose_lin_vec[i]->d_rel_d_h;
-                storage.template block<2, 6>(obs_idx, abs_t_idx) +=
-                    d_res_d_xi * pose_lin_vec[i]->d_rel_d_t;
-              }
-            }
-
-            i++;
-          },
-          calib_->intrinsics[tcid_t.cam_id].variant);
+      UNUSED(tcid_t);
+
+      // TODO: The pose_lin_vec[i] == nullptr is intended to deal with
+      // dropped measurements during marginalization. However, dropped
+      // measurements should only occur for the remaining frames, not for
+      // the marginalized frames. Maybe these are observations bewtween
+      // two marginalized frames, if more than one is marginalized at the
+      // same time? But those we would not have to drop... Double check if
+      // and when this happens and possibly resolve by fixing handling
+      // here, or else updating the measurements in lmdb before calling
+      // linearization. Otherwise, check where else we need a `if
+      // (pose_lin_vec[i])` check or `pose_lin_vec[i] != nullptr` assert
+      // in this class.
+
+      if (pose_lin_vec[i]) {
+        size_t obs_idx = i * 2;
+        size_t abs_h_idx =
+            aom_->abs_order_map.at(pose_tcid_vec[i]->first.frame_id).first;
+        size_t abs_t_idx =
+            aom_->abs_order_map.at(pose_tcid_vec[i]->second.frame_id).first;
+
+        const auto [batch_idx, row] = obs_batch_row[i];
+        const ProjectionBatch& batch = projection_batches[batch_idx];
+
+        const Vec4 p_t_3d = batch.p3d.row(row).transpose();
+        Vec2 res = batch.proj.row(row).transpose();
+        Eigen::Matrix<Scalar, 2, 4> Jp;
+        Eigen::Map<Eigen::Matrix<Scalar, 1, 8>>(Jp.data()) =
+            batch.d_proj_d_p3d.row(row);
+
+        const bool valid = batch.valid[row] && res.array().isFinite().all();
+
+        if (!options_->use_valid_projections_only || valid) {
+          Eigen::Matrix<Scalar, 2, POSE_SIZE> d_res_d_xi;
+          Eigen::Matrix<Scalar, 2, 3> d_res_d_p;
+
+          linearizeProjection(obs, *lm_ptr, pose_lin_vec[i]->T_t_h, Jup,
+                              p_t_3d, Jp, res, &d_res_d_xi, &d_res_d_p);
+
+          numerically_valid = numerically_valid &&
+                              d_res_d_xi.array().isFinite().all() &&
+                              d_res_d_p.array().isFinite().all();
+
+          const Scalar res_squared = res.squaredNorm();
+          const auto [weighted_error, weight] =
+              compute_error_weight(res_squared);
+          const Scalar sqrt_weight =
+              std::sqrt(weight) / options_->obs_std_dev;
+
+          error_sum += weighted_error /
+                       (options_->obs_std_dev * options_->obs_std_dev);
+
+          storage.template block<2, 3>(obs_idx, lm_idx) =
+              sqrt_weight * d_res_d_p;
+          storage.template block<2, 1>(obs_idx, res_idx) = sqrt_weight * res;
+
+          d_res_d_xi *= sqrt_weight;
+          storage.template block<2, 6>(obs_idx, abs_h_idx) +=
+              d_res_d_xi * pose_lin_vec[i]->d_rel_d_h;
+          storage.template block<2, 6>(obs_idx, abs_t_idx) +=
+              d_res_d_xi * pose_lin_vec[i]->d_rel_d_t;
+        }
+      }
+
+      i++;
     }
 
     if (numerically_valid) {
@@ -270,7 +363,8 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
                           .template triangularView<Eigen::Upper>();
 
     const auto Q1Jr = storage.col(res_idx).template head<3>();
-    const auto Q1Jp = storage.topLeftCorner(3, padding_idx);
+    const auto Q1Jp = storage.template topLeftCorner<3, Eigen::Dynamic>(
+        3, padding_idx);
 
     Vec3 inc = -Q1Jl.solve(Q1Jr + Q1Jp * pose_inc);
 
@@ -311,12 +405,12 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
     setLandmarkDamping(0);
 
     // compute "Q^T J incp"
-    VecX QJinc = storage.topLeftCorner(num_rows - 3, padding_idx) * pose_inc;
+    VecQ QJinc = Jp_rows(0) * pose_inc;
 
     // add "Q1^T Jl incl" to the first 3 rows
     QJinc.template head<3>() += Q1Jl * inc;
 
-    auto Qr = storage.col(res_idx).head(num_rows - 3);
+    const auto Qr = r_rows(0);
     l_diff -= QJinc.transpose() * (Scalar(0.5) * QJinc + Qr);
 
     // TODO: detect and handle case like ceres, allowing a few iterations but
@@ -354,14 +448,19 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
   virtual inline void addJp_diag2(VecX& res) const override {
     BASALT_ASSERT(state == State::Linearized);
 
-    for (const auto& [frame_id, idx_set] : res_idx_by_abs_pose_) {
+    auto add_block = [&](size_t i, int64_t frame_id) {
       const int pose_idx = aom_->abs_order_map.at(frame_id).first;
-      for (const int i : idx_set) {
-        const auto block = storage.block(2 * i, pose_idx, 2, POSE_SIZE);
+      const auto block = storage.block(2 * i, pose_idx, 2, POSE_SIZE);
 
-        res.template segment<POSE_SIZE>(pose_idx) +=
-            block.colwise().squaredNorm();
-      }
+      res.template segment<POSE_SIZE>(pose_idx) +=
+          block.colwise().squaredNorm();
+    };
+
+    // host and target columns of every residual, once if they coincide
+    for (size_t i = 0; i < pose_tcid_vec.size(); i++) {
+      const auto& [tcid_h, tcid_t] = *pose_tcid_vec[i];
+      add_block(i, tcid_h.frame_id);
+      if (tcid_t.frame_id != tcid_h.frame_id) add_block(i, tcid_t.frame_id);
     }
   }
 
@@ -378,10 +477,10 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
     // we use 1.0 / (eps + sqrt(SquaredColumnNorm))
     Jl_col_scale =
         (options_->jacobi_scaling_eps +
-         storage.block(0, lm_idx, num_rows - 3, 3).colwise().norm().array())
+         Jl_rows().colwise().norm().array())
             .inverse();
 
-    storage.block(0, lm_idx, num_rows - 3, 3) *= Jl_col_scale.asDiagonal();
+    Jl_rows() *= Jl_col_scale.asDiagonal();
   }
 
   virtual inline void scaleJp_cols(const VecX& jacobian_scaling) override {
@@ -390,8 +489,7 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
     // we assume we apply scaling before damping (we exclude the last 3 rows)
     BASALT_ASSERT(!hasLandmarkDamping());
 
-    storage.topLeftCorner(num_rows - 3, padding_idx) *=
-        jacobian_scaling.asDiagonal();
+    Jp_rows(0) *= jacobian_scaling.asDiagonal();
   }
 
   inline bool hasLandmarkDamping() const { return !damping_rotations.empty(); }
@@ -440,6 +538,10 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
 
   virtual inline size_t numQ2rows() const override { return num_rows - 3; }
 
+  virtual inline size_t getBlockType() const override {
+    return NUM_OBS == Eigen::Dynamic ? 0 : NUM_OBS;
+  }
+
  protected:
   inline void performQRGivens() {
     // Based on "Matrix Computations 4th Edition by Golub and Van Loan"
@@ -455,20 +557,34 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
 
   inline void performQRHouseholder() {
     VecX tempVector1(num_cols);
-    VecX tempVector2(num_rows - 3);
-
-    for (size_t k = 0; k < 3; ++k) {
-      size_t remainingRows = num_rows - k - 3;
 
-      Scalar beta;
-      Scalar tau;
-      storage.col(lm_idx + k)
-          .segment(k, remainingRows)
-          .makeHouseholder(tempVector2, tau, beta);
+    performQRHouseholderStep<0>(tempVector1);
+    performQRHouseholderStep<1>(tempVector1);
+    performQRHouseholderStep<2>(tempVector1);
+  }
 
-      storage.block(k, 0, remainingRows, num_cols)
-          .applyHouseholderOnTheLeft(tempVector2, tau, tempVector1.data());
-    }
+  // Householder reflection for landmark column K. The rows it touches are
+  // fixed-size for fixed-size blocks.
+  template <int K>
+  inline void performQRHouseholderStep(VecX& tempVector1) {
+    constexpr int REMAINING_ROWS =
+        Q_ROWS == Eigen::Dynamic ? Eigen::Dynamic : Q_ROWS - K;
+    constexpr int ESSENTIAL_SIZE =
+        Q_ROWS == Eigen::Dynamic ? Eigen::Dynamic : REMAINING_ROWS - 1;
+    const Eigen::Index remainingRows = num_rows - K - 3;
+
+    Eigen::Matrix<Scalar, ESSENTIAL_SIZE, 1> tempVector2(remainingRows - 1);
+
+    Scalar beta;
+    Scalar tau;
+    storage.col(lm_idx + K)
+        .template segment<REMAINING_ROWS>(K, remainingRows)
+        .makeHouseholder(tempVector2, tau, beta);
+
+    storage
+        .template block<REMAINING_ROWS, Eigen::Dynamic>(K, 0, remainingRows,
+                                                        num_cols)
+        .applyHouseholderOnTheLeft(tempVector2, tau, tempVector1.data());
   }
 
   inline std::tuple<Scalar, Scalar> compute_error_weight(
@@ -492,13 +608,12 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
 
   void get_dense_Q2Jp_Q2r(MatX& Q2Jp, VecX& Q2r,
                           size_t start_idx) const override {
-    Q2r.segment(start_idx, num_rows - 3) =
-        storage.col(res_idx).tail(num_rows - 3);
+    Q2r.template segment<Q_ROWS>(start_idx, num_rows - 3) = r_rows(3);
 
     BASALT_ASSERT(Q2Jp.cols() == signed_cast(padding_idx));
 
-    Q2Jp.block(start_idx, 0, num_rows - 3, padding_idx) =
-        storage.block(3, 0, num_rows - 3, padding_idx);
+    Q2Jp.template block<Q_ROWS, Eigen::Dynamic>(start_idx, 0, num_rows - 3,
+                                                padding_idx) = Jp_rows(3);
   }
 
   void get_dense_Q2Jp_Q2r_rel(
@@ -517,13 +632,40 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
   }
 
   void add_dense_H_b(MatX& H, VecX& b) const override {
-    const auto r = storage.col(res_idx).tail(num_rows - 3);
-    const auto J = storage.block(3, 0, num_rows - 3, padding_idx);
+    const auto r = r_rows(3);
+    const auto J = Jp_rows(3);
 
     H.noalias() += J.transpose() * J;
     b.noalias() += J.transpose() * r;
   }
 
+  void add_block_sparse_H_b(
+      BlockSparseAccumulator<Scalar>& accum) const override {
+    const auto r = r_rows(3);
+    const auto J = Jp_rows(3);
+
+    for (size_t i = 0; i < pose_col_idx.size(); i++) {
+      const auto J_i = J.template middleCols<POSE_SIZE>(pose_col_idx[i]);
+
+      accum.template addB<POSE_SIZE>(pose_col_idx[i], J_i.transpose() * r);
+
+      // Both halves are added, the accumulator keeps the one below the
+      // diagonal of its elimination order
+      for (size_t j = 0; j <= i; j++) {
+        const auto J_j = J.template middleCols<POSE_SIZE>(pose_col_idx[j]);
+        const Eigen::Matrix<Scalar, POSE_SIZE, POSE_SIZE> H_ij =
+            J_i.transpose() * J_j;
+
+        accum.template addH<POSE_SIZE, POSE_SIZE>(pose_col_idx[i],
+                                                  pose_col_idx[j], H_ij);
+        if (j < i) {
+          accum.template addH<POSE_SIZE, POSE_SIZE>(
+              pose_col_idx[j], pose_col_idx[i], H_ij.transpose());
+        }
+      }
+    }
+  }
+
   void add_dense_H_b_rel(
       MatX& H_rel, VecX& b_rel,
       const std::map<TimeCamId, size_t>& rel_order) const override {
@@ -553,16 +695,66 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
   virtual TimeCamId getHostKf() const override { return lm_ptr->host_kf_id; }
 
  private:
+  using StorageMap =
+      Eigen::Map<Eigen::Matrix<Scalar, ROWS, Eigen::Dynamic, Eigen::RowMajor>,
+                 Eigen::AlignedMax>;
+
+  // Pose Jacobians and residuals of num_rows - 3 rows starting at row start,
+  // fixed-size for fixed-size blocks
+  inline auto Jp_rows(Eigen::Index start) {
+    return storage.template block<Q_ROWS, Eigen::Dynamic>(
+        start, 0, num_rows - 3, padding_idx);
+  }
+  inline auto Jp_rows(Eigen::Index start) const {
+    return storage.template block<Q_ROWS, Eigen::Dynamic>(
+        start, 0, num_rows - 3, padding_idx);
+  }
+  inline auto r_rows(Eigen::Index start) const {
+    return storage.col(res_idx).template segment<Q_ROWS>(start, num_rows - 3);
+  }
+
+  // Landmark Jacobians of the residuals
+  inline auto Jl_rows() {
+    return storage.template block<Q_ROWS, 3>(0, lm_idx, num_rows - 3, 3);
+  }
+
+  // residuals and lm damping
+  static inline size_t numRows(const Keypoint<Scalar>& lm) {
+    return lm.obs.size() * 2 + 3;
+  }
+
+  // pose Jacobians padded to a multiple of 4, lm Jacobian and residual
+  static inline size_t numCols(const AbsOrderMap& aom) {
+    return (aom.total_size + 3) / 4 * 4 + 4;
+  }
+
   // Dense storage for pose Jacobians, padding, landmark Jacobians and
-  // residuals [J_p | pad | J_l | res]
-  Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      storage;
+  // residuals [J_p | pad | J_l | res]. A view on the memory given to
+  // allocateLandmark, or on the front of storage_buffer if there is none.
+  VecX storage_buffer;
+  StorageMap storage{nullptr, ROWS == Eigen::Dynamic ? 0 : ROWS, 0};
 
   Vec3 Jl_col_scale = Vec3::Ones();
   std::vector<Eigen::JacobiRotation<Scalar>> damping_rotations;
 
   std::vector<const RelPoseLin<Scalar>*> pose_lin_vec;
+  // Sorted first columns of the poses with non-zero Jacobians
+  std::vector<size_t> pose_col_idx;
   std::vector<const std::pair<TimeCamId, TimeCamId>*> pose_tcid_vec;
+
+  // Target points of the observations, projected in one batch per camera
+  struct ProjectionBatch {
+    size_t cam_id = 0;
+    std::vector<size_t> obs_idx;
+
+    typename CameraBatch<Scalar, NUM_OBS>::Points3d p3d;
+    typename CameraBatch<Scalar, NUM_OBS>::Points2d proj;
+    typename CameraBatch<Scalar, NUM_OBS>::Jacobians d_proj_d_p3d;
+    typename CameraBatch<Scalar, NUM_OBS>::Mask valid;
+  };
+  std::vector<ProjectionBatch> projection_batches;
+  // Batch and row of every observation
+  std::vector<std::pair<size_t, size_t>> obs_batch_row;
   size_t padding_idx = 0;
   size_t padding_size = 0;
   size_t lm_idx = 0;
@@ -578,8 +770,6 @@ class LandmarkBlockAbsDynamic : public LandmarkBlock<Scalar> {
   Keypoint<Scalar>* lm_ptr = nullptr;
   const Calibration<Scalar>* calib_ = nullptr;
   const AbsOrderMap* aom_ = nullptr;
-
-  std::map<int64_t, std::set<int>> res_idx_by_abs_pose_;
 };
 
 }  // namespace basalt
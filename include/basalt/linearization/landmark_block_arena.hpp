@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace basalt {
+
+// One slab of memory for the dense storage of all landmark blocks of a
+// linearization. The blocks are placed one after the other in the order of
+// the landmarks and every block starts on a cache line, so a parallel sweep
+// over the landmarks reads memory sequentially. The slab only grows and is
+// reused when the linearization is set up for the next frame.
+template <typename Scalar>
+class LandmarkBlockArena {
+ public:
+  static constexpr size_t ALIGNMENT = 64;
+
+  // Computes the offsets of num_blocks blocks in a prefix sum over their
+  // sizes in scalars, given by block_size(i), and grows the slab if needed.
+  // Pointers to blocks of a previous reset are invalid afterwards.
+  template <class F>
+  void reset(size_t num_blocks, F&& block_size) {
+    offsets.resize(num_blocks);
+
+    size_t total_size = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+      offsets[i] = total_size;
+      total_size += alignedSize(block_size(i));
+    }
+
+    if (total_size > capacity_) {
+      capacity_ = alignedSize(std::max(total_size, capacity_ * 3 / 2));
+
+      Scalar* ptr = static_cast<Scalar*>(
+          std::aligned_alloc(ALIGNMENT, capacity_ * sizeof(Scalar)));
+      if (!ptr) {
+        std::cerr << "Failed to allocate " << capacity_ * sizeof(Scalar)
+                  << " bytes for the landmark blocks." << std::endl;
+        std::abort();
+      }
+      data.reset(ptr);
+    }
+  }
+
+  inline Scalar* block(size_t i) const { return data.get() + offsets[i]; }
+
+  inline size_t numBlocks() const { return offsets.size(); }
+
+  // Number of scalars that fit in the slab
+  inline size_t capacity() const { return capacity_; }
+
+ private:
+  // Round up to full cache lines
+  static inline size_t alignedSize(size_t size) {
+    constexpr size_t n = ALIGNMENT / sizeof(Scalar);
+    return (size + n - 1) / n * n;
+  }
+
+  struct Free {
+    void operator()(Scalar* ptr) const { std::free(ptr); }
+  };
+
+  std::unique_ptr<Scalar, Free> data;
+  size_t capacity_ = 0;
+  std::vector<size_t> offsets;
+};
+
+}  // namespace basalt
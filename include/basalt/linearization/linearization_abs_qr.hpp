@@ -5,6 +5,7 @@
 #include <basalt/optimization/accumulator.h>
 #include <basalt/vi_estimator/landmark_database.h>
 #include <basalt/linearization/landmark_block.hpp>
+#include <basalt/linearization/landmark_block_arena.hpp>
 #include <basalt/utils/cast_utils.hpp>
 #include <basalt/utils/time_utils.hpp>
 
@@ -55,6 +56,14 @@ class LinearizationAbsQR : public LinearizationBase<Scalar_, POSE_SIZE_> {
   LinearizationAbsQR& operator=(const LinearizationAbsQR&) = default;
   LinearizationAbsQR& operator=(LinearizationAbsQR&&) = default;
 
+  bool reinitialize(
+      BundleAdjustmentBase<Scalar>* estimator, const AbsOrderMap& aom,
+      const Options& options, const MargLinData<Scalar>* marg_lin_data,
+      const ImuLinData<Scalar>* imu_lin_data,
+      const std::set<FrameId>* used_frames,
+      const std::unordered_set<KeypointId>* lost_landmarks,
+      int64_t last_state_to_marg) override;
+
   void log_problem_stats(ExecutionStats& stats) const override;
 
   Scalar linearizeProblem(bool* numerically_valid = nullptr) override;
@@ -79,6 +88,9 @@ class LinearizationAbsQR : public LinearizationBase<Scalar_, POSE_SIZE_> {
 
   void get_dense_H_b(MatX& H, VecX& b) const override;
 
+  void get_block_sparse_H_b(
+      BlockSparseAccumulator<Scalar>& accum) const override;
+
  protected:  // types
   using PoseLinMapType =
       Eigen::aligned_unordered_map<std::pair<TimeCamId, TimeCamId>,
@@ -88,7 +100,42 @@ class LinearizationAbsQR : public LinearizationBase<Scalar_, POSE_SIZE_> {
   using HostLandmarkMapType =
       std::unordered_map<TimeCamId, std::vector<const LandmarkBlock<Scalar>*>>;
 
+  // Pose of a frame, which is stored either as pose or as full IMU state
+  struct PoseStateRef {
+    const PoseStateWithLin<Scalar>* pose = nullptr;
+    const PoseVelBiasStateWithLin<Scalar>* state = nullptr;
+
+    inline const Sophus::SE3<Scalar>& getPoseLin() const {
+      return pose ? pose->getPoseLin() : state->getStateLin().T_w_i;
+    }
+
+    inline const Sophus::SE3<Scalar>& getPose() const {
+      return pose ? pose->getPose() : state->getState().T_w_i;
+    }
+
+    inline bool isLinearized() const {
+      return pose ? pose->isLinearized() : state->isLinearized();
+    }
+  };
+
+  // Host/target pair of a relative pose with the states it depends on. The
+  // pointers stay valid until the frames or observations change, which is
+  // followed by a new setupProblem.
+  struct RelPoseTask {
+    RelPoseLin<Scalar>* rpl;
+    TimeCamId tcid_h;
+    TimeCamId tcid_t;
+    PoseStateRef state_h;
+    PoseStateRef state_t;
+  };
+
  protected:  //  helper
+  // (Re-)creates the relative poses and landmark blocks for the current
+  // state of the landmark database, reusing the existing ones
+  void setupProblem(const std::unordered_set<KeypointId>* lost_landmarks);
+
+  PoseStateRef getPoseStateRef(int64_t t_ns) const;
+
   void get_dense_Q2Jp_Q2r_pose_damping(MatX& Q2Jp, size_t start_idx) const;
 
   void get_dense_Q2Jp_Q2r_marg_prior(MatX& Q2Jp, VecX& Q2r,
@@ -102,6 +149,9 @@ class LinearizationAbsQR : public LinearizationBase<Scalar_, POSE_SIZE_> {
 
   void add_dense_H_b_imu(MatX& H, VecX& b) const;
 
+  void add_block_sparse_H_b_marg_prior(
+      BlockSparseAccumulator<Scalar>& accum) const;
+
  protected:
   Options options_;
 
@@ -109,6 +159,15 @@ class LinearizationAbsQR : public LinearizationBase<Scalar_, POSE_SIZE_> {
   std::vector<LandmarkBlockPtr> landmark_blocks;
   std::vector<ImuBlockPtr> imu_blocks;
 
+  // dense storage of landmark_blocks, in the same order
+  LandmarkBlockArena<Scalar> landmark_storage;
+
+  // landmarks of the previous setup and unused blocks by block type, kept
+  // for reuse
+  std::vector<KeypointId> prev_landmark_ids;
+  std::vector<LandmarkBlockPtr> prev_landmark_blocks;
+  std::vector<std::vector<LandmarkBlockPtr>> free_landmark_blocks;
+
   std::unordered_map<TimeCamId, size_t> host_to_idx_;
   HostLandmarkMapType host_to_landmark_block;
 
@@ -128,6 +187,7 @@ class LinearizationAbsQR : public LinearizationBase<Scalar_, POSE_SIZE_> {
 
   PoseLinMapType relative_pose_lin;
   std::vector<std::vector<PoseLinMapTypeConstIter>> relative_pose_per_host;
+  std::vector<RelPoseTask> relative_pose_tasks;
 
   Scalar pose_damping_diagonal;
   Scalar pose_damping_diagonal_sqrt;
@@ -2,6 +2,10 @@
 
 #include <Eigen/Dense>
 
+#include <algorithm>
+#include <vector>
+
+#include <basalt/optimization/accumulator.h>
 #include <basalt/vi_estimator/ba_base.h>
 #include <basalt/linearization/landmark_block.hpp>
 #include <basalt/utils/time_utils.hpp>
@@ -48,6 +52,50 @@ class LinearizationBase {
 
   virtual void get_dense_H_b(MatX& H, VecX& b) const = 0;
 
+  // Same system as get_dense_H_b, added to accum, which has to be reset for
+  // the order. The default goes through the dense system, only ABS_QR adds
+  // the blocks directly.
+  virtual void get_block_sparse_H_b(
+      BlockSparseAccumulator<Scalar>& accum) const {
+    MatX H;
+    VecX b;
+    get_dense_H_b(H, b);
+    accum.addDense(0, H, b);
+  }
+
+  // Layout of a BlockSparseAccumulator for aom, in which the poses come
+  // before the states. The keyframe poses are one block, as the landmarks
+  // couple them densely, and every state is a block of its own. The states
+  // are eliminated first and the pose block last, so the fill-in of the
+  // factor stays within the blocks the states are coupled with.
+  static void getBlockSparseLayout(const AbsOrderMap& aom,
+                                   std::vector<int>& block_start,
+                                   std::vector<int>& elimination_order) {
+    int poses_size = 0;
+    for (const auto& kv : aom.abs_order_map) {
+      if (kv.second.second == POSE_SIZE) poses_size += POSE_SIZE;
+    }
+    const bool has_poses = poses_size > 0;
+
+    block_start.clear();
+    if (has_poses) block_start.push_back(0);
+    for (const auto& kv : aom.abs_order_map) {
+      if (kv.second.second == POSE_SIZE) {
+        BASALT_ASSERT(kv.second.first + POSE_SIZE <= poses_size);
+      } else {
+        BASALT_ASSERT(kv.second.first >= poses_size);
+        block_start.push_back(kv.second.first);
+      }
+    }
+    std::sort(block_start.begin(), block_start.end());
+
+    elimination_order.clear();
+    for (int k = has_poses; k < int(block_start.size()); k++) {
+      elimination_order.push_back(k);
+    }
+    if (has_poses) elimination_order.push_back(0);
+  }
+
   static std::unique_ptr<LinearizationBase> create(
       BundleAdjustmentBase<Scalar>* estimator, const AbsOrderMap& aom,
       const Options& options,
@@ -56,6 +104,34 @@ class LinearizationBase {
       const std::set<FrameId>* used_frames = nullptr,
       const std::unordered_set<KeypointId>* lost_landmarks = nullptr,
       int64_t last_state_to_marg = std::numeric_limits<int64_t>::max());
+
+  // Brings lin up to date with the landmark database of the estimator, with
+  // the same arguments as create(). Linearizations that support it are
+  // updated in place and keep the memory of their landmark blocks, others
+  // are created anew. aom has to outlive lin, the caller may modify it
+  // between updates.
+  static void update(
+      std::unique_ptr<LinearizationBase>& lin,
+      BundleAdjustmentBase<Scalar>* estimator, const AbsOrderMap& aom,
+      const Options& options,
+      const MargLinData<Scalar>* marg_lin_data = nullptr,
+      const ImuLinData<Scalar>* imu_lin_data = nullptr,
+      const std::set<FrameId>* used_frames = nullptr,
+      const std::unordered_set<KeypointId>* lost_landmarks = nullptr,
+      int64_t last_state_to_marg = std::numeric_limits<int64_t>::max());
+
+  // Re-initializes the linearization in place for the arguments of
+  // create(). Returns false if that is not supported for them.
+  virtual bool reinitialize(
+      BundleAdjustmentBase<Scalar>* /*estimator*/,
+      const AbsOrderMap& /*aom*/, const Options& /*options*/,
+      const MargLinData<Scalar>* /*marg_lin_data*/,
+      const ImuLinData<Scalar>* /*imu_lin_data*/,
+      const std::set<FrameId>* /*used_frames*/,
+      const std::unordered_set<KeypointId>* /*lost_landmarks*/,
+      int64_t /*last_state_to_marg*/) {
+    return false;
+  }
 };
 
 bool isLinearizationSqrt(const LinearizationType& type);
@@ -40,22 +40,30 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sophus/se2.hpp>
 
 #include <tbb/blocked_range.h>
-#include <tbb/concurrent_unordered_map.h>
+#include <tbb/flow_graph.h>
 #include <tbb/parallel_for.h>
 
 #include <basalt/optical_flow/optical_flow.h>
 #include <basalt/optical_flow/patch.h>
 
 #include <basalt/image/image_pyr.h>
+#include <basalt/utils/camera_batch.h>
 #include <basalt/utils/keypoints.h>
 
 namespace basalt {
 
-template <typename Scalar, template <typename> typename Pattern>
+template <typename Scalar, template <typename> typename Pattern,
+          typename Pixel>
 class FrameToFrameOpticalFlow : public OpticalFlowBase {
  public:
   typedef OpticalFlowPatch<Scalar, Pattern<Scalar>> PatchT;
 
+  // Reference patches of one keypoint, one per pyramid level.
+  typedef Eigen::aligned_vector<PatchT> PatchVec;
+  // Reference patches of all tracks of one camera, indexed like the
+  // KeypointTracks. Empty entries are created on demand.
+  typedef std::vector<PatchVec> PatchCache;
+
   typedef Eigen::Matrix<Scalar, 2, 1> Vector2;
   typedef Eigen::Matrix<Scalar, 2, 2> Matrix2;
 
@@ -69,10 +77,15 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
 
   FrameToFrameOpticalFlow(const VioConfig& config,
                           const basalt::Calibration<double>& calib)
-      : t_ns(-1), frame_counter(0), last_keypoint_id(0), config(config) {
+      : t_ns(-1),
+        frame_counter(0),
+        last_keypoint_id(0),
+        config(config),
+        iteration_stats(config.optical_flow_levels + 1) {
     input_queue.set_capacity(10);
 
     this->calib = calib.cast<Scalar>();
+    calib_gyro_bias = calib.calib_gyro_bias;
 
     patch_coord = PatchT::pattern2.template cast<float>();
 
@@ -83,17 +96,29 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
       E = Ed.cast<Scalar>();
     }
 
+    buildFrameGraph();
+
     processing_thread.reset(
         new std::thread(&FrameToFrameOpticalFlow::processingLoop, this));
   }
 
   ~FrameToFrameOpticalFlow() { processing_thread->join(); }
 
+  size_t numPyramidsAllocated() const override {
+    return pyramid_pool.numAllocated();
+  }
+  size_t numPyramidsReused() const override { return pyramid_pool.numReused(); }
+
   void processingLoop() {
+    BASALT_TRACE_THREAD_NAME("optical_flow");
+
     OpticalFlowInput::Ptr input_ptr;
 
     while (true) {
-      input_queue.pop(input_ptr);
+      {
+        BASALT_TRACE_SCOPE("input_queue.pop");
+        input_queue.pop(input_ptr);
+      }
 
       if (!input_ptr.get()) {
         if (output_queue) output_queue->push(nullptr);
@@ -105,111 +130,171 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
   }
 
   void processFrame(int64_t curr_t_ns, OpticalFlowInput::Ptr& new_img_vec) {
+    BASALT_TRACE_SCOPE("processFrame");
+
     for (const auto& v : new_img_vec->img_data) {
-      if (!v.img.get()) return;
+      if (v.empty()) return;
     }
 
     if (t_ns < 0) {
-      t_ns = curr_t_ns;
-
-      transforms.reset(new OpticalFlowResult);
-      transforms->observations.resize(calib.intrinsics.size());
-      transforms->t_ns = t_ns;
-
-      pyramid.reset(new std::vector<basalt::ManagedImagePyr<uint16_t>>);
-      pyramid->resize(calib.intrinsics.size());
-
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, calib.intrinsics.size()),
-                        [&](const tbb::blocked_range<size_t>& r) {
-                          for (size_t i = r.begin(); i != r.end(); ++i) {
-                            pyramid->at(i).setFromImage(
-                                *new_img_vec->img_data[i].img,
-                                config.optical_flow_levels);
-                          }
-                        });
-
-      transforms->input_images = new_img_vec;
-
-      addPoints();
-      filterPoints();
-
-    } else {
-      t_ns = curr_t_ns;
-
-      old_pyramid = pyramid;
-
-      pyramid.reset(new std::vector<basalt::ManagedImagePyr<uint16_t>>);
-      pyramid->resize(calib.intrinsics.size());
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, calib.intrinsics.size()),
-                        [&](const tbb::blocked_range<size_t>& r) {
-                          for (size_t i = r.begin(); i != r.end(); ++i) {
-                            pyramid->at(i).setFromImage(
-                                *new_img_vec->img_data[i].img,
-                                config.optical_flow_levels);
-                          }
-                        });
-
-      OpticalFlowResult::Ptr new_transforms;
-      new_transforms.reset(new OpticalFlowResult);
-      new_transforms->observations.resize(calib.intrinsics.size());
-      new_transforms->t_ns = t_ns;
-
-      for (size_t i = 0; i < calib.intrinsics.size(); i++) {
-        trackPoints(old_pyramid->at(i), pyramid->at(i),
-                    transforms->observations[i],
-                    new_transforms->observations[i]);
-      }
-
-      transforms = new_transforms;
-      transforms->input_images = new_img_vec;
+      patch_cache.resize(calib.intrinsics.size());
+    }
 
-      addPoints();
-      filterPoints();
+    if (config.optical_flow_use_gyro) {
+      R_c2_c1 = gyroCameraRotations(calib, t_ns < 0 ? curr_t_ns : t_ns,
+                                    curr_t_ns);
     }
 
+    t_ns = curr_t_ns;
+
+    old_pyramid = pyramid;
+    pyramid = pyramid_pool.get(calib.intrinsics.size());
+
+    // Empty for the first frame, then nothing is tracked
+    old_transforms = transforms;
+
+    transforms.reset(new OpticalFlowResult);
+    transforms->observations.resize(calib.intrinsics.size());
+    transforms->t_ns = t_ns;
+    transforms->input_images = new_img_vec;
+
+    frame_start->try_put(tbb::flow::continue_msg());
+    frame_graph.wait_for_all();
+
+    old_transforms.reset();
+
+    iteration_stats.collect(stats);
+
     if (output_queue && frame_counter % config.optical_flow_skip_frames == 0) {
+      if (latency_recorder) {
+        latency_recorder->record(transforms->t_ns,
+                                 FrameLatencyRecorder::OPTICAL_FLOW);
+      }
+      BASALT_TRACE_SCOPE("output_queue.push");
       output_queue->push(transforms);
     }
 
     frame_counter++;
   }
 
-  void trackPoints(const basalt::ManagedImagePyr<uint16_t>& pyr_1,
-                   const basalt::ManagedImagePyr<uint16_t>& pyr_2,
-                   const Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f>&
-                       transform_map_1,
-                   Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f>&
-                       transform_map_2) const {
-    size_t num_points = transform_map_1.size();
-
-    std::vector<KeypointId> ids;
-    Eigen::aligned_vector<Eigen::AffineCompact2f> init_vec;
-
-    ids.reserve(num_points);
-    init_vec.reserve(num_points);
+  // Per-frame work as a dependency graph, so that the stages of different
+  // cameras overlap instead of waiting for the slowest camera:
+  //
+  //   pyramid i -> temporal tracking i             (for every camera i)
+  //   tracking 0 -> detection in camera 0
+  //   detection, pyramid 1 -> stereo tracking of new points
+  //   stereo tracking, tracking 1 -> merge new points and filterPoints
+  void buildFrameGraph() {
+    using tbb::flow::continue_msg;
+
+    const size_t num_cams = calib.intrinsics.size();
+
+    frame_start.reset(new tbb::flow::broadcast_node<continue_msg>(frame_graph));
+
+    for (size_t i = 0; i < num_cams; i++) {
+      pyramid_nodes.emplace_back(new FrameNode(
+          frame_graph, [this, i](const continue_msg&) {
+            const auto img =
+                transforms->input_images->img_data[i].getImage<Pixel>();
+            pyramid->at(i).setFromImage(*img, config.optical_flow_levels,
+                                        config.optical_flow_pyramid_type);
+          }));
+
+      tracking_nodes.emplace_back(new FrameNode(
+          frame_graph, [this, i](const continue_msg&) {
+            if (!old_transforms) return;
+
+            // Only the patches of successfully tracked points are carried
+            // over, so the cache entries of lost tracks are dropped here.
+            PatchCache new_patch_cache;
+            trackPoints(old_pyramid->at(i), pyramid->at(i),
+                        old_transforms->observations[i],
+                        transforms->observations[i], patch_cache[i],
+                        new_patch_cache, i);
+            patch_cache[i].swap(new_patch_cache);
+          }));
+
+      tbb::flow::make_edge(*frame_start, *pyramid_nodes[i]);
+      tbb::flow::make_edge(*pyramid_nodes[i], *tracking_nodes[i]);
+    }
 
-    for (const auto& kv : transform_map_1) {
-      ids.push_back(kv.first);
-      init_vec.push_back(kv.second);
+    detection_node.reset(new FrameNode(
+        frame_graph, [this](const continue_msg&) { addPoints(); }));
+    tbb::flow::make_edge(*tracking_nodes[0], *detection_node);
+
+    if (num_cams > 1) {
+      stereo_tracking_node.reset(new FrameNode(
+          frame_graph, [this](const continue_msg&) { trackNewPoints(); }));
+      tbb::flow::make_edge(*detection_node, *stereo_tracking_node);
+      tbb::flow::make_edge(*pyramid_nodes[1], *stereo_tracking_node);
+
+      filter_node.reset(new FrameNode(
+          frame_graph, [this](const continue_msg&) {
+            mergeNewPoints();
+            filterPoints();
+          }));
+      tbb::flow::make_edge(*stereo_tracking_node, *filter_node);
+      tbb::flow::make_edge(*tracking_nodes[1], *filter_node);
     }
+  }
 
-    tbb::concurrent_unordered_map<KeypointId, Eigen::AffineCompact2f,
-                                  std::hash<KeypointId>>
-        result;
+  // Tracks the points of tracks_1 from pyr_1 to pyr_2. Reference patches in
+  // pyr_1 are taken from patches_1 (indexed like tracks_1) and are created
+  // there if missing. The patches built in pyr_2 for the backward consistency
+  // check are exactly the reference patches needed to track the point out of
+  // pyr_2, so for every accepted track they are appended to patches_2
+  // together with the track. For temporal tracking the camera is given as
+  // gyro_cam_id, then the gyro rotation between the frames provides the
+  // initial guesses if available.
+  void trackPoints(const basalt::ManagedImagePyr<Pixel>& pyr_1,
+                   const basalt::ManagedImagePyr<Pixel>& pyr_2,
+                   const KeypointTracks& tracks_1, KeypointTracks& tracks_2,
+                   PatchCache& patches_1, PatchCache& patches_2,
+                   int gyro_cam_id = -1) const {
+    BASALT_TRACE_SCOPE("trackPoints");
+
+    const size_t num_points = tracks_1.size();
+    BASALT_ASSERT(patches_1.size() == num_points);
+
+    const bool use_gyro = gyro_cam_id >= 0 && !R_c2_c1.empty();
+
+    Eigen::aligned_vector<Eigen::AffineCompact2f> result(num_points);
+    std::vector<uint8_t> result_valid(num_points, 0);
+    PatchCache result_patches(num_points);
 
     auto compute_func = [&](const tbb::blocked_range<size_t>& range) {
+      BASALT_TRACE_SCOPE("trackPointsRange");
       for (size_t r = range.begin(); r != range.end(); ++r) {
-        const KeypointId id = ids[r];
-
-        const Eigen::AffineCompact2f& transform_1 = init_vec[r];
+        const Eigen::AffineCompact2f transform_1 = tracks_1.transform(r);
         Eigen::AffineCompact2f transform_2 = transform_1;
 
-        bool valid = trackPoint(pyr_1, pyr_2, transform_1, transform_2);
+        if (use_gyro) {
+          transform_2.translation() = predictRotation<Scalar>(
+              calib.intrinsics[gyro_cam_id], R_c2_c1[gyro_cam_id],
+              transform_1.translation());
+        }
+
+        if (patches_1[r].empty()) {
+          createPatches(pyr_1, transform_1.translation(), patches_1[r]);
+        }
+
+        bool valid = trackPoint(patches_1[r], pyr_2, transform_1, transform_2);
 
         if (valid) {
           Eigen::AffineCompact2f transform_1_recovered = transform_2;
 
-          valid = trackPoint(pyr_2, pyr_1, transform_2, transform_1_recovered);
+          if (use_gyro) {
+            transform_1_recovered.translation() = predictRotation<Scalar>(
+                calib.intrinsics[gyro_cam_id],
+                Matrix3(R_c2_c1[gyro_cam_id].transpose()),
+                transform_2.translation());
+          }
+
+          PatchVec& patch_vec_2 = result_patches[r];
+          createPatches(pyr_2, transform_2.translation(), patch_vec_2);
+
+          valid = trackPoint(patch_vec_2, pyr_1, transform_2,
+                             transform_1_recovered);
 
           if (valid) {
             Scalar dist2 = (transform_1.translation() -
@@ -217,7 +302,8 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
                                .squaredNorm();
 
             if (dist2 < config.optical_flow_max_recovered_dist2) {
-              result[id] = transform_2;
+              result[r] = transform_2;
+              result_valid[r] = 1;
             }
           }
         }
@@ -229,12 +315,33 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
     tbb::parallel_for(range, compute_func);
     // compute_func(range);
 
-    transform_map_2.clear();
-    transform_map_2.insert(result.begin(), result.end());
+    tracks_2.clear();
+    tracks_2.reserve(num_points);
+    patches_2.clear();
+    patches_2.reserve(num_points);
+
+    for (size_t r = 0; r < num_points; r++) {
+      if (result_valid[r]) {
+        tracks_2.push_back(tracks_1.id(r), result[r]);
+        patches_2.emplace_back(std::move(result_patches[r]));
+      }
+    }
+  }
+
+  inline void createPatches(const basalt::ManagedImagePyr<Pixel>& pyr,
+                            const Vector2& pos, PatchVec& patch_vec) const {
+    patch_vec.resize(config.optical_flow_levels + 1);
+
+    // Levels below an invalid patch are never used for tracking
+    for (int level = config.optical_flow_levels; level >= 0; level--) {
+      const Scalar scale = 1 << level;
+      patch_vec[level].setFromImage(pyr.lvl(level), pos / scale);
+      if (!patch_vec[level].valid) break;
+    }
   }
 
-  inline bool trackPoint(const basalt::ManagedImagePyr<uint16_t>& old_pyr,
-                         const basalt::ManagedImagePyr<uint16_t>& pyr,
+  inline bool trackPoint(const PatchVec& patch_vec,
+                         const basalt::ManagedImagePyr<Pixel>& pyr,
                          const Eigen::AffineCompact2f& old_transform,
                          Eigen::AffineCompact2f& transform) const {
     bool patch_valid = true;
@@ -247,12 +354,12 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
 
       transform.translation() /= scale;
 
-      PatchT p(old_pyr.lvl(level), old_transform.translation() / scale);
+      const PatchT& p = patch_vec[level];
 
       patch_valid &= p.valid;
       if (patch_valid) {
         // Perform tracking on current level
-        patch_valid &= trackPointAtLevel(pyr.lvl(level), p, transform);
+        patch_valid &= trackPointAtLevel(pyr.lvl(level), p, transform, level);
       }
 
       transform.translation() *= scale;
@@ -263,13 +370,20 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
     return patch_valid;
   }
 
-  inline bool trackPointAtLevel(const Image<const uint16_t>& img_2,
+  inline bool trackPointAtLevel(const Image<const Pixel>& img_2,
                                 const PatchT& dp,
-                                Eigen::AffineCompact2f& transform) const {
+                                Eigen::AffineCompact2f& transform,
+                                int level) const {
     bool patch_valid = true;
+    bool converged = false;
+
+    const Scalar convergence_threshold2 =
+        config.optical_flow_convergence_threshold *
+        config.optical_flow_convergence_threshold;
 
-    for (int iteration = 0;
-         patch_valid && iteration < config.optical_flow_max_iterations;
+    int iteration = 0;
+    for (; patch_valid && !converged &&
+           iteration < config.optical_flow_max_iterations;
          iteration++) {
       typename PatchT::VectorP res;
 
@@ -294,88 +408,141 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
           const int filter_margin = 2;
 
           patch_valid &= img_2.InBounds(transform.translation(), filter_margin);
+
+          converged = inc.squaredNorm() < convergence_threshold2;
         }
       }
     }
 
+    iteration_stats.add(level, iteration, converged);
+
     return patch_valid;
   }
 
+  // Detects new points in camera 0. Their reference patches are created
+  // lazily or by the stereo tracking.
   void addPoints() {
+    KeypointTracks& tracks0 = transforms->observations.at(0);
+
     Eigen::aligned_vector<Eigen::Vector2d> pts0;
+    pts0.reserve(tracks0.size());
 
-    for (const auto& kv : transforms->observations.at(0)) {
-      pts0.emplace_back(kv.second.translation().cast<double>());
+    for (size_t i = 0; i < tracks0.size(); i++) {
+      pts0.emplace_back(tracks0.translation(i).cast<double>());
     }
 
     KeypointsData kd;
 
     detectKeypoints(pyramid->at(0).lvl(0), kd,
-                    config.optical_flow_detection_grid_size, 1, pts0);
+                    config.optical_flow_detection_grid_size, 1, pts0,
+                    config.optical_flow_detector_type);
 
-    Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f> new_poses0,
-        new_poses1;
+    new_poses0.clear();
+    new_poses0.reserve(kd.corners.size());
 
     for (size_t i = 0; i < kd.corners.size(); i++) {
       Eigen::AffineCompact2f transform;
       transform.setIdentity();
       transform.translation() = kd.corners[i].cast<Scalar>();
 
-      transforms->observations.at(0)[last_keypoint_id] = transform;
-      new_poses0[last_keypoint_id] = transform;
+      tracks0.push_back(last_keypoint_id, transform);
+      new_poses0.push_back(last_keypoint_id, transform);
 
       last_keypoint_id++;
     }
 
-    if (calib.intrinsics.size() > 1) {
-      trackPoints(pyramid->at(0), pyramid->at(1), new_poses0, new_poses1);
+    patch_cache.at(0).resize(tracks0.size());
+  }
 
-      for (const auto& kv : new_poses1) {
-        transforms->observations.at(1).emplace(kv);
-      }
+  // Tracks the points detected by addPoints from camera 0 to camera 1. Only
+  // touches data of camera 1 that the temporal tracking doesn't use, so both
+  // can run concurrently.
+  void trackNewPoints() {
+    PatchCache new_patches0(new_poses0.size());
+
+    trackPoints(pyramid->at(0), pyramid->at(1), new_poses0, new_poses1,
+                new_patches0, new_patches1);
+
+    // The new points are at the end of the tracks of camera 0
+    PatchCache& patches0 = patch_cache.at(0);
+    const size_t offset = patches0.size() - new_patches0.size();
+    for (size_t i = 0; i < new_patches0.size(); i++) {
+      patches0[offset + i] = std::move(new_patches0[i]);
+    }
+  }
+
+  void mergeNewPoints() {
+    // New ids are larger than all existing ones, so appending keeps the
+    // tracks sorted
+    KeypointTracks& tracks1 = transforms->observations.at(1);
+    PatchCache& patches1 = patch_cache.at(1);
+    for (size_t i = 0; i < new_poses1.size(); i++) {
+      tracks1.push_back(new_poses1.id(i), new_poses1.transform(i));
+      patches1.emplace_back(std::move(new_patches1[i]));
     }
   }
 
   void filterPoints() {
     if (calib.intrinsics.size() < 2) return;
 
-    std::set<KeypointId> lm_to_remove;
+    const KeypointTracks& tracks0 = transforms->observations.at(0);
+    KeypointTracks& tracks1 = transforms->observations.at(1);
 
-    std::vector<KeypointId> kpid;
-    Eigen::aligned_vector<Eigen::Vector2f> proj0, proj1;
+    std::vector<uint8_t> lm_to_remove(tracks1.size(), 0);
 
-    for (const auto& kv : transforms->observations.at(1)) {
-      auto it = transforms->observations.at(0).find(kv.first);
+    // indices into tracks1
+    std::vector<size_t> kpid, kpid0;
 
-      if (it != transforms->observations.at(0).end()) {
-        proj0.emplace_back(it->second.translation());
-        proj1.emplace_back(kv.second.translation());
-        kpid.emplace_back(kv.first);
+    for (size_t i = 0; i < tracks1.size(); i++) {
+      const size_t idx0 = tracks0.index(tracks1.id(i));
+
+      if (idx0 != KeypointTracks::INVALID_INDEX) {
+        kpid0.emplace_back(idx0);
+        kpid.emplace_back(i);
       }
     }
 
-    Eigen::aligned_vector<Eigen::Vector4f> p3d0, p3d1;
-    std::vector<bool> p3d0_success, p3d1_success;
+    typename CameraBatch<Scalar>::Points2d proj0(kpid.size(), 2),
+        proj1(kpid.size(), 2);
+    for (size_t i = 0; i < kpid.size(); i++) {
+      proj0.row(i) =
+          tracks0.translation(kpid0[i]).transpose().template cast<Scalar>();
+      proj1.row(i) =
+          tracks1.translation(kpid[i]).transpose().template cast<Scalar>();
+    }
+
+    typename CameraBatch<Scalar>::Points3d p3d0, p3d1;
+    typename CameraBatch<Scalar>::Mask p3d0_success, p3d1_success;
+
+    unprojectBatch(calib.intrinsics[0], proj0, p3d0, p3d0_success);
+    unprojectBatch(calib.intrinsics[1], proj1, p3d1, p3d1_success);
 
-    calib.intrinsics[0].unproject(proj0, p3d0, p3d0_success);
-    calib.intrinsics[1].unproject(proj1, p3d1, p3d1_success);
+    // p3d0^T * E * p3d1 of all points at once
+    const Eigen::Matrix<Scalar, Eigen::Dynamic, 1> epipolar_errors =
+        (p3d0 * E).cwiseProduct(p3d1).rowwise().sum().cwiseAbs();
 
-    for (size_t i = 0; i < p3d0_success.size(); i++) {
+    for (size_t i = 0; i < kpid.size(); i++) {
       if (p3d0_success[i] && p3d1_success[i]) {
-        const double epipolar_error =
-            std::abs(p3d0[i].transpose() * E * p3d1[i]);
+        const double epipolar_error = epipolar_errors[i];
 
         if (epipolar_error > config.optical_flow_epipolar_error) {
-          lm_to_remove.emplace(kpid[i]);
+          lm_to_remove[kpid[i]] = 1;
         }
       } else {
-        lm_to_remove.emplace(kpid[i]);
+        lm_to_remove[kpid[i]] = 1;
       }
     }
 
-    for (int id : lm_to_remove) {
-      transforms->observations.at(1).erase(id);
+    tracks1.removeIf([&](size_t i) { return lm_to_remove[i]; });
+
+    PatchCache& patches1 = patch_cache.at(1);
+    size_t j = 0;
+    for (size_t i = 0; i < patches1.size(); i++) {
+      if (lm_to_remove[i]) continue;
+      if (i != j) patches1[j] = std::move(patches1[i]);
+      j++;
     }
+    patches1.resize(j);
   }
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -389,12 +556,34 @@ class FrameToFrameOpticalFlow : public OpticalFlowBase {
   VioConfig config;
   basalt::Calibration<Scalar> calib;
 
-  OpticalFlowResult::Ptr transforms;
-  std::shared_ptr<std::vector<basalt::ManagedImagePyr<uint16_t>>> old_pyramid,
-      pyramid;
+  mutable TrackingIterationStats iteration_stats;
+
+  OpticalFlowResult::Ptr old_transforms, transforms;
+  PyramidPool<Pixel> pyramid_pool;
+  typename PyramidPool<Pixel>::Ptr old_pyramid, pyramid;
+
+  // Per-camera reference patches of the currently tracked points, built in
+  // the latest pyramid
+  std::vector<PatchCache> patch_cache;
+
+  // Points detected in the current frame and their stereo tracks
+  KeypointTracks new_poses0, new_poses1;
+  PatchCache new_patches1;
+
+  // Gyro rotation of every camera from the previous to the current frame,
+  // empty if the gyro is not used
+  Eigen::aligned_vector<Matrix3> R_c2_c1;
 
   Matrix4 E;
 
+  typedef tbb::flow::continue_node<tbb::flow::continue_msg> FrameNode;
+
+  tbb::flow::graph frame_graph;
+  std::unique_ptr<tbb::flow::broadcast_node<tbb::flow::continue_msg>>
+      frame_start;
+  std::vector<std::unique_ptr<FrameNode>> pyramid_nodes, tracking_nodes;
+  std::unique_ptr<FrameNode> detection_node, stereo_tracking_node, filter_node;
+
   std::shared_ptr<std::thread> processing_thread;
 };
 
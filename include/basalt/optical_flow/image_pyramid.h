@@ -0,0 +1,305 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <basalt/image/image_pyr.h>
+#include <basalt/utils/vio_config.h>
+
+namespace basalt {
+
+/// Downsampling kernels for 8 and 16 bit image pyramids. All kernels reduce
+/// an image of size w x h to (w / 2) x (h / 2).
+namespace pyramid_downsample {
+
+// Reflection at the border without repeating the border pixel, as in
+// ManagedImagePyr::border101.
+inline int reflect101(int x, int size) {
+  return size - 1 - std::abs(size - 1 - std::abs(x));
+}
+
+#ifdef __AVX2__
+// Loads 16 pixels into 16 bit lanes
+template <typename T>
+inline __m256i loadPixels16(const T* p) {
+  if constexpr (sizeof(T) == 2) {
+    return _mm256_loadu_si256((const __m256i*)p);
+  } else {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+  }
+}
+
+// Stores 16 pixels from 16 bit lanes, which have to fit into T
+template <typename T>
+inline void storePixels16(T* p, __m256i v) {
+  if constexpr (sizeof(T) == 2) {
+    _mm256_storeu_si256((__m256i*)p, v);
+  } else {
+    _mm_storeu_si128((__m128i*)p,
+                     _mm_packus_epi16(_mm256_castsi256_si128(v),
+                                      _mm256_extracti128_si256(v, 1)));
+  }
+}
+#endif
+
+/// Gaussian 5x5 kernel [1 4 6 4 1]^T [1 4 6 4 1] / 256 evaluated at every
+/// second pixel. Computed in integer arithmetic, so the result is identical
+/// to ManagedImagePyr::subsample. The kernel is separable: for every output
+/// row the vertical pass writes the even and odd columns of the filtered
+/// input row into separate buffers, the horizontal pass then only needs
+/// unit-stride loads.
+template <typename T>
+inline void gaussian5(const Image<const T>& img, Image<T>& img_sub) {
+  const int w = img.w;
+  const int h = img.h;
+  const int w_sub = img_sub.w;
+  const int h_sub = img_sub.h;
+
+  if (w_sub == 0 || h_sub == 0) return;
+
+  // Even and odd columns after the vertical pass, with one element of
+  // padding in front for the reflection at the left border and some
+  // elements after for the right border and vector tails.
+  const int buf_size = w / 2 + 16;
+  std::vector<int32_t> even_buf(buf_size), odd_buf(buf_size);
+  int32_t* even = even_buf.data() + 1;
+  int32_t* odd = odd_buf.data() + 1;
+
+  for (int r = 0; r < h_sub; r++) {
+    const T* row_m2 = img.RowPtr(reflect101(2 * r - 2, h));
+    const T* row_m1 = img.RowPtr(reflect101(2 * r - 1, h));
+    const T* row = img.RowPtr(2 * r);
+    const T* row_p1 = img.RowPtr(reflect101(2 * r + 1, h));
+    const T* row_p2 = img.RowPtr(reflect101(2 * r + 2, h));
+
+    int x = 0;
+
+#ifdef __AVX2__
+    // 16 input pixels per iteration. Seen as 8 32 bit lanes, the low halves
+    // are the even and the high halves the odd pixels.
+    const __m256i low_mask = _mm256_set1_epi32(0xffff);
+    for (; x + 16 <= w; x += 16) {
+      const __m256i p_m2 = loadPixels16(row_m2 + x);
+      const __m256i p_m1 = loadPixels16(row_m1 + x);
+      const __m256i p = loadPixels16(row + x);
+      const __m256i p_p1 = loadPixels16(row_p1 + x);
+      const __m256i p_p2 = loadPixels16(row_p2 + x);
+
+      auto filter = [](__m256i m2, __m256i m1, __m256i c, __m256i p1,
+                       __m256i p2) {
+        // m2 + p2 + 4 * (m1 + p1) + 6 * c
+        const __m256i outer = _mm256_add_epi32(m2, p2);
+        const __m256i inner = _mm256_slli_epi32(_mm256_add_epi32(m1, p1), 2);
+        const __m256i center = _mm256_add_epi32(_mm256_slli_epi32(c, 2),
+                                                _mm256_slli_epi32(c, 1));
+        return _mm256_add_epi32(_mm256_add_epi32(outer, inner), center);
+      };
+
+      const __m256i e = filter(
+          _mm256_and_si256(p_m2, low_mask), _mm256_and_si256(p_m1, low_mask),
+          _mm256_and_si256(p, low_mask), _mm256_and_si256(p_p1, low_mask),
+          _mm256_and_si256(p_p2, low_mask));
+      const __m256i o = filter(
+          _mm256_srli_epi32(p_m2, 16), _mm256_srli_epi32(p_m1, 16),
+          _mm256_srli_epi32(p, 16), _mm256_srli_epi32(p_p1, 16),
+          _mm256_srli_epi32(p_p2, 16));
+
+      _mm256_storeu_si256((__m256i*)(even + x / 2), e);
+      _mm256_storeu_si256((__m256i*)(odd + x / 2), o);
+    }
+#endif
+
+    for (; x < w; x++) {
+      const int32_t v = int32_t(row_m2[x]) + 4 * int32_t(row_m1[x]) +
+                        6 * int32_t(row[x]) + 4 * int32_t(row_p1[x]) +
+                        int32_t(row_p2[x]);
+      if (x % 2 == 0) {
+        even[x / 2] = v;
+      } else {
+        odd[x / 2] = v;
+      }
+    }
+
+    // Reflection at the borders: column -2 is column 2 and column -1 is
+    // column 1. Column w is column w - 2, only needed for even w.
+    even[-1] = even[w > 2 ? 1 : 0];
+    odd[-1] = odd[0];
+    if (w % 2 == 0) even[w / 2] = even[w / 2 - 1];
+
+    // out = even[c - 1] + 4 * odd[c - 1] + 6 * even[c] + 4 * odd[c] +
+    //       even[c + 1]
+    T* out = img_sub.RowPtr(r);
+    int c = 0;
+
+#ifdef __AVX2__
+    const __m256i round = _mm256_set1_epi32(1 << 7);
+    auto horizontal = [&](int i) {
+      const __m256i e_m1 = _mm256_loadu_si256((const __m256i*)(even + i - 1));
+      const __m256i e = _mm256_loadu_si256((const __m256i*)(even + i));
+      const __m256i e_p1 = _mm256_loadu_si256((const __m256i*)(even + i + 1));
+      const __m256i o_m1 = _mm256_loadu_si256((const __m256i*)(odd + i - 1));
+      const __m256i o = _mm256_loadu_si256((const __m256i*)(odd + i));
+
+      const __m256i outer = _mm256_add_epi32(e_m1, e_p1);
+      const __m256i inner = _mm256_slli_epi32(_mm256_add_epi32(o_m1, o), 2);
+      const __m256i center =
+          _mm256_add_epi32(_mm256_slli_epi32(e, 2), _mm256_slli_epi32(e, 1));
+      const __m256i sum = _mm256_add_epi32(_mm256_add_epi32(outer, inner),
+                                           _mm256_add_epi32(center, round));
+      return _mm256_srli_epi32(sum, 8);
+    };
+
+    for (; c + 16 <= w_sub; c += 16) {
+      const __m256i lo = horizontal(c);
+      const __m256i hi = horizontal(c + 8);
+      // packus works within 128 bit lanes, restore the order afterwards
+      const __m256i packed = _mm256_permute4x64_epi64(
+          _mm256_packus_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+      storePixels16(out + c, packed);
+    }
+#endif
+
+    for (; c < w_sub; c++) {
+      const int32_t sum = even[c - 1] + 4 * odd[c - 1] + 6 * even[c] +
+                          4 * odd[c] + even[c + 1];
+      out[c] = (sum + (1 << 7)) >> 8;
+    }
+  }
+}
+
+/// Average of 2x2 pixel blocks. Cheaper than gaussian5, but pixel c of the
+/// result is centered at 2c + 0.5 of the input instead of 2c, so coarse
+/// levels are shifted by up to one pixel relative to level 0.
+template <typename T>
+inline void box2x2(const Image<const T>& img, Image<T>& img_sub) {
+  const int w_sub = img_sub.w;
+  const int h_sub = img_sub.h;
+
+  for (int r = 0; r < h_sub; r++) {
+    const T* row_0 = img.RowPtr(2 * r);
+    const T* row_1 = img.RowPtr(2 * r + 1);
+    T* out = img_sub.RowPtr(r);
+
+    int c = 0;
+
+#ifdef __AVX2__
+    const __m256i low_mask = _mm256_set1_epi32(0xffff);
+    const __m256i round = _mm256_set1_epi32(2);
+    auto block_sum = [&](int i) {
+      const __m256i p0 = loadPixels16(row_0 + 2 * i);
+      const __m256i p1 = loadPixels16(row_1 + 2 * i);
+      const __m256i even = _mm256_add_epi32(_mm256_and_si256(p0, low_mask),
+                                            _mm256_and_si256(p1, low_mask));
+      const __m256i odd = _mm256_add_epi32(_mm256_srli_epi32(p0, 16),
+                                           _mm256_srli_epi32(p1, 16));
+      return _mm256_srli_epi32(
+          _mm256_add_epi32(_mm256_add_epi32(even, odd), round), 2);
+    };
+
+    for (; c + 16 <= w_sub; c += 16) {
+      const __m256i lo = block_sum(c);
+      const __m256i hi = block_sum(c + 8);
+      const __m256i packed = _mm256_permute4x64_epi64(
+          _mm256_packus_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+      storePixels16(out + c, packed);
+    }
+#endif
+
+    for (; c < w_sub; c++) {
+      const uint32_t sum = uint32_t(row_0[2 * c]) + row_0[2 * c + 1] +
+                           row_1[2 * c] + row_1[2 * c + 1];
+      out[c] = (sum + 2) >> 2;
+    }
+  }
+}
+
+}  // namespace pyramid_downsample
+
+/// Image pyramid of the optical flow frontends. Same layout as
+/// ManagedImagePyr, but the construction of the levels can be selected with
+/// PyramidType. For types other than uint8_t and uint16_t the reference
+/// implementation is always used.
+template <typename T>
+class OpticalFlowPyr : public ManagedImagePyr<T> {
+ public:
+  using ManagedImagePyr<T>::setFromImage;
+
+  static constexpr bool HAS_FAST_KERNELS =
+      std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t>;
+
+  inline void setFromImage(const ManagedImage<T>& other, size_t num_levels,
+                           PyramidType type) {
+    if (!HAS_FAST_KERNELS || type == PyramidType::REFERENCE) {
+      ManagedImagePyr<T>::setFromImage(other, num_levels);
+      return;
+    }
+
+    const size_t mipmap_w = other.w + other.w / 2;
+
+    // The parts of the mipmap that are not covered by a level are never
+    // written, so clearing them once after allocation is enough.
+    if (this->image.w != mipmap_w || this->image.h != other.h) {
+      this->image.Reinitialise(mipmap_w, other.h);
+      this->image.Fill(0);
+    }
+
+    this->orig_w = other.w;
+    this->lvl_internal(0).CopyFrom(other);
+
+    if constexpr (HAS_FAST_KERNELS) {
+      for (size_t i = 0; i < num_levels; i++) {
+        const Image<const T> l = this->lvl(i);
+        Image<T> lp1 = this->lvl_internal(i + 1);
+
+        if (type == PyramidType::BOX2X2) {
+          pyramid_downsample::box2x2(l, lp1);
+        } else {
+          pyramid_downsample::gaussian5(l, lp1);
+        }
+      }
+    }
+  }
+};
+
+}  // namespace basalt
@@ -0,0 +1,224 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <basalt/utils/assert.h>
+#include <basalt/utils/sophus_utils.hpp>
+
+namespace basalt {
+
+using KeypointId = size_t;
+
+/// Keypoint tracks of one camera image, stored as structure-of-arrays sorted
+/// by keypoint id. An open-addressing hash index maps ids to track indices,
+/// so lookup by id is O(1) and no per-keypoint nodes are allocated.
+class KeypointTracks {
+ public:
+  static constexpr size_t INVALID_INDEX = std::numeric_limits<size_t>::max();
+
+  KeypointTracks() = default;
+
+  inline size_t size() const { return ids_.size(); }
+  inline bool empty() const { return ids_.empty(); }
+
+  inline void clear() {
+    ids_.clear();
+    translations_.clear();
+    linears_.clear();
+    levels_.clear();
+    std::fill(index_.begin(), index_.end(), -1);
+  }
+
+  inline void reserve(size_t n) {
+    ids_.reserve(n);
+    translations_.reserve(n);
+    linears_.reserve(n);
+    levels_.reserve(n);
+    if (2 * n > index_.size()) rehash(n);
+  }
+
+  inline KeypointId id(size_t i) const { return ids_[i]; }
+  inline const Eigen::Vector2f& translation(size_t i) const {
+    return translations_[i];
+  }
+  inline const Eigen::Matrix2f& linear(size_t i) const { return linears_[i]; }
+  inline size_t level(size_t i) const { return levels_[i]; }
+
+  inline Eigen::AffineCompact2f transform(size_t i) const {
+    Eigen::AffineCompact2f t;
+    t.linear() = linears_[i];
+    t.translation() = translations_[i];
+    return t;
+  }
+
+  inline const std::vector<KeypointId>& ids() const { return ids_; }
+  inline const Eigen::aligned_vector<Eigen::Vector2f>& translations() const {
+    return translations_;
+  }
+
+  /// Index of the track with the given id or INVALID_INDEX if not present
+  inline size_t index(KeypointId id) const {
+    if (index_.empty()) return INVALID_INDEX;
+
+    const size_t mask = index_.size() - 1;
+    for (size_t slot = hash(id);; slot = (slot + 1) & mask) {
+      const int32_t i = index_[slot];
+      if (i < 0) return INVALID_INDEX;
+      if (ids_[i] == id) return i;
+    }
+  }
+
+  inline bool contains(KeypointId id) const {
+    return index(id) != INVALID_INDEX;
+  }
+
+  /// Append a track. The id must be larger than all ids already present.
+  inline void push_back(KeypointId id, const Eigen::AffineCompact2f& transform,
+                        size_t level = 0) {
+    BASALT_ASSERT(empty() || id > ids_.back());
+
+    ids_.emplace_back(id);
+    translations_.emplace_back(transform.translation());
+    linears_.emplace_back(transform.linear());
+    levels_.emplace_back(level);
+
+    if (2 * ids_.size() > index_.size()) {
+      rehash(ids_.size());
+    } else {
+      insertIndex(ids_.size() - 1);
+    }
+  }
+
+  /// Insert or overwrite a track with an arbitrary id. Falls back to
+  /// push_back for increasing ids, otherwise the index is rebuilt, which is
+  /// O(n).
+  inline void insert(KeypointId id, const Eigen::AffineCompact2f& transform,
+                     size_t level = 0) {
+    if (empty() || id > ids_.back()) {
+      push_back(id, transform, level);
+      return;
+    }
+
+    const size_t i =
+        std::lower_bound(ids_.begin(), ids_.end(), id) - ids_.begin();
+
+    if (ids_[i] != id) {
+      ids_.insert(ids_.begin() + i, id);
+      translations_.insert(translations_.begin() + i, transform.translation());
+      linears_.insert(linears_.begin() + i, transform.linear());
+      levels_.insert(levels_.begin() + i, level);
+      rehash(ids_.size());
+    } else {
+      translations_[i] = transform.translation();
+      linears_[i] = transform.linear();
+      levels_[i] = level;
+    }
+  }
+
+  /// Remove all tracks for which pred(i) returns true, where i is the index
+  /// of the track before removal. The order of the remaining tracks is kept.
+  template <typename Pred>
+  inline void removeIf(Pred pred) {
+    size_t j = 0;
+    for (size_t i = 0; i < ids_.size(); i++) {
+      if (pred(i)) continue;
+      if (i != j) {
+        ids_[j] = ids_[i];
+        translations_[j] = translations_[i];
+        linears_[j] = linears_[i];
+        levels_[j] = levels_[i];
+      }
+      j++;
+    }
+
+    if (j == ids_.size()) return;
+
+    ids_.resize(j);
+    translations_.resize(j);
+    linears_.resize(j);
+    levels_.resize(j);
+    rehash(j);
+  }
+
+  inline void erase(KeypointId id) {
+    const size_t idx = index(id);
+    if (idx != INVALID_INDEX) removeIf([&](size_t i) { return i == idx; });
+  }
+
+ private:
+  // Fibonacci hashing, keypoint ids are mostly consecutive
+  inline size_t hash(KeypointId id) const {
+    return (uint64_t(id) * 0x9E3779B97F4A7C15ull) >> hash_shift_;
+  }
+
+  inline void insertIndex(size_t i) {
+    const size_t mask = index_.size() - 1;
+    size_t slot = hash(ids_[i]);
+    while (index_[slot] >= 0) slot = (slot + 1) & mask;
+    index_[slot] = i;
+  }
+
+  // Rebuild the index with a load factor of at most 0.5 for n tracks
+  inline void rehash(size_t n) {
+    size_t num_slots = 16;
+    int num_bits = 4;
+    while (num_slots < 2 * n) {
+      num_slots *= 2;
+      num_bits++;
+    }
+
+    hash_shift_ = 64 - num_bits;
+    index_.assign(num_slots, -1);
+    for (size_t i = 0; i < ids_.size(); i++) insertIndex(i);
+  }
+
+  std::vector<KeypointId> ids_;
+  Eigen::aligned_vector<Eigen::Vector2f> translations_;
+  Eigen::aligned_vector<Eigen::Matrix2f> linears_;
+  std::vector<uint8_t> levels_;
+
+  std::vector<int32_t> index_;
+  int hash_shift_ = 64;
+};
+
+}  // namespace basalt
@@ -43,18 +43,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sophus/se2.hpp>
 
 #include <tbb/blocked_range.h>
-#include <tbb/concurrent_unordered_map.h>
 #include <tbb/parallel_for.h>
 
 #include <basalt/optical_flow/optical_flow.h>
 #include <basalt/optical_flow/patch.h>
 
 #include <basalt/image/image_pyr.h>
+#include <basalt/utils/camera_batch.h>
 #include <basalt/utils/keypoints.h>
 
 namespace basalt {
 
-template <typename Scalar, template <typename> typename Pattern>
+template <typename Scalar, template <typename> typename Pattern,
+          typename Pixel>
 class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
  public:
   typedef OpticalFlowPatch<Scalar, Pattern<Scalar>> PatchT;
@@ -72,10 +73,15 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
 
   MultiscaleFrameToFrameOpticalFlow(const VioConfig& config,
                                     const basalt::Calibration<double>& calib)
-      : t_ns(-1), frame_counter(0), last_keypoint_id(0), config(config) {
+      : t_ns(-1),
+        frame_counter(0),
+        last_keypoint_id(0),
+        config(config),
+        iteration_stats(config.optical_flow_levels + 1) {
     input_queue.set_capacity(10);
 
     this->calib = calib.cast<Scalar>();
+    calib_gyro_bias = calib.calib_gyro_bias;
 
     patch_coord = PatchT::pattern2.template cast<float>();
 
@@ -92,11 +98,21 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
 
   ~MultiscaleFrameToFrameOpticalFlow() { processing_thread->join(); }
 
+  size_t numPyramidsAllocated() const override {
+    return pyramid_pool.numAllocated();
+  }
+  size_t numPyramidsReused() const override { return pyramid_pool.numReused(); }
+
   void processingLoop() {
+    BASALT_TRACE_THREAD_NAME("optical_flow");
+
     OpticalFlowInput::Ptr input_ptr;
 
     while (true) {
-      input_queue.pop(input_ptr);
+      {
+        BASALT_TRACE_SCOPE("input_queue.pop");
+        input_queue.pop(input_ptr);
+      }
 
       if (!input_ptr.get()) {
         if (output_queue) output_queue->push(nullptr);
@@ -108,29 +124,37 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
   }
 
   bool processFrame(int64_t curr_t_ns, OpticalFlowInput::Ptr& new_img_vec) {
+    BASALT_TRACE_SCOPE("processFrame");
+
     for (const auto& v : new_img_vec->img_data) {
-      if (!v.img.get()) {
+      if (v.empty()) {
         std::cout << "Image for " << curr_t_ns << " not present!" << std::endl;
         return true;
       }
     }
+
+    if (config.optical_flow_use_gyro) {
+      R_c2_c1 = gyroCameraRotations(calib, t_ns < 0 ? curr_t_ns : t_ns,
+                                    curr_t_ns);
+    }
+
     if (t_ns < 0) {
       t_ns = curr_t_ns;
 
       transforms.reset(new OpticalFlowResult);
       transforms->observations.resize(calib.intrinsics.size());
-      transforms->pyramid_levels.resize(calib.intrinsics.size());
       transforms->t_ns = t_ns;
 
-      pyramid.reset(new std::vector<basalt::ManagedImagePyr<uint16_t>>);
-      pyramid->resize(calib.intrinsics.size());
+      pyramid = pyramid_pool.get(calib.intrinsics.size());
 
       tbb::parallel_for(tbb::blocked_range<size_t>(0, calib.intrinsics.size()),
                         [&](const tbb::blocked_range<size_t>& r) {
                           for (size_t i = r.begin(); i != r.end(); ++i) {
+                            const auto img =
+                                new_img_vec->img_data[i].getImage<Pixel>();
                             pyramid->at(i).setFromImage(
-                                *new_img_vec->img_data[i].img,
-                                config.optical_flow_levels);
+                                *img, config.optical_flow_levels,
+                                config.optical_flow_pyramid_type);
                           }
                         });
 
@@ -143,28 +167,27 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
 
       old_pyramid = pyramid;
 
-      pyramid.reset(new std::vector<basalt::ManagedImagePyr<uint16_t>>);
-      pyramid->resize(calib.intrinsics.size());
+      pyramid = pyramid_pool.get(calib.intrinsics.size());
       tbb::parallel_for(tbb::blocked_range<size_t>(0, calib.intrinsics.size()),
                         [&](const tbb::blocked_range<size_t>& r) {
                           for (size_t i = r.begin(); i != r.end(); ++i) {
+                            const auto img =
+                                new_img_vec->img_data[i].getImage<Pixel>();
                             pyramid->at(i).setFromImage(
-                                *new_img_vec->img_data[i].img,
-                                config.optical_flow_levels);
+                                *img, config.optical_flow_levels,
+                                config.optical_flow_pyramid_type);
                           }
                         });
 
       OpticalFlowResult::Ptr new_transforms;
       new_transforms.reset(new OpticalFlowResult);
       new_transforms->observations.resize(calib.intrinsics.size());
-      new_transforms->pyramid_levels.resize(calib.intrinsics.size());
       new_transforms->t_ns = t_ns;
 
       for (size_t i = 0; i < calib.intrinsics.size(); i++) {
         trackPoints(old_pyramid->at(i), pyramid->at(i),
-                    transforms->observations[i], transforms->pyramid_levels[i],
-                    new_transforms->observations[i],
-                    new_transforms->pyramid_levels[i]);
+                    transforms->observations[i],
+                    new_transforms->observations[i], i);
       }
 
       // std::cout << t_ns << ": Could track "
@@ -178,7 +201,14 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
       filterPoints();
     }
 
+    iteration_stats.collect(stats);
+
     if (frame_counter % config.optical_flow_skip_frames == 0) {
+      if (latency_recorder) {
+        latency_recorder->record(transforms->t_ns,
+                                 FrameLatencyRecorder::OPTICAL_FLOW);
+      }
+      BASALT_TRACE_SCOPE("output_queue.push");
       try {
         output_queue->push(transforms);
       } catch (const tbb::user_abort&) {
@@ -190,61 +220,61 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
     return true;
   }
 
-  void trackPoints(
-      const basalt::ManagedImagePyr<uint16_t>& pyr_1,
-      const basalt::ManagedImagePyr<uint16_t>& pyr_2,
-      const Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f>&
-          transform_map_1,
-      const std::map<KeypointId, size_t>& pyramid_levels_1,
-      Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f>& transform_map_2,
-      std::map<KeypointId, size_t>& pyramid_levels_2) const {
-    size_t num_points = transform_map_1.size();
-
-    std::vector<KeypointId> ids;
-    Eigen::aligned_vector<Eigen::AffineCompact2f> init_vec;
-    std::vector<size_t> pyramid_level;
-
-    ids.reserve(num_points);
-    init_vec.reserve(num_points);
-    pyramid_level.reserve(num_points);
-
-    for (const auto& kv : transform_map_1) {
-      ids.push_back(kv.first);
-      init_vec.push_back(kv.second);
-      pyramid_level.push_back(pyramid_levels_1.at(kv.first));
-    }
+  // Tracks the points of tracks_1 from pyr_1 to pyr_2. For temporal
+  // tracking the camera is given as gyro_cam_id, then the gyro rotation
+  // between the frames provides the initial guesses if available.
+  void trackPoints(const basalt::ManagedImagePyr<Pixel>& pyr_1,
+                   const basalt::ManagedImagePyr<Pixel>& pyr_2,
+                   const KeypointTracks& tracks_1, KeypointTracks& tracks_2,
+                   int gyro_cam_id = -1) const {
+    BASALT_TRACE_SCOPE("trackPoints");
+
+    const size_t num_points = tracks_1.size();
 
-    tbb::concurrent_unordered_map<KeypointId, Eigen::AffineCompact2f,
-                                  std::hash<KeypointId>>
-        result_transforms;
-    tbb::concurrent_unordered_map<KeypointId, size_t, std::hash<KeypointId>>
-        result_pyramid_level;
+    const bool use_gyro = gyro_cam_id >= 0 && !R_c2_c1.empty();
+
+    Eigen::aligned_vector<Eigen::AffineCompact2f> result(num_points);
+    std::vector<uint8_t> result_valid(num_points, 0);
 
     auto compute_func = [&](const tbb::blocked_range<size_t>& range) {
+      BASALT_TRACE_SCOPE("trackPointsRange");
       for (size_t r = range.begin(); r != range.end(); ++r) {
-        const KeypointId id = ids[r];
+        const size_t pyramid_level = tracks_1.level(r);
 
-        const Eigen::AffineCompact2f& transform_1 = init_vec[r];
+        const Eigen::AffineCompact2f transform_1 = tracks_1.transform(r);
         Eigen::AffineCompact2f transform_2 = transform_1;
 
-        bool valid = trackPoint(pyr_1, pyr_2, transform_1, pyramid_level[r],
+        if (use_gyro) {
+          transform_2.translation() = predictRotation<Scalar>(
+              calib.intrinsics[gyro_cam_id], R_c2_c1[gyro_cam_id],
+              transform_1.translation());
+        }
+
+        bool valid = trackPoint(pyr_1, pyr_2, transform_1, pyramid_level,
                                 transform_2);
 
         if (valid) {
           Eigen::AffineCompact2f transform_1_recovered = transform_2;
 
-          valid = trackPoint(pyr_2, pyr_1, transform_2, pyramid_level[r],
+          if (use_gyro) {
+            transform_1_recovered.translation() = predictRotation<Scalar>(
+                calib.intrinsics[gyro_cam_id],
+                Matrix3(R_c2_c1[gyro_cam_id].transpose()),
+                transform_2.translation());
+          }
+
+          valid = trackPoint(pyr_2, pyr_1, transform_2, pyramid_level,
                              transform_1_recovered);
 
           if (valid) {
-            const Scalar scale = 1 << pyramid_level[r];
+            const Scalar scale = 1 << pyramid_level;
             Scalar dist2 = (transform_1.translation() / scale -
                             transform_1_recovered.translation() / scale)
                                .squaredNorm();
 
             if (dist2 < config.optical_flow_max_recovered_dist2) {
-              result_transforms[id] = transform_2;
-              result_pyramid_level[id] = pyramid_level[r];
+              result[r] = transform_2;
+              result_valid[r] = 1;
             }
           }
         }
@@ -256,15 +286,17 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
     tbb::parallel_for(range, compute_func);
     // compute_func(range);
 
-    transform_map_2.clear();
-    transform_map_2.insert(result_transforms.begin(), result_transforms.end());
-    pyramid_levels_2.clear();
-    pyramid_levels_2.insert(result_pyramid_level.begin(),
-                            result_pyramid_level.end());
+    tracks_2.clear();
+    tracks_2.reserve(num_points);
+    for (size_t r = 0; r < num_points; r++) {
+      if (result_valid[r]) {
+        tracks_2.push_back(tracks_1.id(r), result[r], tracks_1.level(r));
+      }
+    }
   }
 
-  inline bool trackPoint(const basalt::ManagedImagePyr<uint16_t>& old_pyr,
-                         const basalt::ManagedImagePyr<uint16_t>& pyr,
+  inline bool trackPoint(const basalt::ManagedImagePyr<Pixel>& old_pyr,
+                         const basalt::ManagedImagePyr<Pixel>& pyr,
                          const Eigen::AffineCompact2f& old_transform,
                          const size_t pyramid_level,
                          Eigen::AffineCompact2f& transform) const {
@@ -285,7 +317,8 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
       patch_valid &= p.valid;
       if (patch_valid) {
         // Perform tracking on current level
-        patch_valid &= trackPointAtLevel(pyr.lvl(level), p, transform_tmp);
+        patch_valid &=
+            trackPointAtLevel(pyr.lvl(level), p, transform_tmp, level);
       }
 
       if (level == static_cast<ssize_t>(pyramid_level) + 1 && !patch_valid) {
@@ -304,13 +337,20 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
     return patch_valid;
   }
 
-  inline bool trackPointAtLevel(const Image<const uint16_t>& img_2,
+  inline bool trackPointAtLevel(const Image<const Pixel>& img_2,
                                 const PatchT& dp,
-                                Eigen::AffineCompact2f& transform) const {
+                                Eigen::AffineCompact2f& transform,
+                                int level) const {
     bool patch_valid = true;
+    bool converged = false;
+
+    const Scalar convergence_threshold2 =
+        config.optical_flow_convergence_threshold *
+        config.optical_flow_convergence_threshold;
 
-    for (int iteration = 0;
-         patch_valid && iteration < config.optical_flow_max_iterations;
+    int iteration = 0;
+    for (; patch_valid && !converged &&
+           iteration < config.optical_flow_max_iterations;
          iteration++) {
       typename PatchT::VectorP res;
 
@@ -335,110 +375,130 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
           const int filter_margin = 2;
 
           patch_valid &= img_2.InBounds(transform.translation(), filter_margin);
+
+          converged = inc.squaredNorm() < convergence_threshold2;
         }
       }
     }
 
+    iteration_stats.add(level, iteration, converged);
+
     return patch_valid;
   }
 
   void addPoints() {
     KeypointsData kd;
 
-    Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f> new_poses_main,
-        new_poses_stereo;
-    std::map<KeypointId, size_t> new_pyramid_levels_main,
-        new_pyramid_levels_stereo;
+    KeypointTracks& tracks_main = transforms->observations.at(0);
+    KeypointTracks& tracks_stereo = transforms->observations.at(1);
+
+    KeypointTracks new_poses_main, new_poses_stereo;
 
     for (ssize_t level = 0;
          level < static_cast<ssize_t>(config.optical_flow_levels) - 1;
          level++) {
       Eigen::aligned_vector<Eigen::Vector2d> pts;
 
-      for (const auto& kv : transforms->observations.at(0)) {
-        const ssize_t point_level =
-            transforms->pyramid_levels.at(0).at(kv.first);
+      for (size_t i = 0; i < tracks_main.size(); i++) {
+        const ssize_t point_level = tracks_main.level(i);
 
         // do not create points were already points at similar levels are
         if (point_level <= level + 1 && point_level >= level - 1) {
           // if (point_level == level) {
           const Scalar scale = 1 << point_level;
           pts.emplace_back(
-              (kv.second.translation() / scale).template cast<double>());
+              (tracks_main.translation(i) / scale).template cast<double>());
         }
       }
 
       detectKeypoints(pyramid->at(0).lvl(level), kd,
-                      config.optical_flow_detection_grid_size, 1, pts);
+                      config.optical_flow_detection_grid_size, 1, pts,
+                      config.optical_flow_detector_type);
 
       const Scalar scale = 1 << level;
 
+      // Points added at previous levels are already in tracks_stereo
+      new_poses_main.clear();
+
       for (size_t i = 0; i < kd.corners.size(); i++) {
         Eigen::AffineCompact2f transform;
         transform.setIdentity();
         transform.translation() =
             kd.corners[i].cast<Scalar>() * scale;  // TODO cast float?
 
-        transforms->observations.at(0)[last_keypoint_id] = transform;
-        transforms->pyramid_levels.at(0)[last_keypoint_id] = level;
-        new_poses_main[last_keypoint_id] = transform;
-        new_pyramid_levels_main[last_keypoint_id] = level;
+        tracks_main.push_back(last_keypoint_id, transform, level);
+        new_poses_main.push_back(last_keypoint_id, transform, level);
 
         last_keypoint_id++;
       }
 
       trackPoints(pyramid->at(0), pyramid->at(1), new_poses_main,
-                  new_pyramid_levels_main, new_poses_stereo,
-                  new_pyramid_levels_stereo);
-
-      for (const auto& kv : new_poses_stereo) {
-        transforms->observations.at(1).emplace(kv);
-        transforms->pyramid_levels.at(1)[kv.first] =
-            new_pyramid_levels_stereo.at(kv.first);
+                  new_poses_stereo);
+
+      // New ids are larger than all existing ones, so appending keeps the
+      // tracks sorted
+      for (size_t i = 0; i < new_poses_stereo.size(); i++) {
+        tracks_stereo.push_back(new_poses_stereo.id(i),
+                                new_poses_stereo.transform(i),
+                                new_poses_stereo.level(i));
       }
     }
   }
 
   void filterPoints() {
-    std::set<KeypointId> lm_to_remove;
+    const KeypointTracks& tracks_main = transforms->observations.at(0);
+    KeypointTracks& tracks_stereo = transforms->observations.at(1);
+
+    std::vector<uint8_t> lm_to_remove(tracks_stereo.size(), 0);
 
-    std::vector<KeypointId> kpid;
-    Eigen::aligned_vector<Eigen::Vector2f> proj0, proj1;
+    // indices into tracks_main and tracks_stereo
+    std::vector<size_t> kpid_main, kpid;
 
-    for (const auto& kv : transforms->observations.at(1)) {
-      auto it = transforms->observations.at(0).find(kv.first);
+    for (size_t i = 0; i < tracks_stereo.size(); i++) {
+      const size_t idx = tracks_main.index(tracks_stereo.id(i));
 
-      if (it != transforms->observations.at(0).end()) {
-        proj0.emplace_back(it->second.translation());
-        proj1.emplace_back(kv.second.translation());
-        kpid.emplace_back(kv.first);
+      if (idx != KeypointTracks::INVALID_INDEX) {
+        kpid_main.emplace_back(idx);
+        kpid.emplace_back(i);
       }
     }
 
-    Eigen::aligned_vector<Eigen::Vector4f> p3d_main, p3d_stereo;
-    std::vector<bool> p3d_main_success, p3d_stereo_success;
+    typename CameraBatch<Scalar>::Points2d proj0(kpid.size(), 2),
+        proj1(kpid.size(), 2);
+    for (size_t i = 0; i < kpid.size(); i++) {
+      proj0.row(i) = tracks_main.translation(kpid_main[i])
+                         .transpose()
+                         .template cast<Scalar>();
+      proj1.row(i) = tracks_stereo.translation(kpid[i])
+                         .transpose()
+                         .template cast<Scalar>();
+    }
+
+    typename CameraBatch<Scalar>::Points3d p3d_main, p3d_stereo;
+    typename CameraBatch<Scalar>::Mask p3d_main_success, p3d_stereo_success;
 
-    calib.intrinsics[0].unproject(proj0, p3d_main, p3d_main_success);
-    calib.intrinsics[1].unproject(proj1, p3d_stereo, p3d_stereo_success);
+    unprojectBatch(calib.intrinsics[0], proj0, p3d_main, p3d_main_success);
+    unprojectBatch(calib.intrinsics[1], proj1, p3d_stereo, p3d_stereo_success);
 
-    for (size_t i = 0; i < p3d_main_success.size(); i++) {
+    // p3d_main^T * E * p3d_stereo of all points at once
+    const Eigen::Matrix<Scalar, Eigen::Dynamic, 1> epipolar_errors =
+        (p3d_main * E).cwiseProduct(p3d_stereo).rowwise().sum().cwiseAbs();
+
+    for (size_t i = 0; i < kpid.size(); i++) {
       if (p3d_main_success[i] && p3d_stereo_success[i]) {
-        const double epipolar_error =
-            std::abs(p3d_main[i].transpose() * E * p3d_stereo[i]);
+        const double epipolar_error = epipolar_errors[i];
 
-        const Scalar scale = 1 << transforms->pyramid_levels.at(0).at(kpid[i]);
+        const Scalar scale = 1 << tracks_main.level(kpid_main[i]);
 
         if (epipolar_error > config.optical_flow_epipolar_error * scale) {
-          lm_to_remove.emplace(kpid[i]);
+          lm_to_remove[kpid[i]] = 1;
         }
       } else {
-        lm_to_remove.emplace(kpid[i]);
+        lm_to_remove[kpid[i]] = 1;
       }
     }
 
-    for (int id : lm_to_remove) {
-      transforms->observations.at(1).erase(id);
-    }
+    tracks_stereo.removeIf([&](size_t i) { return lm_to_remove[i]; });
   }
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -452,9 +512,15 @@ class MultiscaleFrameToFrameOpticalFlow : public OpticalFlowBase {
   VioConfig config;
   basalt::Calibration<Scalar> calib;
 
+  mutable TrackingIterationStats iteration_stats;
+
   OpticalFlowResult::Ptr transforms;
-  std::shared_ptr<std::vector<basalt::ManagedImagePyr<uint16_t>>> old_pyramid,
-      pyramid;
+  PyramidPool<Pixel> pyramid_pool;
+  typename PyramidPool<Pixel>::Ptr old_pyramid, pyramid;
+
+  // Gyro rotation of every camera from the previous to the current frame,
+  // empty if the gyro is not used
+  Eigen::aligned_vector<Matrix3> R_c2_c1;
 
   // map from stereo pair -> essential matrix
   Matrix4 E;
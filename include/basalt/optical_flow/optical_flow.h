@@ -34,23 +34,28 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <memory>
 
 #include <Eigen/Geometry>
 
+#include <basalt/optical_flow/keypoint_tracks.h>
+#include <basalt/optical_flow/pyramid_pool.h>
 #include <basalt/utils/vio_config.h>
 
 #include <basalt/io/dataset_io.h>
 #include <basalt/calibration/calibration.hpp>
 #include <basalt/camera/stereographic_param.hpp>
+#include <basalt/imu/imu_types.h>
 #include <basalt/utils/sophus_utils.hpp>
+#include <basalt/utils/time_utils.hpp>
+#include <basalt/utils/tracing.h>
 
 #include <tbb/concurrent_queue.h>
 
 namespace basalt {
 
-using KeypointId = size_t;
-
 struct OpticalFlowInput {
   using Ptr = std::shared_ptr<OpticalFlowInput>;
 
@@ -62,22 +67,111 @@ struct OpticalFlowResult {
   using Ptr = std::shared_ptr<OpticalFlowResult>;
 
   int64_t t_ns;
-  std::vector<Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f>>
-      observations;
 
-  std::vector<std::map<KeypointId, size_t>> pyramid_levels;
+  // Tracked keypoints per camera, including the pyramid level they were
+  // detected at
+  std::vector<KeypointTracks> observations;
 
   OpticalFlowInput::Ptr input_images;
 };
 
+// Gauss-Newton iterations of the patch tracking per pyramid level. Updated
+// concurrently by the tracking threads and collected once per frame.
+class TrackingIterationStats {
+ public:
+  explicit TrackingIterationStats(int num_levels)
+      : calls_(num_levels), iterations_(num_levels), converged_(num_levels) {}
+
+  inline void add(int level, int iterations, bool converged) {
+    calls_[level].fetch_add(1, std::memory_order_relaxed);
+    iterations_[level].fetch_add(iterations, std::memory_order_relaxed);
+    if (converged) converged_[level].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Adds the mean number of iterations and the fraction of converged calls of
+  // every level used since the last collect to stats and resets the counters.
+  void collect(ExecutionStats& stats);
+
+ private:
+  std::vector<std::atomic<int64_t>> calls_, iterations_, converged_;
+};
+
 class OpticalFlowBase {
  public:
   using Ptr = std::shared_ptr<OpticalFlowBase>;
 
+  virtual ~OpticalFlowBase() = default;
+
   tbb::concurrent_bounded_queue<OpticalFlowInput::Ptr> input_queue;
   tbb::concurrent_bounded_queue<OpticalFlowResult::Ptr>* output_queue = nullptr;
 
+  // Optional, records when the results are handed to the output_queue
+  FrameLatencyRecorder* latency_recorder = nullptr;
+
   Eigen::MatrixXf patch_coord;
+
+  // Statistics of the recycled image pyramids of the frontend
+  virtual size_t numPyramidsAllocated() const { return 0; }
+  virtual size_t numPyramidsReused() const { return 0; }
+
+  // Per-frame statistics, only to be read after the processing has finished
+  ExecutionStats stats;
+
+  // Optional IMU input, only consumed if config.optical_flow_use_gyro is set.
+  // Terminated by a nullptr like the input_queue.
+  tbb::concurrent_bounded_queue<ImuData<double>::Ptr> imu_data_queue;
+
+  // Rotation R_i0_i1 of the IMU from t0_ns to t1_ns, integrated from the
+  // bias-corrected gyro samples of imu_data_queue. Blocks until the samples
+  // up to t1_ns have arrived or the IMU input has ended with a nullptr, and
+  // returns the identity without waiting if t1_ns <= t0_ns. Samples that are
+  // not needed for later intervals are dropped, so the calls must have
+  // increasing timestamps.
+  Sophus::SO3d integrateGyro(int64_t t0_ns, int64_t t1_ns);
+
+  // Rotations R_c1_c0 of all cameras from t0_ns to t1_ns according to the
+  // gyro.
+  template <typename Scalar>
+  Eigen::aligned_vector<Eigen::Matrix<Scalar, 3, 3>> gyroCameraRotations(
+      const Calibration<Scalar>& calib, int64_t t0_ns, int64_t t1_ns) {
+    const Eigen::Matrix<Scalar, 3, 3> R_i1_i0 =
+        integrateGyro(t0_ns, t1_ns).inverse().matrix().template cast<Scalar>();
+
+    Eigen::aligned_vector<Eigen::Matrix<Scalar, 3, 3>> res;
+    for (const auto& T_i_c : calib.T_i_c) {
+      const Eigen::Matrix<Scalar, 3, 3> R_i_c = T_i_c.so3().matrix();
+      res.emplace_back(R_i_c.transpose() * R_i1_i0 * R_i_c);
+    }
+    return res;
+  }
+
+  // Position of the point p_1 after the pure camera rotation R_2_1, i.e. p_1
+  // mapped through the rotation-only homography. Returns p_1 if the point
+  // can't be unprojected or projected.
+  template <typename Scalar>
+  static Eigen::Matrix<Scalar, 2, 1> predictRotation(
+      const GenericCamera<Scalar>& cam,
+      const Eigen::Matrix<Scalar, 3, 3>& R_2_1,
+      const Eigen::Matrix<Scalar, 2, 1>& p_1) {
+    Eigen::Matrix<Scalar, 4, 1> p3d;
+    if (!cam.unproject(p_1, p3d)) return p_1;
+
+    p3d.template head<3>() = R_2_1 * p3d.template head<3>();
+
+    Eigen::Matrix<Scalar, 2, 1> p_2;
+    if (!cam.project(p3d, p_2)) return p_1;
+
+    return p_2;
+  }
+
+  // Gyro calibration used by integrateGyro, set by the frontends
+  CalibGyroBias<double> calib_gyro_bias;
+
+ private:
+  // Gyro samples not yet consumed by integrateGyro. The first one is the
+  // last sample before the end of the previous interval.
+  std::deque<ImuData<double>::Ptr> imu_buffer;
+  bool imu_finished = false;
 };
 
 class OpticalFlowFactory {
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <Eigen/Dense>
 
 #include <basalt/image/image.h>
+#include <basalt/optical_flow/patch_interp.h>
 #include <basalt/optical_flow/patterns.h>
 
 namespace basalt {
@@ -67,11 +68,15 @@ struct OpticalFlowPatch {
 
   OpticalFlowPatch() = default;
 
-  OpticalFlowPatch(const Image<const uint16_t> &img, const Vector2 &pos) {
+  template <typename Pixel>
+  OpticalFlowPatch(const Image<const Pixel> &img, const Vector2 &pos) {
     setFromImage(img, pos);
   }
 
-  void setFromImage(const Image<const uint16_t> &img, const Vector2 &pos) {
+  // The patch is normalized by its mean intensity, so it doesn't depend on
+  // the bit depth of the image (8 or 16 bit).
+  template <typename Pixel>
+  void setFromImage(const Image<const Pixel> &img, const Vector2 &pos) {
     this->pos = pos;
 
     int num_valid_points = 0;
@@ -80,17 +85,33 @@ struct OpticalFlowPatch {
 
     MatrixP2 grad;
 
-    for (int i = 0; i < PATTERN_SIZE; i++) {
-      Vector2 p = pos + pattern2.col(i);
-      if (img.InBounds(p, 2)) {
-        Vector3 valGrad = img.interpGrad<Scalar>(p);
-        data[i] = valGrad[0];
-        sum += valGrad[0];
-        grad.row(i) = valGrad.template tail<2>();
-        grad_sum += valGrad.template tail<2>();
-        num_valid_points++;
-      } else {
-        data[i] = -1;
+    Matrix2P pattern_pos = pattern2;
+    pattern_pos.colwise() += pos;
+
+    if (patch_interp::patchInBounds(img, pattern_pos, 2)) {
+      // all points are valid, interpolate the whole patch at once
+      patch_interp::interpGradPoints(img, pattern_pos.data(), PATTERN_SIZE,
+                                     data.data(), grad.col(0).data(),
+                                     grad.col(1).data());
+
+      for (int i = 0; i < PATTERN_SIZE; i++) {
+        sum += data[i];
+        grad_sum += grad.row(i).transpose();
+      }
+      num_valid_points = PATTERN_SIZE;
+    } else {
+      for (int i = 0; i < PATTERN_SIZE; i++) {
+        Vector2 p = pattern_pos.col(i);
+        if (img.InBounds(p, 2)) {
+          Vector3 valGrad = img.template interpGrad<Scalar>(p);
+          data[i] = valGrad[0];
+          sum += valGrad[0];
+          grad.row(i) = valGrad.template tail<2>();
+          grad_sum += valGrad.template tail<2>();
+          num_valid_points++;
+        } else {
+          data[i] = -1;
+        }
       }
     }
 
@@ -139,20 +160,33 @@ struct OpticalFlowPatch {
             data.array().isFinite().all();
   }
 
-  inline bool residual(const Image<const uint16_t> &img,
+  template <typename Pixel>
+  inline bool residual(const Image<const Pixel> &img,
                        const Matrix2P &transformed_pattern,
                        VectorP &residual) const {
     Scalar sum = 0;
     Vector2 grad_sum(0, 0);
     int num_valid_points = 0;
 
-    for (int i = 0; i < PATTERN_SIZE; i++) {
-      if (img.InBounds(transformed_pattern.col(i), 2)) {
-        residual[i] = img.interp<Scalar>(transformed_pattern.col(i));
+    if (patch_interp::patchInBounds(img, transformed_pattern, 2)) {
+      // all points are valid, interpolate the whole patch at once
+      patch_interp::interpPoints(img, transformed_pattern.data(),
+                                 PATTERN_SIZE, residual.data());
+
+      for (int i = 0; i < PATTERN_SIZE; i++) {
         sum += residual[i];
-        num_valid_points++;
-      } else {
-        residual[i] = -1;
+      }
+      num_valid_points = PATTERN_SIZE;
+    } else {
+      for (int i = 0; i < PATTERN_SIZE; i++) {
+        if (img.InBounds(transformed_pattern.col(i), 2)) {
+          residual[i] =
+              img.template interp<Scalar>(transformed_pattern.col(i));
+          sum += residual[i];
+          num_valid_points++;
+        } else {
+          residual[i] = -1;
+        }
       }
     }
 
@@ -0,0 +1,407 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <Eigen/Dense>
+
+#include <basalt/image/image.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace basalt {
+
+// Bilinear interpolation of an 8 or 16 bit image at many points at once. The
+// points are given as interleaved (x, y) coordinates, i.e. in the memory
+// layout of a column-major 2xN Eigen matrix. None of the functions here check
+// bounds; the caller has to make sure that every point passes
+// img.InBounds(p, 2), which for a patch is done once with patchInBounds().
+//
+// The arithmetic follows Image::interp() and Image::interpGrad() operation by
+// operation, so the results only differ if the compiler contracts the scalar
+// code into FMA instructions.
+namespace patch_interp {
+
+// Reference implementation, one point at a time
+struct Scalar {
+  static constexpr int BATCH_SIZE = 1;
+
+  template <typename Pixel>
+  static inline void interp(const Image<const Pixel>& img, const float* xy,
+                            float* val) {
+    val[0] = img.template interp<float>(xy[0], xy[1]);
+  }
+
+  template <typename Pixel>
+  static inline void interpGrad(const Image<const Pixel>& img,
+                                const float* xy, float* val, float* grad_x,
+                                float* grad_y) {
+    const Eigen::Vector3f res = img.template interpGrad<float>(xy[0], xy[1]);
+    val[0] = res[0];
+    grad_x[0] = res[1];
+    grad_y[0] = res[2];
+  }
+};
+
+#if defined(__AVX2__)
+
+struct AVX2 {
+  static constexpr int BATCH_SIZE = 8;
+
+  // Splits 8 interleaved points into x and y registers
+  static inline void deinterleave(const float* xy, __m256& x, __m256& y) {
+    const __m256 a = _mm256_loadu_ps(xy);
+    const __m256 b = _mm256_loadu_ps(xy + 8);
+    x = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+        _MM_SHUFFLE(3, 1, 2, 0)));
+    y = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))),
+        _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+
+  // Loads the pixels (ix + dx, iy) and (ix + dx + 1, iy) of all lanes with a
+  // single 32 bit gather. offset is the byte offset of (ix, iy).
+  template <typename Pixel>
+  static inline void gatherPair(const uint8_t* base, __m256i offset, int dx,
+                                __m256& p0, __m256& p1) {
+    constexpr int BITS = 8 * sizeof(Pixel);
+    const __m256i mask = _mm256_set1_epi32((1 << BITS) - 1);
+
+    const __m256i v = _mm256_i32gather_epi32(
+        reinterpret_cast<const int*>(base + dx * int(sizeof(Pixel))), offset,
+        1);
+    p0 = _mm256_cvtepi32_ps(_mm256_and_si256(v, mask));
+    if constexpr (BITS == 16) {
+      p1 = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+    } else {
+      p1 = _mm256_cvtepi32_ps(
+          _mm256_and_si256(_mm256_srli_epi32(v, BITS), mask));
+    }
+  }
+
+  static inline __m256 bilinear(__m256 ddx, __m256 ddy, __m256 dx, __m256 dy,
+                                __m256 px0y0, __m256 px0y1, __m256 px1y0,
+                                __m256 px1y1) {
+    __m256 res = _mm256_mul_ps(_mm256_mul_ps(ddx, ddy), px0y0);
+    res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_mul_ps(ddx, dy), px0y1));
+    res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_mul_ps(dx, ddy), px1y0));
+    res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_mul_ps(dx, dy), px1y1));
+    return res;
+  }
+
+  template <typename Pixel>
+  static inline void setup(const Image<const Pixel>& img, const float* xy,
+                           __m256i& offset, __m256& dx, __m256& dy,
+                           __m256& ddx, __m256& ddy) {
+    __m256 x, y;
+    deinterleave(xy, x, y);
+
+    // coordinates are positive, so truncation is the same as floor
+    const __m256i ix = _mm256_cvttps_epi32(x);
+    const __m256i iy = _mm256_cvttps_epi32(y);
+
+    dx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix));
+    dy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy));
+    ddx = _mm256_sub_ps(_mm256_set1_ps(1.f), dx);
+    ddy = _mm256_sub_ps(_mm256_set1_ps(1.f), dy);
+
+    offset = _mm256_mullo_epi32(iy, _mm256_set1_epi32(int(img.pitch)));
+    if constexpr (sizeof(Pixel) == 2) {
+      offset = _mm256_add_epi32(offset, _mm256_slli_epi32(ix, 1));
+    } else {
+      offset = _mm256_add_epi32(offset, ix);
+    }
+  }
+
+  template <typename Pixel>
+  static inline void interp(const Image<const Pixel>& img, const float* xy,
+                            float* val) {
+    __m256i offset;
+    __m256 dx, dy, ddx, ddy;
+    setup(img, xy, offset, dx, dy, ddx, ddy);
+
+    const uint8_t* row0 = reinterpret_cast<const uint8_t*>(img.ptr);
+    const uint8_t* row1 = row0 + img.pitch;
+
+    __m256 px0y0, px1y0, px0y1, px1y1;
+    gatherPair<Pixel>(row0, offset, 0, px0y0, px1y0);
+    gatherPair<Pixel>(row1, offset, 0, px0y1, px1y1);
+
+    _mm256_storeu_ps(
+        val, bilinear(ddx, ddy, dx, dy, px0y0, px0y1, px1y0, px1y1));
+  }
+
+  template <typename Pixel>
+  static inline void interpGrad(const Image<const Pixel>& img,
+                                const float* xy, float* val, float* grad_x,
+                                float* grad_y) {
+    __m256i offset;
+    __m256 dx, dy, ddx, ddy;
+    setup(img, xy, offset, dx, dy, ddx, ddy);
+
+    const uint8_t* row0 = reinterpret_cast<const uint8_t*>(img.ptr);
+    const uint8_t* rowm1 = row0 - img.pitch;
+    const uint8_t* row1 = row0 + img.pitch;
+    const uint8_t* row2 = row1 + img.pitch;
+
+    __m256 pxm1y0, px0y0, px1y0, px2y0;
+    gatherPair<Pixel>(row0, offset, -1, pxm1y0, px0y0);
+    gatherPair<Pixel>(row0, offset, 1, px1y0, px2y0);
+
+    __m256 pxm1y1, px0y1, px1y1, px2y1;
+    gatherPair<Pixel>(row1, offset, -1, pxm1y1, px0y1);
+    gatherPair<Pixel>(row1, offset, 1, px1y1, px2y1);
+
+    __m256 px0ym1, px1ym1, px0y2, px1y2;
+    gatherPair<Pixel>(rowm1, offset, 0, px0ym1, px1ym1);
+    gatherPair<Pixel>(row2, offset, 0, px0y2, px1y2);
+
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    _mm256_storeu_ps(
+        val, bilinear(ddx, ddy, dx, dy, px0y0, px0y1, px1y0, px1y1));
+
+    const __m256 res_mx =
+        bilinear(ddx, ddy, dx, dy, pxm1y0, pxm1y1, px0y0, px0y1);
+    const __m256 res_px =
+        bilinear(ddx, ddy, dx, dy, px1y0, px1y1, px2y0, px2y1);
+    _mm256_storeu_ps(grad_x,
+                     _mm256_mul_ps(half, _mm256_sub_ps(res_px, res_mx)));
+
+    const __m256 res_my =
+        bilinear(ddx, ddy, dx, dy, px0ym1, px0y0, px1ym1, px1y0);
+    const __m256 res_py =
+        bilinear(ddx, ddy, dx, dy, px0y1, px0y2, px1y1, px1y2);
+    _mm256_storeu_ps(grad_y,
+                     _mm256_mul_ps(half, _mm256_sub_ps(res_py, res_my)));
+  }
+};
+
+using Default = AVX2;
+
+#elif defined(__ARM_NEON)
+
+// NEON has no gather instruction, so the pixel pairs are loaded lane by lane
+// and only the arithmetic is vectorized.
+struct NEON {
+  static constexpr int BATCH_SIZE = 4;
+
+  template <typename Pixel>
+  static inline void setup(const Image<const Pixel>& img, const float* xy,
+                           uint32_t* offset, float32x4_t& dx, float32x4_t& dy,
+                           float32x4_t& ddx, float32x4_t& ddy) {
+    const float32x4x2_t p = vld2q_f32(xy);
+
+    // coordinates are positive, so truncation is the same as floor
+    const int32x4_t ix = vcvtq_s32_f32(p.val[0]);
+    const int32x4_t iy = vcvtq_s32_f32(p.val[1]);
+
+    dx = vsubq_f32(p.val[0], vcvtq_f32_s32(ix));
+    dy = vsubq_f32(p.val[1], vcvtq_f32_s32(iy));
+    ddx = vsubq_f32(vdupq_n_f32(1.f), dx);
+    ddy = vsubq_f32(vdupq_n_f32(1.f), dy);
+
+    const uint32x4_t row_off =
+        vmulq_n_u32(vreinterpretq_u32_s32(iy), uint32_t(img.pitch));
+    if constexpr (sizeof(Pixel) == 2) {
+      vst1q_u32(offset,
+                vaddq_u32(row_off, vshlq_n_u32(vreinterpretq_u32_s32(ix), 1)));
+    } else {
+      vst1q_u32(offset, vaddq_u32(row_off, vreinterpretq_u32_s32(ix)));
+    }
+  }
+
+  // Loads the pixels (ix + dx, iy) and (ix + dx + 1, iy) of all lanes
+  template <typename Pixel>
+  static inline void gatherPair(const uint8_t* base, const uint32_t* offset,
+                                int dx, float32x4_t& p0, float32x4_t& p1) {
+    uint32_t v0[BATCH_SIZE], v1[BATCH_SIZE];
+    for (int i = 0; i < BATCH_SIZE; i++) {
+      Pixel pair[2];
+      std::memcpy(pair, base + offset[i] + dx * int(sizeof(Pixel)),
+                  sizeof(pair));
+      v0[i] = pair[0];
+      v1[i] = pair[1];
+    }
+    p0 = vcvtq_f32_u32(vld1q_u32(v0));
+    p1 = vcvtq_f32_u32(vld1q_u32(v1));
+  }
+
+  static inline float32x4_t bilinear(float32x4_t ddx, float32x4_t ddy,
+                                     float32x4_t dx, float32x4_t dy,
+                                     float32x4_t px0y0, float32x4_t px0y1,
+                                     float32x4_t px1y0, float32x4_t px1y1) {
+    float32x4_t res = vmulq_f32(vmulq_f32(ddx, ddy), px0y0);
+    res = vaddq_f32(res, vmulq_f32(vmulq_f32(ddx, dy), px0y1));
+    res = vaddq_f32(res, vmulq_f32(vmulq_f32(dx, ddy), px1y0));
+    res = vaddq_f32(res, vmulq_f32(vmulq_f32(dx, dy), px1y1));
+    return res;
+  }
+
+  template <typename Pixel>
+  static inline void interp(const Image<const Pixel>& img, const float* xy,
+                            float* val) {
+    uint32_t offset[BATCH_SIZE];
+    float32x4_t dx, dy, ddx, ddy;
+    setup(img, xy, offset, dx, dy, ddx, ddy);
+
+    const uint8_t* row0 = reinterpret_cast<const uint8_t*>(img.ptr);
+    const uint8_t* row1 = row0 + img.pitch;
+
+    float32x4_t px0y0, px1y0, px0y1, px1y1;
+    gatherPair<Pixel>(row0, offset, 0, px0y0, px1y0);
+    gatherPair<Pixel>(row1, offset, 0, px0y1, px1y1);
+
+    vst1q_f32(val, bilinear(ddx, ddy, dx, dy, px0y0, px0y1, px1y0, px1y1));
+  }
+
+  template <typename Pixel>
+  static inline void interpGrad(const Image<const Pixel>& img,
+                                const float* xy, float* val, float* grad_x,
+                                float* grad_y) {
+    uint32_t offset[BATCH_SIZE];
+    float32x4_t dx, dy, ddx, ddy;
+    setup(img, xy, offset, dx, dy, ddx, ddy);
+
+    const uint8_t* row0 = reinterpret_cast<const uint8_t*>(img.ptr);
+    const uint8_t* rowm1 = row0 - img.pitch;
+    const uint8_t* row1 = row0 + img.pitch;
+    const uint8_t* row2 = row1 + img.pitch;
+
+    float32x4_t pxm1y0, px0y0, px1y0, px2y0;
+    gatherPair<Pixel>(row0, offset, -1, pxm1y0, px0y0);
+    gatherPair<Pixel>(row0, offset, 1, px1y0, px2y0);
+
+    float32x4_t pxm1y1, px0y1, px1y1, px2y1;
+    gatherPair<Pixel>(row1, offset, -1, pxm1y1, px0y1);
+    gatherPair<Pixel>(row1, offset, 1, px1y1, px2y1);
+
+    float32x4_t px0ym1, px1ym1, px0y2, px1y2;
+    gatherPair<Pixel>(rowm1, offset, 0, px0ym1, px1ym1);
+    gatherPair<Pixel>(row2, offset, 0, px0y2, px1y2);
+
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    vst1q_f32(val, bilinear(ddx, ddy, dx, dy, px0y0, px0y1, px1y0, px1y1));
+
+    const float32x4_t res_mx =
+        bilinear(ddx, ddy, dx, dy, pxm1y0, pxm1y1, px0y0, px0y1);
+    const float32x4_t res_px =
+        bilinear(ddx, ddy, dx, dy, px1y0, px1y1, px2y0, px2y1);
+    vst1q_f32(grad_x, vmulq_f32(half, vsubq_f32(res_px, res_mx)));
+
+    const float32x4_t res_my =
+        bilinear(ddx, ddy, dx, dy, px0ym1, px0y0, px1ym1, px1y0);
+    const float32x4_t res_py =
+        bilinear(ddx, ddy, dx, dy, px0y1, px0y2, px1y1, px1y2);
+    vst1q_f32(grad_y, vmulq_f32(half, vsubq_f32(res_py, res_my)));
+  }
+};
+
+using Default = NEON;
+
+#else
+
+using Default = Scalar;
+
+#endif
+
+// Interpolates the image at num_points interleaved points. Only float
+// coordinates are vectorized, other types are evaluated point by point.
+template <typename Backend = Default, typename Pixel, typename T>
+inline void interpPoints(const Image<const Pixel>& img, const T* xy,
+                         int num_points, T* val) {
+  int i = 0;
+  if constexpr (std::is_same_v<T, float>) {
+    for (; i + Backend::BATCH_SIZE <= num_points; i += Backend::BATCH_SIZE) {
+      Backend::interp(img, xy + 2 * i, val + i);
+    }
+  }
+  for (; i < num_points; i++) {
+    val[i] = img.template interp<T>(xy[2 * i], xy[2 * i + 1]);
+  }
+}
+
+// Interpolates the image and its gradient at num_points interleaved points
+template <typename Backend = Default, typename Pixel, typename T>
+inline void interpGradPoints(const Image<const Pixel>& img, const T* xy,
+                             int num_points, T* val, T* grad_x, T* grad_y) {
+  int i = 0;
+  if constexpr (std::is_same_v<T, float>) {
+    for (; i + Backend::BATCH_SIZE <= num_points; i += Backend::BATCH_SIZE) {
+      Backend::interpGrad(img, xy + 2 * i, val + i, grad_x + i, grad_y + i);
+    }
+  }
+  for (; i < num_points; i++) {
+    const Eigen::Matrix<T, 3, 1> res =
+        img.template interpGrad<T>(xy[2 * i], xy[2 * i + 1]);
+    val[i] = res[0];
+    grad_x[i] = res[1];
+    grad_y[i] = res[2];
+  }
+}
+
+// Same as checking img.InBounds(p, border) for every column p of points, but
+// without a branch per point, so that the compiler can vectorize it. NaN
+// coordinates fail the test.
+template <typename Pixel, typename Scalar, int N>
+inline bool patchInBounds(const Image<const Pixel>& img,
+                          const Eigen::Matrix<Scalar, 2, N>& points,
+                          int border) {
+  const Scalar lo = border;
+  const Scalar hi_x = int(img.w) - border - 1;
+  const Scalar hi_y = int(img.h) - border - 1;
+
+  const Scalar* xy = points.data();
+
+  int out_of_bounds = 0;
+  for (Eigen::Index i = 0; i < 2 * points.cols(); i += 2) {
+    out_of_bounds |= !(lo <= xy[i]) | !(xy[i] < hi_x) | !(lo <= xy[i + 1]) |
+                     !(xy[i + 1] < hi_y);
+  }
+  return !out_of_bounds;
+}
+
+}  // namespace patch_interp
+}  // namespace basalt
@@ -39,18 +39,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sophus/se2.hpp>
 
 #include <tbb/blocked_range.h>
-#include <tbb/concurrent_unordered_map.h>
 #include <tbb/parallel_for.h>
 
 #include <basalt/optical_flow/optical_flow.h>
 #include <basalt/optical_flow/patch.h>
 
 #include <basalt/image/image_pyr.h>
+#include <basalt/utils/camera_batch.h>
 #include <basalt/utils/keypoints.h>
 
 namespace basalt {
 
-template <typename Scalar, template <typename> typename Pattern>
+template <typename Scalar, template <typename> typename Pattern,
+          typename Pixel>
 class PatchOpticalFlow : public OpticalFlowBase {
  public:
   typedef OpticalFlowPatch<Scalar, Pattern<Scalar>> PatchT;
@@ -72,7 +73,8 @@ class PatchOpticalFlow : public OpticalFlowBase {
         frame_counter(0),
         last_keypoint_id(0),
         config(config),
-        calib(calib) {
+        calib(calib),
+        iteration_stats(config.optical_flow_levels + 1) {
     patches.reserve(3000);
     input_queue.set_capacity(10);
 
@@ -89,11 +91,21 @@ class PatchOpticalFlow : public OpticalFlowBase {
 
   ~PatchOpticalFlow() { processing_thread->join(); }
 
+  size_t numPyramidsAllocated() const override {
+    return pyramid_pool.numAllocated();
+  }
+  size_t numPyramidsReused() const override { return pyramid_pool.numReused(); }
+
   void processingLoop() {
+    BASALT_TRACE_THREAD_NAME("optical_flow");
+
     OpticalFlowInput::Ptr input_ptr;
 
     while (true) {
-      input_queue.pop(input_ptr);
+      {
+        BASALT_TRACE_SCOPE("input_queue.pop");
+        input_queue.pop(input_ptr);
+      }
 
       if (!input_ptr.get()) {
         output_queue->push(nullptr);
@@ -105,8 +117,10 @@ class PatchOpticalFlow : public OpticalFlowBase {
   }
 
   void processFrame(int64_t curr_t_ns, OpticalFlowInput::Ptr& new_img_vec) {
+    BASALT_TRACE_SCOPE("processFrame");
+
     for (const auto& v : new_img_vec->img_data) {
-      if (!v.img.get()) return;
+      if (v.empty()) return;
     }
 
     if (t_ns < 0) {
@@ -116,11 +130,11 @@ class PatchOpticalFlow : public OpticalFlowBase {
       transforms->observations.resize(calib.intrinsics.size());
       transforms->t_ns = t_ns;
 
-      pyramid.reset(new std::vector<basalt::ManagedImagePyr<uint16_t>>);
-      pyramid->resize(calib.intrinsics.size());
+      pyramid = pyramid_pool.get(calib.intrinsics.size());
       for (size_t i = 0; i < calib.intrinsics.size(); i++) {
-        pyramid->at(i).setFromImage(*new_img_vec->img_data[i].img,
-                                    config.optical_flow_levels);
+        const auto img = new_img_vec->img_data[i].getImage<Pixel>();
+        pyramid->at(i).setFromImage(*img, config.optical_flow_levels,
+                                    config.optical_flow_pyramid_type);
       }
 
       transforms->input_images = new_img_vec;
@@ -133,11 +147,11 @@ class PatchOpticalFlow : public OpticalFlowBase {
 
       old_pyramid = pyramid;
 
-      pyramid.reset(new std::vector<basalt::ManagedImagePyr<uint16_t>>);
-      pyramid->resize(calib.intrinsics.size());
+      pyramid = pyramid_pool.get(calib.intrinsics.size());
       for (size_t i = 0; i < calib.intrinsics.size(); i++) {
-        pyramid->at(i).setFromImage(*new_img_vec->img_data[i].img,
-                                    config.optical_flow_levels);
+        const auto img = new_img_vec->img_data[i].getImage<Pixel>();
+        pyramid->at(i).setFromImage(*img, config.optical_flow_levels,
+                                    config.optical_flow_pyramid_type);
       }
 
       OpticalFlowResult::Ptr new_transforms;
@@ -158,43 +172,38 @@ class PatchOpticalFlow : public OpticalFlowBase {
       filterPoints();
     }
 
+    iteration_stats.collect(stats);
+
     if (output_queue && frame_counter % config.optical_flow_skip_frames == 0) {
+      if (latency_recorder) {
+        latency_recorder->record(transforms->t_ns,
+                                 FrameLatencyRecorder::OPTICAL_FLOW);
+      }
+      BASALT_TRACE_SCOPE("output_queue.push");
       output_queue->push(transforms);
     }
     frame_counter++;
   }
 
-  void trackPoints(const basalt::ManagedImagePyr<uint16_t>& pyr_1,
-                   const basalt::ManagedImagePyr<uint16_t>& pyr_2,
-                   const Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f>&
-                       transform_map_1,
-                   Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f>&
-                       transform_map_2) const {
-    size_t num_points = transform_map_1.size();
-
-    std::vector<KeypointId> ids;
-    Eigen::aligned_vector<Eigen::AffineCompact2f> init_vec;
+  void trackPoints(const basalt::ManagedImagePyr<Pixel>& pyr_1,
+                   const basalt::ManagedImagePyr<Pixel>& pyr_2,
+                   const KeypointTracks& tracks_1,
+                   KeypointTracks& tracks_2) const {
+    BASALT_TRACE_SCOPE("trackPoints");
 
-    ids.reserve(num_points);
-    init_vec.reserve(num_points);
+    const size_t num_points = tracks_1.size();
 
-    for (const auto& kv : transform_map_1) {
-      ids.push_back(kv.first);
-      init_vec.push_back(kv.second);
-    }
-
-    tbb::concurrent_unordered_map<KeypointId, Eigen::AffineCompact2f,
-                                  std::hash<KeypointId>>
-        result;
+    Eigen::aligned_vector<Eigen::AffineCompact2f> result(num_points);
+    std::vector<uint8_t> result_valid(num_points, 0);
 
     auto compute_func = [&](const tbb::blocked_range<size_t>& range) {
+      BASALT_TRACE_SCOPE("trackPointsRange");
       for (size_t r = range.begin(); r != range.end(); ++r) {
-        const KeypointId id = ids[r];
-
-        const Eigen::AffineCompact2f& transform_1 = init_vec[r];
+        const Eigen::AffineCompact2f transform_1 = tracks_1.transform(r);
         Eigen::AffineCompact2f transform_2 = transform_1;
 
-        const Eigen::aligned_vector<PatchT>& patch_vec = patches.at(id);
+        const Eigen::aligned_vector<PatchT>& patch_vec =
+            patches.at(tracks_1.id(r));
 
         bool valid = trackPoint(pyr_2, patch_vec, transform_2);
 
@@ -209,7 +218,8 @@ class PatchOpticalFlow : public OpticalFlowBase {
                                .squaredNorm();
 
             if (dist2 < config.optical_flow_max_recovered_dist2) {
-              result[id] = transform_2;
+              result[r] = transform_2;
+              result_valid[r] = 1;
             }
           }
         }
@@ -221,11 +231,14 @@ class PatchOpticalFlow : public OpticalFlowBase {
     tbb::parallel_for(range, compute_func);
     // compute_func(range);
 
-    transform_map_2.clear();
-    transform_map_2.insert(result.begin(), result.end());
+    tracks_2.clear();
+    tracks_2.reserve(num_points);
+    for (size_t r = 0; r < num_points; r++) {
+      if (result_valid[r]) tracks_2.push_back(tracks_1.id(r), result[r]);
+    }
   }
 
-  inline bool trackPoint(const basalt::ManagedImagePyr<uint16_t>& pyr,
+  inline bool trackPoint(const basalt::ManagedImagePyr<Pixel>& pyr,
                          const Eigen::aligned_vector<PatchT>& patch_vec,
                          Eigen::AffineCompact2f& transform) const {
     bool patch_valid = true;
@@ -241,7 +254,7 @@ class PatchOpticalFlow : public OpticalFlowBase {
       patch_valid &= p.valid;
       if (patch_valid) {
         // Perform tracking on current level
-        patch_valid &= trackPointAtLevel(pyr.lvl(level), p, transform);
+        patch_valid &= trackPointAtLevel(pyr.lvl(level), p, transform, level);
       }
 
       transform.translation() *= scale;
@@ -250,13 +263,20 @@ class PatchOpticalFlow : public OpticalFlowBase {
     return patch_valid;
   }
 
-  inline bool trackPointAtLevel(const Image<const uint16_t>& img_2,
+  inline bool trackPointAtLevel(const Image<const Pixel>& img_2,
                                 const PatchT& dp,
-                                Eigen::AffineCompact2f& transform) const {
+                                Eigen::AffineCompact2f& transform,
+                                int level) const {
     bool patch_valid = true;
+    bool converged = false;
+
+    const Scalar convergence_threshold2 =
+        config.optical_flow_convergence_threshold *
+        config.optical_flow_convergence_threshold;
 
-    for (int iteration = 0;
-         patch_valid && iteration < config.optical_flow_max_iterations;
+    int iteration = 0;
+    for (; patch_valid && !converged &&
+           iteration < config.optical_flow_max_iterations;
          iteration++) {
       typename PatchT::VectorP res;
 
@@ -281,27 +301,35 @@ class PatchOpticalFlow : public OpticalFlowBase {
           const int filter_margin = 2;
 
           patch_valid &= img_2.InBounds(transform.translation(), filter_margin);
+
+          converged = inc.squaredNorm() < convergence_threshold2;
         }
       }
     }
 
+    iteration_stats.add(level, iteration, converged);
+
     return patch_valid;
   }
 
   void addPoints() {
+    KeypointTracks& tracks0 = transforms->observations.at(0);
+
     Eigen::aligned_vector<Eigen::Vector2d> pts0;
+    pts0.reserve(tracks0.size());
 
-    for (const auto& kv : transforms->observations.at(0)) {
-      pts0.emplace_back(kv.second.translation().cast<double>());
+    for (size_t i = 0; i < tracks0.size(); i++) {
+      pts0.emplace_back(tracks0.translation(i).cast<double>());
     }
 
     KeypointsData kd;
 
     detectKeypoints(pyramid->at(0).lvl(0), kd,
-                    config.optical_flow_detection_grid_size, 1, pts0);
+                    config.optical_flow_detection_grid_size, 1, pts0,
+                    config.optical_flow_detector_type);
 
-    Eigen::aligned_map<KeypointId, Eigen::AffineCompact2f> new_poses0,
-        new_poses1;
+    KeypointTracks new_poses0, new_poses1;
+    new_poses0.reserve(kd.corners.size());
 
     for (size_t i = 0; i < kd.corners.size(); i++) {
       Eigen::aligned_vector<PatchT>& p = patches[last_keypoint_id];
@@ -318,8 +346,8 @@ class PatchOpticalFlow : public OpticalFlowBase {
       transform.setIdentity();
       transform.translation() = kd.corners[i].cast<Scalar>();
 
-      transforms->observations.at(0)[last_keypoint_id] = transform;
-      new_poses0[last_keypoint_id] = transform;
+      tracks0.push_back(last_keypoint_id, transform);
+      new_poses0.push_back(last_keypoint_id, transform);
 
       last_keypoint_id++;
     }
@@ -327,8 +355,11 @@ class PatchOpticalFlow : public OpticalFlowBase {
     if (calib.intrinsics.size() > 1) {
       trackPoints(pyramid->at(0), pyramid->at(1), new_poses0, new_poses1);
 
-      for (const auto& kv : new_poses1) {
-        transforms->observations.at(1).emplace(kv);
+      // New ids are larger than all existing ones, so appending keeps the
+      // tracks sorted
+      KeypointTracks& tracks1 = transforms->observations.at(1);
+      for (size_t i = 0; i < new_poses1.size(); i++) {
+        tracks1.push_back(new_poses1.id(i), new_poses1.transform(i));
       }
     }
   }
@@ -336,43 +367,52 @@ class PatchOpticalFlow : public OpticalFlowBase {
   void filterPoints() {
     if (calib.intrinsics.size() < 2) return;
 
-    std::set<KeypointId> lm_to_remove;
+    const KeypointTracks& tracks0 = transforms->observations.at(0);
+    KeypointTracks& tracks1 = transforms->observations.at(1);
+
+    std::vector<uint8_t> lm_to_remove(tracks1.size(), 0);
 
-    std::vector<KeypointId> kpid;
-    Eigen::aligned_vector<Eigen::Vector2d> proj0, proj1;
+    // indices into tracks1
+    std::vector<size_t> kpid, kpid0;
 
-    for (const auto& kv : transforms->observations.at(1)) {
-      auto it = transforms->observations.at(0).find(kv.first);
+    for (size_t i = 0; i < tracks1.size(); i++) {
+      const size_t idx0 = tracks0.index(tracks1.id(i));
 
-      if (it != transforms->observations.at(0).end()) {
-        proj0.emplace_back(it->second.translation().cast<double>());
-        proj1.emplace_back(kv.second.translation().cast<double>());
-        kpid.emplace_back(kv.first);
+      if (idx0 != KeypointTracks::INVALID_INDEX) {
+        kpid0.emplace_back(idx0);
+        kpid.emplace_back(i);
       }
     }
 
-    Eigen::aligned_vector<Eigen::Vector4d> p3d0, p3d1;
-    std::vector<bool> p3d0_success, p3d1_success;
+    CameraBatch<double>::Points2d proj0(kpid.size(), 2), proj1(kpid.size(), 2);
+    for (size_t i = 0; i < kpid.size(); i++) {
+      proj0.row(i) = tracks0.translation(kpid0[i]).cast<double>().transpose();
+      proj1.row(i) = tracks1.translation(kpid[i]).cast<double>().transpose();
+    }
+
+    CameraBatch<double>::Points3d p3d0, p3d1;
+    CameraBatch<double>::Mask p3d0_success, p3d1_success;
+
+    unprojectBatch(calib.intrinsics[0], proj0, p3d0, p3d0_success);
+    unprojectBatch(calib.intrinsics[1], proj1, p3d1, p3d1_success);
 
-    calib.intrinsics[0].unproject(proj0, p3d0, p3d0_success);
-    calib.intrinsics[1].unproject(proj1, p3d1, p3d1_success);
+    // p3d0^T * E * p3d1 of all points at once
+    const Eigen::VectorXd epipolar_errors =
+        (p3d0 * E).cwiseProduct(p3d1).rowwise().sum().cwiseAbs();
 
-    for (size_t i = 0; i < p3d0_success.size(); i++) {
+    for (size_t i = 0; i < kpid.size(); i++) {
       if (p3d0_success[i] && p3d1_success[i]) {
-        const double epipolar_error =
-            std::abs(p3d0[i].transpose() * E * p3d1[i]);
+        const double epipolar_error = epipolar_errors[i];
 
         if (epipolar_error > config.optical_flow_epipolar_error) {
-          lm_to_remove.emplace(kpid[i]);
+          lm_to_remove[kpid[i]] = 1;
         }
       } else {
-        lm_to_remove.emplace(kpid[i]);
+        lm_to_remove[kpid[i]] = 1;
       }
     }
 
-    for (int id : lm_to_remove) {
-      transforms->observations.at(1).erase(id);
-    }
+    tracks1.removeIf([&](size_t i) { return lm_to_remove[i]; });
   }
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -386,12 +426,14 @@ class PatchOpticalFlow : public OpticalFlowBase {
   VioConfig config;
   basalt::Calibration<double> calib;
 
+  mutable TrackingIterationStats iteration_stats;
+
   Eigen::aligned_unordered_map<KeypointId, Eigen::aligned_vector<PatchT>>
       patches;
 
   OpticalFlowResult::Ptr transforms;
-  std::shared_ptr<std::vector<basalt::ManagedImagePyr<uint16_t>>> old_pyramid,
-      pyramid;
+  PyramidPool<Pixel> pyramid_pool;
+  typename PyramidPool<Pixel>::Ptr old_pyramid, pyramid;
 
   Eigen::Matrix4d E;
 
@@ -0,0 +1,115 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <basalt/optical_flow/image_pyramid.h>
+
+namespace basalt {
+
+/// Pool of per-camera image pyramids for the optical flow frontends. A
+/// pyramid set returned by get() goes back to the pool when the last
+/// shared_ptr to it is released. Its images keep their memory, so once the
+/// pool holds as many sets as are in flight (current and previous frame),
+/// building pyramids doesn't allocate anymore.
+template <typename T>
+class PyramidPool {
+ public:
+  typedef std::vector<OpticalFlowPyr<T>> PyramidVec;
+  typedef std::shared_ptr<PyramidVec> Ptr;
+
+  PyramidPool() : state(std::make_shared<State>()) {}
+
+  /// Pyramid set with num_cams pyramids. The content of the pyramids is
+  /// undefined and has to be set with setFromImage.
+  Ptr get(size_t num_cams) {
+    PyramidVec* pyramids = nullptr;
+
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->free.empty()) {
+        pyramids = state->free.back().release();
+        state->free.pop_back();
+      }
+    }
+
+    if (pyramids) {
+      state->num_reused++;
+    } else {
+      pyramids = new PyramidVec;
+      state->num_allocated++;
+    }
+
+    pyramids->resize(num_cams);
+
+    // The deleter keeps the shared state alive, so pyramids may outlive the
+    // pool
+    std::shared_ptr<State> s = state;
+    return Ptr(pyramids, [s](PyramidVec* p) {
+      std::lock_guard<std::mutex> lock(s->mutex);
+      s->free.emplace_back(p);
+    });
+  }
+
+  /// Number of pyramid sets allocated by the pool
+  size_t numAllocated() const { return state->num_allocated; }
+
+  /// Number of requests served from the pool without allocation
+  size_t numReused() const { return state->num_reused; }
+
+  /// Number of pyramid sets currently not in use
+  size_t numFree() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->free.size();
+  }
+
+ private:
+  struct State {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<PyramidVec>> free;
+
+    std::atomic<size_t> num_allocated{0};
+    std::atomic<size_t> num_reused{0};
+  };
+
+  std::shared_ptr<State> state;
+};
+
+}  // namespace basalt
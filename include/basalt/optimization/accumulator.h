@@ -38,9 +38,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <limits>
+#include <numeric>
 #include <unordered_map>
+#include <vector>
 
 #include <basalt/utils/assert.h>
 #include <basalt/utils/hash.h>
@@ -278,4 +282,351 @@ class SparseHashAccumulator {
   SparseMatrix smm;
 };
 
+// Accumulator for a symmetric system with the variables split into blocks, e.g.
+// of poses and states. The blocks are eliminated in the given order. Only the
+// blocks on and below the diagonal of the system permuted to that order are
+// stored, and only if something was added to them. Callers add both halves of
+// the symmetric system, additions to the other half are ignored. The system is
+// solved with a block Cholesky factorization in the elimination order, which
+// stays sparse if the blocks with few neighbours are eliminated first, e.g. the
+// states of an IMU chain before the keyframe poses. The memory of the blocks
+// and of the factor is kept between resets.
+template <typename Scalar_ = double>
+class BlockSparseAccumulator {
+ public:
+  using Scalar = Scalar_;
+
+  typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> VectorX;
+  typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> MatrixX;
+
+  // block_start holds the first index of every block in ascending order,
+  // starting with 0. The last block ends at opt_size. elimination_order
+  // holds every block once, in the order of elimination. Without it the
+  // blocks are eliminated in ascending order.
+  inline void reset(const std::vector<int>& block_start, int opt_size,
+                    const std::vector<int>* elimination_order = nullptr) {
+    BASALT_ASSERT(!block_start.empty() && block_start.front() == 0);
+
+    block_start_ = block_start;
+    b.setZero(opt_size);
+
+    const int num_blocks = numBlocks();
+
+    block_idx_.resize(opt_size);
+    for (int k = 0; k < num_blocks; k++) {
+      BASALT_ASSERT(block_start_[k] < blockEnd(k));
+      std::fill(block_idx_.begin() + block_start_[k],
+                block_idx_.begin() + blockEnd(k), k);
+    }
+
+    if (elimination_order) {
+      BASALT_ASSERT(int(elimination_order->size()) == num_blocks);
+      pos_block_ = *elimination_order;
+    } else {
+      pos_block_.resize(num_blocks);
+      std::iota(pos_block_.begin(), pos_block_.end(), 0);
+    }
+
+    block_pos_.assign(num_blocks, -1);
+    for (int p = 0; p < num_blocks; p++) {
+      BASALT_ASSERT(block_pos_[pos_block_[p]] == -1);
+      block_pos_[pos_block_[p]] = p;
+    }
+
+    // Blocks keep their memory, only the diagonal ones are non-zero
+    blocks_.resize(size_t(num_blocks) * (num_blocks + 1) / 2);
+    nonzero_.assign(blocks_.size(), false);
+    for (int k = 0; k < num_blocks; k++) getBlock(k, k);
+
+    pattern_valid_ = false;
+  }
+
+  template <int ROWS, int COLS, typename Derived>
+  inline void addH(int i, int j, const Eigen::MatrixBase<Derived>& data) {
+    EIGEN_STATIC_ASSERT_MATRIX_SPECIFIC_SIZE(Derived, ROWS, COLS);
+
+    const int bi = block_idx_[i];
+    const int bj = block_idx_[j];
+    if (block_pos_[bi] < block_pos_[bj]) return;
+
+    BASALT_ASSERT(i + ROWS <= blockEnd(bi));
+    BASALT_ASSERT(j + COLS <= blockEnd(bj));
+
+    getBlock(bi, bj).template block<ROWS, COLS>(i - block_start_[bi],
+                                                 j - block_start_[bj]) += data;
+  }
+
+  template <int ROWS, typename Derived>
+  inline void addB(int i, const Eigen::MatrixBase<Derived>& data) {
+    b.template segment<ROWS>(i) += data;
+  }
+
+  // Adds a dense symmetric matrix and vector for the variables from index
+  // start on. Used for priors that couple all of their variables.
+  inline void addDense(int start, const MatrixX& H, const VectorX& bb) {
+    BASALT_ASSERT(H.rows() == H.cols() && H.rows() == bb.rows());
+
+    b.segment(start, bb.rows()) += bb;
+    if (H.rows() == 0) return;
+
+    const int end = start + int(H.rows());
+    const int first = block_idx_[start];
+    const int last = block_idx_[end - 1];
+
+    for (int i = first; i <= last; i++) {
+      const int row = std::max(block_start_[i], start);
+      const int rows = std::min(blockEnd(i), end) - row;
+
+      for (int j = first; j <= last; j++) {
+        if (block_pos_[i] < block_pos_[j]) continue;
+
+        const int col = std::max(block_start_[j], start);
+        const int cols = std::min(blockEnd(j), end) - col;
+
+        getBlock(i, j).block(row - block_start_[i], col - block_start_[j],
+                             rows, cols) +=
+            H.block(row - start, col - start, rows, cols);
+      }
+    }
+  }
+
+  inline void addDiagonal(Scalar value) {
+    for (int k = 0; k < numBlocks(); k++) {
+      getBlock(k, k).diagonal().array() += value;
+    }
+  }
+
+  inline void setup_solver() {}
+
+  inline VectorX Hdiagonal() const {
+    VectorX diagonal(b.rows());
+    for (int k = 0; k < numBlocks(); k++) {
+      const int p = block_pos_[k];
+      diagonal.segment(block_start_[k], blockSize(k)) =
+          blocks_[blockIdx(p, p)].diagonal();
+    }
+    return diagonal;
+  }
+
+  // Solves (H + diagonal) x = b. If the damped system is not positive
+  // definite, the result is NaN, like for a failed dense LDLT. The pattern of
+  // the factor is computed on the first solve after blocks were added, the
+  // following solves for other diagonals reuse it and the memory of the
+  // factor.
+  inline VectorX solve(const VectorX* diagonal) {
+    const int num_blocks = numBlocks();
+
+    if (!pattern_valid_) analyzePattern();
+
+    // Factor L with P (H + diagonal) P^T = L L^T, the blocks are indexed by
+    // their position in the elimination order
+    for (int p = 0; p < num_blocks; p++) {
+      for (int q = 0; q <= p; q++) {
+        const size_t idx = blockIdx(p, q);
+        if (nonzero_[idx]) {
+          factor_[idx] = blocks_[idx];
+        } else if (pattern_[idx]) {
+          factor_[idx].setZero(posSize(p), posSize(q));
+        }
+      }
+
+      if (diagonal) {
+        factor_[blockIdx(p, p)].diagonal() +=
+            diagonal->segment(posStart(p), posSize(p));
+      }
+    }
+
+    for (int k = 0; k < num_blocks; k++) {
+      MatrixX& L_kk = factor_[blockIdx(k, k)];
+
+      Eigen::LLT<Eigen::Ref<MatrixX>> llt(L_kk);
+      if (llt.info() != Eigen::Success) {
+        return VectorX::Constant(b.rows(),
+                                 std::numeric_limits<Scalar>::quiet_NaN());
+      }
+
+      const std::vector<int>& rows = col_rows_[k];
+      for (int i : rows) {
+        L_kk.template triangularView<Eigen::Lower>()
+            .transpose()
+            .template solveInPlace<Eigen::OnTheRight>(factor_[blockIdx(i, k)]);
+      }
+
+      // Update of the remaining blocks, including the fill-in
+      for (size_t ii = 0; ii < rows.size(); ii++) {
+        for (size_t jj = 0; jj <= ii; jj++) {
+          factor_[blockIdx(rows[ii], rows[jj])].noalias() -=
+              factor_[blockIdx(rows[ii], k)] *
+              factor_[blockIdx(rows[jj], k)].transpose();
+        }
+      }
+    }
+
+    // Forward substitution L y = P b
+    VectorX x = b;
+    for (int k = 0; k < num_blocks; k++) {
+      auto x_k = x.segment(posStart(k), posSize(k));
+      factor_[blockIdx(k, k)]
+          .template triangularView<Eigen::Lower>()
+          .solveInPlace(x_k);
+
+      for (int i : col_rows_[k]) {
+        x.segment(posStart(i), posSize(i)).noalias() -=
+            factor_[blockIdx(i, k)] * x_k;
+      }
+    }
+
+    // Back substitution L^T P x = y
+    for (int k = num_blocks - 1; k >= 0; k--) {
+      auto x_k = x.segment(posStart(k), posSize(k));
+
+      for (int i : col_rows_[k]) {
+        x_k.noalias() -= factor_[blockIdx(i, k)].transpose() *
+                         x.segment(posStart(i), posSize(i));
+      }
+
+      factor_[blockIdx(k, k)]
+          .template triangularView<Eigen::Lower>()
+          .transpose()
+          .solveInPlace(x_k);
+    }
+
+    return x;
+  }
+
+  inline void join(const BlockSparseAccumulator<Scalar>& other) {
+    BASALT_ASSERT(block_start_ == other.block_start_);
+    BASALT_ASSERT(pos_block_ == other.pos_block_);
+
+    for (size_t idx = 0; idx < blocks_.size(); idx++) {
+      if (!other.nonzero_[idx]) continue;
+
+      if (nonzero_[idx]) {
+        blocks_[idx] += other.blocks_[idx];
+      } else {
+        blocks_[idx] = other.blocks_[idx];
+        nonzero_[idx] = true;
+        pattern_valid_ = false;
+      }
+    }
+
+    b += other.b;
+  }
+
+  // Dense matrix of the accumulated system, for testing
+  inline MatrixX getDenseH() const {
+    MatrixX H = MatrixX::Zero(b.rows(), b.rows());
+    for (int p = 0; p < numBlocks(); p++) {
+      for (int q = 0; q <= p; q++) {
+        const size_t idx = blockIdx(p, q);
+        if (!nonzero_[idx]) continue;
+
+        const int i = pos_block_[p];
+        const int j = pos_block_[q];
+        H.block(block_start_[i], block_start_[j], blockSize(i),
+                blockSize(j)) = blocks_[idx];
+        H.block(block_start_[j], block_start_[i], blockSize(j),
+                blockSize(i)) = blocks_[idx].transpose();
+      }
+    }
+    return H;
+  }
+
+  inline int numBlocks() const { return int(block_start_.size()); }
+
+  // Number of stored blocks on and below the diagonal
+  inline size_t numNonZeroBlocks() const {
+    return std::count(nonzero_.begin(), nonzero_.end(), true);
+  }
+
+  inline const std::vector<int>& getBlockStart() const {
+    return block_start_;
+  }
+
+  inline const std::vector<int>& getEliminationOrder() const {
+    return pos_block_;
+  }
+
+  inline VectorX& getB() { return b; }
+  inline const VectorX& getB() const { return b; }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ private:
+  inline int blockEnd(int k) const {
+    return k + 1 < numBlocks() ? block_start_[k + 1] : int(b.rows());
+  }
+
+  inline int blockSize(int k) const { return blockEnd(k) - block_start_[k]; }
+
+  // Start and size of the block at position p of the elimination order
+  inline int posStart(int p) const { return block_start_[pos_block_[p]]; }
+  inline int posSize(int p) const { return blockSize(pos_block_[p]); }
+
+  // Blocks are stored row by row by their position in the elimination order,
+  // lower triangle only
+  static inline size_t blockIdx(int p, int q) {
+    return size_t(p) * (p + 1) / 2 + q;
+  }
+
+  // Block (i, j) of H, with i not before j in the elimination order
+  inline MatrixX& getBlock(int i, int j) {
+    BASALT_ASSERT(block_pos_[i] >= block_pos_[j]);
+
+    const size_t idx = blockIdx(block_pos_[i], block_pos_[j]);
+    if (!nonzero_[idx]) {
+      blocks_[idx].setZero(blockSize(i), blockSize(j));
+      nonzero_[idx] = true;
+      pattern_valid_ = false;
+    }
+    return blocks_[idx];
+  }
+
+  // Symbolic factorization: the non-zero blocks of the factor, which are the
+  // ones of H and their fill-in, and the rows of the non-zero blocks below
+  // the diagonal of every block column
+  inline void analyzePattern() {
+    const int num_blocks = numBlocks();
+
+    pattern_ = nonzero_;
+    col_rows_.resize(num_blocks);
+
+    for (int k = 0; k < num_blocks; k++) {
+      std::vector<int>& rows = col_rows_[k];
+      rows.clear();
+      for (int i = k + 1; i < num_blocks; i++) {
+        if (pattern_[blockIdx(i, k)]) rows.push_back(i);
+      }
+
+      for (size_t ii = 0; ii < rows.size(); ii++) {
+        for (size_t jj = 0; jj <= ii; jj++) {
+          pattern_[blockIdx(rows[ii], rows[jj])] = true;
+        }
+      }
+    }
+
+    factor_.resize(blocks_.size());
+    pattern_valid_ = true;
+  }
+
+  // Start of every block
+  std::vector<int> block_start_;
+  // Block of every variable
+  std::vector<int> block_idx_;
+  // Block at every position of the elimination order and position of every
+  // block
+  std::vector<int> pos_block_;
+  std::vector<int> block_pos_;
+
+  std::vector<MatrixX> blocks_;
+  std::vector<bool> nonzero_;
+
+  // Pattern and memory of the factor, valid until a block is added
+  bool pattern_valid_ = false;
+  std::vector<bool> pattern_;
+  std::vector<std::vector<int>> col_rows_;
+  std::vector<MatrixX> factor_;
+
+  VectorX b;
+};
+
 }  // namespace basalt
@@ -79,6 +79,47 @@ Sophus::SE3<Scalar> computeRelPose(
   return res;
 }
 
+// Residual and Jacobians of an observation, given the projection res of the
+// landmark point p_t_3d = T_t_h * p_h_3d in the target frame with its
+// Jacobian Jp. Jup is the Jacobian of the unprojection of the landmark
+// direction in the host frame. On return res holds the residual.
+template <class Scalar>
+inline void linearizeProjection(
+    const Eigen::Matrix<Scalar, 2, 1>& kpt_obs, const Keypoint<Scalar>& kpt_pos,
+    const Eigen::Matrix<Scalar, 4, 4>& T_t_h,
+    const Eigen::Matrix<Scalar, 4, 2>& Jup,
+    const Eigen::Matrix<Scalar, 4, 1>& p_t_3d,
+    const Eigen::Matrix<Scalar, 2, 4>& Jp, Eigen::Matrix<Scalar, 2, 1>& res,
+    Eigen::Matrix<Scalar, 2, POSE_SIZE>* d_res_d_xi = nullptr,
+    Eigen::Matrix<Scalar, 2, 3>* d_res_d_p = nullptr,
+    Eigen::Matrix<Scalar, 4, 1>* proj = nullptr) {
+  if (proj) {
+    proj->template head<2>() = res;
+    (*proj)[2] = p_t_3d[3] / p_t_3d.template head<3>().norm();
+  }
+  res -= kpt_obs;
+
+  if (d_res_d_xi) {
+    Eigen::Matrix<Scalar, 4, POSE_SIZE> d_point_d_xi;
+    d_point_d_xi.template topLeftCorner<3, 3>() =
+        Eigen::Matrix<Scalar, 3, 3>::Identity() * kpt_pos.inv_dist;
+    d_point_d_xi.template topRightCorner<3, 3>() =
+        -Sophus::SO3<Scalar>::hat(p_t_3d.template head<3>());
+    d_point_d_xi.row(3).setZero();
+
+    *d_res_d_xi = Jp * d_point_d_xi;
+  }
+
+  if (d_res_d_p) {
+    Eigen::Matrix<Scalar, 4, 3> Jpp;
+    Jpp.setZero();
+    Jpp.template block<3, 2>(0, 0) = T_t_h.template topLeftCorner<3, 4>() * Jup;
+    Jpp.col(2) = T_t_h.col(3);
+
+    *d_res_d_p = Jp * Jpp;
+  }
+}
+
 template <class Scalar, class CamT>
 inline bool linearizePoint(
     const Eigen::Matrix<Scalar, 2, 1>& kpt_obs, const Keypoint<Scalar>& kpt_pos,
@@ -114,31 +155,8 @@ inline bool linearizePoint(
     return false;
   }
 
-  if (proj) {
-    proj->template head<2>() = res;
-    (*proj)[2] = p_t_3d[3] / p_t_3d.template head<3>().norm();
-  }
-  res -= kpt_obs;
-
-  if (d_res_d_xi) {
-    Eigen::Matrix<Scalar, 4, POSE_SIZE> d_point_d_xi;
-    d_point_d_xi.template topLeftCorner<3, 3>() =
-        Eigen::Matrix<Scalar, 3, 3>::Identity() * kpt_pos.inv_dist;
-    d_point_d_xi.template topRightCorner<3, 3>() =
-        -Sophus::SO3<Scalar>::hat(p_t_3d.template head<3>());
-    d_point_d_xi.row(3).setZero();
-
-    *d_res_d_xi = Jp * d_point_d_xi;
-  }
-
-  if (d_res_d_p) {
-    Eigen::Matrix<Scalar, 4, 3> Jpp;
-    Jpp.setZero();
-    Jpp.template block<3, 2>(0, 0) = T_t_h.template topLeftCorner<3, 4>() * Jup;
-    Jpp.col(2) = T_t_h.col(3);
-
-    *d_res_d_p = Jp * Jpp;
-  }
+  linearizeProjection(kpt_obs, kpt_pos, T_t_h, Jup, p_t_3d, Jp, res,
+                      d_res_d_xi, d_res_d_p, proj);
 
   return true;
 }
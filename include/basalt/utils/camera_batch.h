@@ -0,0 +1,964 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <variant>
+
+#include <Eigen/Dense>
+
+#include <basalt/camera/generic_camera.hpp>
+
+namespace basalt {
+
+// Batched projection and unprojection. The points of a batch are stored in
+// structure-of-arrays layout as the columns of column-major matrices with one
+// row per point, Jacobians likewise with one column per (column-major) matrix
+// entry. The camera variant of a GenericCamera is dispatched once per batch.
+//
+// The camera models have kernels that work on whole columns, in chunks of
+// CAMERA_BATCH_CHUNK_SIZE rows so that the intermediate columns have a fixed
+// maximum size and stay on the stack. Rows close to the optical axis, where
+// the models switch to a limit form, and other camera types run the per-point
+// code of the model.
+//
+// With MAX_POINTS the batch matrices have a fixed capacity and do not
+// allocate.
+template <typename Scalar, int MAX_POINTS = Eigen::Dynamic>
+using BatchPoints3d =
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 4, 0, MAX_POINTS, 4>;
+template <typename Scalar, int MAX_POINTS = Eigen::Dynamic>
+using BatchPoints2d =
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 2, 0, MAX_POINTS, 2>;
+template <typename Scalar, int MAX_POINTS = Eigen::Dynamic>
+using BatchJacobians =
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 8, 0, MAX_POINTS, 8>;
+template <int MAX_POINTS = Eigen::Dynamic>
+using BatchMask = Eigen::Matrix<uint8_t, Eigen::Dynamic, 1, 0, MAX_POINTS, 1>;
+
+constexpr Eigen::Index CAMERA_BATCH_CHUNK_SIZE = 16;
+
+template <typename Scalar, int MAX_POINTS = Eigen::Dynamic>
+struct CameraBatch {
+  // Homogeneous points x, y, z, w
+  typedef BatchPoints3d<Scalar, MAX_POINTS> Points3d;
+  // Projections u, v
+  typedef BatchPoints2d<Scalar, MAX_POINTS> Points2d;
+  // Entries of the 2x4 d_proj_d_p3d or the 4x2 d_p3d_d_proj
+  typedef BatchJacobians<Scalar, MAX_POINTS> Jacobians;
+  // Validity of the individual points
+  typedef BatchMask<MAX_POINTS> Mask;
+
+  // Intermediate column of a kernel for one chunk of rows
+  typedef Eigen::Array<Scalar, Eigen::Dynamic, 1, 0, CAMERA_BATCH_CHUNK_SIZE,
+                       1>
+      Chunk;
+};
+
+// Calls f(start, size) for the consecutive chunks of the rows [0, n)
+template <typename F>
+inline void forEachBatchChunk(Eigen::Index n, F f) {
+  for (Eigen::Index start = 0; start < n; start += CAMERA_BATCH_CHUNK_SIZE) {
+    f(start, std::min(CAMERA_BATCH_CHUNK_SIZE, n - start));
+  }
+}
+
+template <typename Scalar>
+struct BatchAtan2 {
+  Scalar operator()(const Scalar& y, const Scalar& x) const {
+    return std::atan2(y, x);
+  }
+};
+
+// Per-point projection of row i of a batch
+template <typename CamT, int N>
+inline void projectBatchRow(
+    const CamT& cam, const BatchPoints3d<typename CamT::Scalar, N>& p3d,
+    BatchPoints2d<typename CamT::Scalar, N>& proj, BatchMask<N>& valid,
+    BatchJacobians<typename CamT::Scalar, N>* d_proj_d_p3d, Eigen::Index i) {
+  using Scalar = typename CamT::Scalar;
+
+  Eigen::Matrix<Scalar, 2, 1> p;
+  if (d_proj_d_p3d) {
+    Eigen::Matrix<Scalar, 2, 4> J;
+    valid[i] = cam.project(p3d.row(i).transpose().eval(), p, &J);
+    d_proj_d_p3d->row(i) = Eigen::Map<Eigen::Matrix<Scalar, 1, 8>>(J.data());
+  } else {
+    valid[i] = cam.project(p3d.row(i).transpose().eval(), p);
+  }
+  proj.row(i) = p.transpose();
+}
+
+// Per-point unprojection of row i of a batch
+template <typename CamT, int N>
+inline void unprojectBatchRow(
+    const CamT& cam, const BatchPoints2d<typename CamT::Scalar, N>& proj,
+    BatchPoints3d<typename CamT::Scalar, N>& p3d, BatchMask<N>& valid,
+    BatchJacobians<typename CamT::Scalar, N>* d_p3d_d_proj, Eigen::Index i) {
+  using Scalar = typename CamT::Scalar;
+
+  Eigen::Matrix<Scalar, 4, 1> p;
+  if (d_p3d_d_proj) {
+    Eigen::Matrix<Scalar, 4, 2> J;
+    valid[i] = cam.unproject(proj.row(i).transpose().eval(), p, &J);
+    d_p3d_d_proj->row(i) = Eigen::Map<Eigen::Matrix<Scalar, 1, 8>>(J.data());
+  } else {
+    valid[i] = cam.unproject(proj.row(i).transpose().eval(), p);
+  }
+  p3d.row(i) = p.transpose();
+}
+
+// Per-point projection of all rows of a batch
+template <typename CamT, int N>
+inline void projectBatchPerPoint(
+    const CamT& cam, const BatchPoints3d<typename CamT::Scalar, N>& p3d,
+    BatchPoints2d<typename CamT::Scalar, N>& proj, BatchMask<N>& valid,
+    BatchJacobians<typename CamT::Scalar, N>* d_proj_d_p3d) {
+  const Eigen::Index n = p3d.rows();
+  proj.resize(n, 2);
+  valid.resize(n);
+  if (d_proj_d_p3d) d_proj_d_p3d->resize(n, 8);
+
+  for (Eigen::Index i = 0; i < n; i++) {
+    projectBatchRow(cam, p3d, proj, valid, d_proj_d_p3d, i);
+  }
+}
+
+// Per-point unprojection of all rows of a batch
+template <typename CamT, int N>
+inline void unprojectBatchPerPoint(
+    const CamT& cam, const BatchPoints2d<typename CamT::Scalar, N>& proj,
+    BatchPoints3d<typename CamT::Scalar, N>& p3d, BatchMask<N>& valid,
+    BatchJacobians<typename CamT::Scalar, N>* d_p3d_d_proj) {
+  const Eigen::Index n = proj.rows();
+  p3d.resize(n, 4);
+  valid.resize(n);
+  if (d_p3d_d_proj) d_p3d_d_proj->resize(n, 8);
+
+  for (Eigen::Index i = 0; i < n; i++) {
+    unprojectBatchRow(cam, proj, p3d, valid, d_p3d_d_proj, i);
+  }
+}
+
+// Camera types without a column kernel
+template <typename CamT, int N>
+inline void projectBatch(
+    const CamT& cam, const BatchPoints3d<typename CamT::Scalar, N>& p3d,
+    BatchPoints2d<typename CamT::Scalar, N>& proj, BatchMask<N>& valid,
+    BatchJacobians<typename CamT::Scalar, N>* d_proj_d_p3d = nullptr) {
+  projectBatchPerPoint(cam, p3d, proj, valid, d_proj_d_p3d);
+}
+
+template <typename CamT, int N>
+inline void unprojectBatch(
+    const CamT& cam, const BatchPoints2d<typename CamT::Scalar, N>& proj,
+    BatchPoints3d<typename CamT::Scalar, N>& p3d, BatchMask<N>& valid,
+    BatchJacobians<typename CamT::Scalar, N>* d_p3d_d_proj = nullptr) {
+  unprojectBatchPerPoint(cam, proj, p3d, valid, d_p3d_d_proj);
+}
+
+// Pinhole projection on whole columns, identical to PinholeCamera::project
+template <typename Scalar, int N>
+inline void projectBatch(const PinholeCamera<Scalar>& cam,
+                         const BatchPoints3d<Scalar, N>& p3d,
+                         BatchPoints2d<Scalar, N>& proj, BatchMask<N>& valid,
+                         BatchJacobians<Scalar, N>* d_proj_d_p3d = nullptr) {
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+
+  const auto x = p3d.col(0).array();
+  const auto y = p3d.col(1).array();
+  const auto z = p3d.col(2).array();
+
+  proj.resize(p3d.rows(), 2);
+  proj.col(0).array() = fx * x / z + cx;
+  proj.col(1).array() = fy * y / z + cy;
+
+  valid = (z >= Sophus::Constants<Scalar>::epsilonSqrt())
+              .template cast<uint8_t>();
+
+  if (d_proj_d_p3d) {
+    d_proj_d_p3d->setZero(p3d.rows(), 8);
+    d_proj_d_p3d->col(0).array() = fx / z;
+    d_proj_d_p3d->col(3).array() = fy / z;
+    d_proj_d_p3d->col(4).array() = -fx * x / (z * z);
+    d_proj_d_p3d->col(5).array() = -fy * y / (z * z);
+  }
+}
+
+// Pinhole unprojection to the unit sphere, identical to
+// PinholeCamera::unproject
+template <typename Scalar, int N>
+inline void unprojectBatch(const PinholeCamera<Scalar>& cam,
+                           const BatchPoints2d<Scalar, N>& proj,
+                           BatchPoints3d<Scalar, N>& p3d, BatchMask<N>& valid,
+                           BatchJacobians<Scalar, N>* d_p3d_d_proj = nullptr) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+
+  const Eigen::Index n = proj.rows();
+  p3d.resize(n, 4);
+  valid.setOnes(n);
+  if (d_p3d_d_proj) d_p3d_d_proj->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk mx = (proj.col(0).segment(s, m).array() - cx) / fx;
+    const Chunk my = (proj.col(1).segment(s, m).array() - cy) / fy;
+
+    const Chunk norm_inv =
+        (Scalar(1) + mx.square() + my.square()).sqrt().inverse();
+
+    auto P = p3d.middleRows(s, m);
+    P.col(0).array() = mx * norm_inv;
+    P.col(1).array() = my * norm_inv;
+    P.col(2).array() = norm_inv;
+    P.col(3).setZero();
+
+    if (d_p3d_d_proj) {
+      const Chunk norm_inv3 = norm_inv.cube();
+
+      auto J = d_p3d_d_proj->middleRows(s, m);
+      J.col(0).array() = (norm_inv - mx.square() * norm_inv3) / fx;
+      J.col(1).array() = -mx * my * norm_inv3 / fx;
+      J.col(2).array() = -mx * norm_inv3 / fx;
+      J.col(3).setZero();
+      J.col(4).array() = -mx * my * norm_inv3 / fy;
+      J.col(5).array() = (norm_inv - my.square() * norm_inv3) / fy;
+      J.col(6).array() = -my * norm_inv3 / fy;
+      J.col(7).setZero();
+    }
+  });
+}
+
+// Kannala-Brandt projection on whole columns, identical to
+// KannalaBrandtCamera4::project
+template <typename Scalar, int N>
+inline void projectBatch(const KannalaBrandtCamera4<Scalar>& cam,
+                         const BatchPoints3d<Scalar, N>& p3d,
+                         BatchPoints2d<Scalar, N>& proj, BatchMask<N>& valid,
+                         BatchJacobians<Scalar, N>* d_proj_d_p3d = nullptr) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+  const Scalar k1 = param[4];
+  const Scalar k2 = param[5];
+  const Scalar k3 = param[6];
+  const Scalar k4 = param[7];
+
+  const Scalar eps = Sophus::Constants<Scalar>::epsilonSqrt();
+
+  const Eigen::Index n = p3d.rows();
+  proj.resize(n, 2);
+  valid.setOnes(n);
+  if (d_proj_d_p3d) d_proj_d_p3d->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk x = p3d.col(0).segment(s, m).array();
+    const Chunk y = p3d.col(1).segment(s, m).array();
+    const Chunk z = p3d.col(2).segment(s, m).array();
+
+    const Chunk r2 = x.square() + y.square();
+    const Chunk r = r2.sqrt();
+
+    const Chunk theta = r.binaryExpr(z, BatchAtan2<Scalar>());
+    const Chunk theta2 = theta.square();
+
+    const Chunk r_theta =
+        ((((k4 * theta2 + k3) * theta2 + k2) * theta2 + k1) * theta2 +
+         Scalar(1)) *
+        theta;
+
+    proj.col(0).segment(s, m).array() = fx * x * r_theta / r + cx;
+    proj.col(1).segment(s, m).array() = fy * y * r_theta / r + cy;
+
+    if (d_proj_d_p3d) {
+      const Chunk tmp = z.square() + r2;
+
+      const Chunk d_theta_d_x = x / r * z / tmp;
+      const Chunk d_theta_d_y = y / r * z / tmp;
+      const Chunk d_theta_d_z = -r / tmp;
+
+      const Chunk d_r_theta_d_theta =
+          (((Scalar(9) * k4 * theta2 + Scalar(7) * k3) * theta2 +
+            Scalar(5) * k2) *
+               theta2 +
+           Scalar(3) * k1) *
+              theta2 +
+          Scalar(1);
+
+      auto J = d_proj_d_p3d->middleRows(s, m);
+      J.col(0).array() = fx *
+                         (r_theta * r +
+                          x * r * d_r_theta_d_theta * d_theta_d_x -
+                          x * x * r_theta / r) /
+                         r2;
+      J.col(1).array() =
+          fy * y * (d_r_theta_d_theta * d_theta_d_x * r - x * r_theta / r) /
+          r2;
+      J.col(2).array() =
+          fx * x * (d_r_theta_d_theta * d_theta_d_y * r - y * r_theta / r) /
+          r2;
+      J.col(3).array() = fy *
+                         (r_theta * r +
+                          y * r * d_r_theta_d_theta * d_theta_d_y -
+                          y * y * r_theta / r) /
+                         r2;
+      J.col(4).array() = fx * x * d_r_theta_d_theta * d_theta_d_z / r;
+      J.col(5).array() = fy * y * d_r_theta_d_theta * d_theta_d_z / r;
+      J.col(6).setZero();
+      J.col(7).setZero();
+    }
+
+    for (Eigen::Index k = 0; k < m; k++) {
+      if (r[k] <= eps) {
+        projectBatchRow(cam, p3d, proj, valid, d_proj_d_p3d, s + k);
+      }
+    }
+  });
+}
+
+// Kannala-Brandt unprojection on whole columns, identical to
+// KannalaBrandtCamera4::unproject
+template <typename Scalar, int N>
+inline void unprojectBatch(const KannalaBrandtCamera4<Scalar>& cam,
+                           const BatchPoints2d<Scalar, N>& proj,
+                           BatchPoints3d<Scalar, N>& p3d, BatchMask<N>& valid,
+                           BatchJacobians<Scalar, N>* d_p3d_d_proj = nullptr) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+  const Scalar k1 = param[4];
+  const Scalar k2 = param[5];
+  const Scalar k3 = param[6];
+  const Scalar k4 = param[7];
+
+  const Scalar eps = Sophus::Constants<Scalar>::epsilonSqrt();
+
+  const Eigen::Index n = proj.rows();
+  p3d.resize(n, 4);
+  valid.setOnes(n);
+  if (d_p3d_d_proj) d_p3d_d_proj->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk mx = (proj.col(0).segment(s, m).array() - cx) / fx;
+    const Chunk my = (proj.col(1).segment(s, m).array() - cy) / fy;
+
+    const Chunk thetad = (mx.square() + my.square()).sqrt();
+
+    // Newton iterations of solveTheta<3>, the Jacobian uses the derivative
+    // of the last iteration
+    Chunk theta = thetad;
+    Chunk d_func_d_theta(m);
+    for (int i = 0; i < 3; i++) {
+      const Chunk theta2 = theta.square();
+
+      const Chunk func =
+          ((((k4 * theta2 + k3) * theta2 + k2) * theta2 + k1) * theta2 +
+           Scalar(1)) *
+          theta;
+
+      d_func_d_theta = (((Scalar(9) * k4 * theta2 + Scalar(7) * k3) * theta2 +
+                         Scalar(5) * k2) *
+                            theta2 +
+                        Scalar(3) * k1) *
+                           theta2 +
+                       Scalar(1);
+
+      theta -= (func - thetad) / d_func_d_theta;
+    }
+
+    const Chunk sin_theta = theta.sin();
+    const Chunk cos_theta = theta.cos();
+    const Chunk scaling = sin_theta / thetad;
+
+    auto P = p3d.middleRows(s, m);
+    P.col(0).array() = mx * scaling;
+    P.col(1).array() = my * scaling;
+    P.col(2).array() = cos_theta;
+    P.col(3).setZero();
+
+    if (d_p3d_d_proj) {
+      const Chunk d_thetad_d_mx = mx / thetad;
+      const Chunk d_thetad_d_my = my / thetad;
+
+      const Chunk d_scaling_d_thetad =
+          (thetad * cos_theta / d_func_d_theta - sin_theta) / thetad.square();
+      const Chunk d_cos_d_thetad = sin_theta / d_func_d_theta;
+
+      auto J = d_p3d_d_proj->middleRows(s, m);
+      J.col(0).array() =
+          (scaling + mx * d_scaling_d_thetad * d_thetad_d_mx) / fx;
+      J.col(1).array() = my * d_scaling_d_thetad * d_thetad_d_mx / fx;
+      J.col(2).array() = -d_cos_d_thetad * d_thetad_d_mx / fx;
+      J.col(3).setZero();
+      J.col(4).array() = mx * d_scaling_d_thetad * d_thetad_d_my / fy;
+      J.col(5).array() =
+          (scaling + my * d_scaling_d_thetad * d_thetad_d_my) / fy;
+      J.col(6).array() = -d_cos_d_thetad * d_thetad_d_my / fy;
+      J.col(7).setZero();
+    }
+
+    for (Eigen::Index k = 0; k < m; k++) {
+      if (thetad[k] <= eps) {
+        unprojectBatchRow(cam, proj, p3d, valid, d_p3d_d_proj, s + k);
+      }
+    }
+  });
+}
+
+// Projection of the extended unified model on whole columns, the unified
+// model is the special case beta = 1
+template <typename Scalar, int N>
+inline void projectBatchEucm(const Scalar fx, const Scalar fy,
+                             const Scalar cx, const Scalar cy,
+                             const Scalar alpha, const Scalar beta,
+                             const BatchPoints3d<Scalar, N>& p3d,
+                             BatchPoints2d<Scalar, N>& proj,
+                             BatchMask<N>& valid,
+                             BatchJacobians<Scalar, N>* d_proj_d_p3d) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const Scalar w = alpha > Scalar(0.5) ? (Scalar(1) - alpha) / alpha
+                                       : alpha / (Scalar(1) - alpha);
+
+  const Eigen::Index n = p3d.rows();
+  proj.resize(n, 2);
+  valid.resize(n);
+  if (d_proj_d_p3d) d_proj_d_p3d->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk x = p3d.col(0).segment(s, m).array();
+    const Chunk y = p3d.col(1).segment(s, m).array();
+    const Chunk z = p3d.col(2).segment(s, m).array();
+
+    const Chunk r2 = x.square() + y.square();
+    const Chunk rho = (beta * r2 + z.square()).sqrt();
+    const Chunk norm = alpha * rho + (Scalar(1) - alpha) * z;
+
+    proj.col(0).segment(s, m).array() = fx * x / norm + cx;
+    proj.col(1).segment(s, m).array() = fy * y / norm + cy;
+
+    valid.segment(s, m).array() = (z > -w * rho).template cast<uint8_t>();
+
+    if (d_proj_d_p3d) {
+      const Chunk denom = norm.square() * rho;
+      const Chunk mid = -(alpha * beta * x * y);
+      const Chunk add = norm * rho;
+      const Chunk addz = alpha * z + (Scalar(1) - alpha) * rho;
+
+      auto J = d_proj_d_p3d->middleRows(s, m);
+      J.col(0).array() = fx * (add - x * x * alpha * beta) / denom;
+      J.col(1).array() = fy * mid / denom;
+      J.col(2).array() = fx * mid / denom;
+      J.col(3).array() = fy * (add - y * y * alpha * beta) / denom;
+      J.col(4).array() = -fx * x * addz / denom;
+      J.col(5).array() = -fy * y * addz / denom;
+      J.col(6).setZero();
+      J.col(7).setZero();
+    }
+  });
+}
+
+// Unprojection of the extended unified model on whole columns, the unified
+// model is the special case beta = 1
+template <typename Scalar, int N>
+inline void unprojectBatchEucm(const Scalar fx, const Scalar fy,
+                               const Scalar cx, const Scalar cy,
+                               const Scalar alpha, const Scalar beta,
+                               const BatchPoints2d<Scalar, N>& proj,
+                               BatchPoints3d<Scalar, N>& p3d,
+                               BatchMask<N>& valid,
+                               BatchJacobians<Scalar, N>* d_p3d_d_proj) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const Scalar gamma = Scalar(1) - alpha;
+
+  const Eigen::Index n = proj.rows();
+  p3d.resize(n, 4);
+  valid.resize(n);
+  if (d_p3d_d_proj) d_p3d_d_proj->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk mx = (proj.col(0).segment(s, m).array() - cx) / fx;
+    const Chunk my = (proj.col(1).segment(s, m).array() - cy) / fy;
+
+    const Chunk r2 = mx.square() + my.square();
+
+    if (alpha > Scalar(0.5)) {
+      valid.segment(s, m).array() =
+          (r2 < Scalar(1) / ((alpha - gamma) * beta)).template cast<uint8_t>();
+    } else {
+      valid.segment(s, m).setOnes();
+    }
+
+    const Chunk tmp1 = Scalar(1) - alpha * alpha * beta * r2;
+    const Chunk tmp_sqrt = (Scalar(1) - (alpha - gamma) * beta * r2).sqrt();
+    const Chunk tmp2 = alpha * tmp_sqrt + gamma;
+
+    const Chunk k = tmp1 / tmp2;
+    const Chunk norm = (r2 + k.square()).sqrt();
+
+    auto P = p3d.middleRows(s, m);
+    P.col(0).array() = mx / norm;
+    P.col(1).array() = my / norm;
+    P.col(2).array() = k / norm;
+    P.col(3).setZero();
+
+    if (d_p3d_d_proj) {
+      const Chunk d_k_d_r2 =
+          Scalar(0.5) * alpha * beta *
+          (Scalar(-2) * alpha * tmp2 + tmp1 * (alpha - gamma) / tmp_sqrt) /
+          tmp2.square();
+      const Chunk d_norm_inv_d_r2 =
+          Scalar(-0.5) * (Scalar(1) + Scalar(2) * k * d_k_d_r2) / norm.cube();
+
+      auto J = d_p3d_d_proj->middleRows(s, m);
+      J.col(0).array() =
+          (norm.inverse() + Scalar(2) * mx * mx * d_norm_inv_d_r2) / fx;
+      J.col(1).array() = Scalar(2) * my * mx * d_norm_inv_d_r2 / fx;
+      J.col(2).array() = Scalar(2) * mx *
+                         (d_k_d_r2 / norm + k * d_norm_inv_d_r2) / fx;
+      J.col(3).setZero();
+      J.col(4).array() = Scalar(2) * my * mx * d_norm_inv_d_r2 / fy;
+      J.col(5).array() =
+          (norm.inverse() + Scalar(2) * my * my * d_norm_inv_d_r2) / fy;
+      J.col(6).array() = Scalar(2) * my *
+                         (d_k_d_r2 / norm + k * d_norm_inv_d_r2) / fy;
+      J.col(7).setZero();
+    }
+  });
+}
+
+// Extended unified projection on whole columns, identical to
+// ExtendedUnifiedCamera::project
+template <typename Scalar, int N>
+inline void projectBatch(const ExtendedUnifiedCamera<Scalar>& cam,
+                         const BatchPoints3d<Scalar, N>& p3d,
+                         BatchPoints2d<Scalar, N>& proj, BatchMask<N>& valid,
+                         BatchJacobians<Scalar, N>* d_proj_d_p3d = nullptr) {
+  const auto& param = cam.getParam();
+  projectBatchEucm(param[0], param[1], param[2], param[3], param[4], param[5],
+                   p3d, proj, valid, d_proj_d_p3d);
+}
+
+// Extended unified unprojection on whole columns, identical to
+// ExtendedUnifiedCamera::unproject
+template <typename Scalar, int N>
+inline void unprojectBatch(const ExtendedUnifiedCamera<Scalar>& cam,
+                           const BatchPoints2d<Scalar, N>& proj,
+                           BatchPoints3d<Scalar, N>& p3d, BatchMask<N>& valid,
+                           BatchJacobians<Scalar, N>* d_p3d_d_proj = nullptr) {
+  const auto& param = cam.getParam();
+  unprojectBatchEucm(param[0], param[1], param[2], param[3], param[4],
+                     param[5], proj, p3d, valid, d_p3d_d_proj);
+}
+
+// Unified projection on whole columns, identical to UnifiedCamera::project
+template <typename Scalar, int N>
+inline void projectBatch(const UnifiedCamera<Scalar>& cam,
+                         const BatchPoints3d<Scalar, N>& p3d,
+                         BatchPoints2d<Scalar, N>& proj, BatchMask<N>& valid,
+                         BatchJacobians<Scalar, N>* d_proj_d_p3d = nullptr) {
+  const auto& param = cam.getParam();
+  projectBatchEucm(param[0], param[1], param[2], param[3], param[4],
+                   Scalar(1), p3d, proj, valid, d_proj_d_p3d);
+}
+
+// Unified unprojection on whole columns, identical to
+// UnifiedCamera::unproject
+template <typename Scalar, int N>
+inline void unprojectBatch(const UnifiedCamera<Scalar>& cam,
+                           const BatchPoints2d<Scalar, N>& proj,
+                           BatchPoints3d<Scalar, N>& p3d, BatchMask<N>& valid,
+                           BatchJacobians<Scalar, N>* d_p3d_d_proj = nullptr) {
+  const auto& param = cam.getParam();
+  unprojectBatchEucm(param[0], param[1], param[2], param[3], param[4],
+                     Scalar(1), proj, p3d, valid, d_p3d_d_proj);
+}
+
+// Double sphere projection on whole columns, identical to
+// DoubleSphereCamera::project
+template <typename Scalar, int N>
+inline void projectBatch(const DoubleSphereCamera<Scalar>& cam,
+                         const BatchPoints3d<Scalar, N>& p3d,
+                         BatchPoints2d<Scalar, N>& proj, BatchMask<N>& valid,
+                         BatchJacobians<Scalar, N>* d_proj_d_p3d = nullptr) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+  const Scalar xi = param[4];
+  const Scalar alpha = param[5];
+
+  const Scalar w1 = alpha > Scalar(0.5) ? (Scalar(1) - alpha) / alpha
+                                        : alpha / (Scalar(1) - alpha);
+  const Scalar w2 =
+      (w1 + xi) / std::sqrt(Scalar(2) * w1 * xi + xi * xi + Scalar(1));
+
+  const Eigen::Index n = p3d.rows();
+  proj.resize(n, 2);
+  valid.resize(n);
+  if (d_proj_d_p3d) d_proj_d_p3d->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk x = p3d.col(0).segment(s, m).array();
+    const Chunk y = p3d.col(1).segment(s, m).array();
+    const Chunk z = p3d.col(2).segment(s, m).array();
+
+    const Chunk r2 = x.square() + y.square();
+    const Chunk d1 = (r2 + z.square()).sqrt();
+
+    const Chunk k = xi * d1 + z;
+    const Chunk d2 = (r2 + k.square()).sqrt();
+    const Chunk norm = alpha * d2 + (Scalar(1) - alpha) * k;
+
+    proj.col(0).segment(s, m).array() = fx * x / norm + cx;
+    proj.col(1).segment(s, m).array() = fy * y / norm + cy;
+
+    valid.segment(s, m).array() = (z > -w2 * d1).template cast<uint8_t>();
+
+    if (d_proj_d_p3d) {
+      const Chunk norm2 = norm.square();
+      const Chunk tt2 = xi * z / d1 + Scalar(1);
+
+      const Chunk d_norm_d_r2 =
+          (xi * (Scalar(1) - alpha) / d1 +
+           alpha * (xi * k / d1 + Scalar(1)) / d2) /
+          norm2;
+      const Chunk tmp2 =
+          ((Scalar(1) - alpha) * tt2 + alpha * k * tt2 / d2) / norm2;
+
+      auto J = d_proj_d_p3d->middleRows(s, m);
+      J.col(0).array() = fx * (norm.inverse() - x * x * d_norm_d_r2);
+      J.col(1).array() = -fy * x * y * d_norm_d_r2;
+      J.col(2).array() = -fx * x * y * d_norm_d_r2;
+      J.col(3).array() = fy * (norm.inverse() - y * y * d_norm_d_r2);
+      J.col(4).array() = -fx * x * tmp2;
+      J.col(5).array() = -fy * y * tmp2;
+      J.col(6).setZero();
+      J.col(7).setZero();
+    }
+  });
+}
+
+// Double sphere unprojection on whole columns, identical to
+// DoubleSphereCamera::unproject
+template <typename Scalar, int N>
+inline void unprojectBatch(const DoubleSphereCamera<Scalar>& cam,
+                           const BatchPoints2d<Scalar, N>& proj,
+                           BatchPoints3d<Scalar, N>& p3d, BatchMask<N>& valid,
+                           BatchJacobians<Scalar, N>* d_p3d_d_proj = nullptr) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+  const Scalar xi = param[4];
+  const Scalar alpha = param[5];
+
+  const Eigen::Index n = proj.rows();
+  p3d.resize(n, 4);
+  valid.resize(n);
+  if (d_p3d_d_proj) d_p3d_d_proj->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk mx = (proj.col(0).segment(s, m).array() - cx) / fx;
+    const Chunk my = (proj.col(1).segment(s, m).array() - cy) / fy;
+
+    const Chunk r2 = mx.square() + my.square();
+
+    if (alpha > Scalar(0.5)) {
+      valid.segment(s, m).array() =
+          (r2 < Scalar(1) / (Scalar(2) * alpha - Scalar(1)))
+              .template cast<uint8_t>();
+    } else {
+      valid.segment(s, m).setOnes();
+    }
+
+    const Chunk sqrt2 =
+        (Scalar(1) - (Scalar(2) * alpha - Scalar(1)) * r2).sqrt();
+    const Chunk norm2 = alpha * sqrt2 + Scalar(1) - alpha;
+
+    const Chunk mz = (Scalar(1) - alpha * alpha * r2) / norm2;
+    const Chunk mz2 = mz.square();
+
+    const Chunk norm1 = mz2 + r2;
+    const Chunk sqrt1 = (mz2 + (Scalar(1) - xi * xi) * r2).sqrt();
+    const Chunk k = (mz * xi + sqrt1) / norm1;
+
+    auto P = p3d.middleRows(s, m);
+    P.col(0).array() = k * mx;
+    P.col(1).array() = k * my;
+    P.col(2).array() = k * mz - xi;
+    P.col(3).setZero();
+
+    if (d_p3d_d_proj) {
+      const Chunk d_norm2_d_r2 =
+          -alpha * (Scalar(2) * alpha - Scalar(1)) / (Scalar(2) * sqrt2);
+      const Chunk d_mz_d_r2 = (-alpha * alpha - mz * d_norm2_d_r2) / norm2;
+      const Chunk d_norm1_d_r2 = Scalar(2) * mz * d_mz_d_r2 + Scalar(1);
+      const Chunk d_sqrt1_d_r2 =
+          (Scalar(2) * mz * d_mz_d_r2 + Scalar(1) - xi * xi) /
+          (Scalar(2) * sqrt1);
+      const Chunk d_k_d_r2 =
+          (d_mz_d_r2 * xi + d_sqrt1_d_r2 - k * d_norm1_d_r2) / norm1;
+      const Chunk d_z_d_r2 = d_k_d_r2 * mz + k * d_mz_d_r2;
+
+      auto J = d_p3d_d_proj->middleRows(s, m);
+      J.col(0).array() = (k + Scalar(2) * mx * mx * d_k_d_r2) / fx;
+      J.col(1).array() = Scalar(2) * mx * my * d_k_d_r2 / fx;
+      J.col(2).array() = Scalar(2) * mx * d_z_d_r2 / fx;
+      J.col(3).setZero();
+      J.col(4).array() = Scalar(2) * mx * my * d_k_d_r2 / fy;
+      J.col(5).array() = (k + Scalar(2) * my * my * d_k_d_r2) / fy;
+      J.col(6).array() = Scalar(2) * my * d_z_d_r2 / fy;
+      J.col(7).setZero();
+    }
+  });
+}
+
+// Field-of-view projection on whole columns, identical to
+// FovCamera::project
+template <typename Scalar, int N>
+inline void projectBatch(const FovCamera<Scalar>& cam,
+                         const BatchPoints3d<Scalar, N>& p3d,
+                         BatchPoints2d<Scalar, N>& proj, BatchMask<N>& valid,
+                         BatchJacobians<Scalar, N>* d_proj_d_p3d = nullptr) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+  const Scalar w = param[4];
+
+  const Scalar eps = Sophus::Constants<Scalar>::epsilonSqrt();
+
+  // the model degenerates for w close to zero
+  if (w <= eps) {
+    projectBatchPerPoint(cam, p3d, proj, valid, d_proj_d_p3d);
+    return;
+  }
+
+  const Scalar tanwhalf = std::tan(w / Scalar(2));
+
+  const Eigen::Index n = p3d.rows();
+  proj.resize(n, 2);
+  valid.setOnes(n);
+  if (d_proj_d_p3d) d_proj_d_p3d->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk x = p3d.col(0).segment(s, m).array();
+    const Chunk y = p3d.col(1).segment(s, m).array();
+    const Chunk z = p3d.col(2).segment(s, m).array();
+
+    const Chunk r2 = x.square() + y.square();
+    const Chunk r = r2.sqrt();
+
+    const Chunk atan_wrd =
+        (Scalar(2) * tanwhalf * r).binaryExpr(z, BatchAtan2<Scalar>());
+    const Chunk rd = atan_wrd / (r * w);
+
+    proj.col(0).segment(s, m).array() = fx * x * rd + cx;
+    proj.col(1).segment(s, m).array() = fy * y * rd + cy;
+
+    if (d_proj_d_p3d) {
+      const Chunk tmp = z.square() + Scalar(4) * tanwhalf * tanwhalf * r2;
+
+      const Chunk d_r_d_x = x / r;
+      const Chunk d_r_d_y = y / r;
+
+      const Chunk d_atan_wrd_d_x = Scalar(2) * tanwhalf * d_r_d_x * z / tmp;
+      const Chunk d_atan_wrd_d_y = Scalar(2) * tanwhalf * d_r_d_y * z / tmp;
+      const Chunk d_atan_wrd_d_z = Scalar(-2) * tanwhalf * r / tmp;
+
+      const Chunk d_rd_d_x =
+          (d_atan_wrd_d_x * r - d_r_d_x * atan_wrd) / (r2 * w);
+      const Chunk d_rd_d_y =
+          (d_atan_wrd_d_y * r - d_r_d_y * atan_wrd) / (r2 * w);
+      const Chunk d_rd_d_z = d_atan_wrd_d_z / (r * w);
+
+      auto J = d_proj_d_p3d->middleRows(s, m);
+      J.col(0).array() = fx * (d_rd_d_x * x + rd);
+      J.col(1).array() = fy * d_rd_d_x * y;
+      J.col(2).array() = fx * d_rd_d_y * x;
+      J.col(3).array() = fy * (d_rd_d_y * y + rd);
+      J.col(4).array() = fx * d_rd_d_z * x;
+      J.col(5).array() = fy * d_rd_d_z * y;
+      J.col(6).setZero();
+      J.col(7).setZero();
+    }
+
+    for (Eigen::Index k = 0; k < m; k++) {
+      if (r2[k] <= eps) {
+        projectBatchRow(cam, p3d, proj, valid, d_proj_d_p3d, s + k);
+      }
+    }
+  });
+}
+
+// Field-of-view unprojection on whole columns, identical to
+// FovCamera::unproject
+template <typename Scalar, int N>
+inline void unprojectBatch(const FovCamera<Scalar>& cam,
+                           const BatchPoints2d<Scalar, N>& proj,
+                           BatchPoints3d<Scalar, N>& p3d, BatchMask<N>& valid,
+                           BatchJacobians<Scalar, N>* d_p3d_d_proj = nullptr) {
+  using Chunk = typename CameraBatch<Scalar>::Chunk;
+
+  const auto& param = cam.getParam();
+  const Scalar fx = param[0];
+  const Scalar fy = param[1];
+  const Scalar cx = param[2];
+  const Scalar cy = param[3];
+  const Scalar w = param[4];
+
+  const Scalar eps = Sophus::Constants<Scalar>::epsilonSqrt();
+
+  const Scalar mul2tanwby2 = Scalar(2) * std::tan(w / Scalar(2));
+
+  // the model degenerates for w close to zero
+  if (mul2tanwby2 <= eps) {
+    unprojectBatchPerPoint(cam, proj, p3d, valid, d_p3d_d_proj);
+    return;
+  }
+
+  const Eigen::Index n = proj.rows();
+  p3d.resize(n, 4);
+  valid.setOnes(n);
+  if (d_p3d_d_proj) d_p3d_d_proj->resize(n, 8);
+
+  forEachBatchChunk(n, [&](Eigen::Index s, Eigen::Index m) {
+    const Chunk mx = (proj.col(0).segment(s, m).array() - cx) / fx;
+    const Chunk my = (proj.col(1).segment(s, m).array() - cy) / fy;
+
+    const Chunk rd = (mx.square() + my.square()).sqrt();
+
+    const Chunk sin_rd_w = (rd * w).sin();
+    const Chunk cos_rd_w = (rd * w).cos();
+
+    // (mx ru, my ru, cos(rd w)) normalized to the unit sphere
+    const Chunk ru = sin_rd_w / (rd * mul2tanwby2);
+    const Chunk norm = (rd.square() * ru.square() + cos_rd_w.square()).sqrt();
+
+    const Chunk scaling = ru / norm;
+
+    auto P = p3d.middleRows(s, m);
+    P.col(0).array() = mx * scaling;
+    P.col(1).array() = my * scaling;
+    P.col(2).array() = cos_rd_w / norm;
+    P.col(3).setZero();
+
+    if (d_p3d_d_proj) {
+      const Chunk d_ru_d_rd =
+          (w * cos_rd_w * rd - sin_rd_w) / (rd.square() * mul2tanwby2);
+      const Chunk d_cos_d_rd = -w * sin_rd_w;
+      const Chunk d_norm_d_rd =
+          (rd * ru.square() + rd.square() * ru * d_ru_d_rd +
+           cos_rd_w * d_cos_d_rd) /
+          norm;
+
+      const Chunk d_scaling_d_rd =
+          (d_ru_d_rd * norm - ru * d_norm_d_rd) / norm.square();
+      const Chunk d_z_d_rd =
+          (d_cos_d_rd * norm - cos_rd_w * d_norm_d_rd) / norm.square();
+
+      const Chunk d_rd_d_mx = mx / rd;
+      const Chunk d_rd_d_my = my / rd;
+
+      auto J = d_p3d_d_proj->middleRows(s, m);
+      J.col(0).array() = (scaling + mx * d_scaling_d_rd * d_rd_d_mx) / fx;
+      J.col(1).array() = my * d_scaling_d_rd * d_rd_d_mx / fx;
+      J.col(2).array() = d_z_d_rd * d_rd_d_mx / fx;
+      J.col(3).setZero();
+      J.col(4).array() = mx * d_scaling_d_rd * d_rd_d_my / fy;
+      J.col(5).array() = (scaling + my * d_scaling_d_rd * d_rd_d_my) / fy;
+      J.col(6).array() = d_z_d_rd * d_rd_d_my / fy;
+      J.col(7).setZero();
+    }
+
+    for (Eigen::Index k = 0; k < m; k++) {
+      if (rd[k] <= eps) {
+        unprojectBatchRow(cam, proj, p3d, valid, d_p3d_d_proj, s + k);
+      }
+    }
+  });
+}
+
+template <typename Scalar, int N>
+inline void projectBatch(const GenericCamera<Scalar>& cam,
+                         const BatchPoints3d<Scalar, N>& p3d,
+                         BatchPoints2d<Scalar, N>& proj, BatchMask<N>& valid,
+                         BatchJacobians<Scalar, N>* d_proj_d_p3d = nullptr) {
+  std::visit(
+      [&](const auto& c) { projectBatch(c, p3d, proj, valid, d_proj_d_p3d); },
+      cam.variant);
+}
+
+template <typename Scalar, int N>
+inline void unprojectBatch(const GenericCamera<Scalar>& cam,
+                           const BatchPoints2d<Scalar, N>& proj,
+                           BatchPoints3d<Scalar, N>& p3d, BatchMask<N>& valid,
+                           BatchJacobians<Scalar, N>* d_p3d_d_proj = nullptr) {
+  std::visit(
+      [&](const auto& c) { unprojectBatch(c, proj, p3d, valid, d_p3d_d_proj); },
+      cam.variant);
+}
+
+}  // namespace basalt
@@ -44,6 +44,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <basalt/utils/sophus_utils.hpp>
 
 #include <basalt/utils/common_types.h>
+#include <basalt/utils/vio_config.h>
 #include <basalt/camera/generic_camera.hpp>
 
 namespace basalt {
@@ -53,11 +54,24 @@ typedef std::bitset<256> Descriptor;
 void detectKeypointsMapping(const basalt::Image<const uint16_t>& img_raw,
                             KeypointsData& kd, int num_features);
 
+/// Detects up to num_points_cell FAST corners in every cell of a grid with
+/// PATCH_SIZE cells that does not contain any of the current_points. The
+/// default detector is the one of the default VioConfig.
 void detectKeypoints(
     const basalt::Image<const uint16_t>& img_raw, KeypointsData& kd,
     int PATCH_SIZE = 32, int num_points_cell = 1,
     const Eigen::aligned_vector<Eigen::Vector2d>& current_points =
-        Eigen::aligned_vector<Eigen::Vector2d>());
+        Eigen::aligned_vector<Eigen::Vector2d>(),
+    KeypointDetectorType detector_type = KeypointDetectorType::GRID_FAST);
+
+/// Same for 8 bit images, gives the same corners as the 16 bit version on the
+/// image shifted to 16 bit.
+void detectKeypoints(
+    const basalt::Image<const uint8_t>& img_raw, KeypointsData& kd,
+    int PATCH_SIZE = 32, int num_points_cell = 1,
+    const Eigen::aligned_vector<Eigen::Vector2d>& current_points =
+        Eigen::aligned_vector<Eigen::Vector2d>(),
+    KeypointDetectorType detector_type = KeypointDetectorType::GRID_FAST);
 
 void computeAngles(const basalt::Image<const uint16_t>& img_raw,
                    KeypointsData& kd, bool rotate_features);
@@ -65,10 +79,17 @@ void computeAngles(const basalt::Image<const uint16_t>& img_raw,
 void computeDescriptors(const basalt::Image<const uint16_t>& img_raw,
                         KeypointsData& kd);
 
+/// Cross-checked descriptor matching. A pair matches if both descriptors
+/// are the best match of each other with a distance below threshold and the
+/// second best distance is at least dist_2_best times larger. BRUTE_FORCE
+/// computes both directions from a single pass over all distances,
+/// MULTI_INDEX_HASHING only compares candidates with similar substrings.
 void matchDescriptors(const std::vector<std::bitset<256>>& corner_descriptors_1,
                       const std::vector<std::bitset<256>>& corner_descriptors_2,
                       std::vector<std::pair<int, int>>& matches, int threshold,
-                      double dist_2_best);
+                      double dist_2_best,
+                      DescriptorMatcherType matcher_type =
+                          DescriptorMatcherType::BRUTE_FORCE);
 
 inline void computeEssential(const Sophus::SE3d& T_0_1, Eigen::Matrix4d& E) {
   E.setZero();
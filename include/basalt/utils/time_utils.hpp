@@ -35,7 +35,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <variant>
@@ -138,4 +141,55 @@ class ExecutionStats {
   std::vector<std::string> order_;
 };
 
+// Wall clock time at which every frame passes the stages of the VIO pipeline,
+// keyed by the frame timestamp. The stages are recorded by different threads.
+class FrameLatencyRecorder {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum Stage {
+    INPUT = 0,     // frame handed to the optical flow
+    OPTICAL_FLOW,  // tracking result handed to the estimator
+    ESTIMATOR,     // estimator finished processing the frame
+    STATE_OUTPUT,  // estimated state received by the consumer
+    NUM_STAGES
+  };
+
+  struct StageSummary {
+    size_t num_frames = 0;
+
+    // latency relative to INPUT in seconds
+    double p50 = 0, p95 = 0, p99 = 0, max = 0;
+  };
+
+  struct Summary {
+    size_t num_input_frames = 0;
+
+    // frames tracked by the optical flow but never processed by the estimator
+    // (e.g. dropped because of vio_enforce_realtime)
+    size_t num_dropped_frames = 0;
+
+    std::array<StageSummary, NUM_STAGES> stages;
+  };
+
+  static const char* stage_name(Stage stage);
+
+  inline void record(int64_t frame_t_ns, Stage stage) {
+    record(frame_t_ns, stage, Clock::now());
+  }
+
+  // only the first time a frame reaches a stage is kept
+  void record(int64_t frame_t_ns, Stage stage, Clock::time_point time);
+
+  Summary summarize() const;
+
+  void print() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<int64_t,
+                     std::array<std::optional<Clock::time_point>, NUM_STAGES>>
+      stamps_;
+};
+
 }  // namespace basalt
@@ -0,0 +1,151 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timeline tracing of the processing threads, exported in the Chrome trace
+// event format (chrome://tracing, https://ui.perfetto.dev). Only compiled in
+// if BASALT_ENABLE_TRACING is defined (CMake option of the same name),
+// otherwise the macros below expand to nothing.
+//
+//   BASALT_TRACE_THREAD_NAME("estimator");
+//   {
+//     BASALT_TRACE_SCOPE("optimize");
+//     ...
+//   }
+//   BASALT_TRACE_SAVE("trace.json");
+//
+// Names of the scopes must be string literals, they are stored as pointers.
+
+namespace basalt {
+namespace tracing {
+
+struct TraceEvent {
+  const char* name;
+  int64_t start_ns;
+  int64_t duration_ns;
+};
+
+// Ring buffer with the most recent events of one thread. Only the owning
+// thread writes, so recording an event takes no locks. The buffers are kept
+// alive after their thread has finished, until the trace is saved.
+class ThreadTraceBuffer {
+ public:
+  static constexpr size_t CAPACITY = 1 << 16;
+
+  explicit ThreadTraceBuffer(int tid) : tid(tid), events(CAPACITY) {}
+
+  inline void add(const char* name, int64_t start_ns, int64_t duration_ns) {
+    const uint64_t n = num_events.load(std::memory_order_relaxed);
+    events[n % CAPACITY] = TraceEvent{name, start_ns, duration_ns};
+    num_events.store(n + 1, std::memory_order_release);
+  }
+
+  const int tid;
+
+  // Set through set_thread_name, read when the trace is saved
+  std::string name;
+
+  // Total number of events added, including overwritten ones
+  std::atomic<uint64_t> num_events{0};
+
+  std::vector<TraceEvent> events;
+};
+
+// Nanoseconds of the steady clock
+inline int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+ThreadTraceBuffer* register_thread();
+
+inline ThreadTraceBuffer& thread_buffer() {
+  thread_local ThreadTraceBuffer* buffer = register_thread();
+  return *buffer;
+}
+
+void set_thread_name(const std::string& name);
+
+// Writes the events of all threads as Chrome trace JSON. Should be called
+// when the traced threads are idle, e.g. after they have been joined; events
+// recorded while saving might be torn.
+bool save_chrome_trace(const std::string& path);
+
+class ScopedTrace {
+ public:
+  explicit ScopedTrace(const char* name) : name_(name), start_ns_(now_ns()) {}
+
+  ~ScopedTrace() {
+    thread_buffer().add(name_, start_ns_, now_ns() - start_ns_);
+  }
+
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+ private:
+  const char* name_;
+  int64_t start_ns_;
+};
+
+}  // namespace tracing
+}  // namespace basalt
+
+#ifdef BASALT_ENABLE_TRACING
+
+#define BASALT_TRACE_CONCAT_IMPL(a, b) a##b
+#define BASALT_TRACE_CONCAT(a, b) BASALT_TRACE_CONCAT_IMPL(a, b)
+
+#define BASALT_TRACE_SCOPE(name)      \
+  ::basalt::tracing::ScopedTrace      \
+  BASALT_TRACE_CONCAT(basalt_trace_scope_, __LINE__)(name)
+#define BASALT_TRACE_THREAD_NAME(name) \
+  ::basalt::tracing::set_thread_name(name)
+#define BASALT_TRACE_SAVE(path) ::basalt::tracing::save_chrome_trace(path)
+
+#else
+
+#define BASALT_TRACE_SCOPE(name) ((void)0)
+#define BASALT_TRACE_THREAD_NAME(name) ((void)0)
+#define BASALT_TRACE_SAVE(path) ((void)0)
+
+#endif
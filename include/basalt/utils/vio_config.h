@@ -40,6 +40,21 @@ namespace basalt {
 
 enum class LinearizationType { ABS_QR, ABS_SC, REL_SC };
 
+// Construction of the optical flow image pyramids. REFERENCE is
+// ManagedImagePyr::setFromImage, GAUSSIAN5 gives identical results with
+// vectorized integer code, BOX2X2 averages 2x2 blocks.
+enum class PyramidType { REFERENCE, GAUSSIAN5, BOX2X2 };
+
+// Keypoint detection in the empty grid cells. OPENCV_FAST runs cv::FAST on
+// an 8-bit copy of every cell with decreasing thresholds, GRID_FAST scores
+// the 16-bit image in a single vectorized sweep.
+enum class KeypointDetectorType { OPENCV_FAST, GRID_FAST };
+
+// Descriptor matching of the mapper. BRUTE_FORCE compares all pairs,
+// MULTI_INDEX_HASHING only pairs that share a similar descriptor substring
+// and may miss some matches.
+enum class DescriptorMatcherType { BRUTE_FORCE, MULTI_INDEX_HASHING };
+
 struct VioConfig {
   VioConfig();
   void load(const std::string& filename);
@@ -50,9 +65,20 @@ struct VioConfig {
   float optical_flow_max_recovered_dist2;
   int optical_flow_pattern;
   int optical_flow_max_iterations;
+  // Tracking on a pyramid level stops once the norm of the SE2 increment
+  // falls below this threshold
+  float optical_flow_convergence_threshold;
   int optical_flow_levels;
   float optical_flow_epipolar_error;
   int optical_flow_skip_frames;
+  PyramidType optical_flow_pyramid_type;
+  KeypointDetectorType optical_flow_detector_type;
+  // Initial guesses of the frame-to-frame frontends from the gyro rotation
+  // between frames. Requires IMU data in OpticalFlowBase::imu_data_queue.
+  bool optical_flow_use_gyro;
+  // Run the frontend on 8 bit images. Images of 8 bit sensors are then read
+  // without conversion to 16 bit, 16 bit images are reduced to 8 bit.
+  bool optical_flow_native_8bit;
 
   LinearizationType vio_linearization_type;
   bool vio_sqrt_marg;
@@ -67,6 +93,10 @@ struct VioConfig {
   //  double vio_outlier_threshold;
   //  int vio_filter_iteration;
   int vio_max_iterations;
+  // Solve the reduced camera system with a block-sparse Cholesky
+  // factorization from this many variables on, dense below. Only used with
+  // the ABS_QR linearization. Negative values always solve dense.
+  int vio_block_sparse_min_size;
 
   double vio_obs_std_dev;
   double vio_obs_huber_thresh;
@@ -98,6 +128,8 @@ struct VioConfig {
   double mapper_min_track_length;
   double mapper_max_hamming_distance;
   double mapper_second_best_test_ratio;
+  DescriptorMatcherType mapper_match_stereo_type;
+  DescriptorMatcherType mapper_match_all_type;
   int mapper_bow_num_bits;
   double mapper_min_triangulation_dist;
   bool mapper_no_factor_weights;
@@ -39,6 +39,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <basalt/imu/preintegration.h>
 #include <basalt/utils/time_utils.hpp>
 
+#include <basalt/linearization/linearization_base.hpp>
 #include <basalt/vi_estimator/sqrt_ba_base.h>
 #include <basalt/vi_estimator/vio_estimator.h>
 
@@ -127,6 +128,13 @@ class SqrtKeypointVioEstimator : public VioEstimatorBase,
                    const std::unordered_set<KeypointId>& lost_landmaks);
   void optimize();
 
+  // Updates aom to all poses followed by the states up to last_state_t_ns,
+  // in ascending order. Frames that stay in the window keep their map nodes,
+  // only their offsets are updated.
+  void updateAbsOrderMap(AbsOrderMap& aom,
+                         int64_t last_state_t_ns =
+                             std::numeric_limits<int64_t>::max()) const;
+
   void debug_finalize() override;
 
   void logMargNullspace();
@@ -236,6 +244,11 @@ class SqrtKeypointVioEstimator : public VioEstimatorBase,
   // Used only for debug and log purporses.
   MargLinData<Scalar> nullspace_marg_data;
 
+  // Orders and linearizations of optimization and marginalization, updated
+  // from frame to frame
+  AbsOrderMap opt_aom, marg_aom;
+  std::unique_ptr<LinearizationBase<Scalar, POSE_SIZE>> opt_lqr, marg_lqr;
+
   Vec3 gyro_bias_sqrt_weight, accel_bias_sqrt_weight;
 
   size_t max_states;
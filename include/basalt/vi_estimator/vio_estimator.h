@@ -85,6 +85,9 @@ class VioEstimatorBase {
   tbb::concurrent_bounded_queue<VioVisualizationData::Ptr>* out_vis_queue =
       nullptr;
 
+  // Optional, records when the processing of a frame has finished
+  FrameLatencyRecorder* latency_recorder = nullptr;
+
   virtual void initialize(int64_t t_ns, const Sophus::SE3d& T_w_i,
                           const Eigen::Vector3d& vel_w_i,
                           const Eigen::Vector3d& bg,
@@ -45,6 +45,8 @@ int main(int argc, char **argv) {
   std::vector<std::string> cam_types;
   std::string cache_dataset_name = "calib-cam";
   int skip_images = 1;
+  size_t num_load_threads = 2;
+  size_t load_lookahead = 32;
 
   CLI::App app{"Calibrate IMU"};
 
@@ -62,6 +64,12 @@ int main(int argc, char **argv) {
                  "Name to save cached files");
 
   app.add_option("--skip-images", skip_images, "Number of images to skip");
+  app.add_option("--num-load-threads", num_load_threads,
+                 "Number of threads that load the images ahead of the corner "
+                 "detection (0 loads them in order before the detection).");
+  app.add_option("--load-lookahead", load_lookahead,
+                 "Number of frames that are loaded ahead of the corner "
+                 "detection.");
   app.add_option("--cam-types", cam_types,
                  "Type of cameras (eucm, ds, kb4, pinhole)")
       ->required();
@@ -74,6 +82,7 @@ int main(int argc, char **argv) {
 
   basalt::CamCalib cv(dataset_path, dataset_type, aprilgrid_path, result_path,
                       cache_dataset_name, skip_images, cam_types);
+  cv.setImageLoading(num_load_threads, load_lookahead);
 
   cv.renderingLoop();
 
@@ -46,6 +46,8 @@ int main(int argc, char **argv) {
   std::string result_path;
   std::string cache_dataset_name = "calib-cam-imu";
   int skip_images = 1;
+  size_t num_load_threads = 2;
+  size_t load_lookahead = 32;
 
   double accel_noise_std = 0.016;
   double gyro_noise_std = 0.000282;
@@ -77,6 +79,12 @@ int main(int argc, char **argv) {
                  "Name to save cached files");
 
   app.add_option("--skip-images", skip_images, "Number of images to skip");
+  app.add_option("--num-load-threads", num_load_threads,
+                 "Number of threads that load the images ahead of the corner "
+                 "detection (0 loads them in order before the detection).");
+  app.add_option("--load-lookahead", load_lookahead,
+                 "Number of frames that are loaded ahead of the corner "
+                 "detection.");
 
   try {
     app.parse(argc, argv);
@@ -88,6 +96,7 @@ int main(int argc, char **argv) {
       dataset_path, dataset_type, aprilgrid_path, result_path,
       cache_dataset_name, skip_images,
       {accel_noise_std, gyro_noise_std, accel_bias_std, gyro_bias_std});
+  cv.setImageLoading(num_load_threads, load_lookahead);
 
   cv.renderingLoop();
 
@@ -111,40 +111,58 @@ void CalibHelper::detectCorners(const VioDatasetPtr &vio_data,
   calib_corners.clear();
   calib_corners_rejected.clear();
 
-  tbb::parallel_for(
-      tbb::blocked_range<size_t>(0, vio_data->get_image_timestamps().size()),
-      [&](const tbb::blocked_range<size_t> &r) {
-        ApriltagDetector ad;
-
-        for (size_t j = r.begin(); j != r.end(); ++j) {
-          int64_t timestamp_ns = vio_data->get_image_timestamps()[j];
-          const std::vector<ImageData> &img_vec =
-              vio_data->get_image_data(timestamp_ns);
-
-          for (size_t i = 0; i < img_vec.size(); i++) {
-            if (img_vec[i].img.get()) {
-              CalibCornerData ccd_good;
-              CalibCornerData ccd_bad;
-              ad.detectTags(*img_vec[i].img, ccd_good.corners,
-                            ccd_good.corner_ids, ccd_good.radii,
-                            ccd_bad.corners, ccd_bad.corner_ids, ccd_bad.radii);
-
-              //                std::cout << "image (" << timestamp_ns << ","
-              //                << i
-              //                          << ")  detected " <<
-              //                          ccd_good.corners.size()
-              //                          << "corners (" <<
-              //                          ccd_bad.corners.size()
-              //                          << " rejected)" << std::endl;
-
-              TimeCamId tcid(timestamp_ns, i);
-
-              calib_corners.emplace(tcid, ccd_good);
-              calib_corners_rejected.emplace(tcid, ccd_bad);
+  const std::vector<int64_t> &timestamps = vio_data->get_image_timestamps();
+
+  // The images are read in timestamp order, so that a PrefetchingVioDataset
+  // loads the next batch while the corners of the current one are detected.
+  constexpr size_t BATCH_SIZE = 16;
+  std::vector<std::vector<ImageData>> batch;
+
+  for (size_t batch_begin = 0; batch_begin < timestamps.size();
+       batch_begin += BATCH_SIZE) {
+    const size_t batch_end =
+        std::min(batch_begin + BATCH_SIZE, timestamps.size());
+
+    batch.clear();
+    for (size_t j = batch_begin; j < batch_end; j++) {
+      batch.emplace_back(vio_data->get_image_data(timestamps[j]));
+    }
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(batch_begin, batch_end),
+        [&](const tbb::blocked_range<size_t> &r) {
+          ApriltagDetector ad;
+
+          for (size_t j = r.begin(); j != r.end(); ++j) {
+            int64_t timestamp_ns = timestamps[j];
+            const std::vector<ImageData> &img_vec = batch[j - batch_begin];
+
+            for (size_t i = 0; i < img_vec.size(); i++) {
+              if (img_vec[i].img.get()) {
+                CalibCornerData ccd_good;
+                CalibCornerData ccd_bad;
+                ad.detectTags(*img_vec[i].img, ccd_good.corners,
+                              ccd_good.corner_ids, ccd_good.radii,
+                              ccd_bad.corners, ccd_bad.corner_ids,
+                              ccd_bad.radii);
+
+                //                std::cout << "image (" << timestamp_ns << ","
+                //                << i
+                //                          << ")  detected " <<
+                //                          ccd_good.corners.size()
+                //                          << "corners (" <<
+                //                          ccd_bad.corners.size()
+                //                          << " rejected)" << std::endl;
+
+                TimeCamId tcid(timestamp_ns, i);
+
+                calib_corners.emplace(tcid, ccd_good);
+                calib_corners_rejected.emplace(tcid, ccd_bad);
+              }
             }
           }
-        }
-      });
+        });
+  }
 }
 
 void CalibHelper::initCamPoses(
@@ -35,6 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <basalt/calibration/cam_calib.h>
 
+#include <basalt/io/prefetching_dataset.h>
 #include <basalt/utils/system_utils.h>
 
 #include <basalt/calibration/vignette.h>
@@ -802,6 +803,12 @@ void CamCalib::loadDataset() {
     vio_dataset->get_image_timestamps() = new_image_timestamps;
   }
 
+  // after skipping, the timestamps must not change while images are loaded
+  if (num_load_threads > 0) {
+    vio_dataset.reset(new PrefetchingVioDataset(vio_dataset, num_load_threads,
+                                                load_lookahead));
+  }
+
   // load detected corners if they exist
   {
     std::string path =
@@ -0,0 +1,103 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <chrono>
+#include <iostream>
+
+#include <basalt/io/dataset_io.h>
+#include <basalt/io/dataset_io_binary.h>
+#include <basalt/io/prefetching_dataset.h>
+
+#include <CLI/CLI.hpp>
+
+int main(int argc, char **argv) {
+  std::string dataset_path;
+  std::string dataset_type;
+  std::string output_path;
+  bool compress = false;
+  bool keep_8bit = true;
+  size_t num_load_threads = 4;
+
+  CLI::App app{"Convert a dataset to the basalt binary dataset format"};
+
+  app.add_option("--dataset-path", dataset_path, "Path to dataset.")
+      ->required();
+  app.add_option("--dataset-type", dataset_type,
+                 "Dataset type <euroc, bag, uzh, kitti, basalt>.")
+      ->required();
+  app.add_option("--output", output_path, "Path to the output file.")
+      ->required();
+  app.add_option("--compress", compress, "Store LZ4 compressed images.");
+  app.add_option("--keep-8bit", keep_8bit,
+                 "Store images of 8 bit sensors as 8 bit instead of 16 bit.");
+  app.add_option("--num-load-threads", num_load_threads,
+                 "Number of threads that load the input images.");
+
+  try {
+    app.parse(argc, argv);
+  } catch (const CLI::ParseError &e) {
+    return app.exit(e);
+  }
+
+  basalt::DatasetIoInterfacePtr dataset_io =
+      basalt::DatasetIoFactory::getDatasetIo(dataset_type);
+
+  dataset_io->read(dataset_path);
+
+  basalt::VioDatasetPtr vio_dataset = dataset_io->get_data();
+  vio_dataset->native_8bit_images = keep_8bit;
+
+  if (num_load_threads > 0) {
+    vio_dataset.reset(new basalt::PrefetchingVioDataset(
+        vio_dataset, num_load_threads, 2 * num_load_threads));
+  }
+
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  basalt::saveBinaryDataset(*vio_dataset, output_path, compress);
+
+  const auto end = std::chrono::high_resolution_clock::now();
+  const double duration =
+      std::chrono::duration_cast<std::chrono::duration<double>>(end - start)
+          .count();
+
+  std::cout << "Wrote " << vio_dataset->get_image_timestamps().size()
+            << " frames, " << vio_dataset->get_gyro_data().size()
+            << " IMU samples and " << vio_dataset->get_gt_timestamps().size()
+            << " ground truth poses to " << output_path << " in " << duration
+            << "s" << std::endl;
+
+  return 0;
+}
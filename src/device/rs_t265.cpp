@@ -139,6 +139,7 @@ void RsT265Device::start() {
             data->accel = accel_interpolated;
             data->gyro = gyro_data.data;
 
+            if (flow_imu_data_queue) flow_imu_data_queue->push(data);
             if (imu_data_queue) imu_data_queue->push(data);
           }
 
@@ -191,18 +192,9 @@ void RsT265Device::start() {
         data->img_data[i].exposure =
             vf.get_frame_metadata(RS2_FRAME_METADATA_ACTUAL_EXPOSURE) * 1e-6;
 
-        data->img_data[i].img.reset(new basalt::ManagedImage<uint16_t>(
-            vf.get_width(), vf.get_height()));
-
-        const uint8_t* data_in = (const uint8_t*)vf.get_data();
-        uint16_t* data_out = data->img_data[i].img->ptr;
-
-        size_t full_size = vf.get_width() * vf.get_height();
-        for (size_t j = 0; j < full_size; j++) {
-          int val = data_in[j];
-          val = val << 8;
-          data_out[j] = val;
-        }
+        data->img_data[i].setFrom8Bit((const uint8_t*)vf.get_data(),
+                                      vf.get_width(), vf.get_height(), 1,
+                                      native_8bit_images);
 
         //        std::cout << "Timestamp / exposure " << i << ": " <<
         //        data->t_ns << " / "
@@ -236,6 +228,7 @@ void RsT265Device::start() {
 void RsT265Device::stop() {
   if (image_data_queue) image_data_queue->push(nullptr);
   if (imu_data_queue) imu_data_queue->push(nullptr);
+  if (flow_imu_data_queue) flow_imu_data_queue->push(nullptr);
 }
 
 bool RsT265Device::setExposure(double exposure) {
@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <basalt/io/dataset_io.h>
+#include <basalt/io/dataset_io_binary.h>
 #include <basalt/io/dataset_io_euroc.h>
 #include <basalt/io/dataset_io_kitti.h>
 #include <basalt/io/dataset_io_rosbag.h>
@@ -52,6 +53,8 @@ DatasetIoInterfacePtr DatasetIoFactory::getDatasetIo(
     return DatasetIoInterfacePtr(new UzhIO);
   } else if (dataset_type == "kitti") {
     return DatasetIoInterfacePtr(new KittiIO);
+  } else if (dataset_type == "basalt") {
+    return DatasetIoInterfacePtr(new BinaryIO);
   } else {
     std::cerr << "Dataset type " << dataset_type << " is not supported"
               << std::endl;
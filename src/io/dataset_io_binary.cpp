@@ -0,0 +1,466 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <basalt/io/dataset_io_binary.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <lz4.h>
+
+namespace basalt {
+
+namespace {
+
+constexpr char MAGIC[8] = {'B', 'A', 'S', 'A', 'L', 'T', 'D', 'S'};
+constexpr uint32_t VERSION = 2;
+
+// Written in the byte order of the writing machine, reads back differently
+// on a machine with the other byte order
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Images and sections start at multiples of this
+constexpr size_t ALIGNMENT = 64;
+
+enum class Compression : uint8_t { NONE = 0, LZ4 = 1 };
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t num_cams;
+  uint32_t padding;
+  uint64_t num_frames;
+  uint64_t num_accel;
+  uint64_t num_gyro;
+  uint64_t num_gt;
+  int64_t mocap_to_imu_offset_ns;
+
+  // File offsets of the sections
+  uint64_t timestamps_offset;
+  uint64_t image_index_offset;
+  uint64_t accel_offset;
+  uint64_t gyro_offset;
+  uint64_t gt_offset;
+};
+
+struct ImageRecord {
+  uint64_t offset;  // 0 if the camera has no image in this frame
+  uint64_t size;    // stored bytes
+  uint32_t w;
+  uint32_t h;
+  uint8_t bytes_per_pixel;
+  Compression compression;
+  uint8_t padding[6];
+  double exposure;
+};
+
+struct ImuRecord {
+  int64_t t_ns;
+  double data[3];
+};
+
+struct GtRecord {
+  int64_t t_ns;
+  double q[4];  // x, y, z, w
+  double t[3];
+};
+
+static_assert(sizeof(FileHeader) == 104);
+static_assert(sizeof(ImageRecord) == 40);
+static_assert(sizeof(ImuRecord) == 32);
+static_assert(sizeof(GtRecord) == 64);
+
+template <typename Record>
+Record readRecord(const char *data, size_t idx) {
+  Record r;
+  std::memcpy(&r, data + idx * sizeof(Record), sizeof(Record));
+  return r;
+}
+
+template <typename Record>
+void writeRecords(std::ofstream &os, const std::vector<Record> &records) {
+  os.write(reinterpret_cast<const char *>(records.data()),
+           records.size() * sizeof(Record));
+}
+
+void writePadding(std::ofstream &os) {
+  static const char zeros[ALIGNMENT] = {};
+  const size_t pos = os.tellp();
+  os.write(zeros, (ALIGNMENT - pos % ALIGNMENT) % ALIGNMENT);
+}
+
+// Whether count records of record_size bytes starting at offset are inside
+// a file of file_size bytes, without overflowing for corrupted headers
+bool fitsInFile(uint64_t offset, uint64_t count, uint64_t record_size,
+                size_t file_size) {
+  if (offset > file_size) return false;
+  return record_size == 0 || count <= (file_size - offset) / record_size;
+}
+
+// Image from a record. Uncompressed images point into the mapped file and
+// keep it mapped.
+template <typename T>
+typename ManagedImage<T>::Ptr loadImage(const std::shared_ptr<char> &file_data,
+                                        size_t file_size,
+                                        const ImageRecord &r) {
+  if (!fitsInFile(r.offset, r.size, 1, file_size)) {
+    std::cerr << "Truncated image data at offset " << r.offset << std::endl;
+    std::abort();
+  }
+
+  const char *data = file_data.get() + r.offset;
+  const size_t size = size_t(r.w) * r.h * sizeof(T);
+
+  if (r.bytes_per_pixel != sizeof(T) ||
+      (r.compression != Compression::LZ4 && r.size != size)) {
+    std::cerr << "Corrupted image data at offset " << r.offset << std::endl;
+    std::abort();
+  }
+
+  if (r.compression == Compression::LZ4) {
+    typename ManagedImage<T>::Ptr img(new ManagedImage<T>(r.w, r.h));
+
+    const int res = LZ4_decompress_safe(
+        data, reinterpret_cast<char *>(img->ptr), r.size, size);
+    if (res < 0 || size_t(res) != size) {
+      std::cerr << "Corrupted LZ4 image data at offset " << r.offset
+                << std::endl;
+      std::abort();
+    }
+
+    return img;
+  }
+
+  ManagedImage<T> *img = new ManagedImage<T>;
+  img->ptr = reinterpret_cast<T *>(file_data.get() + r.offset);
+  img->w = r.w;
+  img->h = r.h;
+  img->pitch = r.w * sizeof(T);
+
+  // the image does not own the memory, the captured file_data does
+  return typename ManagedImage<T>::Ptr(img, [file_data](ManagedImage<T> *img) {
+    img->ptr = nullptr;
+    delete img;
+  });
+}
+
+}  // namespace
+
+std::vector<ImageData> BinaryVioDataset::get_image_data(int64_t t_ns) {
+  std::vector<ImageData> res(num_cams);
+
+  const int64_t *end = frame_timestamps + num_frames;
+  const int64_t *it = std::lower_bound(frame_timestamps, end, t_ns);
+  if (it == end || *it != t_ns) return res;
+
+  const size_t frame_idx = it - frame_timestamps;
+
+  for (size_t i = 0; i < num_cams; i++) {
+    const ImageRecord r =
+        readRecord<ImageRecord>(image_index, frame_idx * num_cams + i);
+
+    res[i].exposure = r.exposure;
+    if (r.offset == 0) continue;
+
+    if (r.bytes_per_pixel == 1) {
+      ManagedImage<uint8_t>::Ptr img =
+          loadImage<uint8_t>(file_data, file_size, r);
+      if (native_8bit_images) {
+        res[i].img_u8 = img;
+      } else {
+        res[i].img = convertImageDepth<uint16_t>(*img);
+      }
+    } else {
+      res[i].img = loadImage<uint16_t>(file_data, file_size, r);
+    }
+  }
+
+  return res;
+}
+
+void BinaryIO::read(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could not open binary dataset " << path << std::endl;
+    std::abort();
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    std::cerr << "Could not open binary dataset " << path << std::endl;
+    std::abort();
+  }
+  const size_t file_size = st.st_size;
+
+  void *ptr = file_size >= sizeof(FileHeader)
+                  ? mmap(nullptr, file_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0)
+                  : MAP_FAILED;
+  close(fd);
+
+  if (ptr == MAP_FAILED) {
+    std::cerr << "Could not map binary dataset " << path << std::endl;
+    std::abort();
+  }
+
+  data.reset(new BinaryVioDataset);
+  data->file_data = std::shared_ptr<char>(
+      static_cast<char *>(ptr),
+      [file_size](char *p) { munmap(p, file_size); });
+
+  const char *file = data->file_data.get();
+  const FileHeader header = readRecord<FileHeader>(file, 0);
+
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    std::cerr << path << " is not a binary dataset" << std::endl;
+    std::abort();
+  }
+
+  if (header.byte_order != BYTE_ORDER_MARK) {
+    std::cerr << "Binary dataset " << path
+              << " was written with a different byte order" << std::endl;
+    std::abort();
+  }
+
+  if (header.version != VERSION) {
+    std::cerr << path << " is not a binary dataset of version " << VERSION
+              << std::endl;
+    std::abort();
+  }
+
+  if (!fitsInFile(header.timestamps_offset, header.num_frames,
+                  sizeof(int64_t), file_size) ||
+      !fitsInFile(header.image_index_offset, header.num_frames,
+                  uint64_t(header.num_cams) * sizeof(ImageRecord),
+                  file_size) ||
+      !fitsInFile(header.accel_offset, header.num_accel, sizeof(ImuRecord),
+                  file_size) ||
+      !fitsInFile(header.gyro_offset, header.num_gyro, sizeof(ImuRecord),
+                  file_size) ||
+      !fitsInFile(header.gt_offset, header.num_gt, sizeof(GtRecord),
+                  file_size)) {
+    std::cerr << "Binary dataset " << path << " is truncated" << std::endl;
+    std::abort();
+  }
+
+  data->file_size = file_size;
+  data->num_cams = header.num_cams;
+  data->num_frames = header.num_frames;
+  data->mocap_to_imu_offset_ns = header.mocap_to_imu_offset_ns;
+  data->frame_timestamps =
+      reinterpret_cast<const int64_t *>(file + header.timestamps_offset);
+  data->image_index = file + header.image_index_offset;
+
+  data->image_timestamps.assign(data->frame_timestamps,
+                                data->frame_timestamps + header.num_frames);
+
+  for (size_t i = 0; i < header.num_accel; i++) {
+    const ImuRecord r = readRecord<ImuRecord>(file + header.accel_offset, i);
+    AccelData d;
+    d.timestamp_ns = r.t_ns;
+    d.data = Eigen::Vector3d(r.data);
+    data->accel_data.push_back(d);
+  }
+
+  for (size_t i = 0; i < header.num_gyro; i++) {
+    const ImuRecord r = readRecord<ImuRecord>(file + header.gyro_offset, i);
+    GyroData d;
+    d.timestamp_ns = r.t_ns;
+    d.data = Eigen::Vector3d(r.data);
+    data->gyro_data.push_back(d);
+  }
+
+  for (size_t i = 0; i < header.num_gt; i++) {
+    const GtRecord r = readRecord<GtRecord>(file + header.gt_offset, i);
+    data->gt_timestamps.push_back(r.t_ns);
+    data->gt_pose_data.emplace_back(Eigen::Quaterniond(r.q),
+                                    Eigen::Vector3d(r.t));
+  }
+}
+
+void saveBinaryDataset(VioDataset &dataset, const std::string &path,
+                       bool compress) {
+  std::ofstream os(path, std::ios::binary);
+  if (!os.is_open()) {
+    std::cerr << "Could not open " << path << " for writing" << std::endl;
+    std::abort();
+  }
+
+  const std::vector<int64_t> &timestamps = dataset.get_image_timestamps();
+  const size_t num_cams = dataset.get_num_cams();
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.num_cams = num_cams;
+  header.num_frames = timestamps.size();
+  header.num_accel = dataset.get_accel_data().size();
+  header.num_gyro = dataset.get_gyro_data().size();
+  header.num_gt = dataset.get_gt_timestamps().size();
+  header.mocap_to_imu_offset_ns = dataset.get_mocap_to_imu_offset_ns();
+
+  // placeholder, written again when the offsets are known
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  std::vector<ImageRecord> image_index(timestamps.size() * num_cams);
+  std::vector<char> contiguous, compressed;
+
+  for (size_t frame_idx = 0; frame_idx < timestamps.size(); frame_idx++) {
+    const std::vector<ImageData> img_data =
+        dataset.get_image_data(timestamps[frame_idx]);
+
+    for (size_t i = 0; i < num_cams && i < img_data.size(); i++) {
+      ImageRecord &r = image_index[frame_idx * num_cams + i];
+      std::memset(&r, 0, sizeof(r));
+      r.exposure = img_data[i].exposure;
+
+      if (img_data[i].empty()) continue;
+
+      const uint8_t *ptr;
+      size_t pitch;
+      if (img_data[i].img_u8) {
+        const ManagedImage<uint8_t> &img = *img_data[i].img_u8;
+        ptr = img.ptr;
+        pitch = img.pitch;
+        r.w = img.w;
+        r.h = img.h;
+        r.bytes_per_pixel = 1;
+      } else {
+        const ManagedImage<uint16_t> &img = *img_data[i].img;
+        ptr = reinterpret_cast<const uint8_t *>(img.ptr);
+        pitch = img.pitch;
+        r.w = img.w;
+        r.h = img.h;
+        r.bytes_per_pixel = 2;
+      }
+
+      const size_t row_size = size_t(r.w) * r.bytes_per_pixel;
+      contiguous.resize(row_size * r.h);
+      for (size_t y = 0; y < r.h; y++) {
+        std::memcpy(contiguous.data() + y * row_size, ptr + y * pitch,
+                    row_size);
+      }
+
+      writePadding(os);
+      r.offset = os.tellp();
+
+      // keep images that do not get smaller uncompressed
+      int compressed_size = 0;
+      if (compress) {
+        compressed.resize(LZ4_compressBound(contiguous.size()));
+        compressed_size =
+            LZ4_compress_default(contiguous.data(), compressed.data(),
+                                 contiguous.size(), compressed.size());
+      }
+
+      if (compressed_size > 0 && size_t(compressed_size) < contiguous.size()) {
+        r.compression = Compression::LZ4;
+        r.size = compressed_size;
+        os.write(compressed.data(), compressed_size);
+      } else {
+        r.compression = Compression::NONE;
+        r.size = contiguous.size();
+        os.write(contiguous.data(), contiguous.size());
+      }
+    }
+  }
+
+  writePadding(os);
+  header.timestamps_offset = os.tellp();
+  writeRecords(os, timestamps);
+
+  writePadding(os);
+  header.image_index_offset = os.tellp();
+  writeRecords(os, image_index);
+
+  std::vector<ImuRecord> imu_records;
+  for (const AccelData &d : dataset.get_accel_data()) {
+    ImuRecord r;
+    r.t_ns = d.timestamp_ns;
+    Eigen::Map<Eigen::Vector3d>(r.data) = d.data;
+    imu_records.push_back(r);
+  }
+
+  writePadding(os);
+  header.accel_offset = os.tellp();
+  writeRecords(os, imu_records);
+
+  imu_records.clear();
+  for (const GyroData &d : dataset.get_gyro_data()) {
+    ImuRecord r;
+    r.t_ns = d.timestamp_ns;
+    Eigen::Map<Eigen::Vector3d>(r.data) = d.data;
+    imu_records.push_back(r);
+  }
+
+  writePadding(os);
+  header.gyro_offset = os.tellp();
+  writeRecords(os, imu_records);
+
+  std::vector<GtRecord> gt_records;
+  for (size_t i = 0; i < dataset.get_gt_timestamps().size(); i++) {
+    const Sophus::SE3d &T = dataset.get_gt_pose_data()[i];
+
+    GtRecord r;
+    r.t_ns = dataset.get_gt_timestamps()[i];
+    Eigen::Map<Eigen::Vector4d>(r.q) = T.unit_quaternion().coeffs();
+    Eigen::Map<Eigen::Vector3d>(r.t) = T.translation();
+    gt_records.push_back(r);
+  }
+
+  writePadding(os);
+  header.gt_offset = os.tellp();
+  writeRecords(os, gt_records);
+
+  os.seekp(0);
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  if (!os.good()) {
+    std::cerr << "Failed to write " << path << std::endl;
+    std::abort();
+  }
+}
+
+}  // namespace basalt
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <basalt/serialization/headers_serialization.h>
 #include <basalt/utils/filesystem.h>
+#include <basalt/utils/tracing.h>
 
 namespace basalt {
 
@@ -52,12 +53,17 @@ MargDataSaver::MargDataSaver(const std::string& path) {
   in_marg_queue.set_capacity(1000);
 
   auto save_func = [&, path]() {
+    BASALT_TRACE_THREAD_NAME("marg_data_saver");
+
     basalt::MargData::Ptr data;
 
     std::unordered_set<int64_t> processed_opt_flow;
 
     while (true) {
-      in_marg_queue.pop(data);
+      {
+        BASALT_TRACE_SCOPE("in_marg_queue.pop");
+        in_marg_queue.pop(data);
+      }
 
       if (data.get()) {
         int64_t kf_id = *data->kfs_to_marg.begin();
@@ -114,7 +120,8 @@ MargDataSaver::MargDataSaver(const std::string& path) {
   saving_img_thread.reset(new std::thread(save_image_func));
 }  // namespace basalt
 
-MargDataLoader::MargDataLoader() : out_marg_queue(nullptr) {}
+MargDataLoader::MargDataLoader(size_t num_load_threads)
+    : out_marg_queue(nullptr), num_load_threads(num_load_threads) {}
 
 void MargDataLoader::start(const std::string& path) {
   if (!fs::exists(path))
@@ -127,15 +134,35 @@ void MargDataLoader::start(const std::string& path) {
 
     std::map<int64_t, OpticalFlowResult::Ptr> opt_flow_res;
 
+    std::vector<fs::path> img_files;
     for (const auto& entry : fs::directory_iterator(img_path)) {
-      OpticalFlowResult::Ptr data;
-      // std::cout << entry.path() << std::endl;
-      std::ifstream is(entry.path(), std::ios::binary);
-      {
-        cereal::BinaryInputArchive archive(is);
-        archive(data);
+      img_files.emplace_back(entry.path());
+    }
+
+    // every thread loads every num_threads-th file
+    std::vector<OpticalFlowResult::Ptr> img_data(img_files.size());
+    auto load_images = [&](size_t begin, size_t num_threads) {
+      for (size_t i = begin; i < img_files.size(); i += num_threads) {
+        std::ifstream is(img_files[i], std::ios::binary);
+        {
+          cereal::BinaryInputArchive archive(is);
+          archive(img_data[i]);
+        }
+        is.close();
       }
-      is.close();
+    };
+
+    if (num_load_threads > 0) {
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < num_load_threads; i++) {
+        threads.emplace_back(load_images, i, num_load_threads);
+      }
+      for (auto& t : threads) t.join();
+    } else {
+      load_images(0, 1);
+    }
+
+    for (const auto& data : img_data) {
       opt_flow_res[data->t_ns] = data;
     }
 
@@ -207,16 +234,47 @@ void serialize(Archive& ar, basalt::OpticalFlowResult& m) {
   ar(m.input_images);
 }
 
+// Stored as a map to keep the format of existing marginalization data
+template <class Archive>
+void save(Archive& ar, const basalt::KeypointTracks& m) {
+  Eigen::aligned_map<basalt::KeypointId, Eigen::AffineCompact2f> map;
+  for (size_t i = 0; i < m.size(); i++) {
+    map.emplace_hint(map.end(), m.id(i), m.transform(i));
+  }
+  ar(map);
+}
+
+template <class Archive>
+void load(Archive& ar, basalt::KeypointTracks& m) {
+  Eigen::aligned_map<basalt::KeypointId, Eigen::AffineCompact2f> map;
+  ar(map);
+
+  m.clear();
+  m.reserve(map.size());
+  for (const auto& kv : map) {
+    m.push_back(kv.first, kv.second);
+  }
+}
+
 template <class Archive>
 void serialize(Archive& ar, basalt::OpticalFlowInput& m) {
   ar(m.t_ns);
   ar(m.img_data);
 }
 
+// 8 bit images are stored as 16 bit, so the format does not depend on the
+// pixel type of the frontend
+template <class Archive>
+void save(Archive& ar, const basalt::ImageData& m) {
+  ar(m.exposure);
+  ar(m.getImage<uint16_t>());
+}
+
 template <class Archive>
-void serialize(Archive& ar, basalt::ImageData& m) {
+void load(Archive& ar, basalt::ImageData& m) {
   ar(m.exposure);
   ar(m.img);
+  m.img_u8.reset();
 }
 
 template <class Archive>
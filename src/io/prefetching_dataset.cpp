@@ -0,0 +1,159 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <basalt/io/prefetching_dataset.h>
+
+#include <algorithm>
+
+namespace basalt {
+
+PrefetchingVioDataset::PrefetchingVioDataset(const VioDatasetPtr &dataset,
+                                             size_t num_threads,
+                                             size_t lookahead)
+    : dataset(dataset), lookahead(lookahead) {
+  native_8bit_images = dataset->native_8bit_images;
+
+  for (size_t i = 0; i < num_threads; i++) {
+    threads.emplace_back(&PrefetchingVioDataset::decodeLoop, this);
+  }
+}
+
+PrefetchingVioDataset::~PrefetchingVioDataset() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv_queue.notify_all();
+
+  for (auto &t : threads) t.join();
+}
+
+std::vector<ImageData> PrefetchingVioDataset::get_image_data(int64_t t_ns) {
+  if (threads.empty()) return dataset->get_image_data(t_ns);
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  const std::vector<int64_t> &timestamps = dataset->get_image_timestamps();
+  const auto begin =
+      std::lower_bound(timestamps.begin(), timestamps.end(), t_ns);
+
+  if (begin == timestamps.end() || *begin != t_ns) {
+    lock.unlock();
+    return dataset->get_image_data(t_ns);
+  }
+
+  // Frames before the window, e.g. from a reader lagging behind the
+  // sequential one, are loaded directly so the prefetched frames are kept.
+  if (!window.empty() && t_ns < window.begin()->first) {
+    num_misses++;
+    lock.unlock();
+    return dataset->get_image_data(t_ns);
+  }
+
+  const auto end =
+      begin + std::min<size_t>(lookahead + 1, timestamps.end() - begin);
+
+  // Move the window to [t_ns, t_ns + lookahead]. Dropped frames are only
+  // loaded if some other call is still waiting for them.
+  window.erase(window.begin(), window.lower_bound(t_ns));
+  window.erase(window.upper_bound(*(end - 1)), window.end());
+  queue.erase(std::remove_if(queue.begin(), queue.end(),
+                             [](const Frame::Ptr &f) {
+                               return f.use_count() == 1;
+                             }),
+              queue.end());
+
+  if (window.count(t_ns)) {
+    num_hits++;
+  } else {
+    num_misses++;
+  }
+
+  for (auto it = begin; it != end; ++it) {
+    Frame::Ptr &f = window[*it];
+    if (f) continue;
+
+    f = std::make_shared<Frame>();
+    f->t_ns = *it;
+
+    // the requested frame goes first
+    if (it == begin) {
+      queue.push_front(f);
+    } else {
+      queue.push_back(f);
+    }
+  }
+  cv_queue.notify_all();
+
+  const Frame::Ptr frame = window.at(t_ns);
+  cv_done.wait(lock, [&] { return frame->done; });
+
+  return frame->img_data;
+}
+
+size_t PrefetchingVioDataset::numPrefetchHits() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return num_hits;
+}
+
+size_t PrefetchingVioDataset::numPrefetchMisses() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return num_misses;
+}
+
+void PrefetchingVioDataset::decodeLoop() {
+  while (true) {
+    Frame::Ptr frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv_queue.wait(lock, [&] { return stop || !queue.empty(); });
+      if (stop) return;
+
+      frame = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    std::vector<ImageData> img_data = dataset->get_image_data(frame->t_ns);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      frame->img_data = std::move(img_data);
+      frame->done = true;
+    }
+    cv_done.notify_all();
+  }
+}
+
+}  // namespace basalt
@@ -41,8 +41,28 @@ namespace basalt {
 template <typename Scalar>
 template <int POSE_SIZE>
 std::unique_ptr<LandmarkBlock<Scalar>>
-LandmarkBlock<Scalar>::createLandmarkBlock() {
-  return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE>>();
+LandmarkBlock<Scalar>::createLandmarkBlock(size_t num_obs) {
+  static_assert(MIN_FIXED_SIZE_OBS == 2 && MAX_FIXED_SIZE_OBS == 8,
+                "add the fixed-size blocks to the switch below");
+
+  switch (blockType(num_obs)) {
+    case 2:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE, 2>>();
+    case 3:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE, 3>>();
+    case 4:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE, 4>>();
+    case 5:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE, 5>>();
+    case 6:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE, 6>>();
+    case 7:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE, 7>>();
+    case 8:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE, 8>>();
+    default:
+      return std::make_unique<LandmarkBlockAbsDynamic<Scalar, POSE_SIZE>>();
+  }
 }
 
 // //////////////////////////////////////////////////////////////////
@@ -51,13 +71,13 @@ LandmarkBlock<Scalar>::createLandmarkBlock() {
 #ifdef BASALT_INSTANTIATIONS_DOUBLE
 // Scalar=double, POSE_SIZE=6
 template std::unique_ptr<LandmarkBlock<double>>
-LandmarkBlock<double>::createLandmarkBlock<6>();
+LandmarkBlock<double>::createLandmarkBlock<6>(size_t num_obs);
 #endif
 
 #ifdef BASALT_INSTANTIATIONS_FLOAT
 // Scalar=float, POSE_SIZE=6
 template std::unique_ptr<LandmarkBlock<float>>
-LandmarkBlock<float>::createLandmarkBlock<6>();
+LandmarkBlock<float>::createLandmarkBlock<6>(size_t num_obs);
 #endif
 
 }  // namespace basalt
@@ -35,6 +35,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <basalt/linearization/linearization_abs_qr.hpp>
 
+#include <algorithm>
+
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
@@ -42,6 +44,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <basalt/utils/ba_utils.h>
 #include <basalt/linearization/imu_block.hpp>
 #include <basalt/utils/cast_utils.hpp>
+#include <basalt/utils/tracing.h>
 
 namespace basalt {
 
@@ -66,19 +69,76 @@ LinearizationAbsQR<Scalar, POSE_SIZE>::LinearizationAbsQR(
       pose_damping_diagonal_sqrt(0) {
   UNUSED(last_state_to_marg);
 
+  setupProblem(lost_landmarks);
+}
+
+template <typename Scalar, int POSE_SIZE>
+bool LinearizationAbsQR<Scalar, POSE_SIZE>::reinitialize(
+    BundleAdjustmentBase<Scalar>* estimator, const AbsOrderMap& aom,
+    const Options& options, const MargLinData<Scalar>* marg_lin_data,
+    const ImuLinData<Scalar>* imu_lin_data,
+    const std::set<FrameId>* used_frames,
+    const std::unordered_set<KeypointId>* lost_landmarks,
+    int64_t last_state_to_marg) {
+  UNUSED(last_state_to_marg);
+
+  // The landmark database, calibration and order are held by reference
+  if (estimator != this->estimator || &aom != &this->aom ||
+      options.linearization_type != options_.linearization_type) {
+    return false;
+  }
+
+  options_ = options;
+  this->used_frames = used_frames;
+  this->marg_lin_data = marg_lin_data;
+  this->imu_lin_data = imu_lin_data;
+
+  setupProblem(lost_landmarks);
+
+  return true;
+}
+
+template <typename Scalar, int POSE_SIZE>
+void LinearizationAbsQR<Scalar, POSE_SIZE>::setupProblem(
+    const std::unordered_set<KeypointId>* lost_landmarks) {
+  BASALT_TRACE_SCOPE("setupProblem");
+
   BASALT_ASSERT_STREAM(
-      options.lb_options.huber_parameter == estimator->huber_thresh,
+      options_.lb_options.huber_parameter == estimator->huber_thresh,
       "Huber threshold should be set to the same value");
 
-  BASALT_ASSERT_STREAM(options.lb_options.obs_std_dev == estimator->obs_std_dev,
-                       "obs_std_dev should be set to the same value");
+  BASALT_ASSERT_STREAM(
+      options_.lb_options.obs_std_dev == estimator->obs_std_dev,
+      "obs_std_dev should be set to the same value");
+
+  const auto& observations = lmdb_.getObservations();
+
+  // Drop relative poses and hosts without observations. The entries of the
+  // others are kept, so that only new pairs allocate below.
+  for (auto it = relative_pose_lin.begin(); it != relative_pose_lin.end();) {
+    auto it_h = observations.find(it->first.first);
+    if (it_h != observations.end() && it_h->second.count(it->first.second)) {
+      ++it;
+    } else {
+      it = relative_pose_lin.erase(it);
+    }
+  }
+  for (auto it = host_to_idx_.begin(); it != host_to_idx_.end();) {
+    it = observations.count(it->first) ? std::next(it)
+                                       : host_to_idx_.erase(it);
+  }
+  for (auto it = host_to_landmark_block.begin();
+       it != host_to_landmark_block.end();) {
+    it = observations.count(it->first) ? std::next(it)
+                                       : host_to_landmark_block.erase(it);
+  }
 
   // Allocate memory for relative pose linearization
-  for (const auto& [tcid_h, target_map] : lmdb_.getObservations()) {
+  size_t host_idx = 0;
+  for (const auto& [tcid_h, target_map] : observations) {
     // if (used_frames && used_frames->count(tcid_h.frame_id) == 0) continue;
-    const size_t host_idx = host_to_idx_.size();
-    host_to_idx_.try_emplace(tcid_h, host_idx);
-    host_to_landmark_block.try_emplace(tcid_h);
+    host_to_idx_[tcid_h] = host_idx++;
+    host_to_landmark_block[tcid_h].clear();
 
     // assumption: every host frame has at least target frame with
     // observations
@@ -92,14 +152,18 @@ LinearizationAbsQR<Scalar, POSE_SIZE>::LinearizationAbsQR(
       BASALT_ASSERT(!obs.empty());
 
       std::pair<TimeCamId, TimeCamId> key(tcid_h, tcid_t);
-      relative_pose_lin.emplace(key, RelPoseLin<Scalar>());
+      relative_pose_lin.try_emplace(key);
     }
   }
 
-  // Populate lookup for relative poses grouped by host-frame
-  for (const auto& [tcid_h, target_map] : lmdb_.getObservations()) {
+  // Populate lookup for relative poses grouped by host-frame. The iterators
+  // are only valid after all insertions above.
+  relative_pose_per_host.resize(observations.size());
+  host_idx = 0;
+  for (const auto& [tcid_h, target_map] : observations) {
     // if (used_frames && used_frames->count(tcid_h.frame_id) == 0) continue;
-    relative_pose_per_host.emplace_back();
+    auto& rpph = relative_pose_per_host[host_idx++];
+    rpph.clear();
 
     for (const auto& [tcid_t, _] : target_map) {
       std::pair<TimeCamId, TimeCamId> key(tcid_h, tcid_t);
@@ -107,12 +171,36 @@ LinearizationAbsQR<Scalar, POSE_SIZE>::LinearizationAbsQR(
 
       BASALT_ASSERT(it != relative_pose_lin.end());
 
-      relative_pose_per_host.back().emplace_back(it);
+      rpph.emplace_back(it);
+    }
+  }
+
+  // Flat list of the pairs for the parallel linearization of the relative
+  // poses, with the states looked up once here
+  relative_pose_tasks.clear();
+  relative_pose_tasks.reserve(relative_pose_lin.size());
+  for (const auto& [tcid_h, target_map] : observations) {
+    const PoseStateRef state_h = getPoseStateRef(tcid_h.frame_id);
+
+    for (const auto& [tcid_t, _] : target_map) {
+      std::pair<TimeCamId, TimeCamId> key(tcid_h, tcid_t);
+
+      RelPoseTask& task = relative_pose_tasks.emplace_back();
+      task.rpl = &relative_pose_lin.at(key);
+      task.tcid_h = tcid_h;
+      task.tcid_t = tcid_t;
+      task.state_h = state_h;
+      task.state_t = getPoseStateRef(tcid_t.frame_id);
     }
   }
 
   num_cameras = frame_poses.size();
 
+  // The blocks of the previous setup are matched to the landmarks by id, so
+  // that a landmark keeps its block while it stays in the window.
+  std::swap(landmark_ids, prev_landmark_ids);
+  std::swap(landmark_blocks, prev_landmark_blocks);
+
   landmark_ids.clear();
   for (const auto& [k, v] : lmdb_.getLandmarks()) {
     if (used_frames || lost_landmarks) {
@@ -125,12 +213,66 @@ LinearizationAbsQR<Scalar, POSE_SIZE>::LinearizationAbsQR(
       landmark_ids.emplace_back(k);
     }
   }
+  std::sort(landmark_ids.begin(), landmark_ids.end());
   size_t num_landmakrs = landmark_ids.size();
 
   // std::cout << "num_landmakrs " << num_landmakrs << std::endl;
 
+  landmark_blocks.clear();
   landmark_blocks.resize(num_landmakrs);
 
+  // Both id lists are sorted, blocks of landmarks that left are recycled.
+  // Blocks are kept per type, as fixed-size blocks only fit landmarks with
+  // the same number of observations.
+  free_landmark_blocks.resize(LandmarkBlock<Scalar>::MAX_FIXED_SIZE_OBS + 1);
+  auto recycle = [&](LandmarkBlockPtr lb) {
+    const size_t type = lb->getBlockType();
+    free_landmark_blocks[type].emplace_back(std::move(lb));
+  };
+
+  size_t j = 0;
+  for (size_t i = 0; i < num_landmakrs; i++) {
+    while (j < prev_landmark_ids.size() &&
+           prev_landmark_ids[j] < landmark_ids[i]) {
+      recycle(std::move(prev_landmark_blocks[j++]));
+    }
+    if (j < prev_landmark_ids.size() &&
+        prev_landmark_ids[j] == landmark_ids[i]) {
+      landmark_blocks[i] = std::move(prev_landmark_blocks[j++]);
+    }
+  }
+  for (; j < prev_landmark_ids.size(); j++) {
+    recycle(std::move(prev_landmark_blocks[j]));
+  }
+  prev_landmark_blocks.clear();
+
+  for (size_t i = 0; i < num_landmakrs; i++) {
+    auto& lb = landmark_blocks[i];
+
+    const size_t num_obs = lmdb_.getLandmark(landmark_ids[i]).obs.size();
+    const size_t type = LandmarkBlock<Scalar>::blockType(num_obs);
+
+    if (lb) {
+      if (lb->getBlockType() == type) continue;
+      recycle(std::move(lb));
+    }
+
+    auto& free_blocks = free_landmark_blocks[type];
+    if (free_blocks.empty()) {
+      lb = LandmarkBlock<Scalar>::template createLandmarkBlock<POSE_SIZE>(
+          num_obs);
+    } else {
+      lb = std::move(free_blocks.back());
+      free_blocks.pop_back();
+    }
+  }
+
+  // Pack the storage of all blocks into one slab
+  landmark_storage.reset(num_landmakrs, [&](size_t i) {
+    return landmark_blocks[i]->storageSize(
+        lmdb_.getLandmark(landmark_ids[i]), aom);
+  });
+
   {
     auto body = [&](const tbb::blocked_range<size_t>& range) {
       for (size_t r = range.begin(); r != range.end(); ++r) {
@@ -138,10 +280,9 @@ LinearizationAbsQR<Scalar, POSE_SIZE>::LinearizationAbsQR(
         auto& lb = landmark_blocks[r];
         auto& landmark = lmdb_.getLandmark(lm_id);
 
-        lb = LandmarkBlock<Scalar>::template createLandmarkBlock<POSE_SIZE>();
-
         lb->allocateLandmark(landmark, relative_pose_lin, calib, aom,
-                             options.lb_options);
+                             options_.lb_options, nullptr,
+                             landmark_storage.block(r));
       }
     };
 
@@ -149,6 +290,7 @@ LinearizationAbsQR<Scalar, POSE_SIZE>::LinearizationAbsQR(
     tbb::parallel_for(range, body);
   }
 
+  landmark_block_idx.clear();
   landmark_block_idx.reserve(num_landmakrs);
 
   num_rows_Q2r = 0;
@@ -160,10 +302,20 @@ LinearizationAbsQR<Scalar, POSE_SIZE>::LinearizationAbsQR(
     host_to_landmark_block.at(lb->getHostKf()).emplace_back(lb.get());
   }
 
+  // The IMU blocks have fixed-size storage, existing ones are rebound to the
+  // measurements of the window
+  const size_t num_imu_blocks =
+      imu_lin_data ? imu_lin_data->imu_meas.size() : 0;
+  imu_blocks.resize(num_imu_blocks);
   if (imu_lin_data) {
+    size_t i = 0;
     for (const auto& kv : imu_lin_data->imu_meas) {
-      imu_blocks.emplace_back(
-          new ImuBlock<Scalar>(kv.second, imu_lin_data, aom));
+      if (imu_blocks[i]) {
+        imu_blocks[i]->setMeasurement(kv.second, imu_lin_data);
+      } else {
+        imu_blocks[i].reset(new ImuBlock<Scalar>(kv.second, imu_lin_data, aom));
+      }
+      i++;
     }
   }
 
@@ -181,50 +333,76 @@ void LinearizationAbsQR<Scalar_, POSE_SIZE_>::log_problem_stats(
   UNUSED(stats);
 }
 
+template <typename Scalar, int POSE_SIZE>
+typename LinearizationAbsQR<Scalar, POSE_SIZE>::PoseStateRef
+LinearizationAbsQR<Scalar, POSE_SIZE>::getPoseStateRef(int64_t t_ns) const {
+  PoseStateRef res;
+
+  auto it = frame_poses.find(t_ns);
+  if (it != frame_poses.end()) {
+    res.pose = &it->second;
+    return res;
+  }
+
+  auto it2 = estimator->frame_states.find(t_ns);
+  if (it2 == estimator->frame_states.end()) {
+    std::cerr << "Could not find pose " << t_ns << std::endl;
+    std::abort();
+  }
+
+  res.state = &it2->second;
+  return res;
+}
+
 template <typename Scalar, int POSE_SIZE>
 Scalar LinearizationAbsQR<Scalar, POSE_SIZE>::linearizeProblem(
     bool* numerically_valid) {
+  BASALT_TRACE_SCOPE("linearizeProblem");
+
   // reset damping and scaling (might be set from previous iteration)
   pose_damping_diagonal = 0;
   pose_damping_diagonal_sqrt = 0;
   marg_scaling = VecX();
 
   // Linearize relative poses
-  for (const auto& [tcid_h, target_map] : lmdb_.getObservations()) {
-    // if (used_frames && used_frames->count(tcid_h.frame_id) == 0) continue;
+  {
+    BASALT_TRACE_SCOPE("linearizeRelPoses");
 
-    for (const auto& [tcid_t, _] : target_map) {
-      std::pair<TimeCamId, TimeCamId> key(tcid_h, tcid_t);
-      RelPoseLin<Scalar>& rpl = relative_pose_lin.at(key);
-
-      if (tcid_h != tcid_t) {
-        const PoseStateWithLin<Scalar>& state_h =
-            estimator->getPoseStateWithLin(tcid_h.frame_id);
-        const PoseStateWithLin<Scalar>& state_t =
-            estimator->getPoseStateWithLin(tcid_t.frame_id);
-
-        // compute relative pose & Jacobians at linearization point
-        Sophus::SE3<Scalar> T_t_h_sophus =
-            computeRelPose(state_h.getPoseLin(), calib.T_i_c[tcid_h.cam_id],
-                           state_t.getPoseLin(), calib.T_i_c[tcid_t.cam_id],
-                           &rpl.d_rel_d_h, &rpl.d_rel_d_t);
-
-        // if either state is already linearized, then the current state
-        // estimate is different from the linearization point, so recompute
-        // the value (not Jacobian) again based on the current state.
-        if (state_h.isLinearized() || state_t.isLinearized()) {
-          T_t_h_sophus =
-              computeRelPose(state_h.getPose(), calib.T_i_c[tcid_h.cam_id],
-                             state_t.getPose(), calib.T_i_c[tcid_t.cam_id]);
+    auto body = [&](const tbb::blocked_range<size_t>& range) {
+      for (size_t r = range.begin(); r != range.end(); ++r) {
+        const RelPoseTask& task = relative_pose_tasks[r];
+        RelPoseLin<Scalar>& rpl = *task.rpl;
+
+        if (task.tcid_h != task.tcid_t) {
+          const PoseStateRef& state_h = task.state_h;
+          const PoseStateRef& state_t = task.state_t;
+
+          // compute relative pose & Jacobians at linearization point
+          Sophus::SE3<Scalar> T_t_h_sophus = computeRelPose(
+              state_h.getPoseLin(), calib.T_i_c[task.tcid_h.cam_id],
+              state_t.getPoseLin(), calib.T_i_c[task.tcid_t.cam_id],
+              &rpl.d_rel_d_h, &rpl.d_rel_d_t);
+
+          // if either state is already linearized, then the current state
+          // estimate is different from the linearization point, so recompute
+          // the value (not Jacobian) again based on the current state.
+          if (state_h.isLinearized() || state_t.isLinearized()) {
+            T_t_h_sophus = computeRelPose(
+                state_h.getPose(), calib.T_i_c[task.tcid_h.cam_id],
+                state_t.getPose(), calib.T_i_c[task.tcid_t.cam_id]);
+          }
+
+          rpl.T_t_h = T_t_h_sophus.matrix();
+        } else {
+          rpl.T_t_h.setIdentity();
+          rpl.d_rel_d_h.setZero();
+          rpl.d_rel_d_t.setZero();
         }
-
-        rpl.T_t_h = T_t_h_sophus.matrix();
-      } else {
-        rpl.T_t_h.setIdentity();
-        rpl.d_rel_d_h.setZero();
-        rpl.d_rel_d_t.setZero();
       }
-    }
+    };
+
+    tbb::blocked_range<size_t> range(0, relative_pose_tasks.size());
+    tbb::parallel_for(range, body);
   }
 
   // Linearize landmarks
@@ -232,6 +410,7 @@ Scalar LinearizationAbsQR<Scalar, POSE_SIZE>::linearizeProblem(
 
   auto body = [&](const tbb::blocked_range<size_t>& range,
                   std::pair<Scalar, bool> error_valid) {
+    BASALT_TRACE_SCOPE("linearizeLandmarks");
     for (size_t r = range.begin(); r != range.end(); ++r) {
       error_valid.first += landmark_blocks[r]->linearizeLandmark();
       error_valid.second =
@@ -269,7 +448,10 @@ Scalar LinearizationAbsQR<Scalar, POSE_SIZE>::linearizeProblem(
 
 template <typename Scalar, int POSE_SIZE>
 void LinearizationAbsQR<Scalar, POSE_SIZE>::performQR() {
+  BASALT_TRACE_SCOPE("performQR");
+
   auto body = [&](const tbb::blocked_range<size_t>& range) {
+    BASALT_TRACE_SCOPE("performQRLandmarks");
     for (size_t r = range.begin(); r != range.end(); ++r) {
       landmark_blocks[r]->performQR();
     }
@@ -590,6 +772,64 @@ void LinearizationAbsQR<Scalar, POSE_SIZE>::get_dense_H_b(MatX& H,
   b = std::move(r.b_);
 }
 
+template <typename Scalar, int POSE_SIZE>
+void LinearizationAbsQR<Scalar, POSE_SIZE>::get_block_sparse_H_b(
+    BlockSparseAccumulator<Scalar>& accum) const {
+  struct Reductor {
+    Reductor(const BlockSparseAccumulator<Scalar>& layout,
+             const std::vector<LandmarkBlockPtr>& landmark_blocks)
+        : layout_(layout), landmark_blocks_(landmark_blocks) {
+      accum_.reset(layout_.getBlockStart(), layout_.getB().size(),
+                   &layout_.getEliminationOrder());
+    }
+
+    void operator()(const tbb::blocked_range<size_t>& range) {
+      for (size_t r = range.begin(); r != range.end(); ++r) {
+        auto& lb = landmark_blocks_[r];
+        lb->add_block_sparse_H_b(accum_);
+      }
+    }
+
+    Reductor(Reductor& a, tbb::split)
+        : layout_(a.layout_), landmark_blocks_(a.landmark_blocks_) {
+      accum_.reset(layout_.getBlockStart(), layout_.getB().size(),
+                   &layout_.getEliminationOrder());
+    };
+
+    inline void join(Reductor& b) { accum_.join(b.accum_); }
+
+    const BlockSparseAccumulator<Scalar>& layout_;
+    const std::vector<LandmarkBlockPtr>& landmark_blocks_;
+
+    BlockSparseAccumulator<Scalar> accum_;
+  };
+
+  BASALT_ASSERT(accum.getB().size() == signed_cast(aom.total_size));
+
+  Reductor r(accum, landmark_blocks);
+
+  // go over all landmarks
+  tbb::blocked_range<size_t> range(0, landmark_block_idx.size());
+  tbb::parallel_reduce(range, r);
+
+  accum.join(r.accum_);
+
+  // Add imu
+  if (imu_lin_data) {
+    for (const auto& imu_block : imu_blocks) {
+      imu_block->add_dense_H_b(accum);
+    }
+  }
+
+  // Add damping
+  if (hasPoseDamping()) {
+    accum.addDiagonal(pose_damping_diagonal);
+  }
+
+  // Add marginalization
+  add_block_sparse_H_b_marg_prior(accum);
+}
+
 template <typename Scalar, int POSE_SIZE>
 void LinearizationAbsQR<Scalar, POSE_SIZE>::get_dense_Q2Jp_Q2r_pose_damping(
     MatX& Q2Jp, size_t start_idx) const {
@@ -667,6 +907,28 @@ void LinearizationAbsQR<Scalar, POSE_SIZE>::add_dense_H_b_marg_prior(
   //  }
 }
 
+template <typename Scalar, int POSE_SIZE>
+void LinearizationAbsQR<Scalar, POSE_SIZE>::add_block_sparse_H_b_marg_prior(
+    BlockSparseAccumulator<Scalar>& accum) const {
+  if (!marg_lin_data) return;
+
+  // Scaling not supported ATM
+  BASALT_ASSERT(marg_scaling.rows() == 0);
+
+  // The prior is dense over its variables, which are the first ones of the
+  // order, so it is linearized on its own order and added as a whole
+  const size_t marg_size = marg_lin_data->order.total_size;
+
+  MatX H = MatX::Zero(marg_size, marg_size);
+  VecX b = VecX::Zero(marg_size);
+
+  Scalar marg_prior_error;
+  estimator->linearizeMargPrior(*marg_lin_data, marg_lin_data->order, H, b,
+                                marg_prior_error);
+
+  accum.addDense(0, H, b);
+}
+
 template <typename Scalar, int POSE_SIZE>
 void LinearizationAbsQR<Scalar, POSE_SIZE>::add_dense_H_b_imu(
     DenseAccumulator<Scalar>& accum) const {
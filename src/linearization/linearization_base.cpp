@@ -90,6 +90,25 @@ LinearizationBase<Scalar_, POSE_SIZE_>::create(
   }
 }
 
+template <typename Scalar_, int POSE_SIZE_>
+void LinearizationBase<Scalar_, POSE_SIZE_>::update(
+    std::unique_ptr<LinearizationBase>& lin,
+    BundleAdjustmentBase<Scalar>* estimator, const AbsOrderMap& aom,
+    const Options& options, const MargLinData<Scalar>* marg_lin_data,
+    const ImuLinData<Scalar>* imu_lin_data,
+    const std::set<FrameId>* used_frames,
+    const std::unordered_set<KeypointId>* lost_landmarks,
+    int64_t last_state_to_marg) {
+  if (lin && lin->reinitialize(estimator, aom, options, marg_lin_data,
+                               imu_lin_data, used_frames, lost_landmarks,
+                               last_state_to_marg)) {
+    return;
+  }
+
+  lin = create(estimator, aom, options, marg_lin_data, imu_lin_data,
+               used_frames, lost_landmarks, last_state_to_marg);
+}
+
 // //////////////////////////////////////////////////////////////////
 // instatiate factory templates
 
@@ -103,6 +122,14 @@ LinearizationBase<double, 6>::create(
     const std::set<FrameId>* used_frames,
     const std::unordered_set<KeypointId>* lost_landmarks,
     int64_t last_state_to_marg);
+template void LinearizationBase<double, 6>::update(
+    std::unique_ptr<LinearizationBase<double, 6>>& lin,
+    BundleAdjustmentBase<double>* estimator, const AbsOrderMap& aom,
+    const Options& options, const MargLinData<double>* marg_lin_data,
+    const ImuLinData<double>* imu_lin_data,
+    const std::set<FrameId>* used_frames,
+    const std::unordered_set<KeypointId>* lost_landmarks,
+    int64_t last_state_to_marg);
 #endif
 
 #ifdef BASALT_INSTANTIATIONS_FLOAT
@@ -114,6 +141,13 @@ LinearizationBase<float, 6>::create(
     const ImuLinData<float>* imu_lin_data, const std::set<FrameId>* used_frames,
     const std::unordered_set<KeypointId>* lost_landmarks,
     int64_t last_state_to_marg);
+template void LinearizationBase<float, 6>::update(
+    std::unique_ptr<LinearizationBase<float, 6>>& lin,
+    BundleAdjustmentBase<float>* estimator, const AbsOrderMap& aom,
+    const Options& options, const MargLinData<float>* marg_lin_data,
+    const ImuLinData<float>* imu_lin_data, const std::set<FrameId>* used_frames,
+    const std::unordered_set<KeypointId>* lost_landmarks,
+    int64_t last_state_to_marg);
 #endif
 
 }  // namespace basalt
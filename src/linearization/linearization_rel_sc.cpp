@@ -43,6 +43,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <basalt/vi_estimator/sc_ba_base.h>
 #include <basalt/linearization/imu_block.hpp>
 #include <basalt/utils/cast_utils.hpp>
+#include <basalt/utils/tracing.h>
 
 namespace basalt {
 
@@ -97,6 +98,8 @@ void LinearizationRelSC<Scalar_, POSE_SIZE_>::log_problem_stats(
 template <typename Scalar, int POSE_SIZE>
 Scalar LinearizationRelSC<Scalar, POSE_SIZE>::linearizeProblem(
     bool* numerically_valid) {
+  BASALT_TRACE_SCOPE("linearizeProblem");
+
   // reset damping and scaling (might be set from previous iteration)
   pose_damping_diagonal = 0;
   pose_damping_diagonal_sqrt = 0;
@@ -146,6 +146,7 @@ Button save_traj_btn("ui.save_traj", &saveTrajectoryButton);
 pangolin::OpenGlRenderState camera;
 
 std::string marg_data_path;
+size_t num_load_threads = 4;
 
 int main(int argc, char** argv) {
   bool show_gui = true;
@@ -167,6 +168,10 @@ int main(int argc, char** argv) {
 
   app.add_option("--result-path", result_path, "Path to config file.");
 
+  app.add_option("--num-load-threads", num_load_threads,
+                 "Number of threads that load the stored images (0 loads "
+                 "them on the loader thread).");
+
   try {
     app.parse(argc, argv);
   } catch (const CLI::ParseError& e) {
@@ -565,7 +570,7 @@ void load_data(const std::string& calib_path, const std::string& cache_path) {
 
   nrf_mapper.reset(new basalt::NfrMapper(calib, vio_config));
 
-  basalt::MargDataLoader mdl;
+  basalt::MargDataLoader mdl(num_load_threads);
   tbb::concurrent_bounded_queue<basalt::MargData::Ptr> marg_queue;
   mdl.out_marg_queue = &marg_queue;
 
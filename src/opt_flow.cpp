@@ -111,6 +111,23 @@ void feed_images() {
   std::cout << "Finished input_data thread " << std::endl;
 }
 
+// Only consumed by the frontend with optical_flow_use_gyro, otherwise the
+// queue would grow for the whole sequence
+void feed_imu() {
+  if (!vio_config.optical_flow_use_gyro) return;
+
+  for (size_t i = 0; i < vio_dataset->get_gyro_data().size(); i++) {
+    basalt::ImuData<double>::Ptr data(new basalt::ImuData<double>);
+    data->t_ns = vio_dataset->get_gyro_data()[i].timestamp_ns;
+
+    data->accel = vio_dataset->get_accel_data()[i].data;
+    data->gyro = vio_dataset->get_gyro_data()[i].data;
+
+    opt_flow_ptr->imu_data_queue.push(data);
+  }
+  opt_flow_ptr->imu_data_queue.push(nullptr);
+}
+
 void read_result() {
   std::cout << "Started read_result thread " << std::endl;
 
@@ -125,11 +142,11 @@ void read_result() {
     observations.emplace(res->t_ns, res);
 
     for (size_t i = 0; i < res->observations.size(); i++)
-      for (const auto& kv : res->observations.at(i)) {
-        if (keypoint_stats.count(kv.first) == 0) {
-          keypoint_stats[kv.first] = 1;
+      for (const basalt::KeypointId id : res->observations.at(i).ids()) {
+        if (keypoint_stats.count(id) == 0) {
+          keypoint_stats[id] = 1;
         } else {
-          keypoint_stats[kv.first]++;
+          keypoint_stats[id]++;
         }
       }
   }
@@ -187,12 +204,21 @@ int main(int argc, char** argv) {
     dataset_io->read(dataset_path);
 
     vio_dataset = dataset_io->get_data();
+    vio_dataset->native_8bit_images = vio_config.optical_flow_native_8bit;
     vio_dataset->get_image_timestamps().erase(
         vio_dataset->get_image_timestamps().begin());
 
     show_frame.Meta().range[1] = vio_dataset->get_image_timestamps().size() - 1;
     show_frame.Meta().gui_changed = true;
 
+    if (vio_config.optical_flow_use_gyro &&
+        vio_dataset->get_gyro_data().empty()) {
+      std::cerr << "Warning: the dataset has no IMU data, disabling "
+                   "optical_flow_use_gyro."
+                << std::endl;
+      vio_config.optical_flow_use_gyro = false;
+    }
+
     opt_flow_ptr =
         basalt::OpticalFlowFactory::getOpticalFlow(vio_config, calib);
     if (show_gui) opt_flow_ptr->output_queue = &observations_queue;
@@ -203,6 +229,8 @@ int main(int argc, char** argv) {
 
   std::thread t1(&feed_images);
 
+  std::thread t_imu(&feed_imu);
+
   if (show_gui) {
     std::thread t2(&read_result);
 
@@ -253,6 +281,16 @@ int main(int argc, char** argv) {
             fmt.gltype = GL_UNSIGNED_SHORT;
             fmt.scalable_internal_format = GL_LUMINANCE16;
 
+            img_view[cam_id]->SetImage(img->ptr, img->w, img->h, img->pitch,
+                                       fmt);
+          } else if (img_vec[cam_id].img_u8.get()) {
+            auto img = img_vec[cam_id].img_u8;
+
+            pangolin::GlPixFormat fmt;
+            fmt.glformat = GL_LUMINANCE;
+            fmt.gltype = GL_UNSIGNED_BYTE;
+            fmt.scalable_internal_format = GL_LUMINANCE8;
+
             img_view[cam_id]->SetImage(img->ptr, img->w, img->h, img->pitch,
                                        fmt);
           } else {
@@ -276,6 +314,7 @@ int main(int argc, char** argv) {
   }
 
   t1.join();
+  t_imu.join();
 
   return 0;
 }
@@ -293,27 +332,29 @@ void draw_image_overlay(pangolin::View& v, size_t cam_id) {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     if (observations.count(t_ns) > 0) {
-      const Eigen::aligned_map<basalt::KeypointId, Eigen::AffineCompact2f>&
-          kp_map = observations.at(t_ns)->observations[cam_id];
+      const basalt::KeypointTracks& tracks =
+          observations.at(t_ns)->observations[cam_id];
 
-      for (const auto& kv : kp_map) {
+      for (size_t j = 0; j < tracks.size(); j++) {
         Eigen::MatrixXf transformed_patch =
-            kv.second.linear() * opt_flow_ptr->patch_coord;
-        transformed_patch.colwise() += kv.second.translation();
+            tracks.linear(j) * opt_flow_ptr->patch_coord;
+        transformed_patch.colwise() += tracks.translation(j);
 
         for (int i = 0; i < transformed_patch.cols(); i++) {
           const Eigen::Vector2f c = transformed_patch.col(i);
           pangolin::glDrawCirclePerimeter(c[0], c[1], 0.5f);
         }
 
-        const Eigen::Vector2f c = kv.second.translation();
+        const Eigen::Vector2f c = tracks.translation(j);
 
         if (show_ids)
-          pangolin::GlFont::I().Text("%d", kv.first).Draw(5 + c[0], 5 + c[1]);
+          pangolin::GlFont::I()
+              .Text("%d", tracks.id(j))
+              .Draw(5 + c[0], 5 + c[1]);
       }
 
       pangolin::GlFont::I()
-          .Text("Tracked %d keypoints", kp_map.size())
+          .Text("Tracked %d keypoints", tracks.size())
           .Draw(5, 20);
     }
   }
@@ -41,91 +41,125 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace basalt {
 
+void TrackingIterationStats::collect(ExecutionStats& stats) {
+  for (size_t level = 0; level < calls_.size(); level++) {
+    const int64_t calls = calls_[level].exchange(0);
+    const int64_t iterations = iterations_[level].exchange(0);
+    const int64_t converged = converged_[level].exchange(0);
+
+    if (calls == 0) continue;
+
+    const std::string suffix = "_level" + std::to_string(level);
+    stats.add("opt_flow_iterations" + suffix, double(iterations) / calls)
+        .format("count");
+    stats.add("opt_flow_converged" + suffix, double(converged) / calls);
+  }
+}
+
+Sophus::SO3d OpticalFlowBase::integrateGyro(int64_t t0_ns, int64_t t1_ns) {
+  // Nothing to integrate, e.g. for the first frame
+  if (t1_ns <= t0_ns) return Sophus::SO3d();
+
+  while (!imu_finished &&
+         (imu_buffer.empty() || imu_buffer.back()->t_ns < t1_ns)) {
+    ImuData<double>::Ptr data;
+    imu_data_queue.pop(data);
+
+    if (data) {
+      imu_buffer.push_back(data);
+    } else {
+      imu_finished = true;
+    }
+  }
+
+  // Every sample holds until the next one, the first one also before it
+  Sophus::SO3d R_i0_i1;
+  for (size_t k = 0; k < imu_buffer.size(); k++) {
+    const int64_t begin =
+        k == 0 ? t0_ns : std::max(imu_buffer[k]->t_ns, t0_ns);
+    const int64_t end = k + 1 < imu_buffer.size()
+                            ? std::min(imu_buffer[k + 1]->t_ns, t1_ns)
+                            : t1_ns;
+
+    if (end > begin) {
+      const Eigen::Vector3d gyro =
+          calib_gyro_bias.getCalibrated(imu_buffer[k]->gyro);
+      R_i0_i1 *= Sophus::SO3d::exp(gyro * ((end - begin) * 1e-9));
+    }
+  }
+
+  while (imu_buffer.size() > 1 && imu_buffer[1]->t_ns <= t1_ns) {
+    imu_buffer.pop_front();
+  }
+
+  return R_i0_i1;
+}
+
+namespace {
+
+template <template <typename, template <typename> typename, typename>
+          typename OpticalFlow,
+          typename Pixel>
+OpticalFlowBase::Ptr makeOpticalFlow(const VioConfig& config,
+                                     const Calibration<double>& cam) {
+  OpticalFlowBase::Ptr res;
+
+  switch (config.optical_flow_pattern) {
+    case 24:
+      res.reset(new OpticalFlow<float, Pattern24, Pixel>(config, cam));
+      break;
+
+    case 52:
+      res.reset(new OpticalFlow<float, Pattern52, Pixel>(config, cam));
+      break;
+
+    case 51:
+      res.reset(new OpticalFlow<float, Pattern51, Pixel>(config, cam));
+      break;
+
+    case 50:
+      res.reset(new OpticalFlow<float, Pattern50, Pixel>(config, cam));
+      break;
+
+    default:
+      std::cerr << "config.optical_flow_pattern "
+                << config.optical_flow_pattern << " is not supported."
+                << std::endl;
+      std::abort();
+  }
+
+  return res;
+}
+
+template <template <typename, template <typename> typename, typename>
+          typename OpticalFlow>
+OpticalFlowBase::Ptr makeOpticalFlow(const VioConfig& config,
+                                     const Calibration<double>& cam) {
+  if (config.optical_flow_native_8bit) {
+    return makeOpticalFlow<OpticalFlow, uint8_t>(config, cam);
+  } else {
+    return makeOpticalFlow<OpticalFlow, uint16_t>(config, cam);
+  }
+}
+
+}  // namespace
+
 OpticalFlowBase::Ptr OpticalFlowFactory::getOpticalFlow(
     const VioConfig& config, const Calibration<double>& cam) {
   OpticalFlowBase::Ptr res;
 
   if (config.optical_flow_type == "patch") {
-    switch (config.optical_flow_pattern) {
-      case 24:
-        res.reset(new PatchOpticalFlow<float, Pattern24>(config, cam));
-        break;
-
-      case 52:
-        res.reset(new PatchOpticalFlow<float, Pattern52>(config, cam));
-        break;
-
-      case 51:
-        res.reset(new PatchOpticalFlow<float, Pattern51>(config, cam));
-        break;
-
-      case 50:
-        res.reset(new PatchOpticalFlow<float, Pattern50>(config, cam));
-        break;
-
-      default:
-        std::cerr << "config.optical_flow_pattern "
-                  << config.optical_flow_pattern << " is not supported."
-                  << std::endl;
-        std::abort();
-    }
+    res = makeOpticalFlow<PatchOpticalFlow>(config, cam);
   }
 
   if (config.optical_flow_type == "frame_to_frame") {
-    switch (config.optical_flow_pattern) {
-      case 24:
-        res.reset(new FrameToFrameOpticalFlow<float, Pattern24>(config, cam));
-        break;
-
-      case 52:
-        res.reset(new FrameToFrameOpticalFlow<float, Pattern52>(config, cam));
-        break;
-
-      case 51:
-        res.reset(new FrameToFrameOpticalFlow<float, Pattern51>(config, cam));
-        break;
-
-      case 50:
-        res.reset(new FrameToFrameOpticalFlow<float, Pattern50>(config, cam));
-        break;
-
-      default:
-        std::cerr << "config.optical_flow_pattern "
-                  << config.optical_flow_pattern << " is not supported."
-                  << std::endl;
-        std::abort();
-    }
+    res = makeOpticalFlow<FrameToFrameOpticalFlow>(config, cam);
   }
 
   if (config.optical_flow_type == "multiscale_frame_to_frame") {
-    switch (config.optical_flow_pattern) {
-      case 24:
-        res.reset(new MultiscaleFrameToFrameOpticalFlow<float, Pattern24>(
-            config, cam));
-        break;
-
-      case 52:
-        res.reset(new MultiscaleFrameToFrameOpticalFlow<float, Pattern52>(
-            config, cam));
-        break;
-
-      case 51:
-        res.reset(new MultiscaleFrameToFrameOpticalFlow<float, Pattern51>(
-            config, cam));
-        break;
-
-      case 50:
-        res.reset(new MultiscaleFrameToFrameOpticalFlow<float, Pattern50>(
-            config, cam));
-        break;
-
-      default:
-        std::cerr << "config.optical_flow_pattern "
-                  << config.optical_flow_pattern << " is not supported."
-                  << std::endl;
-        std::abort();
-    }
+    res = makeOpticalFlow<MultiscaleFrameToFrameOpticalFlow>(config, cam);
   }
+
   return res;
 }
 }  // namespace basalt
@@ -162,6 +162,7 @@ int main(int argc, char** argv) {
   // realsense
   t265_device.reset(
       new basalt::RsT265Device(false, 1, 90, 10.0));  // TODO: add options?
+  t265_device->native_8bit_images = vio_config.optical_flow_native_8bit;
 
   // startup device and load calibration
   t265_device->start();
@@ -178,6 +179,9 @@ int main(int argc, char** argv) {
       vio_config, calib, basalt::constants::g, true, use_double);
   vio->initialize(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
   t265_device->imu_data_queue = &vio->imu_data_queue;
+  if (vio_config.optical_flow_use_gyro) {
+    t265_device->flow_imu_data_queue = &opt_flow_ptr->imu_data_queue;
+  }
 
   opt_flow_ptr->output_queue = &vio->vision_data_queue;
   if (show_gui) vio->out_vis_queue = &out_vis_queue;
@@ -335,10 +339,20 @@ int main(int argc, char** argv) {
 
           for (size_t cam_id = 0; cam_id < basalt::RsT265Device::NUM_CAMS;
                cam_id++) {
-            if (img_data[cam_id].img.get())
+            if (img_data[cam_id].img.get()) {
               img_view[cam_id]->SetImage(
                   img_data[cam_id].img->ptr, img_data[cam_id].img->w,
                   img_data[cam_id].img->h, img_data[cam_id].img->pitch, fmt);
+            } else if (img_data[cam_id].img_u8.get()) {
+              pangolin::GlPixFormat fmt_u8 = fmt;
+              fmt_u8.gltype = GL_UNSIGNED_BYTE;
+              fmt_u8.scalable_internal_format = GL_LUMINANCE8;
+
+              img_view[cam_id]->SetImage(
+                  img_data[cam_id].img_u8->ptr, img_data[cam_id].img_u8->w,
+                  img_data[cam_id].img_u8->h, img_data[cam_id].img_u8->pitch,
+                  fmt_u8);
+            }
           }
         }
 
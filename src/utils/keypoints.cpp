@@ -33,10 +33,19 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <array>
 #include <unordered_set>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <basalt/hash_bow/hash_bow.h>
 #include <basalt/utils/keypoints.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -133,6 +142,594 @@ const static char pattern_31_y_b[256] = {
     -9,  -1,  -2,  -8,  5,   10,  5,   5,   11,  -6,  -12, 9,   4,   -2, -2,
     -11};
 
+namespace {
+
+// Bresenham circle of radius 3 around the pixel as used by FAST
+const int FAST_CIRCLE[16][2] = {{0, -3},  {1, -3},  {2, -2},  {3, -1},
+                                {3, 0},   {3, 1},   {2, 2},   {1, 3},
+                                {0, 3},   {-1, 3},  {-2, 2},  {-3, 1},
+                                {-3, 0},  {-3, -1}, {-2, -2}, {-1, -3}};
+
+// Corners need a FAST score above this value. Corresponds to the lowest
+// threshold of the OpenCV path, which runs on 8 bit images, so 16 bit images
+// use the threshold shifted by 8 bits.
+template <typename T>
+constexpr int fastMinScore() {
+  return sizeof(T) == 1 ? 5 : 5 << 8;
+}
+
+// FAST needs the full circle inside the cell image in the OpenCV path, so
+// the native detector skips the same margin at the cell borders.
+const int FAST_CELL_MARGIN = 3;
+
+struct GridCorner {
+  int score;
+  int x;
+  int y;
+};
+
+// FAST-9 score of the pixel p: the largest t such that 9 contiguous circle
+// pixels are all brighter than p + t or all darker than p - t. Returns 0
+// early if the score can not exceed fastMinScore.
+template <typename T>
+inline int fastScore(const T* p, const std::ptrdiff_t* offsets) {
+  int bright[16], dark[16];
+  for (int i = 0; i < 16; i += 4) {
+    const int d = int(p[offsets[i]]) - int(p[0]);
+    bright[i] = std::max(d, 0);
+    dark[i] = std::max(-d, 0);
+  }
+
+  // An arc of 9 pixels always contains two neighboring compass points.
+  int compass = 0;
+  for (int i = 0; i < 16; i += 4) {
+    const int j = (i + 4) & 15;
+    compass = std::max(compass, std::max(std::min(bright[i], bright[j]),
+                                         std::min(dark[i], dark[j])));
+  }
+  if (compass <= fastMinScore<T>()) return 0;
+
+  for (int i = 0; i < 16; i++) {
+    if (i % 4 == 0) continue;
+    const int d = int(p[offsets[i]]) - int(p[0]);
+    bright[i] = std::max(d, 0);
+    dark[i] = std::max(-d, 0);
+  }
+
+  int score = 0;
+  for (int s = 0; s < 16; s++) {
+    int min_bright = bright[s];
+    int min_dark = dark[s];
+    for (int k = 1; k < 9; k++) {
+      min_bright = std::min(min_bright, bright[(s + k) & 15]);
+      min_dark = std::min(min_dark, dark[(s + k) & 15]);
+    }
+    score = std::max(score, std::max(min_bright, min_dark));
+  }
+  return score;
+}
+
+#ifdef __AVX2__
+// Loads 16 pixels into 16 bit lanes
+template <typename T>
+inline __m256i loadPixels16(const T* p) {
+  if constexpr (sizeof(T) == 2) {
+    return _mm256_loadu_si256((const __m256i*)p);
+  } else {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+  }
+}
+
+// a >= b for unsigned 16 bit lanes
+inline __m256i greaterEqualEpu16(__m256i a, __m256i b) {
+  return _mm256_cmpeq_epi16(_mm256_max_epu16(a, b), a);
+}
+
+// Maximum over the 16 arcs of the minimum of 9 contiguous values. The arc
+// minima are built from minima over 2, 4 and 8 values.
+inline __m256i maxArcMin(const __m256i d[16]) {
+  __m256i m2[16], m4[16];
+  for (int i = 0; i < 16; i++) {
+    m2[i] = _mm256_min_epu16(d[i], d[(i + 1) & 15]);
+  }
+  for (int i = 0; i < 16; i++) {
+    m4[i] = _mm256_min_epu16(m2[i], m2[(i + 2) & 15]);
+  }
+
+  __m256i res = _mm256_setzero_si256();
+  for (int i = 0; i < 16; i++) {
+    const __m256i m8 = _mm256_min_epu16(m4[i], m4[(i + 4) & 15]);
+    res = _mm256_max_epu16(res, _mm256_min_epu16(m8, d[(i + 8) & 15]));
+  }
+  return res;
+}
+#endif
+
+// Inserts a corner into the score-sorted list of the best corners of a cell.
+// Unused entries have score 0. A corner next to a stronger one is
+// suppressed, weaker neighbors are removed.
+inline void addCorner(GridCorner* best, int num_best, const GridCorner& c) {
+  if (c.score <= best[num_best - 1].score) return;
+
+  for (int i = 0; i < num_best && best[i].score > 0; i++) {
+    if (std::abs(best[i].x - c.x) <= 1 && std::abs(best[i].y - c.y) <= 1) {
+      if (best[i].score >= c.score) return;
+
+      std::copy(best + i + 1, best + num_best, best + i);
+      best[num_best - 1].score = 0;
+      i--;
+    }
+  }
+
+  int i = num_best - 1;
+  while (i > 0 && best[i - 1].score < c.score) {
+    best[i] = best[i - 1];
+    i--;
+  }
+  best[i] = c;
+}
+
+// Scores the pixels [x_begin, x_end) of row y and adds the corners to the
+// best corners of the cell. The vectorized path reads up to 15 pixels past
+// x_end, which stays inside the image for x_end <= w - EDGE_THRESHOLD.
+template <typename T>
+void detectCornersInRow(const basalt::Image<const T>& img, int y, int x_begin,
+                        int x_end, const std::ptrdiff_t* offsets,
+                        GridCorner* best, int num_best) {
+  const T* row = img.RowPtr(y);
+  int x = x_begin;
+
+#ifdef __AVX2__
+  const __m256i min_score = _mm256_set1_epi16(fastMinScore<T>() + 1);
+
+  for (; x < x_end; x += 16) {
+    const T* p = row + x;
+    const __m256i v = loadPixels16(p);
+
+    // two mask bits per 16 bit lane, lanes past x_end are ignored
+    const int num_lanes = std::min(16, x_end - x);
+    const uint32_t lane_mask =
+        num_lanes == 16 ? 0xffffffffu : (1u << (2 * num_lanes)) - 1;
+
+    __m256i bright[16], dark[16];
+    for (int i = 0; i < 16; i += 4) {
+      const __m256i c = loadPixels16(p + offsets[i]);
+      bright[i] = _mm256_subs_epu16(c, v);
+      dark[i] = _mm256_subs_epu16(v, c);
+    }
+
+    // An arc of 9 pixels always contains two neighboring compass points,
+    // which rejects most pixels before computing the full score.
+    __m256i compass = _mm256_setzero_si256();
+    for (int i = 0; i < 16; i += 4) {
+      const int j = (i + 4) & 15;
+      compass = _mm256_max_epu16(
+          compass, _mm256_max_epu16(_mm256_min_epu16(bright[i], bright[j]),
+                                    _mm256_min_epu16(dark[i], dark[j])));
+    }
+    if (!(_mm256_movemask_epi8(greaterEqualEpu16(compass, min_score)) &
+          lane_mask)) {
+      continue;
+    }
+
+    for (int i = 0; i < 16; i++) {
+      if (i % 4 == 0) continue;
+      const __m256i c = loadPixels16(p + offsets[i]);
+      bright[i] = _mm256_subs_epu16(c, v);
+      dark[i] = _mm256_subs_epu16(v, c);
+    }
+
+    const __m256i score =
+        _mm256_max_epu16(maxArcMin(bright), maxArcMin(dark));
+
+    uint32_t mask =
+        _mm256_movemask_epi8(greaterEqualEpu16(score, min_score)) & lane_mask;
+    if (!mask) continue;
+
+    alignas(32) uint16_t scores[16];
+    _mm256_store_si256((__m256i*)scores, score);
+
+    while (mask) {
+      const int lane = __builtin_ctz(mask) / 2;
+      mask &= ~(3u << (2 * lane));
+      addCorner(best, num_best, GridCorner{scores[lane], x + lane, y});
+    }
+  }
+#endif
+
+  for (; x < x_end; x++) {
+    const int score = fastScore(row + x, offsets);
+    if (score > fastMinScore<T>()) {
+      addCorner(best, num_best, GridCorner{score, x, y});
+    }
+  }
+}
+
+// Single sweep over the rows of all empty cells keeping the best FAST
+// corners of every cell, without per-cell image copies or repeated passes
+// with decreasing thresholds.
+template <typename T>
+void detectKeypointsGrid(const basalt::Image<const T>& img_raw,
+                         KeypointsData& kd, int PATCH_SIZE,
+                         int num_points_cell, const Eigen::MatrixXi& cells,
+                         int x_start, int x_stop, int y_start, int y_stop) {
+  const int num_cells_x = (x_stop - x_start) / PATCH_SIZE + 1;
+  const int num_cells_y = (y_stop - y_start) / PATCH_SIZE + 1;
+
+  std::vector<GridCorner> best(num_cells_x * num_cells_y * num_points_cell,
+                               GridCorner{0, 0, 0});
+
+  std::ptrdiff_t offsets[16];
+  for (int i = 0; i < 16; i++) {
+    offsets[i] = FAST_CIRCLE[i][1] * std::ptrdiff_t(img_raw.pitch / sizeof(T)) +
+                 FAST_CIRCLE[i][0];
+  }
+
+  // same valid region as img_raw.InBounds(x, y, EDGE_THRESHOLD)
+  const int x_min = EDGE_THRESHOLD;
+  const int x_max = int(img_raw.w) - EDGE_THRESHOLD - 1;
+  const int y_min = EDGE_THRESHOLD;
+  const int y_max = int(img_raw.h) - EDGE_THRESHOLD - 1;
+
+  for (int cy = 0; cy < num_cells_y; cy++) {
+    if ((cells.row(cy).head(num_cells_x).array() > 0).all()) continue;
+
+    const int cell_y = y_start + cy * PATCH_SIZE;
+    const int y_begin = std::max(cell_y + FAST_CELL_MARGIN, y_min);
+    const int y_end = std::min(cell_y + PATCH_SIZE - FAST_CELL_MARGIN, y_max);
+
+    for (int y = y_begin; y < y_end; y++) {
+      for (int cx = 0; cx < num_cells_x; cx++) {
+        if (cells(cy, cx) > 0) continue;
+
+        const int cell_x = x_start + cx * PATCH_SIZE;
+        const int x_begin = std::max(cell_x + FAST_CELL_MARGIN, x_min);
+        const int x_end =
+            std::min(cell_x + PATCH_SIZE - FAST_CELL_MARGIN, x_max);
+
+        if (x_begin < x_end) {
+          GridCorner* cell_best =
+              &best[(cy * num_cells_x + cx) * num_points_cell];
+          detectCornersInRow(img_raw, y, x_begin, x_end, offsets, cell_best,
+                             num_points_cell);
+        }
+      }
+    }
+  }
+
+  // same order of the corners as in the OpenCV path
+  for (int cx = 0; cx < num_cells_x; cx++) {
+    for (int cy = 0; cy < num_cells_y; cy++) {
+      const GridCorner* cell_best =
+          &best[(cy * num_cells_x + cx) * num_points_cell];
+      for (int i = 0; i < num_points_cell && cell_best[i].score > 0; i++) {
+        kd.corners.emplace_back(cell_best[i].x, cell_best[i].y);
+      }
+    }
+  }
+}
+
+// Number of quantized orientations of the rotated descriptor pattern. The
+// rotated points differ by less than a quarter pixel from the exact rotation.
+const int PATTERN_ANGLE_BINS = 256;
+
+// Descriptor pattern rotated to one of the quantized orientations
+struct RotatedPattern {
+  int8_t xa[256], ya[256], xb[256], yb[256];
+};
+
+const std::vector<RotatedPattern>& rotatedPatterns() {
+  static const std::vector<RotatedPattern> patterns = [] {
+    std::vector<RotatedPattern> res(PATTERN_ANGLE_BINS);
+
+    for (int a = 0; a < PATTERN_ANGLE_BINS; a++) {
+      Eigen::Rotation2Dd rot(2 * M_PI * a / PATTERN_ANGLE_BINS);
+      Eigen::Matrix2d mat_rot = rot.matrix();
+
+      for (int i = 0; i < 256; i++) {
+        Eigen::Vector2d va(pattern_31_x_a[i], pattern_31_y_a[i]),
+            vb(pattern_31_x_b[i], pattern_31_y_b[i]);
+
+        Eigen::Vector2i vva = (mat_rot * va).array().round().cast<int>();
+        Eigen::Vector2i vvb = (mat_rot * vb).array().round().cast<int>();
+
+        res[a].xa[i] = vva[0];
+        res[a].ya[i] = vva[1];
+        res[a].xb[i] = vvb[0];
+        res[a].yb[i] = vvb[1];
+      }
+    }
+
+    return res;
+  }();
+
+  return patterns;
+}
+
+inline int patternAngleBin(double angle) {
+  const int bin = std::lround(angle * PATTERN_ANGLE_BINS / (2 * M_PI));
+  return ((bin % PATTERN_ANGLE_BINS) + PATTERN_ANGLE_BINS) % PATTERN_ANGLE_BINS;
+}
+
+// Half widths of the rows of the disk used for the corner orientation
+const std::array<int, 2 * HALF_PATCH_SIZE + 1>& momentHalfWidths() {
+  static const std::array<int, 2 * HALF_PATCH_SIZE + 1> half_widths = [] {
+    std::array<int, 2 * HALF_PATCH_SIZE + 1> res;
+    for (int y = -HALF_PATCH_SIZE; y <= HALF_PATCH_SIZE; y++) {
+      int hw = 0;
+      while ((hw + 1) * (hw + 1) + y * y <= HALF_PATCH_SIZE * HALF_PATCH_SIZE) {
+        hw++;
+      }
+      res[y + HALF_PATCH_SIZE] = hw;
+    }
+    return res;
+  }();
+
+  return half_widths;
+}
+
+// Descriptors are matched against MATCH_LANES descriptors at once
+const int MATCH_LANES = 8;
+
+// Number of blocks of MATCH_LANES descriptors that are matched against all
+// descriptors of the first set before moving on (16 KB of descriptors).
+const int MATCH_TILE_BLOCKS = 64;
+
+// Distance of the padding descriptors, larger than any real distance
+const int MATCH_INVALID_DIST = 1000;
+
+inline void descriptorWords(const std::bitset<256>& d, uint64_t* w) {
+  static const std::bitset<256> mask(~uint64_t(0));
+  for (int k = 0; k < 4; k++) {
+    w[k] = ((d >> (64 * k)) & mask).to_ullong();
+  }
+}
+
+// Hamming distances of one descriptor to a block of MATCH_LANES descriptors
+// with interleaved words.
+inline void hammingDistances(const uint64_t* a, const uint64_t* block,
+                             int32_t* dist) {
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+  __m512i acc = _mm512_setzero_si512();
+  for (int k = 0; k < 4; k++) {
+    const __m512i x = _mm512_xor_si512(
+        _mm512_set1_epi64(a[k]), _mm512_loadu_si512(block + k * MATCH_LANES));
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+  }
+  _mm512_mask_cvtepi64_storeu_epi32(dist, 0xff, acc);
+#elif defined(__AVX2__)
+  // popcount of the bytes with a nibble lookup table
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                       3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                       2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i pack_idx = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+  for (int h = 0; h < MATCH_LANES; h += 4) {
+    __m256i acc = _mm256_setzero_si256();
+    for (int k = 0; k < 4; k++) {
+      const __m256i x = _mm256_xor_si256(
+          _mm256_set1_epi64x(a[k]),
+          _mm256_loadu_si256((const __m256i*)(block + k * MATCH_LANES + h)));
+      const __m256i lo = _mm256_and_si256(x, low_mask);
+      const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+      acc = _mm256_add_epi8(acc, _mm256_shuffle_epi8(lut, lo));
+      acc = _mm256_add_epi8(acc, _mm256_shuffle_epi8(lut, hi));
+    }
+    const __m256i sums = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+    _mm_storeu_si128((__m128i*)(dist + h),
+                     _mm256_castsi256_si128(
+                         _mm256_permutevar8x32_epi32(sums, pack_idx)));
+  }
+#else
+  for (int l = 0; l < MATCH_LANES; l++) {
+    int32_t d = 0;
+    for (int k = 0; k < 4; k++) {
+      d += __builtin_popcountll(a[k] ^ block[k * MATCH_LANES + l]);
+    }
+    dist[l] = d;
+  }
+#endif
+}
+
+// Updates MATCH_LANES best match candidates with the distances to the
+// matches idx_0 + l * idx_step. Follows the rule of a sequential scan over
+// the matches: the last of several equally good matches wins and the second
+// best distance counts duplicates.
+inline void updateCandidates(int32_t* best, int32_t* best2, int32_t* idx,
+                             const int32_t* dist, int idx_0, int idx_step) {
+#ifdef __AVX2__
+  const __m256i d = _mm256_loadu_si256((const __m256i*)dist);
+  const __m256i b = _mm256_loadu_si256((const __m256i*)best);
+  const __m256i b2 = _mm256_loadu_si256((const __m256i*)best2);
+  const __m256i id = _mm256_loadu_si256((const __m256i*)idx);
+
+  const __m256i new_id = _mm256_add_epi32(
+      _mm256_set1_epi32(idx_0),
+      _mm256_mullo_epi32(_mm256_set1_epi32(idx_step),
+                         _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+  // lanes where the current best stays
+  const __m256i gt = _mm256_cmpgt_epi32(d, b);
+
+  _mm256_storeu_si256((__m256i*)best2,
+                      _mm256_blendv_epi8(b, _mm256_min_epi32(b2, d), gt));
+  _mm256_storeu_si256((__m256i*)idx, _mm256_blendv_epi8(new_id, id, gt));
+  _mm256_storeu_si256((__m256i*)best, _mm256_min_epi32(b, d));
+#else
+  for (int l = 0; l < MATCH_LANES; l++) {
+    const bool le = dist[l] <= best[l];
+    best2[l] = le ? best[l] : std::min(best2[l], dist[l]);
+    idx[l] = le ? idx_0 + l * idx_step : idx[l];
+    best[l] = le ? dist[l] : best[l];
+  }
+#endif
+}
+
+// Merges MATCH_LANES candidates that have seen interleaved subsequences of
+// the matches.
+inline void mergeCandidates(const int32_t* best, const int32_t* best2,
+                            const int32_t* idx, int& best_idx, int& best_dist,
+                            int& best2_dist) {
+  int best_lane = 0;
+  for (int l = 1; l < MATCH_LANES; l++) {
+    if (best[l] < best[best_lane] ||
+        (best[l] == best[best_lane] && idx[l] > idx[best_lane])) {
+      best_lane = l;
+    }
+  }
+
+  best_idx = idx[best_lane];
+  best_dist = best[best_lane];
+  best2_dist = best2[best_lane];
+  for (int l = 0; l < MATCH_LANES; l++) {
+    if (l != best_lane) best2_dist = std::min(best2_dist, best[l]);
+  }
+}
+
+// Multi-index hashing splits the descriptors into MIH_NUM_SUBSTRINGS
+// disjoint substrings of MIH_SUBSTRING_BITS bits taken along the HashBow bit
+// permutation. Descriptors are match candidates if at least one substring is
+// identical. By the pigeonhole principle this finds all pairs with a
+// distance up to MIH_NUM_SUBSTRINGS - 1 and most of the typical matches up
+// to mapper_max_hamming_distance.
+const int MIH_NUM_SUBSTRINGS = 21;
+const int MIH_SUBSTRING_BITS = 12;
+
+typedef std::array<uint16_t, MIH_NUM_SUBSTRINGS> SubstringKeys;
+
+inline SubstringKeys substringKeys(const uint64_t* w) {
+  static constexpr std::array<size_t, 256> bits =
+      HashBow<256>::descriptor_bit_permutation();
+
+  SubstringKeys res;
+  for (int t = 0; t < MIH_NUM_SUBSTRINGS; t++) {
+    uint16_t key = 0;
+    for (int b = 0; b < MIH_SUBSTRING_BITS; b++) {
+      const size_t bit = bits[t * MIH_SUBSTRING_BITS + b];
+      key |= ((w[bit / 64] >> (bit % 64)) & 1) << b;
+    }
+    res[t] = key;
+  }
+  return res;
+}
+
+// Descriptors indexed by the value of one substring. The ids with substring
+// value k are ids[offsets[k]] to ids[offsets[k + 1] - 1].
+struct SubstringTable {
+  void build(const std::vector<SubstringKeys>& keys, int t) {
+    offsets.assign((1 << MIH_SUBSTRING_BITS) + 1, 0);
+    for (const SubstringKeys& k : keys) offsets[k[t] + 1]++;
+    for (int k = 0; k < (1 << MIH_SUBSTRING_BITS); k++) {
+      offsets[k + 1] += offsets[k];
+    }
+
+    ids.resize(keys.size());
+    std::vector<uint32_t> pos(offsets.begin(), offsets.end() - 1);
+    for (size_t j = 0; j < keys.size(); j++) {
+      ids[pos[keys[j][t]]++] = j;
+    }
+  }
+
+  std::vector<uint32_t> offsets;
+  std::vector<int32_t> ids;
+};
+
+// Same matching rule as the brute force matcher, but only the candidates
+// found in the substring tables are compared.
+void matchDescriptorsMultiIndex(
+    const std::vector<std::bitset<256>>& corner_descriptors_1,
+    const std::vector<std::bitset<256>>& corner_descriptors_2,
+    std::vector<std::pair<int, int>>& matches, int threshold,
+    double dist_2_best) {
+  matches.clear();
+
+  const int num_1 = corner_descriptors_1.size();
+  const int num_2 = corner_descriptors_2.size();
+
+  std::vector<uint64_t> words_1(4 * num_1), words_2(4 * num_2);
+  for (int i = 0; i < num_1; i++) {
+    descriptorWords(corner_descriptors_1[i], &words_1[4 * i]);
+  }
+
+  std::vector<SubstringKeys> keys_2(num_2);
+  for (int j = 0; j < num_2; j++) {
+    descriptorWords(corner_descriptors_2[j], &words_2[4 * j]);
+    keys_2[j] = substringKeys(&words_2[4 * j]);
+  }
+
+  std::array<SubstringTable, MIH_NUM_SUBSTRINGS> tables;
+  for (int t = 0; t < MIH_NUM_SUBSTRINGS; t++) {
+    tables[t].build(keys_2, t);
+  }
+
+  std::vector<int32_t> col_best(num_2, 500), col_best2(num_2, 500),
+      col_idx(num_2, -1);
+  std::vector<int32_t> row_best(num_1, 500), row_best2(num_1, 500),
+      row_idx(num_1, -1);
+
+  // last query that compared a candidate, to skip repeated candidates
+  std::vector<int32_t> last_query(num_2, -1);
+
+  for (int i = 0; i < num_1; i++) {
+    const uint64_t* w = &words_1[4 * i];
+    const SubstringKeys keys = substringKeys(w);
+
+    int32_t& best = row_best[i];
+    int32_t& best2 = row_best2[i];
+    int32_t& best_idx = row_idx[i];
+
+    auto compare = [&](int32_t j) {
+      if (last_query[j] == i) return;
+      last_query[j] = i;
+
+      const uint64_t* w2 = &words_2[4 * j];
+      int32_t d = 0;
+      for (int k = 0; k < 4; k++) d += __builtin_popcountll(w[k] ^ w2[k]);
+
+      // candidates are not visited in order, ties go to the last index
+      if (d < best || (d == best && j > best_idx)) {
+        best2 = best;
+        best = d;
+        best_idx = j;
+      } else if (d < best2) {
+        best2 = d;
+      }
+
+      // queries are visited in order
+      if (d <= col_best[j]) {
+        col_best2[j] = col_best[j];
+        col_best[j] = d;
+        col_idx[j] = i;
+      } else if (d < col_best2[j]) {
+        col_best2[j] = d;
+      }
+    };
+
+    for (int t = 0; t < MIH_NUM_SUBSTRINGS; t++) {
+      const SubstringTable& table = tables[t];
+      for (uint32_t e = table.offsets[keys[t]]; e < table.offsets[keys[t] + 1];
+           e++) {
+        compare(table.ids[e]);
+      }
+    }
+  }
+
+  auto passes = [&](int best_dist, int best2_dist) {
+    return best_dist < threshold && best_dist * dist_2_best <= best2_dist;
+  };
+
+  for (int i = 0; i < num_1; i++) {
+    const int j = row_idx[i];
+    if (j >= 0 && passes(row_best[i], row_best2[i]) && col_idx[j] == i &&
+        passes(col_best[j], col_best2[j])) {
+      matches.emplace_back(i, j);
+    }
+  }
+}
+
+}  // namespace
+
 void detectKeypointsMapping(const basalt::Image<const uint16_t>& img_raw,
                             KeypointsData& kd, int num_features) {
   cv::Mat image(img_raw.h, img_raw.w, CV_8U);
@@ -158,10 +755,14 @@ void detectKeypointsMapping(const basalt::Image<const uint16_t>& img_raw,
   }
 }
 
-void detectKeypoints(
-    const basalt::Image<const uint16_t>& img_raw, KeypointsData& kd,
-    int PATCH_SIZE, int num_points_cell,
-    const Eigen::aligned_vector<Eigen::Vector2d>& current_points) {
+namespace {
+
+template <typename T>
+void detectKeypointsImpl(
+    const basalt::Image<const T>& img_raw, KeypointsData& kd, int PATCH_SIZE,
+    int num_points_cell,
+    const Eigen::aligned_vector<Eigen::Vector2d>& current_points,
+    KeypointDetectorType detector_type) {
   kd.corners.clear();
   kd.corner_angles.clear();
   kd.corner_descriptors.clear();
@@ -188,20 +789,34 @@ void detectKeypoints(
     }
   }
 
+  if (detector_type == KeypointDetectorType::GRID_FAST) {
+    detectKeypointsGrid(img_raw, kd, PATCH_SIZE, num_points_cell, cells,
+                        x_start, x_stop, y_start, y_stop);
+    return;
+  }
+
   for (size_t x = x_start; x <= x_stop; x += PATCH_SIZE) {
     for (size_t y = y_start; y <= y_stop; y += PATCH_SIZE) {
       if (cells((y - y_start) / PATCH_SIZE, (x - x_start) / PATCH_SIZE) > 0)
         continue;
 
-      const basalt::Image<const uint16_t> sub_img_raw =
+      const basalt::Image<const T> sub_img_raw =
           img_raw.SubImage(x, y, PATCH_SIZE, PATCH_SIZE);
 
-      cv::Mat subImg(PATCH_SIZE, PATCH_SIZE, CV_8U);
+      cv::Mat subImg;
 
-      for (int y = 0; y < PATCH_SIZE; y++) {
-        uchar* sub_ptr = subImg.ptr(y);
-        for (int x = 0; x < PATCH_SIZE; x++) {
-          sub_ptr[x] = (sub_img_raw(x, y) >> 8);
+      if constexpr (sizeof(T) == 1) {
+        // 8 bit images are used by OpenCV in place
+        subImg = cv::Mat(PATCH_SIZE, PATCH_SIZE, CV_8U,
+                         const_cast<T*>(sub_img_raw.ptr), sub_img_raw.pitch);
+      } else {
+        subImg.create(PATCH_SIZE, PATCH_SIZE, CV_8U);
+
+        for (int y = 0; y < PATCH_SIZE; y++) {
+          uchar* sub_ptr = subImg.ptr(y);
+          for (int x = 0; x < PATCH_SIZE; x++) {
+            sub_ptr[x] = (sub_img_raw(x, y) >> 8);
+          }
         }
       }
 
@@ -249,112 +864,196 @@ void detectKeypoints(
   //  }
 }
 
+}  // namespace
+
+void detectKeypoints(
+    const basalt::Image<const uint16_t>& img_raw, KeypointsData& kd,
+    int PATCH_SIZE, int num_points_cell,
+    const Eigen::aligned_vector<Eigen::Vector2d>& current_points,
+    KeypointDetectorType detector_type) {
+  detectKeypointsImpl(img_raw, kd, PATCH_SIZE, num_points_cell, current_points,
+                      detector_type);
+}
+
+void detectKeypoints(
+    const basalt::Image<const uint8_t>& img_raw, KeypointsData& kd,
+    int PATCH_SIZE, int num_points_cell,
+    const Eigen::aligned_vector<Eigen::Vector2d>& current_points,
+    KeypointDetectorType detector_type) {
+  detectKeypointsImpl(img_raw, kd, PATCH_SIZE, num_points_cell, current_points,
+                      detector_type);
+}
+
 void computeAngles(const basalt::Image<const uint16_t>& img_raw,
                    KeypointsData& kd, bool rotate_features) {
   kd.corner_angles.resize(kd.corners.size());
 
-  for (size_t i = 0; i < kd.corners.size(); i++) {
-    const Eigen::Vector2d& p = kd.corners[i];
-
-    const int cx = p[0];
-    const int cy = p[1];
-
-    double angle = 0;
+  if (!rotate_features) {
+    std::fill(kd.corner_angles.begin(), kd.corner_angles.end(), 0);
+    return;
+  }
 
-    if (rotate_features) {
-      double m01 = 0, m10 = 0;
-      for (int x = -HALF_PATCH_SIZE; x <= HALF_PATCH_SIZE; x++) {
-        for (int y = -HALF_PATCH_SIZE; y <= HALF_PATCH_SIZE; y++) {
-          if (x * x + y * y <= HALF_PATCH_SIZE * HALF_PATCH_SIZE) {
-            double val = img_raw(cx + x, cy + y);
-            m01 += y * val;
-            m10 += x * val;
+  const std::array<int, 2 * HALF_PATCH_SIZE + 1>& half_widths =
+      momentHalfWidths();
+
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, kd.corners.size()),
+      [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+          const Eigen::Vector2d& p = kd.corners[i];
+
+          const int cx = p[0];
+          const int cy = p[1];
+
+          // Intensity centroid over the disk. Sums over contiguous row
+          // segments are exact in integer arithmetic and vectorize.
+          int64_t m01 = 0, m10 = 0;
+          for (int y = -HALF_PATCH_SIZE; y <= HALF_PATCH_SIZE; y++) {
+            const int hw = half_widths[y + HALF_PATCH_SIZE];
+            const uint16_t* row = img_raw.RowPtr(cy + y) + cx;
+
+            int32_t sum = 0, sum_x = 0;
+            for (int x = -hw; x <= hw; x++) {
+              sum += row[x];
+              sum_x += x * int32_t(row[x]);
+            }
+
+            m01 += y * int64_t(sum);
+            m10 += sum_x;
           }
-        }
-      }
 
-      angle = atan2(m01, m10);
-    }
-
-    kd.corner_angles[i] = angle;
-  }
+          kd.corner_angles[i] = atan2(double(m01), double(m10));
+        }
+      });
 }
 
 void computeDescriptors(const basalt::Image<const uint16_t>& img_raw,
                         KeypointsData& kd) {
   kd.corner_descriptors.resize(kd.corners.size());
 
-  for (size_t i = 0; i < kd.corners.size(); i++) {
-    std::bitset<256> descriptor;
+  const std::vector<RotatedPattern>& patterns = rotatedPatterns();
+  const std::ptrdiff_t stride = img_raw.pitch / sizeof(uint16_t);
+
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, kd.corners.size()),
+      [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+          const Eigen::Vector2d& p = kd.corners[i];
+
+          const int cx = p[0];
+          const int cy = p[1];
+
+          const RotatedPattern& pattern =
+              patterns[patternAngleBin(kd.corner_angles[i])];
+          const uint16_t* center = img_raw.RowPtr(cy) + cx;
+
+          std::bitset<256> descriptor;
+          for (int k = 0; k < 4; k++) {
+            uint64_t word = 0;
+            for (int j = 0; j < 64; j++) {
+              const int b = 64 * k + j;
+              const std::ptrdiff_t ia = pattern.ya[b] * stride + pattern.xa[b];
+              const std::ptrdiff_t ib = pattern.yb[b] * stride + pattern.xb[b];
+              word |= uint64_t(center[ia] < center[ib]) << j;
+            }
+            descriptor |= std::bitset<256>(word) << (64 * k);
+          }
 
-    const Eigen::Vector2d& p = kd.corners[i];
-    double angle = kd.corner_angles[i];
+          kd.corner_descriptors[i] = descriptor;
+        }
+      });
+}
+
+void matchDescriptors(const std::vector<std::bitset<256>>& corner_descriptors_1,
+                      const std::vector<std::bitset<256>>& corner_descriptors_2,
+                      std::vector<std::pair<int, int>>& matches, int threshold,
+                      double dist_2_best, DescriptorMatcherType matcher_type) {
+  if (matcher_type == DescriptorMatcherType::MULTI_INDEX_HASHING) {
+    matchDescriptorsMultiIndex(corner_descriptors_1, corner_descriptors_2,
+                               matches, threshold, dist_2_best);
+    return;
+  }
 
-    int cx = p[0];
-    int cy = p[1];
+  matches.clear();
 
-    Eigen::Rotation2Dd rot(angle);
-    Eigen::Matrix2d mat_rot = rot.matrix();
+  const int num_1 = corner_descriptors_1.size();
+  const int num_2 = corner_descriptors_2.size();
+  const int num_blocks_2 = (num_2 + MATCH_LANES - 1) / MATCH_LANES;
 
-    for (int i = 0; i < 256; i++) {
-      Eigen::Vector2d va(pattern_31_x_a[i], pattern_31_y_a[i]),
-          vb(pattern_31_x_b[i], pattern_31_y_b[i]);
+  std::vector<uint64_t> words_1(4 * num_1);
+  for (int i = 0; i < num_1; i++) {
+    descriptorWords(corner_descriptors_1[i], &words_1[4 * i]);
+  }
 
-      Eigen::Vector2i vva = (mat_rot * va).array().round().cast<int>();
-      Eigen::Vector2i vvb = (mat_rot * vb).array().round().cast<int>();
+  // Blocks of MATCH_LANES descriptors with the words interleaved, the
+  // padding descriptors are never reported as matches.
+  std::vector<uint64_t> words_2(4 * MATCH_LANES * num_blocks_2, 0);
+  for (int j = 0; j < num_2; j++) {
+    uint64_t w[4];
+    descriptorWords(corner_descriptors_2[j], w);
 
-      descriptor[i] =
-          img_raw(cx + vva[0], cy + vva[1]) < img_raw(cx + vvb[0], cy + vvb[1]);
+    uint64_t* block = &words_2[4 * MATCH_LANES * (j / MATCH_LANES)];
+    for (int k = 0; k < 4; k++) {
+      block[k * MATCH_LANES + j % MATCH_LANES] = w[k];
     }
-
-    kd.corner_descriptors[i] = descriptor;
   }
-}
 
-void matchFastHelper(const std::vector<std::bitset<256>>& corner_descriptors_1,
-                     const std::vector<std::bitset<256>>& corner_descriptors_2,
-                     std::unordered_map<int, int>& matches, int threshold,
-                     double test_dist) {
-  matches.clear();
+  // Best and second best distances of every descriptor in both directions.
+  // Rows keep one candidate per lane that are merged at the end.
+  std::vector<int32_t> row_best(num_1 * MATCH_LANES, 500),
+      row_best2(num_1 * MATCH_LANES, 500), row_idx(num_1 * MATCH_LANES, -1);
+  std::vector<int32_t> col_best(num_blocks_2 * MATCH_LANES, 500),
+      col_best2(num_blocks_2 * MATCH_LANES, 500),
+      col_idx(num_blocks_2 * MATCH_LANES, -1);
 
-  for (size_t i = 0; i < corner_descriptors_1.size(); i++) {
-    int best_idx = -1, best_dist = 500;
-    int best2_dist = 500;
+  for (int tile = 0; tile < num_blocks_2; tile += MATCH_TILE_BLOCKS) {
+    const int tile_end = std::min(tile + MATCH_TILE_BLOCKS, num_blocks_2);
 
-    for (size_t j = 0; j < corner_descriptors_2.size(); j++) {
-      int dist = (corner_descriptors_1[i] ^ corner_descriptors_2[j]).count();
+    for (int i = 0; i < num_1; i++) {
+      const uint64_t* w = &words_1[4 * i];
 
-      if (dist <= best_dist) {
-        best2_dist = best_dist;
+      int32_t best[MATCH_LANES], best2[MATCH_LANES], idx[MATCH_LANES];
+      std::copy_n(&row_best[i * MATCH_LANES], MATCH_LANES, best);
+      std::copy_n(&row_best2[i * MATCH_LANES], MATCH_LANES, best2);
+      std::copy_n(&row_idx[i * MATCH_LANES], MATCH_LANES, idx);
 
-        best_dist = dist;
-        best_idx = j;
-      } else if (dist < best2_dist) {
-        best2_dist = dist;
+      for (int b = tile; b < tile_end; b++) {
+        int32_t dist[MATCH_LANES];
+        hammingDistances(w, &words_2[4 * MATCH_LANES * b], dist);
+
+        if (b == num_blocks_2 - 1) {
+          for (int l = num_2 - b * MATCH_LANES; l < MATCH_LANES; l++) {
+            dist[l] = MATCH_INVALID_DIST;
+          }
+        }
+
+        const int j = b * MATCH_LANES;
+        updateCandidates(best, best2, idx, dist, j, 1);
+        updateCandidates(&col_best[j], &col_best2[j], &col_idx[j], dist, i,
+                         0);
       }
-    }
 
-    if (best_dist < threshold && best_dist * test_dist <= best2_dist) {
-      matches.emplace(i, best_idx);
+      std::copy_n(best, MATCH_LANES, &row_best[i * MATCH_LANES]);
+      std::copy_n(best2, MATCH_LANES, &row_best2[i * MATCH_LANES]);
+      std::copy_n(idx, MATCH_LANES, &row_idx[i * MATCH_LANES]);
     }
   }
-}
-
-void matchDescriptors(const std::vector<std::bitset<256>>& corner_descriptors_1,
-                      const std::vector<std::bitset<256>>& corner_descriptors_2,
-                      std::vector<std::pair<int, int>>& matches, int threshold,
-                      double dist_2_best) {
-  matches.clear();
-
-  std::unordered_map<int, int> matches_1_2, matches_2_1;
-  matchFastHelper(corner_descriptors_1, corner_descriptors_2, matches_1_2,
-                  threshold, dist_2_best);
-  matchFastHelper(corner_descriptors_2, corner_descriptors_1, matches_2_1,
-                  threshold, dist_2_best);
 
-  for (const auto& kv : matches_1_2) {
-    if (matches_2_1[kv.second] == kv.first) {
-      matches.emplace_back(kv.first, kv.second);
+  auto passes = [&](int best_dist, int best2_dist) {
+    return best_dist < threshold && best_dist * dist_2_best <= best2_dist;
+  };
+
+  for (int i = 0; i < num_1; i++) {
+    int best_idx, best_dist, best2_dist;
+    mergeCandidates(&row_best[i * MATCH_LANES], &row_best2[i * MATCH_LANES],
+                    &row_idx[i * MATCH_LANES], best_idx, best_dist,
+                    best2_dist);
+    if (!passes(best_dist, best2_dist)) continue;
+
+    // cross check with the best match of the other direction
+    const int j = best_idx;
+    if (col_idx[j] == i && passes(col_best[j], col_best2[j])) {
+      matches.emplace_back(i, j);
     }
   }
 }
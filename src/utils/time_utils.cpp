@@ -1,6 +1,8 @@
 #include <basalt/utils/assert.h>
 #include <basalt/utils/time_utils.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 
@@ -209,4 +211,91 @@ bool ExecutionStats::save_json(const std::string& path) const {
   return true;
 }
 
+const char* FrameLatencyRecorder::stage_name(Stage stage) {
+  switch (stage) {
+    case INPUT:
+      return "input";
+    case OPTICAL_FLOW:
+      return "optical_flow";
+    case ESTIMATOR:
+      return "estimator";
+    case STATE_OUTPUT:
+      return "state_output";
+    default:
+      return "unknown";
+  }
+}
+
+void FrameLatencyRecorder::record(int64_t frame_t_ns, Stage stage,
+                                  Clock::time_point time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& stamp = stamps_[frame_t_ns][stage];
+  if (!stamp) stamp = time;
+}
+
+FrameLatencyRecorder::Summary FrameLatencyRecorder::summarize() const {
+  std::array<std::vector<double>, NUM_STAGES> latencies;
+
+  Summary res;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const auto& kv : stamps_) {
+      const auto& stamps = kv.second;
+
+      if (stamps[OPTICAL_FLOW] && !stamps[ESTIMATOR]) res.num_dropped_frames++;
+
+      if (!stamps[INPUT]) continue;
+      res.num_input_frames++;
+
+      for (int i = 0; i < NUM_STAGES; i++) {
+        if (stamps[i]) {
+          latencies[i].push_back(
+              std::chrono::duration<double>(*stamps[i] - *stamps[INPUT])
+                  .count());
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < NUM_STAGES; i++) {
+    std::vector<double>& vec = latencies[i];
+    StageSummary& s = res.stages[i];
+
+    s.num_frames = vec.size();
+    if (vec.empty()) continue;
+
+    std::sort(vec.begin(), vec.end());
+
+    // nearest-rank percentile
+    auto percentile = [&](double p) {
+      size_t rank = std::ceil(p * vec.size());
+      return vec[std::clamp<size_t>(rank, 1, vec.size()) - 1];
+    };
+
+    s.p50 = percentile(0.5);
+    s.p95 = percentile(0.95);
+    s.p99 = percentile(0.99);
+    s.max = vec.back();
+  }
+
+  return res;
+}
+
+void FrameLatencyRecorder::print() const {
+  const Summary summary = summarize();
+
+  std::cout << "Latency after input in ms ({} frames, {} dropped):\n"_format(
+      summary.num_input_frames, summary.num_dropped_frames);
+
+  for (int i = OPTICAL_FLOW; i < NUM_STAGES; i++) {
+    const StageSummary& s = summary.stages[i];
+    std::cout << "{:20} ({:>4}): p50 {:8.2f} p95 {:8.2f} p99 {:8.2f} max "
+                 "{:8.2f}\n"_format(stage_name(Stage(i)), s.num_frames,
+                                    s.p50 * 1e3, s.p95 * 1e3, s.p99 * 1e3,
+                                    s.max * 1e3);
+  }
+}
+
 }  // namespace basalt
@@ -0,0 +1,155 @@
+/**
+BSD 3-Clause License
+
+This file is part of the Basalt project.
+https://gitlab.com/VladyslavUsenko/basalt.git
+
+Copyright (c) 2019, Vladyslav Usenko and Nikolaus Demmel.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <basalt/utils/tracing.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace basalt {
+namespace tracing {
+
+namespace {
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers;
+};
+
+Registry& registry() {
+  // Leaked on purpose: threads may still record events during static
+  // destruction.
+  static Registry* r = new Registry;
+  return *r;
+}
+
+void write_escaped(std::ostream& os, const std::string& s) {
+  for (char c : s) {
+    if (c == '"' || c == '\\') os << '\\';
+    os << c;
+  }
+}
+
+}  // namespace
+
+ThreadTraceBuffer* register_thread() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.buffers.emplace_back(new ThreadTraceBuffer(r.buffers.size()));
+  return r.buffers.back().get();
+}
+
+void set_thread_name(const std::string& name) {
+  ThreadTraceBuffer& buffer = thread_buffer();
+
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  buffer.name = name;
+}
+
+bool save_chrome_trace(const std::string& path) {
+  std::ofstream os(path);
+
+  if (!os.is_open()) {
+    std::cerr << "Could not save trace to " << path << std::endl;
+    return false;
+  }
+
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  int64_t min_start_ns = std::numeric_limits<int64_t>::max();
+  for (const auto& b : r.buffers) {
+    const uint64_t n = b->num_events.load(std::memory_order_acquire);
+    const uint64_t first = n > b->CAPACITY ? n - b->CAPACITY : 0;
+    for (uint64_t i = first; i < n; i++) {
+      const TraceEvent& e = b->events[i % b->CAPACITY];
+      min_start_ns = std::min(min_start_ns, e.start_ns);
+    }
+  }
+
+  os << std::fixed << std::setprecision(3);
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  bool first_event = true;
+  auto separator = [&]() -> std::ostream& {
+    if (!first_event) os << ",\n";
+    first_event = false;
+    return os;
+  };
+
+  for (const auto& b : r.buffers) {
+    separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+                << b->tid << ",\"args\":{\"name\":\"";
+    if (b->name.empty()) {
+      os << "thread " << b->tid;
+    } else {
+      write_escaped(os, b->name);
+    }
+    os << "\"}}";
+
+    const uint64_t n = b->num_events.load(std::memory_order_acquire);
+    const uint64_t first = n > b->CAPACITY ? n - b->CAPACITY : 0;
+
+    if (first > 0) {
+      std::cerr << "Trace buffer of thread " << b->tid << " overflowed, "
+                << first << " events dropped." << std::endl;
+    }
+
+    for (uint64_t i = first; i < n; i++) {
+      const TraceEvent& e = b->events[i % b->CAPACITY];
+
+      // timestamps in microseconds
+      separator() << "{\"name\":\"";
+      write_escaped(os, e.name);
+      os << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << b->tid
+         << ",\"ts\":" << (e.start_ns - min_start_ns) * 1e-3
+         << ",\"dur\":" << e.duration_ns * 1e-3 << "}";
+    }
+  }
+
+  os << "]}\n";
+
+  std::cout << "Saved trace to " << path << std::endl;
+
+  return os.good();
+}
+
+}  // namespace tracing
+}  // namespace basalt
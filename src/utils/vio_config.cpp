@@ -51,9 +51,14 @@ VioConfig::VioConfig() {
   optical_flow_max_recovered_dist2 = 0.09f;
   optical_flow_pattern = 51;
   optical_flow_max_iterations = 5;
+  optical_flow_convergence_threshold = 0.01f;
   optical_flow_levels = 3;
   optical_flow_epipolar_error = 0.005;
   optical_flow_skip_frames = 1;
+  optical_flow_pyramid_type = PyramidType::GAUSSIAN5;
+  optical_flow_detector_type = KeypointDetectorType::GRID_FAST;
+  optical_flow_use_gyro = false;
+  optical_flow_native_8bit = false;
 
   vio_linearization_type = LinearizationType::ABS_QR;
   vio_sqrt_marg = true;
@@ -71,6 +76,7 @@ VioConfig::VioConfig() {
   //  vio_outlier_threshold = 3.0;
   //  vio_filter_iteration = 4;
   vio_max_iterations = 7;
+  vio_block_sparse_min_size = 100;
 
   vio_enforce_realtime = false;
 
@@ -99,6 +105,8 @@ VioConfig::VioConfig() {
   mapper_min_track_length = 5;
   mapper_max_hamming_distance = 70;
   mapper_second_best_test_ratio = 1.2;
+  mapper_match_stereo_type = DescriptorMatcherType::BRUTE_FORCE;
+  mapper_match_all_type = DescriptorMatcherType::BRUTE_FORCE;
   mapper_bow_num_bits = 16;
   mapper_min_triangulation_dist = 0.07;
   mapper_no_factor_weights = false;
@@ -157,6 +165,80 @@ void load_minimal(const Archive& ar,
   }
 }
 
+template <class Archive>
+std::string save_minimal(const Archive& ar,
+                         const basalt::PyramidType& pyramid_type) {
+  UNUSED(ar);
+  auto name = magic_enum::enum_name(pyramid_type);
+  return std::string(name);
+}
+
+template <class Archive>
+void load_minimal(const Archive& ar, basalt::PyramidType& pyramid_type,
+                  const std::string& name) {
+  UNUSED(ar);
+
+  auto pyr_enum = magic_enum::enum_cast<basalt::PyramidType>(name);
+
+  if (pyr_enum.has_value()) {
+    pyramid_type = pyr_enum.value();
+  } else {
+    std::cerr << "Could not find the PyramidType for " << name << std::endl;
+    std::abort();
+  }
+}
+
+template <class Archive>
+std::string save_minimal(const Archive& ar,
+                         const basalt::KeypointDetectorType& detector_type) {
+  UNUSED(ar);
+  auto name = magic_enum::enum_name(detector_type);
+  return std::string(name);
+}
+
+template <class Archive>
+void load_minimal(const Archive& ar,
+                  basalt::KeypointDetectorType& detector_type,
+                  const std::string& name) {
+  UNUSED(ar);
+
+  auto det_enum = magic_enum::enum_cast<basalt::KeypointDetectorType>(name);
+
+  if (det_enum.has_value()) {
+    detector_type = det_enum.value();
+  } else {
+    std::cerr << "Could not find the KeypointDetectorType for " << name
+              << std::endl;
+    std::abort();
+  }
+}
+
+template <class Archive>
+std::string save_minimal(const Archive& ar,
+                         const basalt::DescriptorMatcherType& matcher_type) {
+  UNUSED(ar);
+  auto name = magic_enum::enum_name(matcher_type);
+  return std::string(name);
+}
+
+template <class Archive>
+void load_minimal(const Archive& ar,
+                  basalt::DescriptorMatcherType& matcher_type,
+                  const std::string& name) {
+  UNUSED(ar);
+
+  auto matcher_enum =
+      magic_enum::enum_cast<basalt::DescriptorMatcherType>(name);
+
+  if (matcher_enum.has_value()) {
+    matcher_type = matcher_enum.value();
+  } else {
+    std::cerr << "Could not find the DescriptorMatcherType for " << name
+              << std::endl;
+    std::abort();
+  }
+}
+
 template <class Archive>
 void serialize(Archive& ar, basalt::VioConfig& config) {
   ar(CEREAL_NVP(config.optical_flow_type));
@@ -164,9 +246,14 @@ void serialize(Archive& ar, basalt::VioConfig& config) {
   ar(CEREAL_NVP(config.optical_flow_max_recovered_dist2));
   ar(CEREAL_NVP(config.optical_flow_pattern));
   ar(CEREAL_NVP(config.optical_flow_max_iterations));
+  ar(CEREAL_NVP(config.optical_flow_convergence_threshold));
   ar(CEREAL_NVP(config.optical_flow_epipolar_error));
   ar(CEREAL_NVP(config.optical_flow_levels));
   ar(CEREAL_NVP(config.optical_flow_skip_frames));
+  ar(CEREAL_NVP(config.optical_flow_pyramid_type));
+  ar(CEREAL_NVP(config.optical_flow_detector_type));
+  ar(CEREAL_NVP(config.optical_flow_use_gyro));
+  ar(CEREAL_NVP(config.optical_flow_native_8bit));
 
   ar(CEREAL_NVP(config.vio_linearization_type));
   ar(CEREAL_NVP(config.vio_sqrt_marg));
@@ -177,6 +264,7 @@ void serialize(Archive& ar, basalt::VioConfig& config) {
   ar(CEREAL_NVP(config.vio_debug));
   ar(CEREAL_NVP(config.vio_extended_logging));
   ar(CEREAL_NVP(config.vio_max_iterations));
+  ar(CEREAL_NVP(config.vio_block_sparse_min_size));
   //  ar(CEREAL_NVP(config.vio_outlier_threshold));
   //  ar(CEREAL_NVP(config.vio_filter_iteration));
 
@@ -210,6 +298,8 @@ void serialize(Archive& ar, basalt::VioConfig& config) {
   ar(CEREAL_NVP(config.mapper_min_track_length));
   ar(CEREAL_NVP(config.mapper_max_hamming_distance));
   ar(CEREAL_NVP(config.mapper_second_best_test_ratio));
+  ar(CEREAL_NVP(config.mapper_match_stereo_type));
+  ar(CEREAL_NVP(config.mapper_match_all_type));
   ar(CEREAL_NVP(config.mapper_bow_num_bits));
   ar(CEREAL_NVP(config.mapper_min_triangulation_dist));
   ar(CEREAL_NVP(config.mapper_no_factor_weights));
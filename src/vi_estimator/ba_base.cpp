@@ -40,6 +40,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <tbb/parallel_reduce.h>
 
 #include <basalt/utils/ba_utils.h>
+#include <basalt/utils/camera_batch.h>
 
 namespace basalt {
 
@@ -383,23 +384,30 @@ void BundleAdjustmentBase<Scalar_>::computeProjections(
         T_t_h.setIdentity();
       }
 
-      std::visit(
-          [&](const auto& cam) {
-            for (KeypointId kpt_id : obs_kv.second) {
-              const Keypoint<Scalar>& kpt_pos = lmdb.getLandmark(kpt_id);
+      typename CameraBatch<Scalar>::Points3d p_t_3d(obs_kv.second.size(), 4);
+      size_t i = 0;
+      for (KeypointId kpt_id : obs_kv.second) {
+        const Keypoint<Scalar>& kpt_pos = lmdb.getLandmark(kpt_id);
 
-              Vec2 res;
-              Vec4 proj;
+        Vec4 p_h_3d = StereographicParam<Scalar>::unproject(kpt_pos.direction);
+        p_h_3d[3] = kpt_pos.inv_dist;
 
-              using CamT = std::decay_t<decltype(cam)>;
-              linearizePoint<Scalar, CamT>(Vec2::Zero(), kpt_pos, T_t_h, cam,
-                                           res, nullptr, nullptr, &proj);
+        p_t_3d.row(i++) = (T_t_h * p_h_3d).transpose();
+      }
 
-              proj[3] = kpt_id;
-              data[tcid_t.cam_id].emplace_back(proj.template cast<Scalar2>());
-            }
-          },
-          calib.intrinsics[tcid_t.cam_id].variant);
+      typename CameraBatch<Scalar>::Points2d res;
+      typename CameraBatch<Scalar>::Mask valid;
+      projectBatch(calib.intrinsics[tcid_t.cam_id], p_t_3d, res, valid);
+
+      i = 0;
+      for (KeypointId kpt_id : obs_kv.second) {
+        Vec4 proj;
+        proj.template head<2>() = res.row(i).transpose();
+        proj[2] = p_t_3d(i, 3) / p_t_3d.row(i).template head<3>().norm();
+        proj[3] = kpt_id;
+        data[tcid_t.cam_id].emplace_back(proj.template cast<Scalar2>());
+        i++;
+      }
     }
   }
 }
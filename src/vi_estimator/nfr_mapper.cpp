@@ -472,10 +472,12 @@ void NfrMapper::detect_keypoints() {
               TimeCamId tcid(kv->first, i);
               KeypointsData& kd = feature_corners[tcid];
 
-              if (!kv->second->img_data[i].img.get()) continue;
+              if (kv->second->img_data[i].empty()) continue;
 
+              const auto img_ptr =
+                  kv->second->img_data[i].getImage<uint16_t>();
               const Image<const uint16_t> img =
-                  kv->second->img_data[i].img->Reinterpret<const uint16_t>();
+                  img_ptr->Reinterpret<const uint16_t>();
 
               detectKeypointsMapping(img, kd,
                                      config.mapper_detection_num_points);
@@ -535,7 +537,8 @@ void NfrMapper::match_stereo() {
 
     matchDescriptors(kd1.corner_descriptors, kd2.corner_descriptors, md.matches,
                      config.mapper_max_hamming_distance,
-                     config.mapper_second_best_test_ratio);
+                     config.mapper_second_best_test_ratio,
+                     config.mapper_match_stereo_type);
 
     num_matches += md.matches.size();
 
@@ -625,7 +628,7 @@ void NfrMapper::match_all() {
       MatchData md;
 
       matchDescriptors(f1.corner_descriptors, f2.corner_descriptors, md.matches,
-                       70, 1.2);
+                       70, 1.2, config.mapper_match_all_type);
 
       if (int(md.matches.size()) > config.mapper_min_matches) {
         matched++;
@@ -42,6 +42,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <basalt/vi_estimator/sc_ba_base.h>
 #include <basalt/utils/cast_utils.hpp>
 #include <basalt/utils/time_utils.hpp>
+#include <basalt/utils/tracing.h>
 
 #include <basalt/linearization/linearization_base.hpp>
 
@@ -51,6 +52,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
 
+#include <algorithm>
 #include <chrono>
 
 namespace basalt {
@@ -152,6 +154,8 @@ template <class Scalar_>
 void SqrtKeypointVioEstimator<Scalar_>::initialize(const Eigen::Vector3d& bg_,
                                                    const Eigen::Vector3d& ba_) {
   auto proc_func = [&, bg = bg_.cast<Scalar>(), ba = ba_.cast<Scalar>()] {
+    BASALT_TRACE_THREAD_NAME("estimator");
+
     OpticalFlowResult::Ptr prev_frame, curr_frame;
     typename IntegratedImuMeasurement<Scalar>::Ptr meas;
 
@@ -166,7 +170,10 @@ void SqrtKeypointVioEstimator<Scalar_>::initialize(const Eigen::Vector3d& bg_,
     data->gyro = calib.calib_gyro_bias.getCalibrated(data->gyro);
 
     while (true) {
-      vision_data_queue.pop(curr_frame);
+      {
+        BASALT_TRACE_SCOPE("vision_data_queue.pop");
+        vision_data_queue.pop(curr_frame);
+      }
 
       if (config.vio_enforce_realtime) {
         // drop current frame if another frame is already in the queue.
@@ -304,6 +311,8 @@ template <class Scalar_>
 bool SqrtKeypointVioEstimator<Scalar_>::measure(
     const OpticalFlowResult::Ptr& opt_flow_meas,
     const typename IntegratedImuMeasurement<Scalar>::Ptr& meas) {
+  BASALT_TRACE_SCOPE("measure");
+
   stats_sums_.add("frame_id", opt_flow_meas->t_ns).format("none");
   Timer t_total;
 
@@ -338,15 +347,17 @@ bool SqrtKeypointVioEstimator<Scalar_>::measure(
   for (size_t i = 0; i < opt_flow_meas->observations.size(); i++) {
     TimeCamId tcid_target(opt_flow_meas->t_ns, i);
 
-    for (const auto& kv_obs : opt_flow_meas->observations[i]) {
-      int kpt_id = kv_obs.first;
+    const KeypointTracks& tracks = opt_flow_meas->observations[i];
+
+    for (size_t j = 0; j < tracks.size(); j++) {
+      int kpt_id = tracks.id(j);
 
       if (lmdb.landmarkExists(kpt_id)) {
         const TimeCamId& tcid_host = lmdb.getLandmark(kpt_id).host_kf_id;
 
         KeypointObservation<Scalar> kobs;
         kobs.kpt_id = kpt_id;
-        kobs.pos = kv_obs.second.translation().cast<Scalar>();
+        kobs.pos = tracks.translation(j).cast<Scalar>();
 
         lmdb.addObservation(tcid_target, kobs);
         // obs[tcid_host][tcid_target].push_back(kobs);
@@ -391,13 +402,14 @@ bool SqrtKeypointVioEstimator<Scalar_>::measure(
 
       for (const auto& kv : prev_opt_flow_res) {
         for (size_t k = 0; k < kv.second->observations.size(); k++) {
-          auto it = kv.second->observations[k].find(lm_id);
-          if (it != kv.second->observations[k].end()) {
+          const KeypointTracks& tracks = kv.second->observations[k];
+          const size_t idx = tracks.index(lm_id);
+          if (idx != KeypointTracks::INVALID_INDEX) {
             TimeCamId tcido(kv.first, k);
 
             KeypointObservation<Scalar> kobs;
             kobs.kpt_id = lm_id;
-            kobs.pos = it->second.translation().template cast<Scalar>();
+            kobs.pos = tracks.translation(idx).template cast<Scalar>();
 
             // obs[tcidl][tcido].push_back(kobs);
             kp_obs[tcido] = kobs;
@@ -405,6 +417,9 @@ bool SqrtKeypointVioEstimator<Scalar_>::measure(
         }
       }
 
+      // lm_id is observed in the current frame of camera 0
+      const Vec2 p0 = kp_obs.at(tcidl).pos;
+
       // triangulate
       bool valid_kp = false;
       const Scalar min_triang_distance2 =
@@ -414,15 +429,7 @@ bool SqrtKeypointVioEstimator<Scalar_>::measure(
         if (valid_kp) break;
         TimeCamId tcido = kv_obs.first;
 
-        const Vec2 p0 = opt_flow_meas->observations.at(0)
-                            .at(lm_id)
-                            .translation()
-                            .cast<Scalar>();
-        const Vec2 p1 = prev_opt_flow_res[tcido.frame_id]
-                            ->observations[tcido.cam_id]
-                            .at(lm_id)
-                            .translation()
-                            .template cast<Scalar>();
+        const Vec2& p1 = kv_obs.second.pos;
 
         Vec4 p0_3d, p1_3d;
         bool valid1 = calib.intrinsics[0].unproject(p0, p0_3d);
@@ -470,7 +477,7 @@ bool SqrtKeypointVioEstimator<Scalar_>::measure(
     for (const auto& kv : lmdb.getLandmarks()) {
       bool connected = false;
       for (size_t i = 0; i < opt_flow_meas->observations.size(); i++) {
-        if (opt_flow_meas->observations[i].count(kv.first) > 0)
+        if (opt_flow_meas->observations[i].contains(kv.first))
           connected = true;
       }
       if (!connected) {
@@ -487,6 +494,7 @@ bool SqrtKeypointVioEstimator<Scalar_>::measure(
     typename PoseVelBiasState<double>::Ptr data(
         new PoseVelBiasState<double>(p.getState().template cast<double>()));
 
+    BASALT_TRACE_SCOPE("out_state_queue.push");
     out_state_queue->push(data);
   }
 
@@ -516,6 +524,10 @@ bool SqrtKeypointVioEstimator<Scalar_>::measure(
 
   last_processed_t_ns = last_state_t_ns;
 
+  if (latency_recorder) {
+    latency_recorder->record(last_state_t_ns, FrameLatencyRecorder::ESTIMATOR);
+  }
+
   stats_sums_.add("measure", t_total.elapsed()).format("ms");
 
   return true;
@@ -546,10 +558,69 @@ Eigen::VectorXd SqrtKeypointVioEstimator<Scalar_>::checkMargEigenvalues()
   return checkEigenvalues(nullspace_marg_data, false);
 }
 
+template <class Scalar_>
+void SqrtKeypointVioEstimator<Scalar_>::updateAbsOrderMap(
+    AbsOrderMap& aom, int64_t last_state_t_ns) const {
+  // All poses are older than the states, so the order is ascending in time
+  // like the map and can be merged with it in one pass. Entries of frames
+  // that stay are updated in place, since the offsets are prefix sums of the
+  // sizes they shift with every removed frame. Only frames that are new to
+  // the order insert a node.
+  BASALT_ASSERT(frame_poses.empty() || frame_states.empty() ||
+                frame_poses.crbegin()->first < frame_states.cbegin()->first);
+
+  auto& map = aom.abs_order_map;
+  auto it = map.begin();
+
+  aom.total_size = 0;
+  aom.items = 0;
+
+  auto add = [&](int64_t t_ns, int size) {
+    const std::pair<int, int> entry(aom.total_size, size);
+
+    // frames before t_ns left the window
+    while (it != map.end() && it->first < t_ns) it = map.erase(it);
+
+    if (it != map.end() && it->first == t_ns) {
+      it->second = entry;
+      ++it;
+    } else {
+      map.emplace_hint(it, t_ns, entry);
+    }
+
+    aom.total_size += size;
+    aom.items++;
+  };
+
+  for (const auto& kv : frame_poses) {
+    add(kv.first, POSE_SIZE);
+
+    // Check that we have the same order as marginalization
+    BASALT_ASSERT(marg_data.order.abs_order_map.at(kv.first) ==
+                  map.at(kv.first));
+  }
+
+  for (const auto& kv : frame_states) {
+    if (kv.first > last_state_t_ns) break;
+
+    add(kv.first, POSE_VEL_BIAS_SIZE);
+
+    // Check that we have the same order as marginalization
+    if (aom.items <= marg_data.order.abs_order_map.size())
+      BASALT_ASSERT(marg_data.order.abs_order_map.at(kv.first) ==
+                    map.at(kv.first));
+  }
+
+  // frames after the last state left the order
+  map.erase(it, map.end());
+}
+
 template <class Scalar_>
 void SqrtKeypointVioEstimator<Scalar_>::marginalize(
     const std::map<int64_t, int>& num_points_connected,
     const std::unordered_set<KeypointId>& lost_landmaks) {
+  BASALT_TRACE_SCOPE("marginalize");
+
   if (!opt_started) return;
 
   Timer t_total;
@@ -563,46 +634,25 @@ void SqrtKeypointVioEstimator<Scalar_>::marginalize(
     for (int i = 0; i < states_to_remove; i++) it++;
     int64_t last_state_to_marg = it->first;
 
-    AbsOrderMap aom;
+    AbsOrderMap& aom = marg_aom;
+    updateAbsOrderMap(aom, last_state_to_marg);
 
     // remove all frame_poses that are not kfs
     std::set<int64_t> poses_to_marg;
     for (const auto& kv : frame_poses) {
-      aom.abs_order_map[kv.first] = std::make_pair(aom.total_size, POSE_SIZE);
-
       if (kf_ids.count(kv.first) == 0) poses_to_marg.emplace(kv.first);
-
-      // Check that we have the same order as marginalization
-      BASALT_ASSERT(marg_data.order.abs_order_map.at(kv.first) ==
-                    aom.abs_order_map.at(kv.first));
-
-      aom.total_size += POSE_SIZE;
-      aom.items++;
     }
 
     std::set<int64_t> states_to_marg_vel_bias;
     std::set<int64_t> states_to_marg_all;
     for (const auto& kv : frame_states) {
-      if (kv.first > last_state_to_marg) break;
+      if (kv.first >= last_state_to_marg) break;
 
-      if (kv.first != last_state_to_marg) {
-        if (kf_ids.count(kv.first) > 0) {
-          states_to_marg_vel_bias.emplace(kv.first);
-        } else {
-          states_to_marg_all.emplace(kv.first);
-        }
+      if (kf_ids.count(kv.first) > 0) {
+        states_to_marg_vel_bias.emplace(kv.first);
+      } else {
+        states_to_marg_all.emplace(kv.first);
       }
-
-      aom.abs_order_map[kv.first] =
-          std::make_pair(aom.total_size, POSE_VEL_BIAS_SIZE);
-
-      // Check that we have the same order as marginalization
-      if (aom.items < marg_data.order.abs_order_map.size())
-        BASALT_ASSERT(marg_data.order.abs_order_map.at(kv.first) ==
-                      aom.abs_order_map.at(kv.first));
-
-      aom.total_size += POSE_VEL_BIAS_SIZE;
-      aom.items++;
     }
 
     auto kf_ids_all = kf_ids;
@@ -724,17 +774,17 @@ void SqrtKeypointVioEstimator<Scalar_>::marginalize(
         ild.imu_meas[kv.first] = &kv.second;
       }
 
-      auto lqr = LinearizationBase<Scalar, POSE_SIZE>::create(
-          this, aom, lqr_options, &marg_data, &ild, &kfs_to_marg,
+      LinearizationBase<Scalar, POSE_SIZE>::update(
+          marg_lqr, this, aom, lqr_options, &marg_data, &ild, &kfs_to_marg,
           &lost_landmaks, last_state_to_marg);
 
-      lqr->linearizeProblem();
-      lqr->performQR();
+      marg_lqr->linearizeProblem();
+      marg_lqr->performQR();
 
       if (is_lin_sqrt && marg_data.is_sqrt) {
-        lqr->get_dense_Q2Jp_Q2r(Q2Jp_or_H, Q2r_or_b);
+        marg_lqr->get_dense_Q2Jp_Q2r(Q2Jp_or_H, Q2r_or_b);
       } else {
-        lqr->get_dense_H_b(Q2Jp_or_H, Q2r_or_b);
+        marg_lqr->get_dense_H_b(Q2Jp_or_H, Q2r_or_b);
       }
 
       stats_sums_.add("marg_linearize", t_linearize.elapsed()).format("ms");
@@ -775,6 +825,7 @@ void SqrtKeypointVioEstimator<Scalar_>::marginalize(
           m->opt_flow_res.emplace_back(prev_opt_flow_res.at(t));
         }
 
+        BASALT_TRACE_SCOPE("out_marg_queue.push");
         out_marg_queue->push(m);
       }
     }
@@ -1008,6 +1059,8 @@ void SqrtKeypointVioEstimator<Scalar_>::marginalize(
 
 template <class Scalar_>
 void SqrtKeypointVioEstimator<Scalar_>::optimize() {
+  BASALT_TRACE_SCOPE("optimize");
+
   if (config.vio_debug) {
     std::cout << "=================================" << std::endl;
   }
@@ -1026,31 +1079,8 @@ void SqrtKeypointVioEstimator<Scalar_>::optimize() {
 
     // construct order of states in linear system --> sort by ascending
     // timestamp
-    AbsOrderMap aom;
-
-    for (const auto& kv : frame_poses) {
-      aom.abs_order_map[kv.first] = std::make_pair(aom.total_size, POSE_SIZE);
-
-      // Check that we have the same order as marginalization
-      BASALT_ASSERT(marg_data.order.abs_order_map.at(kv.first) ==
-                    aom.abs_order_map.at(kv.first));
-
-      aom.total_size += POSE_SIZE;
-      aom.items++;
-    }
-
-    for (const auto& kv : frame_states) {
-      aom.abs_order_map[kv.first] =
-          std::make_pair(aom.total_size, POSE_VEL_BIAS_SIZE);
-
-      // Check that we have the same order as marginalization
-      if (aom.items < marg_data.order.abs_order_map.size())
-        BASALT_ASSERT(marg_data.order.abs_order_map.at(kv.first) ==
-                      aom.abs_order_map.at(kv.first));
-
-      aom.total_size += POSE_VEL_BIAS_SIZE;
-      aom.items++;
-    }
+    AbsOrderMap& aom = opt_aom;
+    updateAbsOrderMap(aom);
 
     // TODO: Check why we get better accuracy with old SC loop. Possible
     // culprits:
@@ -1070,7 +1100,7 @@ void SqrtKeypointVioEstimator<Scalar_>::optimize() {
     lqr_options.lb_options.obs_std_dev = obs_std_dev;
     lqr_options.linearization_type = config.vio_linearization_type;
 
-    std::unique_ptr<LinearizationBase<Scalar, POSE_SIZE>> lqr;
+    std::unique_ptr<LinearizationBase<Scalar, POSE_SIZE>>& lqr = opt_lqr;
 
     ImuLinData<Scalar> ild = {
         g, gyro_bias_sqrt_weight, accel_bias_sqrt_weight, {}};
@@ -1080,12 +1110,27 @@ void SqrtKeypointVioEstimator<Scalar_>::optimize() {
 
     {
       Timer t;
-      lqr = LinearizationBase<Scalar, POSE_SIZE>::create(this, aom, lqr_options,
-                                                         &marg_data, &ild);
+      LinearizationBase<Scalar, POSE_SIZE>::update(lqr, this, aom, lqr_options,
+                                                   &marg_data, &ild);
       stats.add("allocateLMB", t.reset()).format("ms");
       lqr->log_problem_stats(stats);
     }
 
+    // Large windows are solved block-sparse with the states eliminated before
+    // the keyframe poses, small ones dense. Only ABS_QR accumulates the blocks
+    // directly, the other linearizations would go through the dense system.
+    const bool block_sparse =
+        config.vio_linearization_type == LinearizationType::ABS_QR &&
+        config.vio_block_sparse_min_size >= 0 &&
+        signed_cast(aom.total_size) >= config.vio_block_sparse_min_size;
+
+    std::vector<int> block_start, elimination_order;
+    BlockSparseAccumulator<Scalar> block_sparse_accum;
+    if (block_sparse) {
+      LinearizationBase<Scalar, POSE_SIZE>::getBlockSparseLayout(
+          aom, block_start, elimination_order);
+    }
+
     bool terminated = false;
     bool converged = false;
     std::string message;
@@ -1194,25 +1239,43 @@ void SqrtKeypointVioEstimator<Scalar_>::optimize() {
         {
           Timer t;
 
-          // get dense reduced camera system
+          // get reduced camera system
           MatX H;
           VecX b;
-
-          lqr->get_dense_H_b(H, b);
-
-          stats.add("get_dense_H_b", t.reset()).format("ms");
+          VecX H_diag;
+
+          if (block_sparse) {
+            block_sparse_accum.reset(block_start, aom.total_size,
+                                     &elimination_order);
+            lqr->get_block_sparse_H_b(block_sparse_accum);
+            H_diag = block_sparse_accum.Hdiagonal();
+
+            stats.add("get_block_sparse_H_b", t.reset()).format("ms");
+            stats.add("num_H_blocks", block_sparse_accum.numNonZeroBlocks())
+                .format("count");
+          } else {
+            lqr->get_dense_H_b(H, b);
+            H_diag = H.diagonal();
+
+            stats.add("get_dense_H_b", t.reset()).format("ms");
+          }
 
           int iter = 0;
           bool inc_valid = false;
           constexpr int max_num_iter = 3;
 
           while (iter < max_num_iter && !inc_valid) {
-            VecX Hdiag_lambda = (H.diagonal() * lambda).cwiseMax(min_lambda);
-            MatX H_copy = H;
-            H_copy.diagonal() += Hdiag_lambda;
+            VecX Hdiag_lambda = (H_diag * lambda).cwiseMax(min_lambda);
 
-            Eigen::LDLT<Eigen::Ref<MatX>> ldlt(H_copy);
-            inc = ldlt.solve(b);
+            if (block_sparse) {
+              inc = block_sparse_accum.solve(&Hdiag_lambda);
+            } else {
+              MatX H_copy = H;
+              H_copy.diagonal() += Hdiag_lambda;
+
+              Eigen::LDLT<Eigen::Ref<MatX>> ldlt(H_copy);
+              inc = ldlt.solve(b);
+            }
             stats.add("solve", t.reset()).format("ms");
 
             if (!inc.array().isFinite().all()) {
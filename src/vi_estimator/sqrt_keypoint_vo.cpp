@@ -41,6 +41,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <basalt/utils/system_utils.h>
 #include <basalt/utils/cast_utils.hpp>
 #include <basalt/utils/time_utils.hpp>
+#include <basalt/utils/tracing.h>
 
 #include <basalt/linearization/linearization_base.hpp>
 
@@ -125,12 +126,17 @@ void SqrtKeypointVoEstimator<Scalar_>::initialize(const Eigen::Vector3d& bg,
   UNUSED(ba);
 
   auto proc_func = [&] {
+    BASALT_TRACE_THREAD_NAME("estimator");
+
     OpticalFlowResult::Ptr prev_frame, curr_frame;
     bool add_pose = false;
 
     while (true) {
-      // get next optical flow result (blocking if queue empty)
-      vision_data_queue.pop(curr_frame);
+      {
+        // get next optical flow result (blocking if queue empty)
+        BASALT_TRACE_SCOPE("vision_data_queue.pop");
+        vision_data_queue.pop(curr_frame);
+      }
 
       if (config.vio_enforce_realtime) {
         // drop current frame if another frame is already in the queue.
@@ -208,6 +214,8 @@ void SqrtKeypointVoEstimator<Scalar_>::addIMUToQueue(
 template <class Scalar_>
 bool SqrtKeypointVoEstimator<Scalar_>::measure(
     const OpticalFlowResult::Ptr& opt_flow_meas, const bool add_pose) {
+  BASALT_TRACE_SCOPE("measure");
+
   stats_sums_.add("frame_id", opt_flow_meas->t_ns).format("none");
   Timer t_total;
 
@@ -261,15 +269,17 @@ bool SqrtKeypointVoEstimator<Scalar_>::measure(
   for (size_t i = 0; i < opt_flow_meas->observations.size(); i++) {
     TimeCamId tcid_target(opt_flow_meas->t_ns, i);
 
-    for (const auto& kv_obs : opt_flow_meas->observations[i]) {
-      int kpt_id = kv_obs.first;
+    const KeypointTracks& tracks = opt_flow_meas->observations[i];
+
+    for (size_t j = 0; j < tracks.size(); j++) {
+      int kpt_id = tracks.id(j);
 
       if (lmdb.landmarkExists(kpt_id)) {
         const TimeCamId& tcid_host = lmdb.getLandmark(kpt_id).host_kf_id;
 
         KeypointObservation<Scalar> kobs;
         kobs.kpt_id = kpt_id;
-        kobs.pos = kv_obs.second.translation().cast<Scalar>();
+        kobs.pos = tracks.translation(j).cast<Scalar>();
 
         lmdb.addObservation(tcid_target, kobs);
         // obs[tcid_host][tcid_target].push_back(kobs);
@@ -319,13 +329,14 @@ bool SqrtKeypointVoEstimator<Scalar_>::measure(
 
       for (const auto& kv : prev_opt_flow_res) {
         for (size_t k = 0; k < kv.second->observations.size(); k++) {
-          auto it = kv.second->observations[k].find(lm_id);
-          if (it != kv.second->observations[k].end()) {
+          const KeypointTracks& tracks = kv.second->observations[k];
+          const size_t idx = tracks.index(lm_id);
+          if (idx != KeypointTracks::INVALID_INDEX) {
             TimeCamId tcido(kv.first, k);
 
             KeypointObservation<Scalar> kobs;
             kobs.kpt_id = lm_id;
-            kobs.pos = it->second.translation().template cast<Scalar>();
+            kobs.pos = tracks.translation(idx).template cast<Scalar>();
 
             // obs[tcidl][tcido].push_back(kobs);
             kp_obs[tcido] = kobs;
@@ -333,6 +344,9 @@ bool SqrtKeypointVoEstimator<Scalar_>::measure(
         }
       }
 
+      // lm_id is observed in the current frame of camera 0
+      const Vec2 p0 = kp_obs.at(tcidl).pos;
+
       // triangulate
       bool valid_kp = false;
       const Scalar min_triang_distance2 =
@@ -342,15 +356,7 @@ bool SqrtKeypointVoEstimator<Scalar_>::measure(
         if (valid_kp) break;
         TimeCamId tcido = kv_obs.first;
 
-        const Vec2 p0 = opt_flow_meas->observations.at(0)
-                            .at(lm_id)
-                            .translation()
-                            .cast<Scalar>();
-        const Vec2 p1 = prev_opt_flow_res[tcido.frame_id]
-                            ->observations[tcido.cam_id]
-                            .at(lm_id)
-                            .translation()
-                            .template cast<Scalar>();
+        const Vec2& p1 = kv_obs.second.pos;
 
         Vec4 p0_3d, p1_3d;
         bool valid1 = calib.intrinsics[0].unproject(p0, p0_3d);
@@ -401,7 +407,7 @@ bool SqrtKeypointVoEstimator<Scalar_>::measure(
     for (const auto& kv : lmdb.getLandmarks()) {
       bool connected = false;
       for (size_t i = 0; i < opt_flow_meas->observations.size(); i++) {
-        if (opt_flow_meas->observations[i].count(kv.first) > 0)
+        if (opt_flow_meas->observations[i].contains(kv.first))
           connected = true;
       }
       if (!connected) {
@@ -420,6 +426,7 @@ bool SqrtKeypointVoEstimator<Scalar_>::measure(
         Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(),
         Eigen::Vector3d::Zero()));
 
+    BASALT_TRACE_SCOPE("out_state_queue.push");
     out_state_queue->push(data);
   }
 
@@ -446,6 +453,10 @@ bool SqrtKeypointVoEstimator<Scalar_>::measure(
 
   last_processed_t_ns = last_state_t_ns;
 
+  if (latency_recorder) {
+    latency_recorder->record(last_state_t_ns, FrameLatencyRecorder::ESTIMATOR);
+  }
+
   stats_sums_.add("measure", t_total.elapsed()).format("ms");
 
   return true;
@@ -479,6 +490,8 @@ template <class Scalar_>
 void SqrtKeypointVoEstimator<Scalar_>::marginalize(
     const std::map<int64_t, int>& num_points_connected,
     const std::unordered_set<KeypointId>& lost_landmaks) {
+  BASALT_TRACE_SCOPE("marginalize");
+
   BASALT_ASSERT(frame_states.empty());
 
   Timer t_total;
@@ -746,6 +759,7 @@ void SqrtKeypointVoEstimator<Scalar_>::marginalize(
             m->opt_flow_res.emplace_back(prev_opt_flow_res.at(t));
           }
 
+          BASALT_TRACE_SCOPE("out_marg_queue.push");
           out_marg_queue->push(m);
         }
       }
@@ -929,6 +943,8 @@ void SqrtKeypointVoEstimator<Scalar_>::marginalize(
 
 template <class Scalar_>
 void SqrtKeypointVoEstimator<Scalar_>::optimize() {
+  BASALT_TRACE_SCOPE("optimize");
+
   if (config.vio_debug) {
     std::cout << "=================================" << std::endl;
   }
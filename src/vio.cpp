@@ -57,6 +57,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <basalt/io/dataset_io.h>
 #include <basalt/io/marg_data_io.h>
+#include <basalt/io/prefetching_dataset.h>
 #include <basalt/spline/se3_spline.h>
 #include <basalt/vi_estimator/vio_estimator.h>
 #include <basalt/calibration/calibration.hpp>
@@ -66,6 +67,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <basalt/utils/system_utils.h>
 #include <basalt/utils/vis_utils.h>
 #include <basalt/utils/time_utils.hpp>
+#include <basalt/utils/tracing.h>
 
 using namespace fmt::literals;
 
@@ -147,6 +149,12 @@ size_t max_frames = 0;
 
 std::atomic<bool> terminate = false;
 
+// Replay at the recorded timestamps (0 means as fast as possible)
+double replay_speed = 0;
+int64_t replay_start_t_ns = 0;
+std::chrono::steady_clock::time_point replay_start_time;
+basalt::FrameLatencyRecorder latency_recorder;
+
 // VIO variables
 basalt::Calibration<double> calib;
 
@@ -155,9 +163,19 @@ basalt::VioConfig vio_config;
 basalt::OpticalFlowBase::Ptr opt_flow_ptr;
 basalt::VioEstimatorBase::Ptr vio;
 
+// In replay mode blocks until the sample recorded at t_ns is due
+void wait_for_replay_time(int64_t t_ns) {
+  if (replay_speed <= 0) return;
+
+  const auto offset = std::chrono::nanoseconds(
+      int64_t((t_ns - replay_start_t_ns) / replay_speed));
+  std::this_thread::sleep_until(replay_start_time + offset);
+}
+
 // Feed functions
 void feed_images() {
   std::cout << "Started input_data thread " << std::endl;
+  BASALT_TRACE_THREAD_NAME("feed_images");
 
   for (size_t i = 0; i < vio_dataset->get_image_timestamps().size(); i++) {
     if (vio->finished || terminate || (max_frames > 0 && i >= max_frames)) {
@@ -177,6 +195,13 @@ void feed_images() {
 
     timestamp_to_id[data->t_ns] = i;
 
+    wait_for_replay_time(data->t_ns);
+
+    if (replay_speed > 0) {
+      latency_recorder.record(data->t_ns, basalt::FrameLatencyRecorder::INPUT);
+    }
+
+    BASALT_TRACE_SCOPE("input_queue.push");
     opt_flow_ptr->input_queue.push(data);
   }
 
@@ -187,6 +212,8 @@ void feed_images() {
 }
 
 void feed_imu() {
+  BASALT_TRACE_THREAD_NAME("feed_imu");
+
   for (size_t i = 0; i < vio_dataset->get_gyro_data().size(); i++) {
     if (vio->finished || terminate) {
       break;
@@ -198,8 +225,16 @@ void feed_imu() {
     data->accel = vio_dataset->get_accel_data()[i].data;
     data->gyro = vio_dataset->get_gyro_data()[i].data;
 
+    wait_for_replay_time(data->t_ns);
+
+    if (vio_config.optical_flow_use_gyro) {
+      opt_flow_ptr->imu_data_queue.push(data);
+    }
     vio->imu_data_queue.push(data);
   }
+  if (vio_config.optical_flow_use_gyro) {
+    opt_flow_ptr->imu_data_queue.push(nullptr);
+  }
   vio->imu_data_queue.push(nullptr);
 }
 
@@ -214,6 +249,8 @@ int main(int argc, char** argv) {
   std::string trajectory_fmt;
   bool trajectory_groundtruth;
   int num_threads = 0;
+  size_t num_load_threads = 2;
+  size_t load_lookahead = 8;
   bool use_imu = true;
   bool use_double = false;
 
@@ -238,6 +275,11 @@ int main(int argc, char** argv) {
   app.add_option("--result-path", result_path,
                  "Path to result file where the system will write RMSE ATE.");
   app.add_option("--num-threads", num_threads, "Number of threads.");
+  app.add_option("--num-load-threads", num_load_threads,
+                 "Number of threads that load the images ahead of the VIO (0 "
+                 "loads them on the input thread).");
+  app.add_option("--load-lookahead", load_lookahead,
+                 "Number of frames that are loaded ahead of the VIO.");
   app.add_option("--step-by-step", step_by_step, "Path to config file.");
   app.add_option("--save-trajectory", trajectory_fmt,
                  "Save trajectory. Supported formats <tum, euroc, kitti>");
@@ -248,6 +290,10 @@ int main(int argc, char** argv) {
   app.add_option(
       "--max-frames", max_frames,
       "Limit number of frames to process from dataset (0 means unlimited)");
+  app.add_option("--replay-speed", replay_speed,
+                 "Release images and IMU at their recorded timestamps, scaled "
+                 "by this factor, and report the per-frame latency (0 feeds "
+                 "them as fast as possible).");
 
   try {
     app.parse(argc, argv);
@@ -265,14 +311,15 @@ int main(int argc, char** argv) {
   if (!config_path.empty()) {
     vio_config.load(config_path);
 
-    if (vio_config.vio_enforce_realtime) {
+    if (vio_config.vio_enforce_realtime && replay_speed <= 0) {
       vio_config.vio_enforce_realtime = false;
       std::cout
           << "The option vio_config.vio_enforce_realtime was enabled, "
              "but it should only be used with the live executables (supply "
              "images at a constant framerate). This executable runs on the "
              "datasets and processes images as fast as it can, so the option "
-             "will be disabled. "
+             "will be disabled. Use --replay-speed to supply the images at "
+             "their recorded framerate."
           << std::endl;
     }
   }
@@ -286,6 +333,12 @@ int main(int argc, char** argv) {
     dataset_io->read(dataset_path);
 
     vio_dataset = dataset_io->get_data();
+    vio_dataset->native_8bit_images = vio_config.optical_flow_native_8bit;
+
+    if (num_load_threads > 0) {
+      vio_dataset.reset(new basalt::PrefetchingVioDataset(
+          vio_dataset, num_load_threads, load_lookahead));
+    }
 
     show_frame.Meta().range[1] = vio_dataset->get_image_timestamps().size() - 1;
     show_frame.Meta().gui_changed = true;
@@ -308,6 +361,11 @@ int main(int argc, char** argv) {
     opt_flow_ptr->output_queue = &vio->vision_data_queue;
     if (show_gui) vio->out_vis_queue = &out_vis_queue;
     vio->out_state_queue = &out_state_queue;
+
+    if (replay_speed > 0) {
+      opt_flow_ptr->latency_recorder = &latency_recorder;
+      vio->latency_recorder = &latency_recorder;
+    }
   }
 
   basalt::MargDataSaver::Ptr marg_data_saver;
@@ -332,6 +390,13 @@ int main(int argc, char** argv) {
 
   vio_data_log.Clear();
 
+  replay_start_t_ns = start_t_ns;
+  if (!vio_dataset->get_gyro_data().empty()) {
+    replay_start_t_ns = std::min(
+        replay_start_t_ns, vio_dataset->get_gyro_data().front().timestamp_ns);
+  }
+  replay_start_time = std::chrono::steady_clock::now();
+
   std::thread t1(&feed_images);
   std::thread t2(&feed_imu);
 
@@ -364,6 +429,11 @@ int main(int argc, char** argv) {
 
       int64_t t_ns = data->t_ns;
 
+      if (replay_speed > 0) {
+        latency_recorder.record(t_ns,
+                                basalt::FrameLatencyRecorder::STATE_OUTPUT);
+      }
+
       // std::cerr << "t_ns " << t_ns << std::endl;
       Sophus::SE3d T_w_i = data->T_w_i;
       Eigen::Vector3d vel_w_i = data->vel_w_i;
@@ -507,10 +577,18 @@ int main(int argc, char** argv) {
           fmt.gltype = GL_UNSIGNED_SHORT;
           fmt.scalable_internal_format = GL_LUMINANCE16;
 
-          if (img_vec[cam_id].img.get())
+          if (img_vec[cam_id].img.get()) {
             img_view[cam_id]->SetImage(
                 img_vec[cam_id].img->ptr, img_vec[cam_id].img->w,
                 img_vec[cam_id].img->h, img_vec[cam_id].img->pitch, fmt);
+          } else if (img_vec[cam_id].img_u8.get()) {
+            fmt.gltype = GL_UNSIGNED_BYTE;
+            fmt.scalable_internal_format = GL_LUMINANCE8;
+
+            img_view[cam_id]->SetImage(
+                img_vec[cam_id].img_u8->ptr, img_vec[cam_id].img_u8->w,
+                img_vec[cam_id].img_u8->h, img_vec[cam_id].img_u8->pitch, fmt);
+          }
         }
 
         draw_plots();
@@ -611,14 +689,44 @@ int main(int argc, char** argv) {
   const double ate_rmse =
       basalt::alignSVD(vio_t_ns, vio_t_w_i, gt_t_ns, gt_t_w_i);
   vio->debug_finalize();
+  std::cout << "=== optical flow stats ===\n";
+  opt_flow_ptr->stats.print();
+  opt_flow_ptr->stats.save_json("stats_opt_flow.json");
   std::cout << "Total runtime: {:.3f}s\n"_format(duration_total);
 
+  if (replay_speed > 0) {
+    std::cout << "=== replay latency ===\n";
+    latency_recorder.print();
+  }
+
+  BASALT_TRACE_SAVE("trace_vio.json");
+
   {
     basalt::ExecutionStats stats;
     stats.add("exec_time_s", duration_total);
     stats.add("ate_rmse", ate_rmse);
     stats.add("ate_num_kfs", vio_t_w_i.size());
     stats.add("num_frames", vio_dataset->get_image_timestamps().size());
+    stats.add("opt_flow_pyramids_allocated",
+              opt_flow_ptr->numPyramidsAllocated());
+    stats.add("opt_flow_pyramids_reused", opt_flow_ptr->numPyramidsReused());
+
+    if (replay_speed > 0) {
+      const auto summary = latency_recorder.summarize();
+      stats.add("latency_dropped_frames", summary.num_dropped_frames);
+
+      using Recorder = basalt::FrameLatencyRecorder;
+      for (int i = Recorder::OPTICAL_FLOW; i < Recorder::NUM_STAGES; i++) {
+        const std::string prefix =
+            "latency_{}_"_format(Recorder::stage_name(Recorder::Stage(i)));
+        const auto& s = summary.stages[i];
+
+        stats.add(prefix + "p50", s.p50);
+        stats.add(prefix + "p95", s.p95);
+        stats.add(prefix + "p99", s.p99);
+        stats.add(prefix + "max", s.max);
+      }
+    }
 
     {
       basalt::MemoryInfo mi;
@@ -731,27 +839,29 @@ void draw_image_overlay(pangolin::View& v, size_t cam_id) {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     if (it != vis_map.end()) {
-      const Eigen::aligned_map<basalt::KeypointId, Eigen::AffineCompact2f>&
-          kp_map = it->second->opt_flow_res->observations[cam_id];
+      const basalt::KeypointTracks& tracks =
+          it->second->opt_flow_res->observations[cam_id];
 
-      for (const auto& kv : kp_map) {
+      for (size_t j = 0; j < tracks.size(); j++) {
         Eigen::MatrixXf transformed_patch =
-            kv.second.linear() * opt_flow_ptr->patch_coord;
-        transformed_patch.colwise() += kv.second.translation();
+            tracks.linear(j) * opt_flow_ptr->patch_coord;
+        transformed_patch.colwise() += tracks.translation(j);
 
         for (int i = 0; i < transformed_patch.cols(); i++) {
           const Eigen::Vector2f c = transformed_patch.col(i);
           pangolin::glDrawCirclePerimeter(c[0], c[1], 0.5f);
         }
 
-        const Eigen::Vector2f c = kv.second.translation();
+        const Eigen::Vector2f c = tracks.translation(j);
 
         if (show_ids)
-          pangolin::GlFont::I().Text("%d", kv.first).Draw(5 + c[0], 5 + c[1]);
+          pangolin::GlFont::I()
+              .Text("%d", tracks.id(j))
+              .Draw(5 + c[0], 5 + c[1]);
       }
 
       pangolin::GlFont::I()
-          .Text("%d opt_flow patches", kp_map.size())
+          .Text("%d opt_flow patches", tracks.size())
           .Draw(5, 20);
     }
   }
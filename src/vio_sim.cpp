@@ -237,7 +237,7 @@ int main(int argc, char** argv) {
           Eigen::AffineCompact2f t;
           t.setIdentity();
           t.translation() = obs.pos[k].cast<float>();
-          data->observations.back()[obs.id[k]] = t;
+          data->observations.back().insert(obs.id[k], t);
         }
       }
 
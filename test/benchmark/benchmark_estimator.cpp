@@ -0,0 +1,347 @@
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <basalt/imu/preintegration.h>
+#include <basalt/linearization/linearization_base.hpp>
+#include <basalt/utils/ba_utils.h>
+#include <basalt/vi_estimator/marg_helper.h>
+
+#include "linearization_test_utils.h"
+
+// Benchmarks of the estimator kernels on the synthetic visual odometry and
+// visual-inertial windows of the linearization tests. The problems are
+// generated with a fixed seed, so the numbers are comparable between runs and
+// commits.
+
+namespace {
+
+using Scalar = double;
+constexpr int POSE_SIZE = 6;
+
+using LinearizationT = basalt::LinearizationBase<Scalar, POSE_SIZE>;
+
+// Window of num_frames frames, as in the linearization tests
+struct Problem {
+  basalt::BundleAdjustmentBase<Scalar> estimator;
+  basalt::AbsOrderMap aom;
+  LinearizationT::Options options;
+
+  explicit Problem(int num_frames) {
+    std::srand(42);
+    get_vo_estimator<Scalar>(num_frames, estimator, aom);
+
+    options.lb_options.huber_parameter = estimator.huber_thresh;
+    options.lb_options.obs_std_dev = estimator.obs_std_dev;
+  }
+
+  std::unique_ptr<LinearizationT> linearization(basalt::LinearizationType t) {
+    options.linearization_type = t;
+    return LinearizationT::create(&estimator, aom, options);
+  }
+};
+
+// Visual-inertial window of num_frames frames, of which the last num_states
+// are states
+struct VioProblem {
+  basalt::BundleAdjustmentBase<Scalar> estimator;
+  basalt::AbsOrderMap aom;
+  Eigen::aligned_map<int64_t, basalt::IntegratedImuMeasurement<Scalar>>
+      imu_meas;
+
+  const Eigen::Vector3d g{0, 0, -9.81};
+  const Eigen::Vector3d gyro_bias_weight_sqrt = Eigen::Vector3d::Constant(1e2);
+  const Eigen::Vector3d accel_bias_weight_sqrt =
+      Eigen::Vector3d::Constant(1e1);
+  basalt::ImuLinData<Scalar> ild{
+      g, gyro_bias_weight_sqrt, accel_bias_weight_sqrt, {}};
+
+  LinearizationT::Options options;
+
+  VioProblem(int num_frames, int num_states) {
+    std::srand(42);
+    get_vio_estimator<Scalar>(num_frames, num_states, estimator, aom,
+                              imu_meas);
+
+    for (const auto& kv : imu_meas) ild.imu_meas[kv.first] = &kv.second;
+
+    options.lb_options.huber_parameter = estimator.huber_thresh;
+    options.lb_options.obs_std_dev = estimator.obs_std_dev;
+    options.linearization_type = basalt::LinearizationType::ABS_QR;
+  }
+
+  std::unique_ptr<LinearizationT> linearization() {
+    return LinearizationT::create(&estimator, aom, options, nullptr, &ild);
+  }
+};
+
+// One landmark with the given number of observations (two cameras per frame)
+// and the relative poses between its host and the observing cameras.
+struct LandmarkProblem : Problem {
+  Eigen::aligned_unordered_map<std::pair<basalt::TimeCamId, basalt::TimeCamId>,
+                               basalt::RelPoseLin<Scalar>>
+      relative_pose_lin;
+
+  basalt::Keypoint<Scalar>* lm;
+
+  explicit LandmarkProblem(int num_obs) : Problem(num_obs / 2) {
+    // landmarks of the last frame are observed in all frames
+    lm = &estimator.lmdb.getLandmark(10 * (num_obs / 2 - 1));
+
+    const basalt::TimeCamId& tcid_h = lm->host_kf_id;
+    for (const auto& [tcid_t, pos] : lm->obs) {
+      basalt::RelPoseLin<Scalar>& rpl =
+          relative_pose_lin[std::make_pair(tcid_h, tcid_t)];
+
+      if (tcid_h != tcid_t) {
+        rpl.T_t_h = basalt::computeRelPose(
+                        estimator.getPoseStateWithLin(tcid_h.frame_id)
+                            .getPoseLin(),
+                        estimator.calib.T_i_c[tcid_h.cam_id],
+                        estimator.getPoseStateWithLin(tcid_t.frame_id)
+                            .getPoseLin(),
+                        estimator.calib.T_i_c[tcid_t.cam_id], &rpl.d_rel_d_h,
+                        &rpl.d_rel_d_t)
+                        .matrix();
+      } else {
+        rpl.T_t_h.setIdentity();
+        rpl.d_rel_d_h.setZero();
+        rpl.d_rel_d_t.setZero();
+      }
+    }
+  }
+
+  std::unique_ptr<basalt::LandmarkBlock<Scalar>> landmarkBlock() {
+    auto lb = basalt::LandmarkBlock<Scalar>::createLandmarkBlock<POSE_SIZE>(
+        lm->obs.size());
+    lb->allocateLandmark(*lm, relative_pose_lin, estimator.calib, aom,
+                         options.lb_options);
+    return lb;
+  }
+};
+
+// Argument is the number of observations of the landmark
+void BM_LandmarkLinearize(benchmark::State& state) {
+  LandmarkProblem problem(state.range(0));
+  auto lb = problem.landmarkBlock();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lb->linearizeLandmark());
+  }
+}
+
+void BM_LandmarkLinearizeQR(benchmark::State& state) {
+  LandmarkProblem problem(state.range(0));
+  auto lb = problem.landmarkBlock();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lb->linearizeLandmark());
+    lb->performQR();
+  }
+}
+
+// Linearization of the whole window. Argument is the number of frames.
+template <basalt::LinearizationType Type>
+void BM_LinearizeProblem(benchmark::State& state) {
+  Problem problem(state.range(0));
+  auto lin = problem.linearization(Type);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lin->linearizeProblem());
+    lin->performQR();
+  }
+}
+
+template <basalt::LinearizationType Type>
+void BM_GetDenseHb(benchmark::State& state) {
+  Problem problem(state.range(0));
+  auto lin = problem.linearization(Type);
+  lin->linearizeProblem();
+  lin->performQR();
+
+  Eigen::MatrixXd H;
+  Eigen::VectorXd b;
+  for (auto _ : state) {
+    lin->get_dense_H_b(H, b);
+    benchmark::DoNotOptimize(H.data());
+  }
+}
+
+// Reduced camera system and damped solve of one iteration of the VIO
+// optimization, with the block-sparse Cholesky or the dense LDLT that
+// vio_block_sparse_min_size selects between. Arguments are the numbers of
+// keyframes and of states.
+template <bool BLOCK_SPARSE>
+void BM_VioSolve(benchmark::State& state) {
+  VioProblem problem(state.range(0) + state.range(1), state.range(1));
+  auto lin = problem.linearization();
+  lin->linearizeProblem();
+  lin->performQR();
+
+  std::vector<int> block_start, elimination_order;
+  LinearizationT::getBlockSparseLayout(problem.aom, block_start,
+                                       elimination_order);
+  basalt::BlockSparseAccumulator<Scalar> accum;
+
+  Eigen::MatrixXd H;
+  Eigen::VectorXd b, diagonal, inc;
+  for (auto _ : state) {
+    if (BLOCK_SPARSE) {
+      accum.reset(block_start, problem.aom.total_size, &elimination_order);
+      lin->get_block_sparse_H_b(accum);
+      diagonal = (accum.Hdiagonal() * 1e-4).cwiseMax(1e-6);
+      inc = accum.solve(&diagonal);
+    } else {
+      lin->get_dense_H_b(H, b);
+      diagonal = (H.diagonal() * 1e-4).cwiseMax(1e-6);
+      H.diagonal() += diagonal;
+      Eigen::LDLT<Eigen::Ref<Eigen::MatrixXd>> ldlt(H);
+      inc = ldlt.solve(b);
+    }
+    benchmark::DoNotOptimize(inc.data());
+  }
+
+  state.counters["size"] = problem.aom.total_size;
+}
+
+// Marginalization of the oldest frame of the window. The helpers modify
+// their input, so it is copied outside of the timed region.
+enum class MargVariant { SQ_TO_SQ, SQ_TO_SQRT, SQRT_TO_SQRT };
+
+template <MargVariant Variant>
+void BM_MargHelper(benchmark::State& state) {
+  Problem problem(state.range(0));
+  auto lin = problem.linearization(Variant == MargVariant::SQRT_TO_SQRT
+                                       ? basalt::LinearizationType::ABS_QR
+                                       : basalt::LinearizationType::ABS_SC);
+  lin->linearizeProblem();
+  lin->performQR();
+
+  Eigen::MatrixXd Q2Jp_or_H;
+  Eigen::VectorXd Q2r_or_b;
+  if (Variant == MargVariant::SQRT_TO_SQRT) {
+    lin->get_dense_Q2Jp_Q2r(Q2Jp_or_H, Q2r_or_b);
+  } else {
+    lin->get_dense_H_b(Q2Jp_or_H, Q2r_or_b);
+  }
+
+  std::set<int> idx_to_keep, idx_to_marg;
+  for (int i = 0; i < problem.aom.total_size; i++) {
+    (i < POSE_SIZE ? idx_to_marg : idx_to_keep).insert(i);
+  }
+
+  Eigen::MatrixXd marg_H;
+  Eigen::VectorXd marg_b;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Eigen::MatrixXd A = Q2Jp_or_H;
+    Eigen::VectorXd r = Q2r_or_b;
+    state.ResumeTiming();
+
+    switch (Variant) {
+      case MargVariant::SQ_TO_SQ:
+        basalt::MargHelper<Scalar>::marginalizeHelperSqToSq(
+            A, r, idx_to_keep, idx_to_marg, marg_H, marg_b);
+        break;
+      case MargVariant::SQ_TO_SQRT:
+        basalt::MargHelper<Scalar>::marginalizeHelperSqToSqrt(
+            A, r, idx_to_keep, idx_to_marg, marg_H, marg_b);
+        break;
+      case MargVariant::SQRT_TO_SQRT:
+        basalt::MargHelper<Scalar>::marginalizeHelperSqrtToSqrt(
+            A, r, idx_to_keep, idx_to_marg, marg_H, marg_b);
+        break;
+    }
+    benchmark::DoNotOptimize(marg_H.data());
+  }
+}
+
+// Preintegration of the 200 Hz IMU samples between two frames at 20 Hz
+void BM_ImuIntegrate(benchmark::State& state) {
+  using Vec3 = Eigen::Matrix<Scalar, 3, 1>;
+
+  std::mt19937 gen(42);
+  std::normal_distribution<Scalar> noise(0, 0.1);
+
+  constexpr int NUM_SAMPLES = 10;
+  constexpr int64_t DT_NS = 5000000;
+
+  std::vector<basalt::ImuData<Scalar>> samples(NUM_SAMPLES);
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    samples[i].t_ns = (i + 1) * DT_NS;
+    samples[i].accel = Vec3(noise(gen), noise(gen), 9.81 + noise(gen));
+    samples[i].gyro = Vec3(noise(gen), noise(gen), noise(gen));
+  }
+
+  const Vec3 accel_cov = Vec3::Constant(1e-4);
+  const Vec3 gyro_cov = Vec3::Constant(1e-6);
+
+  for (auto _ : state) {
+    basalt::IntegratedImuMeasurement<Scalar> meas(0, Vec3::Zero(),
+                                                  Vec3::Zero());
+    for (const auto& s : samples) meas.integrate(s, accel_cov, gyro_cov);
+    benchmark::DoNotOptimize(meas);
+  }
+}
+
+}  // namespace
+
+#ifdef BASALT_INSTANTIATIONS_DOUBLE
+
+using basalt::LinearizationType;
+
+BENCHMARK(BM_LandmarkLinearize)->RangeMultiplier(2)->Range(2, 16);
+BENCHMARK(BM_LandmarkLinearizeQR)->RangeMultiplier(2)->Range(2, 16);
+
+BENCHMARK_TEMPLATE(BM_LinearizeProblem, LinearizationType::ABS_QR)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_LinearizeProblem, LinearizationType::ABS_SC)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_LinearizeProblem, LinearizationType::REL_SC)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_GetDenseHb, LinearizationType::ABS_QR)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_GetDenseHb, LinearizationType::ABS_SC)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_GetDenseHb, LinearizationType::REL_SC)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_MargHelper, MargVariant::SQ_TO_SQ)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_MargHelper, MargVariant::SQ_TO_SQRT)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_MargHelper, MargVariant::SQRT_TO_SQRT)
+    ->DenseRange(4, 10, 3)
+    ->Unit(benchmark::kMicrosecond);
+
+// The last arguments are the window of vio_max_kfs=30 and vio_max_states=10
+BENCHMARK_TEMPLATE(BM_VioSolve, false)
+    ->Args({3, 3})
+    ->Args({7, 5})
+    ->Args({15, 7})
+    ->Args({30, 10})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_VioSolve, true)
+    ->Args({3, 3})
+    ->Args({7, 5})
+    ->Args({15, 7})
+    ->Args({30, 10})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_ImuIntegrate);
+
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <basalt/io/dataset_io.h>
+#include <basalt/utils/keypoints.h>
+
+// Benchmarks of the mapping keypoint pipeline (orientation, descriptors and
+// matching of the corners detected by detectKeypointsMapping). Runs on the
+// first images of the left camera of a dataset given by the environment
+// variables
+//
+//   BASALT_BENCHMARK_DATASET=/path/to/MH_05_difficult
+//   BASALT_BENCHMARK_DATASET_TYPE=euroc  (default)
+//
+// and on synthetic images otherwise.
+
+namespace {
+
+constexpr size_t NUM_FRAMES = 20;
+
+struct Frame {
+  basalt::ManagedImage<uint16_t>::Ptr img;
+  basalt::KeypointsData kd;
+};
+
+std::vector<basalt::ManagedImage<uint16_t>::Ptr> loadImages() {
+  std::vector<basalt::ManagedImage<uint16_t>::Ptr> res;
+
+  const char* dataset_path = std::getenv("BASALT_BENCHMARK_DATASET");
+  if (dataset_path) {
+    const char* dataset_type = std::getenv("BASALT_BENCHMARK_DATASET_TYPE");
+
+    basalt::DatasetIoInterfacePtr dataset_io =
+        basalt::DatasetIoFactory::getDatasetIo(dataset_type ? dataset_type
+                                                            : "euroc");
+    dataset_io->read(dataset_path);
+    basalt::VioDatasetPtr data = dataset_io->get_data();
+
+    for (int64_t t_ns : data->get_image_timestamps()) {
+      if (res.size() >= NUM_FRAMES) break;
+
+      std::vector<basalt::ImageData> img_data = data->get_image_data(t_ns);
+      if (!img_data.empty() && img_data[0].img) {
+        res.push_back(img_data[0].img);
+      }
+    }
+  }
+
+  if (res.empty()) {
+    std::cerr << "BASALT_BENCHMARK_DATASET not set or empty, using synthetic "
+                 "images."
+              << std::endl;
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(0, 2 * M_PI);
+
+    for (size_t i = 0; i < NUM_FRAMES; i++) {
+      const double phase_x = dist(gen), phase_y = dist(gen);
+
+      auto img = std::make_shared<basalt::ManagedImage<uint16_t>>(752, 480);
+      for (size_t y = 0; y < img->h; y++) {
+        for (size_t x = 0; x < img->w; x++) {
+          (*img)(x, y) = 32768 + 16000 * std::sin(0.11 * x + phase_x) +
+                         16000 * std::sin(0.07 * y + phase_y) *
+                             std::cos(0.05 * x);
+        }
+      }
+      res.push_back(img);
+    }
+  }
+
+  return res;
+}
+
+std::vector<Frame>& benchmarkFrames() {
+  static std::vector<Frame> frames = [] {
+    std::vector<Frame> res;
+    const int num_points = basalt::VioConfig().mapper_detection_num_points;
+
+    for (const auto& img : loadImages()) {
+      const basalt::Image<const uint16_t> img_const =
+          img->Reinterpret<const uint16_t>();
+
+      Frame f;
+      f.img = img;
+      basalt::detectKeypointsMapping(img_const, f.kd, num_points);
+      basalt::computeAngles(img_const, f.kd, true);
+      basalt::computeDescriptors(img_const, f.kd);
+      res.push_back(std::move(f));
+    }
+    return res;
+  }();
+  return frames;
+}
+
+void setCornerCounter(benchmark::State& state, size_t num_corners) {
+  state.counters["corners"] = benchmark::Counter(
+      num_corners, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Per-pixel intensity centroid over the disk as used before the row sums
+void BM_ComputeAnglesPerPixel(benchmark::State& state) {
+  auto& frames = benchmarkFrames();
+
+  size_t k = 0, num_corners = 0;
+  for (auto _ : state) {
+    Frame& f = frames[k++ % frames.size()];
+    const basalt::Image<const uint16_t> img =
+        f.img->Reinterpret<const uint16_t>();
+
+    for (const Eigen::Vector2d& p : f.kd.corners) {
+      const int cx = p[0];
+      const int cy = p[1];
+
+      double m01 = 0, m10 = 0;
+      for (int x = -15; x <= 15; x++) {
+        for (int y = -15; y <= 15; y++) {
+          if (x * x + y * y <= 15 * 15) {
+            double val = img(cx + x, cy + y);
+            m01 += y * val;
+            m10 += x * val;
+          }
+        }
+      }
+      benchmark::DoNotOptimize(atan2(m01, m10));
+    }
+    num_corners += f.kd.corners.size();
+  }
+  setCornerCounter(state, num_corners / std::max<size_t>(k, 1));
+}
+
+void BM_ComputeAngles(benchmark::State& state) {
+  auto& frames = benchmarkFrames();
+
+  size_t k = 0, num_corners = 0;
+  for (auto _ : state) {
+    Frame& f = frames[k++ % frames.size()];
+    basalt::computeAngles(f.img->Reinterpret<const uint16_t>(), f.kd, true);
+    benchmark::DoNotOptimize(f.kd.corner_angles.data());
+    num_corners += f.kd.corners.size();
+  }
+  setCornerCounter(state, num_corners / std::max<size_t>(k, 1));
+}
+
+void BM_ComputeDescriptors(benchmark::State& state) {
+  auto& frames = benchmarkFrames();
+
+  size_t k = 0, num_corners = 0;
+  for (auto _ : state) {
+    Frame& f = frames[k++ % frames.size()];
+    basalt::computeDescriptors(f.img->Reinterpret<const uint16_t>(), f.kd);
+    benchmark::DoNotOptimize(f.kd.corner_descriptors.data());
+    num_corners += f.kd.corners.size();
+  }
+  setCornerCounter(state, num_corners / std::max<size_t>(k, 1));
+}
+
+// Matching of consecutive frames with the parameters of match_all. Reports
+// the recall of the matcher relative to brute force.
+template <basalt::DescriptorMatcherType Type>
+void BM_MatchDescriptors(benchmark::State& state) {
+  const auto& frames = benchmarkFrames();
+  const basalt::VioConfig config;
+
+  auto match = [&](size_t k, basalt::DescriptorMatcherType type,
+                   std::vector<std::pair<int, int>>& matches) {
+    const Frame& f1 = frames[k % frames.size()];
+    const Frame& f2 = frames[(k + 1) % frames.size()];
+
+    basalt::matchDescriptors(f1.kd.corner_descriptors,
+                             f2.kd.corner_descriptors, matches,
+                             config.mapper_max_hamming_distance,
+                             config.mapper_second_best_test_ratio, type);
+  };
+
+  size_t num_bf = 0, num_common = 0;
+  for (size_t k = 0; k < frames.size(); k++) {
+    std::vector<std::pair<int, int>> matches_bf, matches;
+    match(k, basalt::DescriptorMatcherType::BRUTE_FORCE, matches_bf);
+    match(k, Type, matches);
+
+    std::sort(matches_bf.begin(), matches_bf.end());
+    std::sort(matches.begin(), matches.end());
+
+    std::vector<std::pair<int, int>> common;
+    std::set_intersection(matches_bf.begin(), matches_bf.end(),
+                          matches.begin(), matches.end(),
+                          std::back_inserter(common));
+    num_bf += matches_bf.size();
+    num_common += common.size();
+  }
+
+  std::vector<std::pair<int, int>> matches;
+  size_t k = 0;
+  for (auto _ : state) {
+    match(k++, Type, matches);
+    benchmark::DoNotOptimize(matches.data());
+  }
+
+  state.counters["recall"] = double(num_common) / std::max<size_t>(num_bf, 1);
+}
+
+}  // namespace
+
+BENCHMARK(BM_ComputeAnglesPerPixel)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ComputeAngles)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ComputeDescriptors)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_MatchDescriptors,
+                   basalt::DescriptorMatcherType::BRUTE_FORCE)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_MatchDescriptors,
+                   basalt::DescriptorMatcherType::MULTI_INDEX_HASHING)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,217 @@
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <basalt/optical_flow/patch.h>
+
+namespace {
+
+const basalt::ManagedImage<uint16_t>& benchmarkImage() {
+  static const basalt::ManagedImage<uint16_t> img = [] {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 65535);
+
+    basalt::ManagedImage<uint16_t> res(752, 480);
+    for (size_t y = 0; y < res.h; y++) {
+      for (size_t x = 0; x < res.w; x++) {
+        res(x, y) = dist(gen);
+      }
+    }
+    return res;
+  }();
+  return img;
+}
+
+// Patch centers with random sub-pixel offsets, far enough from the border
+template <typename Scalar>
+Eigen::Matrix<Scalar, 2, Eigen::Dynamic> randomPositions(int num) {
+  const auto& img = benchmarkImage();
+
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<Scalar> dist_x(20, img.w - 20);
+  std::uniform_real_distribution<Scalar> dist_y(20, img.h - 20);
+
+  Eigen::Matrix<Scalar, 2, Eigen::Dynamic> res(2, num);
+  for (int i = 0; i < num; i++) {
+    res.col(i) << dist_x(gen), dist_y(gen);
+  }
+  return res;
+}
+
+constexpr int NUM_POSITIONS = 256;
+
+// Interpolation of all pattern points: per-point path with individual bounds
+// checks as used before the batch kernels, versus the batch kernels.
+template <typename Pattern>
+void BM_InterpPerPoint(benchmark::State& state) {
+  using PatchT = basalt::OpticalFlowPatch<float, Pattern>;
+
+  const basalt::Image<const uint16_t> img =
+      benchmarkImage().Reinterpret<const uint16_t>();
+  const auto pos = randomPositions<float>(NUM_POSITIONS);
+
+  typename PatchT::VectorP res;
+  int k = 0;
+  for (auto _ : state) {
+    typename PatchT::Matrix2P pattern = PatchT::pattern2;
+    pattern.colwise() += pos.col(k++ % NUM_POSITIONS);
+
+    for (int i = 0; i < PatchT::PATTERN_SIZE; i++) {
+      if (img.InBounds(pattern.col(i), 2)) {
+        res[i] = img.interp<float>(pattern.col(i));
+      } else {
+        res[i] = -1;
+      }
+    }
+    benchmark::DoNotOptimize(res);
+  }
+}
+
+template <typename Pattern, typename Backend>
+void BM_InterpBatch(benchmark::State& state) {
+  using PatchT = basalt::OpticalFlowPatch<float, Pattern>;
+
+  const basalt::Image<const uint16_t> img =
+      benchmarkImage().Reinterpret<const uint16_t>();
+  const auto pos = randomPositions<float>(NUM_POSITIONS);
+
+  typename PatchT::VectorP res;
+  int k = 0;
+  for (auto _ : state) {
+    typename PatchT::Matrix2P pattern = PatchT::pattern2;
+    pattern.colwise() += pos.col(k++ % NUM_POSITIONS);
+
+    if (basalt::patch_interp::patchInBounds(img, pattern, 2)) {
+      basalt::patch_interp::interpPoints<Backend>(
+          img, pattern.data(), PatchT::PATTERN_SIZE, res.data());
+    }
+    benchmark::DoNotOptimize(res);
+  }
+}
+
+template <typename Pattern>
+void BM_InterpGradPerPoint(benchmark::State& state) {
+  using PatchT = basalt::OpticalFlowPatch<float, Pattern>;
+
+  const basalt::Image<const uint16_t> img =
+      benchmarkImage().Reinterpret<const uint16_t>();
+  const auto pos = randomPositions<float>(NUM_POSITIONS);
+
+  typename PatchT::VectorP val;
+  typename PatchT::MatrixP2 grad;
+  int k = 0;
+  for (auto _ : state) {
+    typename PatchT::Matrix2P pattern = PatchT::pattern2;
+    pattern.colwise() += pos.col(k++ % NUM_POSITIONS);
+
+    for (int i = 0; i < PatchT::PATTERN_SIZE; i++) {
+      if (img.InBounds(pattern.col(i), 2)) {
+        const Eigen::Vector3f val_grad = img.interpGrad<float>(pattern.col(i));
+        val[i] = val_grad[0];
+        grad.row(i) = val_grad.tail<2>();
+      } else {
+        val[i] = -1;
+      }
+    }
+    benchmark::DoNotOptimize(val);
+    benchmark::DoNotOptimize(grad);
+  }
+}
+
+template <typename Pattern, typename Backend>
+void BM_InterpGradBatch(benchmark::State& state) {
+  using PatchT = basalt::OpticalFlowPatch<float, Pattern>;
+
+  const basalt::Image<const uint16_t> img =
+      benchmarkImage().Reinterpret<const uint16_t>();
+  const auto pos = randomPositions<float>(NUM_POSITIONS);
+
+  typename PatchT::VectorP val;
+  typename PatchT::MatrixP2 grad;
+  int k = 0;
+  for (auto _ : state) {
+    typename PatchT::Matrix2P pattern = PatchT::pattern2;
+    pattern.colwise() += pos.col(k++ % NUM_POSITIONS);
+
+    if (basalt::patch_interp::patchInBounds(img, pattern, 2)) {
+      basalt::patch_interp::interpGradPoints<Backend>(
+          img, pattern.data(), PatchT::PATTERN_SIZE, val.data(),
+          grad.col(0).data(), grad.col(1).data());
+    }
+    benchmark::DoNotOptimize(val);
+    benchmark::DoNotOptimize(grad);
+  }
+}
+
+// Full patch operations as used by the optical flow frontends
+template <typename Pattern>
+void BM_PatchSetFromImage(benchmark::State& state) {
+  using PatchT = basalt::OpticalFlowPatch<float, Pattern>;
+
+  const basalt::Image<const uint16_t> img =
+      benchmarkImage().Reinterpret<const uint16_t>();
+  const auto pos = randomPositions<float>(NUM_POSITIONS);
+
+  PatchT p;
+  int k = 0;
+  for (auto _ : state) {
+    p.setFromImage(img, pos.col(k++ % NUM_POSITIONS));
+    benchmark::DoNotOptimize(p);
+  }
+}
+
+template <typename Pattern>
+void BM_PatchResidual(benchmark::State& state) {
+  using PatchT = basalt::OpticalFlowPatch<float, Pattern>;
+
+  const basalt::Image<const uint16_t> img =
+      benchmarkImage().Reinterpret<const uint16_t>();
+  const auto pos = randomPositions<float>(NUM_POSITIONS);
+
+  std::vector<PatchT, Eigen::aligned_allocator<PatchT>> patches;
+  for (int i = 0; i < NUM_POSITIONS; i++) {
+    patches.emplace_back(img, pos.col(i));
+  }
+
+  typename PatchT::VectorP res;
+  int k = 0;
+  for (auto _ : state) {
+    const int i = k++ % NUM_POSITIONS;
+
+    // residual at a slightly shifted position, as in a tracking iteration
+    typename PatchT::Matrix2P pattern = PatchT::pattern2;
+    pattern.colwise() += pos.col(i) + Eigen::Vector2f(0.3, -0.2);
+
+    benchmark::DoNotOptimize(patches[i].residual(img, pattern, res));
+    benchmark::DoNotOptimize(res);
+  }
+}
+
+}  // namespace
+
+using basalt::Pattern24;
+using basalt::Pattern50;
+using basalt::Pattern51;
+using basalt::Pattern52;
+namespace patch_interp = basalt::patch_interp;
+
+#define BASALT_PATCH_BENCHMARKS(Pattern)                                 \
+  BENCHMARK_TEMPLATE(BM_InterpPerPoint, Pattern<float>);                 \
+  BENCHMARK_TEMPLATE(BM_InterpBatch, Pattern<float>,                     \
+                     patch_interp::Scalar);                              \
+  BENCHMARK_TEMPLATE(BM_InterpBatch, Pattern<float>,                     \
+                     patch_interp::Default);                             \
+  BENCHMARK_TEMPLATE(BM_InterpGradPerPoint, Pattern<float>);             \
+  BENCHMARK_TEMPLATE(BM_InterpGradBatch, Pattern<float>,                 \
+                     patch_interp::Scalar);                              \
+  BENCHMARK_TEMPLATE(BM_InterpGradBatch, Pattern<float>,                 \
+                     patch_interp::Default);                             \
+  BENCHMARK_TEMPLATE(BM_PatchSetFromImage, Pattern<float>);              \
+  BENCHMARK_TEMPLATE(BM_PatchResidual, Pattern<float>)
+
+BASALT_PATCH_BENCHMARKS(Pattern24);
+BASALT_PATCH_BENCHMARKS(Pattern50);
+BASALT_PATCH_BENCHMARKS(Pattern51);
+BASALT_PATCH_BENCHMARKS(Pattern52);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,56 @@
+#include <limits>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <basalt/optical_flow/image_pyramid.h>
+
+namespace {
+
+template <typename T>
+basalt::ManagedImage<T> randomImage(size_t w, size_t h) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, std::numeric_limits<T>::max());
+
+  basalt::ManagedImage<T> img(w, h);
+  for (size_t y = 0; y < h; y++) {
+    for (size_t x = 0; x < w; x++) {
+      img(x, y) = dist(gen);
+    }
+  }
+  return img;
+}
+
+// Pyramid of one camera image with the default number of optical flow
+// levels for 16 and 8 bit pixels. Arguments are the image width and height.
+template <basalt::PyramidType Type, typename T>
+void BM_PyramidSetFromImage(benchmark::State& state) {
+  const basalt::ManagedImage<T> img =
+      randomImage<T>(state.range(0), state.range(1));
+  const int levels = basalt::VioConfig().optical_flow_levels;
+
+  basalt::OpticalFlowPyr<T> pyr;
+  for (auto _ : state) {
+    pyr.setFromImage(img, levels, Type);
+    benchmark::DoNotOptimize(pyr.lvl(levels).ptr);
+    benchmark::ClobberMemory();
+  }
+}
+
+}  // namespace
+
+// EuRoC (752x480) and T265 (848x800) resolutions
+#define BASALT_PYRAMID_BENCHMARK(Type, T)                                     \
+  BENCHMARK_TEMPLATE(BM_PyramidSetFromImage, basalt::PyramidType::Type, T)    \
+      ->Args({752, 480})                                                      \
+      ->Args({848, 800})                                                      \
+      ->Unit(benchmark::kMillisecond)
+
+BASALT_PYRAMID_BENCHMARK(REFERENCE, uint16_t);
+BASALT_PYRAMID_BENCHMARK(GAUSSIAN5, uint16_t);
+BASALT_PYRAMID_BENCHMARK(BOX2X2, uint16_t);
+BASALT_PYRAMID_BENCHMARK(REFERENCE, uint8_t);
+BASALT_PYRAMID_BENCHMARK(GAUSSIAN5, uint8_t);
+BASALT_PYRAMID_BENCHMARK(BOX2X2, uint8_t);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <basalt/imu/preintegration.h>
+#include <basalt/vi_estimator/ba_base.h>
+
+// Synthetic visual odometry problems shared by the linearization tests and
+// the estimator benchmarks. Every frame hosts 10 landmarks that are observed
+// by both cameras of the host frame and of all frames before it. Frame i has
+// the timestamp i * frame_dt_ns.
+
+template <class Scalar>
+void get_vo_estimator(int num_frames,
+                      basalt::BundleAdjustmentBase<Scalar>& estimator,
+                      basalt::AbsOrderMap& aom, int64_t frame_dt_ns = 1) {
+  static constexpr int POSE_SIZE = 6;
+
+  estimator.huber_thresh = 0.5;
+  estimator.obs_std_dev = 2.0;
+
+  estimator.calib.T_i_c.emplace_back(
+      Sophus::se3_expd(Sophus::Vector6d::Random() / 100));
+  estimator.calib.T_i_c.emplace_back(
+      Sophus::se3_expd(Sophus::Vector6d::Random() / 100));
+
+  basalt::GenericCamera<Scalar> cam;
+  cam.variant = basalt::KannalaBrandtCamera4<Scalar>::getTestProjections()[0];
+
+  estimator.calib.intrinsics.emplace_back(cam);
+  estimator.calib.intrinsics.emplace_back(cam);
+
+  Eigen::MatrixXd points_3d;
+  points_3d.setRandom(3, num_frames * 10);
+  points_3d.row(2).array() += 5.0;
+
+  aom.total_size = 0;
+
+  for (int i = 0; i < num_frames; i++) {
+    const int64_t t_ns = i * frame_dt_ns;
+
+    Sophus::SE3d T_w_i;
+    T_w_i.so3() = Sophus::SO3d::exp(Eigen::Vector3d::Random() / 100);
+    T_w_i.translation()[0] = i * 0.1;
+
+    aom.abs_order_map[t_ns] = std::make_pair(i * POSE_SIZE, POSE_SIZE);
+    aom.total_size += POSE_SIZE;
+
+    estimator.frame_poses[t_ns] = basalt::PoseStateWithLin(t_ns, T_w_i, false);
+
+    for (int j = 0; j < 10; j++) {
+      const int kp_idx = 10 * i + j;
+      Eigen::Vector3d p3d = points_3d.col(kp_idx);
+      basalt::Keypoint<Scalar> kpt;
+
+      Sophus::SE3d T_c_w = estimator.calib.T_i_c[0].inverse() * T_w_i.inverse();
+      Eigen::Vector3d p3d_cam = T_c_w * p3d;
+
+      kpt.direction =
+          basalt::StereographicParam<Scalar>::project(p3d_cam.homogeneous());
+      kpt.inv_dist = 1.0 / p3d_cam.norm();
+      kpt.host_kf_id = basalt::TimeCamId(t_ns, 0);
+
+      estimator.lmdb.addLandmark(kp_idx, kpt);
+
+      for (const auto& [frame_id, frame_pose] : estimator.frame_poses) {
+        for (int c = 0; c < 2; c++) {
+          basalt::TimeCamId tcid(frame_id, c);
+          Sophus::SE3d T_c_w = estimator.calib.T_i_c[c].inverse() *
+                               frame_pose.getPose().inverse();
+
+          Eigen::Vector3d p3d_cam = T_c_w * p3d;
+          Eigen::Vector2d p2d_cam;
+          cam.project(p3d_cam, p2d_cam);
+
+          p2d_cam += Eigen::Vector2d::Random() / 100;
+
+          basalt::KeypointObservation<Scalar> ko;
+          ko.kpt_id = kp_idx;
+          ko.pos = p2d_cam;
+
+          estimator.lmdb.addObservation(tcid, ko);
+        }
+      }
+    }
+  }
+}
+
+template <class Scalar>
+void get_vo_estimator_with_marg(int num_frames,
+                                basalt::BundleAdjustmentBase<Scalar>& estimator,
+                                basalt::AbsOrderMap& aom,
+                                basalt::MargLinData<Scalar>& mld) {
+  static constexpr int POSE_SIZE = 6;
+
+  get_vo_estimator(num_frames, estimator, aom);
+
+  mld.H.setIdentity(2 * POSE_SIZE, 2 * POSE_SIZE);
+  mld.H *= 1e6;
+
+  mld.b.setRandom(2 * POSE_SIZE);
+  mld.b *= 10;
+
+  mld.order.abs_order_map[0] = std::make_pair(0, POSE_SIZE);
+  mld.order.abs_order_map[1] = std::make_pair(POSE_SIZE, POSE_SIZE);
+  mld.order.total_size = 2 * POSE_SIZE;
+
+  estimator.frame_poses[0].setLinTrue();
+  estimator.frame_poses[1].setLinTrue();
+
+  estimator.frame_poses[0].applyInc(Sophus::Vector6d::Random() / 100);
+  estimator.frame_poses[1].applyInc(Sophus::Vector6d::Random() / 100);
+}
+
+// Visual-inertial window: the last num_states frames are states that are
+// connected by IMU measurements at 200 Hz, the frames before them keyframe
+// poses. The frames are 50 ms apart.
+template <class Scalar>
+void get_vio_estimator(
+    int num_frames, int num_states,
+    basalt::BundleAdjustmentBase<Scalar>& estimator, basalt::AbsOrderMap& aom,
+    Eigen::aligned_map<int64_t, basalt::IntegratedImuMeasurement<Scalar>>&
+        imu_meas) {
+  static constexpr int POSE_SIZE = 6;
+  static constexpr int64_t FRAME_DT_NS = 50000000;
+  static constexpr int64_t IMU_DT_NS = 5000000;
+
+  get_vo_estimator(num_frames, estimator, aom, FRAME_DT_NS);
+
+  // Poses before states, as in the order of the estimator
+  aom.abs_order_map.clear();
+  aom.total_size = 0;
+
+  for (int i = 0; i < num_frames; i++) {
+    const int64_t t_ns = i * FRAME_DT_NS;
+
+    if (i < num_frames - num_states) {
+      aom.abs_order_map[t_ns] = std::make_pair(aom.total_size, POSE_SIZE);
+      aom.total_size += POSE_SIZE;
+      continue;
+    }
+
+    const Sophus::SE3d T_w_i = estimator.frame_poses.at(t_ns).getPose();
+    estimator.frame_poses.erase(t_ns);
+
+    estimator.frame_states[t_ns] = basalt::PoseVelBiasStateWithLin<Scalar>(
+        t_ns, T_w_i, Eigen::Vector3d(2, 0, 0) + Eigen::Vector3d::Random() / 10,
+        Eigen::Vector3d::Random() / 100, Eigen::Vector3d::Random() / 100,
+        false);
+
+    aom.abs_order_map[t_ns] =
+        std::make_pair(aom.total_size, basalt::POSE_VEL_BIAS_SIZE);
+    aom.total_size += basalt::POSE_VEL_BIAS_SIZE;
+  }
+
+  const Eigen::Vector3d accel_cov = Eigen::Vector3d::Constant(1e-4);
+  const Eigen::Vector3d gyro_cov = Eigen::Vector3d::Constant(1e-6);
+
+  for (int i = num_frames - num_states; i + 1 < num_frames; i++) {
+    const int64_t t_ns = i * FRAME_DT_NS;
+    const auto& state = estimator.frame_states.at(t_ns).getState();
+
+    basalt::IntegratedImuMeasurement<Scalar> meas(t_ns, state.bias_gyro,
+                                                  state.bias_accel);
+    for (int64_t t = t_ns + IMU_DT_NS; t <= t_ns + FRAME_DT_NS;
+         t += IMU_DT_NS) {
+      basalt::ImuData<Scalar> data;
+      data.t_ns = t;
+      data.accel = Eigen::Vector3d(0, 0, 9.81) + Eigen::Vector3d::Random() / 10;
+      data.gyro = Eigen::Vector3d::Random() / 10;
+      meas.integrate(data, accel_cov, gyro_cov);
+    }
+
+    imu_meas.emplace(t_ns, meas);
+  }
+}
@@ -0,0 +1,127 @@
+#include <random>
+
+#include <basalt/utils/camera_batch.h>
+
+#include "gtest/gtest.h"
+
+template <typename CamT>
+class CameraBatchTest : public ::testing::Test {};
+
+typedef ::testing::Types<
+    basalt::PinholeCamera<double>, basalt::KannalaBrandtCamera4<double>,
+    basalt::ExtendedUnifiedCamera<double>, basalt::DoubleSphereCamera<double>,
+    basalt::UnifiedCamera<double>, basalt::FovCamera<double>>
+    CameraTypes;
+
+TYPED_TEST_SUITE(CameraBatchTest, CameraTypes);
+
+namespace {
+
+// Random points with a few on and next to the optical axis, where the models
+// switch to their limit form. The count is not a multiple of the chunk size.
+basalt::CameraBatch<double>::Points3d randomPoints() {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> dist_xy(-2, 2), dist_z(-0.5, 3);
+
+  basalt::CameraBatch<double>::Points3d p3d(203, 4);
+  for (int i = 0; i < p3d.rows(); i++) {
+    p3d.row(i) << dist_xy(gen), dist_xy(gen), dist_z(gen), 0.5;
+  }
+
+  p3d.row(0) << 0, 0, 1, 0.5;
+  p3d.row(1) << 1e-10, -1e-10, 2, 0.5;
+  p3d.row(2) << 0, 0, -1, 0.5;
+  p3d.row(17) << 1e-3, 1e-3, 1, 0.5;
+
+  return p3d;
+}
+
+}  // namespace
+
+// The batch results through GenericCamera have to be identical to the
+// per-point projection of the model
+TYPED_TEST(CameraBatchTest, ProjectUnprojectMatchPerPoint) {
+  using Batch = basalt::CameraBatch<double>;
+
+  const Batch::Points3d p3d = randomPoints();
+
+  for (const TypeParam& cam : TypeParam::getTestProjections()) {
+    basalt::GenericCamera<double> gcam;
+    gcam.variant = cam;
+
+    Batch::Points2d proj;
+    Batch::Mask valid;
+    Batch::Jacobians d_proj_d_p3d;
+    basalt::projectBatch(gcam, p3d, proj, valid, &d_proj_d_p3d);
+
+    ASSERT_EQ(p3d.rows(), proj.rows());
+
+    for (int i = 0; i < p3d.rows(); i++) {
+      Eigen::Vector2d p;
+      Eigen::Matrix<double, 2, 4> J;
+      const bool v = cam.project(p3d.row(i).transpose().eval(), p, &J);
+
+      EXPECT_EQ(v, bool(valid[i])) << "row " << i;
+      if (v) {
+        EXPECT_TRUE(proj.row(i).transpose().isApprox(p)) << "row " << i;
+        EXPECT_TRUE(Eigen::Map<const Eigen::Matrix<double, 1, 8>>(J.data())
+                        .isApprox(d_proj_d_p3d.row(i)))
+            << "row " << i;
+      }
+    }
+
+    Batch::Points3d p3d_unproj;
+    Batch::Mask valid_unproj;
+    Batch::Jacobians d_p3d_d_proj;
+    basalt::unprojectBatch(gcam, proj, p3d_unproj, valid_unproj,
+                           &d_p3d_d_proj);
+
+    ASSERT_EQ(proj.rows(), p3d_unproj.rows());
+
+    for (int i = 0; i < p3d.rows(); i++) {
+      if (!valid[i]) continue;
+
+      Eigen::Vector4d p;
+      Eigen::Matrix<double, 4, 2> J;
+      const bool v = cam.unproject(proj.row(i).transpose().eval(), p, &J);
+
+      EXPECT_EQ(v, bool(valid_unproj[i])) << "row " << i;
+      if (v) {
+        EXPECT_TRUE(p3d_unproj.row(i).transpose().isApprox(p)) << "row " << i;
+        EXPECT_TRUE(Eigen::Map<const Eigen::Matrix<double, 1, 8>>(J.data())
+                        .isApprox(d_p3d_d_proj.row(i)))
+            << "row " << i;
+      }
+    }
+  }
+}
+
+// Batches with a fixed capacity give the same results as dynamic ones
+TYPED_TEST(CameraBatchTest, FixedCapacityMatchesDynamic) {
+  using Batch = basalt::CameraBatch<double>;
+  using FixedBatch = basalt::CameraBatch<double, 8>;
+
+  const Batch::Points3d p3d = randomPoints().topRows(8);
+
+  for (const TypeParam& cam : TypeParam::getTestProjections()) {
+    Batch::Points2d proj;
+    Batch::Mask valid;
+    Batch::Jacobians d_proj_d_p3d;
+    basalt::projectBatch(cam, p3d, proj, valid, &d_proj_d_p3d);
+
+    const FixedBatch::Points3d p3d_fixed = p3d.topRows(5);
+    FixedBatch::Points2d proj_fixed;
+    FixedBatch::Mask valid_fixed;
+    FixedBatch::Jacobians d_proj_d_p3d_fixed;
+    basalt::projectBatch(cam, p3d_fixed, proj_fixed, valid_fixed,
+                         &d_proj_d_p3d_fixed);
+
+    ASSERT_EQ(5, proj_fixed.rows());
+    EXPECT_TRUE(valid.head(5) == valid_fixed);
+    for (int i = 0; i < 5; i++) {
+      if (!valid[i]) continue;
+      EXPECT_TRUE(proj.row(i).isApprox(proj_fixed.row(i)));
+      EXPECT_TRUE(d_proj_d_p3d.row(i).isApprox(d_proj_d_p3d_fixed.row(i)));
+    }
+  }
+}
@@ -0,0 +1,205 @@
+#include <basalt/io/dataset_io_binary.h>
+#include <basalt/utils/filesystem.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Two cameras, the first one with 8 bit and the second one with 16 bit
+// images. The second camera has no image in every third frame.
+class TestDataset : public basalt::VioDataset {
+ public:
+  TestDataset() {
+    for (int i = 0; i < 10; i++) {
+      timestamps.push_back(1000 + 50 * i);
+    }
+
+    for (int i = 0; i < 40; i++) {
+      basalt::AccelData a;
+      a.timestamp_ns = 1000 + 12 * i;
+      a.data = Eigen::Vector3d(0.1 * i, -9.81, 0.5);
+      accel_data.push_back(a);
+
+      basalt::GyroData g;
+      g.timestamp_ns = 1000 + 12 * i;
+      g.data = Eigen::Vector3d(0.01, -0.02 * i, 0.03);
+      gyro_data.push_back(g);
+    }
+
+    for (int i = 0; i < 5; i++) {
+      gt_timestamps.push_back(1000 + 100 * i);
+      gt_pose_data.push_back(Sophus::SE3d(
+          Sophus::SO3d::exp(Eigen::Vector3d(0.1, 0.2 * i, -0.3)),
+          Eigen::Vector3d(i, 2, -1)));
+    }
+  }
+
+  size_t get_num_cams() const override { return 2; }
+
+  std::vector<int64_t> &get_image_timestamps() override { return timestamps; }
+
+  const Eigen::aligned_vector<basalt::AccelData> &get_accel_data()
+      const override {
+    return accel_data;
+  }
+  const Eigen::aligned_vector<basalt::GyroData> &get_gyro_data()
+      const override {
+    return gyro_data;
+  }
+  const std::vector<int64_t> &get_gt_timestamps() const override {
+    return gt_timestamps;
+  }
+  const Eigen::aligned_vector<Sophus::SE3d> &get_gt_pose_data()
+      const override {
+    return gt_pose_data;
+  }
+  int64_t get_mocap_to_imu_offset_ns() const override { return 42; }
+
+  std::vector<basalt::ImageData> get_image_data(int64_t t_ns) override {
+    const int idx = (t_ns - 1000) / 50;
+
+    std::vector<basalt::ImageData> res(2);
+
+    res[0].exposure = 0.001 * idx;
+    res[0].img_u8.reset(new basalt::ManagedImage<uint8_t>(64, 48));
+    for (size_t y = 0; y < 48; y++) {
+      for (size_t x = 0; x < 64; x++) {
+        (*res[0].img_u8)(x, y) = (x + y + idx) % 256;
+      }
+    }
+
+    if (idx % 3 != 0) {
+      res[1].exposure = 0.002 * idx;
+      res[1].img.reset(new basalt::ManagedImage<uint16_t>(32, 24));
+      for (size_t y = 0; y < 24; y++) {
+        for (size_t x = 0; x < 32; x++) {
+          (*res[1].img)(x, y) = 1000 * x + 7 * y + idx;
+        }
+      }
+    }
+
+    return res;
+  }
+
+ private:
+  std::vector<int64_t> timestamps;
+  Eigen::aligned_vector<basalt::AccelData> accel_data;
+  Eigen::aligned_vector<basalt::GyroData> gyro_data;
+  std::vector<int64_t> gt_timestamps;
+  Eigen::aligned_vector<Sophus::SE3d> gt_pose_data;
+};
+
+template <typename T>
+void expectImagesEqual(const basalt::ManagedImage<T> &a,
+                       const basalt::ManagedImage<T> &b) {
+  ASSERT_EQ(a.w, b.w);
+  ASSERT_EQ(a.h, b.h);
+  for (size_t y = 0; y < a.h; y++) {
+    for (size_t x = 0; x < a.w; x++) {
+      ASSERT_EQ(a(x, y), b(x, y)) << "pixel " << x << " " << y;
+    }
+  }
+}
+
+void expectDatasetsEqual(basalt::VioDataset &expected,
+                         basalt::VioDataset &actual) {
+  ASSERT_EQ(expected.get_num_cams(), actual.get_num_cams());
+  ASSERT_EQ(expected.get_image_timestamps(), actual.get_image_timestamps());
+  EXPECT_EQ(expected.get_mocap_to_imu_offset_ns(),
+            actual.get_mocap_to_imu_offset_ns());
+
+  ASSERT_EQ(expected.get_accel_data().size(), actual.get_accel_data().size());
+  for (size_t i = 0; i < expected.get_accel_data().size(); i++) {
+    EXPECT_EQ(expected.get_accel_data()[i].timestamp_ns,
+              actual.get_accel_data()[i].timestamp_ns);
+    EXPECT_EQ(expected.get_accel_data()[i].data,
+              actual.get_accel_data()[i].data);
+    EXPECT_EQ(expected.get_gyro_data()[i].timestamp_ns,
+              actual.get_gyro_data()[i].timestamp_ns);
+    EXPECT_EQ(expected.get_gyro_data()[i].data,
+              actual.get_gyro_data()[i].data);
+  }
+
+  ASSERT_EQ(expected.get_gt_timestamps(), actual.get_gt_timestamps());
+  for (size_t i = 0; i < expected.get_gt_pose_data().size(); i++) {
+    EXPECT_TRUE(expected.get_gt_pose_data()[i].matrix().isApprox(
+        actual.get_gt_pose_data()[i].matrix(), 1e-12));
+  }
+
+  for (int64_t t_ns : expected.get_image_timestamps()) {
+    const std::vector<basalt::ImageData> img_expected =
+        expected.get_image_data(t_ns);
+    const std::vector<basalt::ImageData> img_actual =
+        actual.get_image_data(t_ns);
+
+    ASSERT_EQ(img_expected.size(), img_actual.size());
+    for (size_t i = 0; i < img_expected.size(); i++) {
+      EXPECT_EQ(img_expected[i].exposure, img_actual[i].exposure);
+      ASSERT_EQ(bool(img_expected[i].img), bool(img_actual[i].img));
+      ASSERT_EQ(bool(img_expected[i].img_u8), bool(img_actual[i].img_u8));
+
+      if (img_expected[i].img) {
+        expectImagesEqual(*img_expected[i].img, *img_actual[i].img);
+      }
+      if (img_expected[i].img_u8) {
+        expectImagesEqual(*img_expected[i].img_u8, *img_actual[i].img_u8);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(DatasetIoBinaryTestSuite, WriteRead) {
+  const std::string path =
+      (basalt::fs::temp_directory_path() / "basalt_test_dataset.bin")
+          .string();
+
+  for (bool compress : {false, true}) {
+    TestDataset dataset;
+    basalt::saveBinaryDataset(dataset, path, compress);
+
+    basalt::BinaryIO io;
+    io.read(path);
+    basalt::VioDatasetPtr data = io.get_data();
+
+    data->native_8bit_images = true;
+    expectDatasetsEqual(dataset, *data);
+
+    // 8 bit images are shifted to 16 bit like by the other readers
+    data->native_8bit_images = false;
+    const std::vector<basalt::ImageData> img_data =
+        data->get_image_data(dataset.get_image_timestamps()[4]);
+    ASSERT_TRUE(img_data[0].img);
+    EXPECT_FALSE(img_data[0].img_u8);
+    EXPECT_EQ(((3 + 5 + 4) % 256) << 8, (*img_data[0].img)(3, 5));
+  }
+
+  basalt::fs::remove(path);
+}
+
+TEST(DatasetIoBinaryTestSuite, ImagesOutliveDataset) {
+  const std::string path =
+      (basalt::fs::temp_directory_path() / "basalt_test_dataset_images.bin")
+          .string();
+
+  TestDataset dataset;
+  basalt::saveBinaryDataset(dataset, path, false);
+
+  std::vector<basalt::ImageData> img_data;
+  {
+    basalt::BinaryIO io;
+    io.read(path);
+    img_data = io.get_data()->get_image_data(1100);
+  }
+
+  // the mapping is copy-on-write, writing does not change the file
+  (*img_data[1].img)(1, 1) = 0;
+  EXPECT_EQ(2000 + 7 * 2 + 2, (*img_data[1].img)(2, 2));
+
+  basalt::BinaryIO io;
+  io.read(path);
+  EXPECT_EQ(1000 + 7 + 2, (*io.get_data()->get_image_data(1100)[1].img)(1, 1));
+
+  basalt::fs::remove(path);
+}
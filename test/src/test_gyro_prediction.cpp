@@ -0,0 +1,78 @@
+#include <basalt/optical_flow/optical_flow.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+basalt::ImuData<double>::Ptr gyroSample(int64_t t_ns,
+                                        const Eigen::Vector3d& gyro) {
+  basalt::ImuData<double>::Ptr data(new basalt::ImuData<double>);
+  data->t_ns = t_ns;
+  data->accel.setZero();
+  data->gyro = gyro;
+  return data;
+}
+
+}  // namespace
+
+TEST(GyroPredictionTestSuite, IntegrateGyroPiecewiseConstant) {
+  basalt::OpticalFlowBase flow;
+
+  const Eigen::Vector3d w0(0.3, -0.2, 0.5), w1(-0.1, 0.4, 0.2);
+  const int64_t dt_ns = 5000000;
+
+  // 200 Hz, rate changes at 100 ms
+  for (int k = 0; k <= 40; k++) {
+    flow.imu_data_queue.push(gyroSample(k * dt_ns, k < 20 ? w0 : w1));
+  }
+  flow.imu_data_queue.push(nullptr);
+
+  // Interval boundaries between samples
+  const Sophus::SO3d R_a = flow.integrateGyro(12000000, 62000000);
+  const Sophus::SO3d R_a_ref = Sophus::SO3d::exp(w0 * 0.05);
+  EXPECT_TRUE(R_a.unit_quaternion().isApprox(R_a_ref.unit_quaternion(), 1e-9));
+
+  const Sophus::SO3d R_b = flow.integrateGyro(62000000, 137000000);
+  const Sophus::SO3d R_b_ref =
+      Sophus::SO3d::exp(w0 * 0.038) * Sophus::SO3d::exp(w1 * 0.037);
+  EXPECT_TRUE(R_b.unit_quaternion().isApprox(R_b_ref.unit_quaternion(), 1e-9));
+
+  // The last sample holds after the end of the IMU input
+  const Sophus::SO3d R_c = flow.integrateGyro(137000000, 250000000);
+  const Sophus::SO3d R_c_ref = Sophus::SO3d::exp(w1 * 0.113);
+  EXPECT_TRUE(R_c.unit_quaternion().isApprox(R_c_ref.unit_quaternion(), 1e-9));
+}
+
+TEST(GyroPredictionTestSuite, IntegrateGyroEmptyInterval) {
+  basalt::OpticalFlowBase flow;
+
+  // Must not wait for samples, the queue is empty and not terminated
+  const Sophus::SO3d R = flow.integrateGyro(10000000, 10000000);
+  EXPECT_TRUE(R.unit_quaternion().isApprox(Eigen::Quaterniond::Identity()));
+  EXPECT_EQ(flow.imu_data_queue.size(), 0);
+}
+
+TEST(GyroPredictionTestSuite, PredictRotationHomography) {
+  basalt::GenericCamera<double> cam;
+  cam.variant = basalt::KannalaBrandtCamera4<double>::getTestProjections()[0];
+
+  const Eigen::Matrix3d R_2_1 =
+      Sophus::SO3d::exp(Eigen::Vector3d(0.02, -0.05, 0.03)).matrix();
+
+  for (double x = -0.4; x <= 0.4; x += 0.2) {
+    for (double y = -0.3; y <= 0.3; y += 0.2) {
+      const Eigen::Vector4d p3d_1(x, y, 1, 0);
+      Eigen::Vector4d p3d_2 = p3d_1;
+      p3d_2.head<3>() = R_2_1 * p3d_1.head<3>();
+
+      Eigen::Vector2d p_1, p_2;
+      ASSERT_TRUE(cam.project(p3d_1, p_1));
+      ASSERT_TRUE(cam.project(p3d_2, p_2));
+
+      const Eigen::Vector2d p_2_pred =
+          basalt::OpticalFlowBase::predictRotation(cam, R_2_1, p_1);
+      EXPECT_TRUE(p_2_pred.isApprox(p_2, 1e-6))
+          << "p_2_pred " << p_2_pred.transpose() << " p_2 " << p_2.transpose();
+    }
+  }
+}
@@ -0,0 +1,83 @@
+#include <limits>
+#include <random>
+
+#include <basalt/optical_flow/image_pyramid.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+template <typename T = uint16_t>
+basalt::ManagedImage<T> randomImage(size_t w, size_t h) {
+  std::mt19937 gen(w * 1000 + h);
+  std::uniform_int_distribution<int> dist(0, std::numeric_limits<T>::max());
+
+  basalt::ManagedImage<T> img(w, h);
+  for (size_t y = 0; y < h; y++) {
+    for (size_t x = 0; x < w; x++) {
+      img(x, y) = dist(gen);
+    }
+  }
+  return img;
+}
+
+template <typename T>
+void expectGaussian5MatchesReference() {
+  // even, odd and non-multiple of the vector width sizes
+  const std::vector<std::pair<size_t, size_t>> sizes = {
+      {752, 480}, {848, 800}, {101, 67}, {37, 41}, {8, 6}};
+
+  for (const auto& [w, h] : sizes) {
+    const basalt::ManagedImage<T> img = randomImage<T>(w, h);
+
+    basalt::OpticalFlowPyr<T> pyr_ref, pyr;
+    pyr_ref.setFromImage(img, 3, basalt::PyramidType::REFERENCE);
+    pyr.setFromImage(img, 3, basalt::PyramidType::GAUSSIAN5);
+
+    for (size_t l = 0; l <= 3; l++) {
+      const basalt::Image<const T> lvl_ref = pyr_ref.lvl(l);
+      const basalt::Image<const T> lvl = pyr.lvl(l);
+
+      ASSERT_EQ(lvl_ref.w, lvl.w);
+      ASSERT_EQ(lvl_ref.h, lvl.h);
+
+      for (size_t y = 0; y < lvl.h; y++) {
+        for (size_t x = 0; x < lvl.w; x++) {
+          ASSERT_EQ(lvl_ref(x, y), lvl(x, y))
+              << "size " << w << "x" << h << " level " << l << " pixel " << x
+              << " " << y;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(ImagePyramidTestSuite, Gaussian5MatchesReference) {
+  expectGaussian5MatchesReference<uint16_t>();
+}
+
+TEST(ImagePyramidTestSuite, Gaussian5MatchesReference8Bit) {
+  expectGaussian5MatchesReference<uint8_t>();
+}
+
+TEST(ImagePyramidTestSuite, Box2x2) {
+  const basalt::ManagedImage<uint16_t> img = randomImage(101, 67);
+
+  basalt::OpticalFlowPyr<uint16_t> pyr;
+  pyr.setFromImage(img, 2, basalt::PyramidType::BOX2X2);
+
+  for (size_t l = 0; l < 2; l++) {
+    const basalt::Image<const uint16_t> lvl = pyr.lvl(l);
+    const basalt::Image<const uint16_t> lvl_sub = pyr.lvl(l + 1);
+
+    for (size_t y = 0; y < lvl_sub.h; y++) {
+      for (size_t x = 0; x < lvl_sub.w; x++) {
+        const int sum = lvl(2 * x, 2 * y) + lvl(2 * x + 1, 2 * y) +
+                        lvl(2 * x, 2 * y + 1) + lvl(2 * x + 1, 2 * y + 1);
+        ASSERT_EQ((sum + 2) / 4, lvl_sub(x, y));
+      }
+    }
+  }
+}
@@ -0,0 +1,100 @@
+#include <map>
+#include <random>
+
+#include <basalt/optical_flow/keypoint_tracks.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+Eigen::AffineCompact2f randomTransform(std::mt19937& gen) {
+  std::uniform_real_distribution<float> dist(-100, 100);
+
+  Eigen::AffineCompact2f t;
+  t.linear() << dist(gen), dist(gen), dist(gen), dist(gen);
+  t.translation() << dist(gen), dist(gen);
+  return t;
+}
+
+void expectEqual(
+    const std::map<basalt::KeypointId, Eigen::AffineCompact2f>& reference,
+    const basalt::KeypointTracks& tracks) {
+  ASSERT_EQ(reference.size(), tracks.size());
+
+  size_t i = 0;
+  for (const auto& kv : reference) {
+    EXPECT_EQ(kv.first, tracks.id(i));
+    EXPECT_EQ(i, tracks.index(kv.first));
+    EXPECT_TRUE(kv.second.matrix() == tracks.transform(i).matrix());
+    i++;
+  }
+}
+
+}  // namespace
+
+TEST(KeypointTracksTestSuite, LookupMatchesMap) {
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> id_step(1, 5);
+
+  std::map<basalt::KeypointId, Eigen::AffineCompact2f> reference;
+  basalt::KeypointTracks tracks;
+
+  EXPECT_EQ(basalt::KeypointTracks::INVALID_INDEX, tracks.index(0));
+
+  basalt::KeypointId id = 0;
+  for (int i = 0; i < 1000; i++) {
+    id += id_step(gen);
+    const Eigen::AffineCompact2f t = randomTransform(gen);
+    reference[id] = t;
+    tracks.push_back(id, t, i % 3);
+    EXPECT_EQ(size_t(i % 3), tracks.level(i));
+  }
+
+  expectEqual(reference, tracks);
+
+  for (basalt::KeypointId i = 0; i <= id + 10; i++) {
+    EXPECT_EQ(reference.count(i) > 0, tracks.contains(i));
+  }
+
+  // out of order inserts and overwrites
+  for (int i = 0; i < 100; i++) {
+    const basalt::KeypointId new_id = gen() % (id + 100);
+    const Eigen::AffineCompact2f t = randomTransform(gen);
+    reference[new_id] = t;
+    tracks.insert(new_id, t);
+  }
+
+  expectEqual(reference, tracks);
+}
+
+TEST(KeypointTracksTestSuite, RemoveIf) {
+  std::mt19937 gen(5);
+
+  std::map<basalt::KeypointId, Eigen::AffineCompact2f> reference;
+  basalt::KeypointTracks tracks;
+
+  for (basalt::KeypointId id = 0; id < 500; id++) {
+    const Eigen::AffineCompact2f t = randomTransform(gen);
+    reference[id] = t;
+    tracks.push_back(id, t);
+  }
+
+  std::vector<uint8_t> remove(tracks.size());
+  for (auto& r : remove) r = gen() % 2;
+
+  for (size_t i = 0; i < remove.size(); i++) {
+    if (remove[i]) reference.erase(tracks.id(i));
+  }
+  tracks.removeIf([&](size_t i) { return remove[i]; });
+
+  expectEqual(reference, tracks);
+
+  reference.erase(reference.begin()->first);
+  tracks.erase(tracks.id(0));
+
+  expectEqual(reference, tracks);
+
+  tracks.clear();
+  EXPECT_TRUE(tracks.empty());
+  EXPECT_FALSE(tracks.contains(reference.begin()->first));
+}
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+#include <basalt/utils/keypoints.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Dark image with a bright square with the top left corner at (x, y) in
+// some of the grid cells.
+basalt::ManagedImage<uint16_t> squaresImage(
+    size_t w, size_t h, const std::vector<std::pair<int, int>>& squares) {
+  basalt::ManagedImage<uint16_t> img(w, h);
+  img.Fill(10000);
+
+  for (const auto& [x0, y0] : squares) {
+    for (int y = y0; y < y0 + 12; y++) {
+      for (int x = x0; x < x0 + 12; x++) {
+        img(x, y) = 50000;
+      }
+    }
+  }
+  return img;
+}
+
+const std::vector<std::pair<int, int>> squares = {
+    {60, 30}, {130, 70}, {215, 135}, {270, 180}};
+
+basalt::ManagedImage<uint16_t> randomImage(size_t size) {
+  std::mt19937 gen(size);
+  std::uniform_int_distribution<int> dist(0, 65535);
+
+  basalt::ManagedImage<uint16_t> img(size, size);
+  for (size_t y = 0; y < size; y++) {
+    for (size_t x = 0; x < size; x++) {
+      img(x, y) = dist(gen);
+    }
+  }
+  return img;
+}
+
+}  // namespace
+
+TEST(KeypointsTestSuite, GridFastDetectsCornerPerCell) {
+  const basalt::ManagedImage<uint16_t> img = squaresImage(320, 240, squares);
+
+  basalt::KeypointsData kd;
+  basalt::detectKeypoints(img.Reinterpret<const uint16_t>(), kd, 50, 1, {},
+                          basalt::KeypointDetectorType::GRID_FAST);
+
+  ASSERT_EQ(squares.size(), kd.corners.size());
+
+  // one corner per cell close to one of the square corners
+  for (const auto& [x0, y0] : squares) {
+    int num_found = 0;
+    for (const Eigen::Vector2d& c : kd.corners) {
+      if (c[0] >= x0 - 2 && c[0] <= x0 + 13 && c[1] >= y0 - 2 &&
+          c[1] <= y0 + 13) {
+        num_found++;
+      }
+    }
+    EXPECT_EQ(1, num_found) << "square " << x0 << " " << y0;
+  }
+}
+
+TEST(KeypointsTestSuite, GridFastSkipsOccupiedCells) {
+  const basalt::ManagedImage<uint16_t> img = squaresImage(320, 240, squares);
+
+  // point in the cell of the second square
+  Eigen::aligned_vector<Eigen::Vector2d> current_points;
+  current_points.emplace_back(140, 80);
+
+  basalt::KeypointsData kd;
+  basalt::detectKeypoints(img.Reinterpret<const uint16_t>(), kd, 50, 2,
+                          current_points,
+                          basalt::KeypointDetectorType::GRID_FAST);
+
+  // two corners in each of the other cells
+  ASSERT_EQ(2 * (squares.size() - 1), kd.corners.size());
+  for (const Eigen::Vector2d& c : kd.corners) {
+    EXPECT_FALSE(c[0] >= 110 && c[0] < 160 && c[1] >= 70 && c[1] < 120);
+  }
+}
+
+TEST(KeypointsTestSuite, GridFastMatchesOpenCVCells) {
+  const basalt::ManagedImage<uint16_t> img = squaresImage(320, 240, squares);
+
+  basalt::KeypointsData kd_opencv, kd_grid;
+  basalt::detectKeypoints(img.Reinterpret<const uint16_t>(), kd_opencv, 50, 1,
+                          {}, basalt::KeypointDetectorType::OPENCV_FAST);
+  basalt::detectKeypoints(img.Reinterpret<const uint16_t>(), kd_grid, 50, 1, {},
+                          basalt::KeypointDetectorType::GRID_FAST);
+
+  // both detectors emit the cells in the same order
+  ASSERT_EQ(kd_opencv.corners.size(), kd_grid.corners.size());
+  for (size_t i = 0; i < kd_grid.corners.size(); i++) {
+    EXPECT_LE((kd_opencv.corners[i] - kd_grid.corners[i]).norm(), 16.0);
+  }
+}
+
+TEST(KeypointsTestSuite, GridFastFlatImage) {
+  basalt::ManagedImage<uint16_t> img(320, 240);
+  img.Fill(30000);
+
+  basalt::KeypointsData kd;
+  basalt::detectKeypoints(img.Reinterpret<const uint16_t>(), kd, 50, 1, {},
+                          basalt::KeypointDetectorType::GRID_FAST);
+
+  EXPECT_TRUE(kd.corners.empty());
+}
+
+TEST(KeypointsTestSuite, GridFast8BitMatches16Bit) {
+  const basalt::ManagedImage<uint16_t> img_random = randomImage(320);
+
+  basalt::ManagedImage<uint8_t> img_u8(img_random.w, img_random.h);
+  basalt::ManagedImage<uint16_t> img_u16(img_random.w, img_random.h);
+  for (size_t y = 0; y < img_random.h; y++) {
+    for (size_t x = 0; x < img_random.w; x++) {
+      img_u8(x, y) = img_random(x, y) >> 8;
+      img_u16(x, y) = img_u8(x, y) << 8;
+    }
+  }
+
+  for (const auto type : {basalt::KeypointDetectorType::GRID_FAST,
+                          basalt::KeypointDetectorType::OPENCV_FAST}) {
+    basalt::KeypointsData kd_u8, kd_u16;
+    basalt::detectKeypoints(img_u8.Reinterpret<const uint8_t>(), kd_u8, 50, 2,
+                            {}, type);
+    basalt::detectKeypoints(img_u16.Reinterpret<const uint16_t>(), kd_u16, 50,
+                            2, {}, type);
+
+    EXPECT_FALSE(kd_u16.corners.empty());
+    EXPECT_EQ(kd_u16.corners, kd_u8.corners);
+  }
+}
+
+TEST(KeypointsTestSuite, AnglesMatchIntensityCentroid) {
+  const basalt::ManagedImage<uint16_t> img = randomImage(101);
+
+  basalt::KeypointsData kd;
+  for (int y = 20; y <= 80; y += 12) {
+    for (int x = 20; x <= 80; x += 12) {
+      kd.corners.emplace_back(x + 0.4, y + 0.7);
+    }
+  }
+
+  basalt::computeAngles(img, kd, true);
+
+  for (size_t i = 0; i < kd.corners.size(); i++) {
+    const int cx = kd.corners[i][0];
+    const int cy = kd.corners[i][1];
+
+    double m01 = 0, m10 = 0;
+    for (int x = -15; x <= 15; x++) {
+      for (int y = -15; y <= 15; y++) {
+        if (x * x + y * y <= 15 * 15) {
+          double val = img(cx + x, cy + y);
+          m01 += y * val;
+          m10 += x * val;
+        }
+      }
+    }
+
+    EXPECT_EQ(atan2(m01, m10), kd.corner_angles[i]);
+  }
+}
+
+TEST(KeypointsTestSuite, DescriptorsRotationInvariant) {
+  const basalt::ManagedImage<uint16_t> img = randomImage(101);
+
+  // image rotated by 90 degrees around the center (50, 50)
+  basalt::ManagedImage<uint16_t> img_rot(101, 101);
+  for (int y = 0; y < 101; y++) {
+    for (int x = 0; x < 101; x++) {
+      img_rot(100 - y, x) = img(x, y);
+    }
+  }
+
+  basalt::KeypointsData kd, kd_rot;
+  for (int y = 20; y <= 80; y += 15) {
+    for (int x = 20; x <= 80; x += 15) {
+      kd.corners.emplace_back(x, y);
+      kd_rot.corners.emplace_back(100 - y, x);
+    }
+  }
+
+  basalt::computeAngles(img, kd, true);
+  basalt::computeDescriptors(img, kd);
+  basalt::computeAngles(img_rot, kd_rot, true);
+  basalt::computeDescriptors(img_rot, kd_rot);
+
+  for (size_t i = 0; i < kd.corners.size(); i++) {
+    const double angle_diff = std::remainder(
+        kd_rot.corner_angles[i] - kd.corner_angles[i] - M_PI_2, 2 * M_PI);
+    EXPECT_NEAR(0, angle_diff, 1e-9);
+
+    // the pattern tables are exact up to rounding for 90 degree steps
+    const size_t num_diff =
+        (kd.corner_descriptors[i] ^ kd_rot.corner_descriptors[i]).count();
+    EXPECT_LE(num_diff, 2u) << "corner " << i;
+  }
+}
+
+TEST(KeypointsTestSuite, MatchDescriptorsBruteForce) {
+  std::mt19937_64 gen(5);
+
+  auto random_descriptor = [&]() {
+    std::bitset<256> d;
+    for (int k = 0; k < 4; k++) {
+      d |= std::bitset<256>(gen()) << (64 * k);
+    }
+    return d;
+  };
+
+  // noisy copies of some descriptors, duplicates and sizes that are not
+  // multiples of the vector width
+  std::vector<std::bitset<256>> desc_1(301), desc_2(211);
+  for (auto& d : desc_1) d = random_descriptor();
+  for (size_t j = 0; j < desc_2.size(); j++) {
+    if (j % 3 == 0) {
+      desc_2[j] = random_descriptor();
+    } else {
+      desc_2[j] = desc_1[(7 * j) % desc_1.size()];
+      for (size_t k = 0; k < j % 40; k++) desc_2[j].flip(gen() % 256);
+    }
+  }
+  desc_2[5] = desc_2[4];
+
+  for (double dist_2_best : {1.0, 1.2}) {
+    std::vector<std::pair<int, int>> matches;
+    basalt::matchDescriptors(desc_1, desc_2, matches, 70, dist_2_best);
+
+    // reference: best and second best match in both directions
+    auto best_match = [&](const std::vector<std::bitset<256>>& d1,
+                          const std::vector<std::bitset<256>>& d2, size_t i) {
+      int best_idx = -1, best_dist = 500, best2_dist = 500;
+      for (size_t j = 0; j < d2.size(); j++) {
+        const int dist = (d1[i] ^ d2[j]).count();
+        if (dist <= best_dist) {
+          best2_dist = best_dist;
+          best_dist = dist;
+          best_idx = j;
+        } else if (dist < best2_dist) {
+          best2_dist = dist;
+        }
+      }
+      return best_dist < 70 && best_dist * dist_2_best <= best2_dist
+                 ? best_idx
+                 : -1;
+    };
+
+    std::vector<std::pair<int, int>> matches_ref;
+    for (size_t i = 0; i < desc_1.size(); i++) {
+      const int j = best_match(desc_1, desc_2, i);
+      if (j >= 0 && best_match(desc_2, desc_1, j) == int(i)) {
+        matches_ref.emplace_back(i, j);
+      }
+    }
+
+    std::sort(matches.begin(), matches.end());
+    EXPECT_FALSE(matches_ref.empty());
+    EXPECT_EQ(matches_ref, matches) << "dist_2_best " << dist_2_best;
+  }
+}
+
+TEST(KeypointsTestSuite, MatchDescriptorsMultiIndexRecall) {
+  std::mt19937_64 gen(9);
+
+  auto random_descriptor = [&]() {
+    std::bitset<256> d;
+    for (int k = 0; k < 4; k++) {
+      d |= std::bitset<256>(gen()) << (64 * k);
+    }
+    return d;
+  };
+
+  // noisy copies with up to 50 flipped bits and unrelated descriptors
+  std::vector<std::bitset<256>> desc_1(800), desc_2(800);
+  for (auto& d : desc_1) d = random_descriptor();
+  for (size_t j = 0; j < desc_2.size(); j++) {
+    if (j % 4 == 0) {
+      desc_2[j] = random_descriptor();
+    } else {
+      desc_2[j] = desc_1[(13 * j) % desc_1.size()];
+      const int num_flips = gen() % 51;
+      for (int k = 0; k < num_flips; k++) desc_2[j].flip(gen() % 256);
+    }
+  }
+
+  std::vector<std::pair<int, int>> matches_bf, matches_mih;
+  basalt::matchDescriptors(desc_1, desc_2, matches_bf, 70, 1.2,
+                           basalt::DescriptorMatcherType::BRUTE_FORCE);
+  basalt::matchDescriptors(desc_1, desc_2, matches_mih, 70, 1.2,
+                           basalt::DescriptorMatcherType::MULTI_INDEX_HASHING);
+
+  std::sort(matches_bf.begin(), matches_bf.end());
+  std::sort(matches_mih.begin(), matches_mih.end());
+
+  std::vector<std::pair<int, int>> common;
+  std::set_intersection(matches_bf.begin(), matches_bf.end(),
+                        matches_mih.begin(), matches_mih.end(),
+                        std::back_inserter(common));
+
+  ASSERT_FALSE(matches_bf.empty());
+  const double recall = double(common.size()) / matches_bf.size();
+  const double precision = double(common.size()) / matches_mih.size();
+
+  std::cout << "Multi-index hashing recall " << recall << " precision "
+            << precision << " (" << matches_bf.size()
+            << " brute force matches)" << std::endl;
+
+  EXPECT_GE(recall, 0.95);
+  EXPECT_GE(precision, 0.99);
+}
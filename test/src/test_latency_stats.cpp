@@ -0,0 +1,49 @@
+#include <basalt/utils/time_utils.hpp>
+
+#include "gtest/gtest.h"
+
+TEST(LatencyStatsTestSuite, StagePercentiles) {
+  using Recorder = basalt::FrameLatencyRecorder;
+  Recorder recorder;
+
+  const Recorder::Clock::time_point t0;
+
+  // 100 frames, the optical flow takes (i + 1) ms for frame i
+  for (int i = 0; i < 100; i++) {
+    const int64_t t_ns = i * int64_t(50000000);
+    const auto t_input = t0 + std::chrono::milliseconds(50 * i);
+
+    recorder.record(t_ns, Recorder::INPUT, t_input);
+    recorder.record(t_ns, Recorder::OPTICAL_FLOW,
+                    t_input + std::chrono::milliseconds(i + 1));
+
+    // every 10th frame never reaches the estimator
+    if (i % 10 != 9) {
+      recorder.record(t_ns, Recorder::ESTIMATOR,
+                      t_input + std::chrono::milliseconds(200));
+    }
+  }
+
+  // only the first stamp of a stage is kept
+  recorder.record(0, Recorder::OPTICAL_FLOW,
+                  t0 + std::chrono::milliseconds(500));
+
+  const Recorder::Summary summary = recorder.summarize();
+
+  EXPECT_EQ(100u, summary.num_input_frames);
+  EXPECT_EQ(10u, summary.num_dropped_frames);
+
+  const Recorder::StageSummary& flow = summary.stages[Recorder::OPTICAL_FLOW];
+  EXPECT_EQ(100u, flow.num_frames);
+  EXPECT_NEAR(0.050, flow.p50, 1e-9);
+  EXPECT_NEAR(0.095, flow.p95, 1e-9);
+  EXPECT_NEAR(0.099, flow.p99, 1e-9);
+  EXPECT_NEAR(0.100, flow.max, 1e-9);
+
+  const Recorder::StageSummary& est = summary.stages[Recorder::ESTIMATOR];
+  EXPECT_EQ(90u, est.num_frames);
+  EXPECT_NEAR(0.2, est.p50, 1e-9);
+  EXPECT_NEAR(0.2, est.max, 1e-9);
+
+  EXPECT_EQ(0u, summary.stages[Recorder::STATE_OUTPUT].num_frames);
+}
@@ -1,112 +1,18 @@
 
 
+#include <basalt/linearization/landmark_block_abs_dynamic.hpp>
+#include <basalt/linearization/landmark_block_arena.hpp>
+#include <basalt/linearization/linearization_abs_qr.hpp>
 #include <basalt/linearization/linearization_base.hpp>
+#include <basalt/utils/ba_utils.h>
 
+#include <algorithm>
 #include <iostream>
 
 #include "gtest/gtest.h"
+#include "linearization_test_utils.h"
 #include "test_utils.h"
 
-template <class Scalar>
-void get_vo_estimator(int num_frames,
-                      basalt::BundleAdjustmentBase<Scalar>& estimator,
-                      basalt::AbsOrderMap& aom) {
-  static constexpr int POSE_SIZE = 6;
-
-  estimator.huber_thresh = 0.5;
-  estimator.obs_std_dev = 2.0;
-
-  estimator.calib.T_i_c.emplace_back(
-      Sophus::se3_expd(Sophus::Vector6d::Random() / 100));
-  estimator.calib.T_i_c.emplace_back(
-      Sophus::se3_expd(Sophus::Vector6d::Random() / 100));
-
-  basalt::GenericCamera<Scalar> cam;
-  cam.variant = basalt::KannalaBrandtCamera4<Scalar>::getTestProjections()[0];
-
-  estimator.calib.intrinsics.emplace_back(cam);
-  estimator.calib.intrinsics.emplace_back(cam);
-
-  Eigen::MatrixXd points_3d;
-  points_3d.setRandom(3, num_frames * 10);
-  points_3d.row(2).array() += 5.0;
-
-  aom.total_size = 0;
-
-  for (int i = 0; i < num_frames; i++) {
-    Sophus::SE3d T_w_i;
-    T_w_i.so3() = Sophus::SO3d::exp(Eigen::Vector3d::Random() / 100);
-    T_w_i.translation()[0] = i * 0.1;
-
-    aom.abs_order_map[i] = std::make_pair(i * POSE_SIZE, POSE_SIZE);
-    aom.total_size += POSE_SIZE;
-
-    estimator.frame_poses[i] = basalt::PoseStateWithLin(i, T_w_i, false);
-
-    for (int j = 0; j < 10; j++) {
-      const int kp_idx = 10 * i + j;
-      Eigen::Vector3d p3d = points_3d.col(kp_idx);
-      basalt::Keypoint<Scalar> kpt;
-
-      Sophus::SE3d T_c_w = estimator.calib.T_i_c[0].inverse() * T_w_i.inverse();
-      Eigen::Vector3d p3d_cam = T_c_w * p3d;
-
-      kpt.direction =
-          basalt::StereographicParam<Scalar>::project(p3d_cam.homogeneous());
-      kpt.inv_dist = 1.0 / p3d_cam.norm();
-      kpt.host_kf_id = basalt::TimeCamId(i, 0);
-
-      estimator.lmdb.addLandmark(kp_idx, kpt);
-
-      for (const auto& [frame_id, frame_pose] : estimator.frame_poses) {
-        for (int c = 0; c < 2; c++) {
-          basalt::TimeCamId tcid(frame_id, c);
-          Sophus::SE3d T_c_w = estimator.calib.T_i_c[c].inverse() *
-                               frame_pose.getPose().inverse();
-
-          Eigen::Vector3d p3d_cam = T_c_w * p3d;
-          Eigen::Vector2d p2d_cam;
-          cam.project(p3d_cam, p2d_cam);
-
-          p2d_cam += Eigen::Vector2d::Random() / 100;
-
-          basalt::KeypointObservation<Scalar> ko;
-          ko.kpt_id = kp_idx;
-          ko.pos = p2d_cam;
-
-          estimator.lmdb.addObservation(tcid, ko);
-        }
-      }
-    }
-  }
-}
-
-template <class Scalar>
-void get_vo_estimator_with_marg(int num_frames,
-                                basalt::BundleAdjustmentBase<Scalar>& estimator,
-                                basalt::AbsOrderMap& aom,
-                                basalt::MargLinData<Scalar>& mld) {
-  static constexpr int POSE_SIZE = 6;
-
-  get_vo_estimator(num_frames, estimator, aom);
-
-  mld.H.setIdentity(2 * POSE_SIZE, 2 * POSE_SIZE);
-  mld.H *= 1e6;
-
-  mld.b.setRandom(2 * POSE_SIZE);
-  mld.b *= 10;
-
-  mld.order.abs_order_map[0] = std::make_pair(0, POSE_SIZE);
-  mld.order.abs_order_map[1] = std::make_pair(POSE_SIZE, POSE_SIZE);
-  mld.order.total_size = 2 * POSE_SIZE;
-
-  estimator.frame_poses[0].setLinTrue();
-  estimator.frame_poses[1].setLinTrue();
-
-  estimator.frame_poses[0].applyInc(Sophus::Vector6d::Random() / 100);
-  estimator.frame_poses[1].applyInc(Sophus::Vector6d::Random() / 100);
-}
-
 #ifdef BASALT_INSTANTIATIONS_DOUBLE
 TEST(LinearizationTestSuite, VoNoMargLinearizationTest) {
   using Scalar = double;
@@ -416,3 +322,383 @@ TEST(LinearizationTestSuite, VoMargSqrtLinearizationTest) {
   EXPECT_LE(b_diff5, 1e-5);
 }
 #endif
+
+#ifdef BASALT_INSTANTIATIONS_DOUBLE
+TEST(LinearizationTestSuite, VoUpdateLinearizationTest) {
+  using Scalar = double;
+  static constexpr int POSE_SIZE = 6;
+  static constexpr int NUM_FRAMES = 6;
+
+  basalt::BundleAdjustmentBase<Scalar> estimator;
+  basalt::AbsOrderMap aom;
+
+  get_vo_estimator<Scalar>(NUM_FRAMES, estimator, aom);
+
+  typename basalt::LinearizationBase<Scalar, POSE_SIZE>::Options options;
+  options.lb_options.huber_parameter = estimator.huber_thresh;
+  options.lb_options.obs_std_dev = estimator.obs_std_dev;
+  options.linearization_type = basalt::LinearizationType::ABS_QR;
+
+  std::unique_ptr<basalt::LinearizationBase<Scalar, POSE_SIZE>> l_update;
+  basalt::LinearizationBase<Scalar, POSE_SIZE>::update(l_update, &estimator,
+                                                       aom, options);
+  l_update->linearizeProblem();
+  l_update->performQR();
+
+  // Marginalize the first frame, drop a landmark and some observations
+  estimator.lmdb.removeKeyframes({0}, {}, {});
+  estimator.frame_poses.erase(0);
+  estimator.lmdb.removeLandmark(10 * NUM_FRAMES - 1);
+  estimator.lmdb.removeObservations(45, {basalt::TimeCamId(2, 1)});
+
+  aom.abs_order_map.erase(0);
+  aom.total_size = 0;
+  for (auto& [frame_id, idx_size] : aom.abs_order_map) {
+    idx_size.first = aom.total_size;
+    aom.total_size += POSE_SIZE;
+  }
+
+  const auto* l_update_ptr = l_update.get();
+  basalt::LinearizationBase<Scalar, POSE_SIZE>::update(l_update, &estimator,
+                                                       aom, options);
+  EXPECT_EQ(l_update_ptr, l_update.get());
+
+  auto l_create = basalt::LinearizationBase<Scalar, POSE_SIZE>::create(
+      &estimator, aom, options);
+
+  Eigen::MatrixXd H_update, H_create;
+  Eigen::VectorXd b_update, b_create;
+
+  Scalar error_update = l_update->linearizeProblem();
+  l_update->performQR();
+  l_update->get_dense_H_b(H_update, b_update);
+
+  Scalar error_create = l_create->linearizeProblem();
+  l_create->performQR();
+  l_create->get_dense_H_b(H_create, b_create);
+
+  EXPECT_EQ(H_update.rows(), (NUM_FRAMES - 1) * POSE_SIZE);
+  EXPECT_LE(std::abs(error_update - error_create), 1e-8);
+  EXPECT_LE((H_update - H_create).norm(), 1e-8);
+  EXPECT_LE((b_update - b_create).norm(), 1e-8);
+}
+
+TEST(LinearizationTestSuite, LandmarkBlockArenaTest) {
+  using Scalar = double;
+
+  basalt::LandmarkBlockArena<Scalar> arena;
+
+  const std::vector<size_t> sizes = {3, 8, 17, 1, 0, 40};
+  arena.reset(sizes.size(), [&](size_t i) { return sizes[i]; });
+  ASSERT_EQ(arena.numBlocks(), sizes.size());
+
+  for (size_t i = 0; i < sizes.size(); i++) {
+    const auto addr = reinterpret_cast<std::uintptr_t>(arena.block(i));
+    EXPECT_EQ(addr % basalt::LandmarkBlockArena<Scalar>::ALIGNMENT, 0u);
+
+    // blocks are placed in order and do not overlap
+    if (i + 1 < sizes.size()) {
+      EXPECT_GE(arena.block(i + 1), arena.block(i) + sizes[i]);
+    }
+  }
+  EXPECT_LE(arena.block(sizes.size() - 1) + sizes.back(),
+            arena.block(0) + arena.capacity());
+
+  // smaller problems reuse the slab
+  const Scalar* data = arena.block(0);
+  const size_t capacity = arena.capacity();
+  arena.reset(2, [](size_t) { return 20; });
+  EXPECT_EQ(arena.block(0), data);
+  EXPECT_EQ(arena.capacity(), capacity);
+}
+#endif
+
+#ifdef BASALT_INSTANTIATIONS_DOUBLE
+TEST(LinearizationTestSuite, VoBlockSparseLinearizationTest) {
+  using Scalar = double;
+  static constexpr int POSE_SIZE = 6;
+  static constexpr int NUM_FRAMES = 6;
+
+  basalt::BundleAdjustmentBase<Scalar> estimator;
+  basalt::AbsOrderMap aom;
+
+  get_vo_estimator<Scalar>(NUM_FRAMES, estimator, aom);
+
+  typename basalt::LinearizationBase<Scalar, POSE_SIZE>::Options options;
+  options.lb_options.huber_parameter = estimator.huber_thresh;
+  options.lb_options.obs_std_dev = estimator.obs_std_dev;
+  options.linearization_type = basalt::LinearizationType::ABS_QR;
+
+  auto l_abs_qr = basalt::LinearizationBase<Scalar, POSE_SIZE>::create(
+      &estimator, aom, options);
+  l_abs_qr->linearizeProblem();
+  l_abs_qr->performQR();
+
+  Eigen::MatrixXd H_dense;
+  Eigen::VectorXd b_dense;
+  l_abs_qr->get_dense_H_b(H_dense, b_dense);
+
+  std::vector<int> block_start;
+  for (const auto& [frame_id, idx_size] : aom.abs_order_map) {
+    block_start.push_back(idx_size.first);
+  }
+  std::sort(block_start.begin(), block_start.end());
+
+  basalt::BlockSparseAccumulator<Scalar> accum;
+  accum.reset(block_start, aom.total_size);
+  l_abs_qr->get_block_sparse_H_b(accum);
+
+  EXPECT_LE((accum.getDenseH() - H_dense).norm(), 1e-8);
+  EXPECT_LE((accum.getB() - b_dense).norm(), 1e-8);
+  EXPECT_LE((accum.Hdiagonal() - H_dense.diagonal()).norm(), 1e-8);
+
+  // Damped solve as in the optimization
+  const Eigen::VectorXd diagonal =
+      (H_dense.diagonal() * 1e-4).cwiseMax(1e-6);
+
+  Eigen::MatrixXd H_damped = H_dense;
+  H_damped.diagonal() += diagonal;
+  const Eigen::VectorXd inc = accum.solve(&diagonal);
+
+  ASSERT_TRUE(inc.array().isFinite().all());
+  EXPECT_LE((H_damped * inc - b_dense).norm(), 1e-8 * b_dense.norm());
+}
+#endif
+
+#ifdef BASALT_INSTANTIATIONS_DOUBLE
+TEST(LinearizationTestSuite, VioBlockSparseLinearizationTest) {
+  using Scalar = double;
+  static constexpr int POSE_SIZE = 6;
+  static constexpr int NUM_FRAMES = 8;
+  static constexpr int NUM_STATES = 4;
+
+  basalt::BundleAdjustmentBase<Scalar> estimator;
+  basalt::AbsOrderMap aom;
+  Eigen::aligned_map<int64_t, basalt::IntegratedImuMeasurement<Scalar>>
+      imu_meas;
+
+  get_vio_estimator<Scalar>(NUM_FRAMES, NUM_STATES, estimator, aom, imu_meas);
+
+  const Eigen::Vector3d g(0, 0, -9.81);
+  const Eigen::Vector3d gyro_bias_weight_sqrt = Eigen::Vector3d::Constant(1e2);
+  const Eigen::Vector3d accel_bias_weight_sqrt =
+      Eigen::Vector3d::Constant(1e1);
+
+  basalt::ImuLinData<Scalar> ild = {
+      g, gyro_bias_weight_sqrt, accel_bias_weight_sqrt, {}};
+  for (const auto& kv : imu_meas) {
+    ild.imu_meas[kv.first] = &kv.second;
+  }
+
+  // Square root prior on the poses and the first state, which are the first
+  // variables of the order
+  basalt::MargLinData<Scalar> mld;
+  for (const auto& kv : aom.abs_order_map) {
+    mld.order.abs_order_map.emplace(kv);
+    mld.order.total_size += kv.second.second;
+    if (kv.second.second != POSE_SIZE) break;
+  }
+
+  const int marg_size = mld.order.total_size;
+  mld.H.setRandom(marg_size, marg_size);
+  mld.H.diagonal().array() += 1e2;
+  mld.b.setRandom(marg_size);
+
+  for (auto& kv : estimator.frame_poses) {
+    kv.second.setLinTrue();
+    kv.second.applyInc(Sophus::Vector6d::Random() / 100);
+  }
+
+  auto& first_state = estimator.frame_states.begin()->second;
+  first_state.setLinTrue();
+  first_state.applyInc(
+      basalt::PoseVelBiasState<Scalar>::VecN::Random() / 100);
+
+  typename basalt::LinearizationBase<Scalar, POSE_SIZE>::Options options;
+  options.lb_options.huber_parameter = estimator.huber_thresh;
+  options.lb_options.obs_std_dev = estimator.obs_std_dev;
+  options.linearization_type = basalt::LinearizationType::ABS_QR;
+
+  auto l_abs_qr = basalt::LinearizationBase<Scalar, POSE_SIZE>::create(
+      &estimator, aom, options, &mld, &ild);
+  l_abs_qr->linearizeProblem();
+  l_abs_qr->performQR();
+
+  // Pose damping, added to the blocks with addDiagonal
+  auto* l_abs_qr_damped =
+      dynamic_cast<basalt::LinearizationAbsQR<Scalar, POSE_SIZE>*>(
+          l_abs_qr.get());
+  ASSERT_NE(l_abs_qr_damped, nullptr);
+  l_abs_qr_damped->setPoseDamping(1e-2);
+
+  Eigen::MatrixXd H_dense;
+  Eigen::VectorXd b_dense;
+  l_abs_qr->get_dense_H_b(H_dense, b_dense);
+
+  // One block for the poses, eliminated after the states
+  std::vector<int> block_start, elimination_order;
+  basalt::LinearizationBase<Scalar, POSE_SIZE>::getBlockSparseLayout(
+      aom, block_start, elimination_order);
+  ASSERT_EQ(block_start.size(), size_t(NUM_STATES + 1));
+  EXPECT_EQ(elimination_order.back(), 0);
+
+  basalt::BlockSparseAccumulator<Scalar> accum;
+  accum.reset(block_start, aom.total_size, &elimination_order);
+  l_abs_qr->get_block_sparse_H_b(accum);
+
+  const Scalar H_norm = H_dense.norm();
+  EXPECT_LE((accum.getDenseH() - H_dense).norm(), 1e-12 * H_norm);
+  EXPECT_LE((accum.getB() - b_dense).norm(), 1e-12 * b_dense.norm());
+  EXPECT_LE((accum.Hdiagonal() - H_dense.diagonal()).norm(), 1e-12 * H_norm);
+
+  // Damped solves as in the optimization, the second one reuses the pattern
+  // of the factor
+  for (Scalar lambda : {1e-4, 1e-2}) {
+    const Eigen::VectorXd diagonal =
+        (H_dense.diagonal() * lambda).cwiseMax(1e-6);
+
+    Eigen::MatrixXd H_damped = H_dense;
+    H_damped.diagonal() += diagonal;
+    const Eigen::VectorXd inc = accum.solve(&diagonal);
+
+    ASSERT_TRUE(inc.array().isFinite().all());
+    EXPECT_LE((H_damped * inc - b_dense).norm(), 1e-10 * H_norm * inc.norm());
+  }
+
+  // Not positive definite, NaN like for the dense LDLT
+  const Eigen::VectorXd negative = -2 * H_dense.diagonal();
+  EXPECT_TRUE(accum.solve(&negative).array().isNaN().all());
+}
+#endif
+
+#ifdef BASALT_INSTANTIATIONS_DOUBLE
+// Linearizes the same landmark with the fixed-size block for NUM_OBS
+// observations and with a dynamic block and compares the results.
+template <int NUM_OBS>
+void testFixedSizeLandmarkBlock() {
+  using Scalar = double;
+  static constexpr int POSE_SIZE = 6;
+  static constexpr int NUM_FRAMES = 4;
+
+  basalt::BundleAdjustmentBase<Scalar> estimator;
+  basalt::AbsOrderMap aom;
+
+  get_vo_estimator<Scalar>(NUM_FRAMES, estimator, aom);
+
+  // Landmarks hosted in frame i are observed by both cameras of the frames up
+  // to i. For odd counts the second camera of the host frame is dropped.
+  const int host_frame = (NUM_OBS + 1) / 2 - 1;
+  basalt::Keypoint<Scalar> lm = estimator.lmdb.getLandmark(10 * host_frame);
+  if (NUM_OBS % 2) lm.obs.erase(basalt::TimeCamId(host_frame, 1));
+  ASSERT_EQ(lm.obs.size(), size_t(NUM_OBS));
+
+  Eigen::aligned_unordered_map<std::pair<basalt::TimeCamId, basalt::TimeCamId>,
+                               basalt::RelPoseLin<Scalar>>
+      relative_pose_lin;
+
+  const basalt::TimeCamId& tcid_h = lm.host_kf_id;
+  for (const auto& [tcid_t, pos] : lm.obs) {
+    basalt::RelPoseLin<Scalar>& rpl =
+        relative_pose_lin[std::make_pair(tcid_h, tcid_t)];
+
+    if (tcid_h != tcid_t) {
+      rpl.T_t_h =
+          basalt::computeRelPose(
+              estimator.getPoseStateWithLin(tcid_h.frame_id).getPoseLin(),
+              estimator.calib.T_i_c[tcid_h.cam_id],
+              estimator.getPoseStateWithLin(tcid_t.frame_id).getPoseLin(),
+              estimator.calib.T_i_c[tcid_t.cam_id], &rpl.d_rel_d_h,
+              &rpl.d_rel_d_t)
+              .matrix();
+    } else {
+      rpl.T_t_h.setIdentity();
+      rpl.d_rel_d_h.setZero();
+      rpl.d_rel_d_t.setZero();
+    }
+  }
+
+  const Eigen::VectorXd pose_inc = Eigen::VectorXd::Random(aom.total_size);
+
+  for (bool use_householder : {true, false}) {
+    typename basalt::LandmarkBlock<Scalar>::Options options;
+    options.use_householder = use_householder;
+    options.huber_parameter = estimator.huber_thresh;
+    options.obs_std_dev = estimator.obs_std_dev;
+
+    basalt::Keypoint<Scalar> lm_fixed = lm, lm_dynamic = lm;
+
+    auto lb_fixed =
+        basalt::LandmarkBlock<Scalar>::createLandmarkBlock<POSE_SIZE>(NUM_OBS);
+    std::unique_ptr<basalt::LandmarkBlock<Scalar>> lb_dynamic(
+        new basalt::LandmarkBlockAbsDynamic<Scalar, POSE_SIZE>);
+    ASSERT_EQ(lb_fixed->getBlockType(), size_t(NUM_OBS));
+    ASSERT_EQ(lb_dynamic->getBlockType(), 0u);
+
+    lb_fixed->allocateLandmark(lm_fixed, relative_pose_lin, estimator.calib,
+                               aom, options);
+    lb_dynamic->allocateLandmark(lm_dynamic, relative_pose_lin,
+                                 estimator.calib, aom, options);
+
+    const Scalar error_fixed = lb_fixed->linearizeLandmark();
+    const Scalar error_dynamic = lb_dynamic->linearizeLandmark();
+    EXPECT_LE(std::abs(error_fixed - error_dynamic), 1e-10 * error_dynamic);
+
+    lb_fixed->performQR();
+    lb_dynamic->performQR();
+
+    // Q2Jp and Q2r, as used for the marginalization
+    ASSERT_EQ(lb_fixed->numQ2rows(), size_t(2 * NUM_OBS));
+    ASSERT_EQ(lb_dynamic->numQ2rows(), size_t(2 * NUM_OBS));
+
+    Eigen::MatrixXd Q2Jp_fixed, Q2Jp_dynamic;
+    Eigen::VectorXd Q2r_fixed, Q2r_dynamic;
+    Q2Jp_fixed.setZero(2 * NUM_OBS, aom.total_size);
+    Q2Jp_dynamic.setZero(2 * NUM_OBS, aom.total_size);
+    Q2r_fixed.setZero(2 * NUM_OBS);
+    Q2r_dynamic.setZero(2 * NUM_OBS);
+
+    lb_fixed->get_dense_Q2Jp_Q2r(Q2Jp_fixed, Q2r_fixed, 0);
+    lb_dynamic->get_dense_Q2Jp_Q2r(Q2Jp_dynamic, Q2r_dynamic, 0);
+
+    EXPECT_LE((Q2Jp_fixed - Q2Jp_dynamic).norm(), 1e-10 * Q2Jp_dynamic.norm());
+    EXPECT_LE((Q2r_fixed - Q2r_dynamic).norm(), 1e-10 * Q2r_dynamic.norm());
+
+    // Reduced camera system
+    Eigen::MatrixXd H_fixed, H_dynamic;
+    Eigen::VectorXd b_fixed, b_dynamic;
+    H_fixed.setZero(aom.total_size, aom.total_size);
+    H_dynamic.setZero(aom.total_size, aom.total_size);
+    b_fixed.setZero(aom.total_size);
+    b_dynamic.setZero(aom.total_size);
+
+    lb_fixed->add_dense_H_b(H_fixed, b_fixed);
+    lb_dynamic->add_dense_H_b(H_dynamic, b_dynamic);
+
+    EXPECT_LE((H_fixed - H_dynamic).norm(), 1e-10 * H_dynamic.norm());
+    EXPECT_LE((b_fixed - b_dynamic).norm(), 1e-10 * b_dynamic.norm());
+
+    // Damped back substitution
+    lb_fixed->setLandmarkDamping(1e-2);
+    lb_dynamic->setLandmarkDamping(1e-2);
+
+    Scalar l_diff_fixed = 0, l_diff_dynamic = 0;
+    lb_fixed->backSubstitute(pose_inc, l_diff_fixed);
+    lb_dynamic->backSubstitute(pose_inc, l_diff_dynamic);
+
+    EXPECT_LE(std::abs(l_diff_fixed - l_diff_dynamic),
+              1e-10 * std::abs(l_diff_dynamic));
+    EXPECT_LE((lm_fixed.direction - lm_dynamic.direction).norm(), 1e-10);
+    EXPECT_LE(std::abs(lm_fixed.inv_dist - lm_dynamic.inv_dist), 1e-10);
+  }
+}
+
+TEST(LinearizationTestSuite, FixedSizeLandmarkBlockTest) {
+  testFixedSizeLandmarkBlock<2>();
+  testFixedSizeLandmarkBlock<3>();
+  testFixedSizeLandmarkBlock<4>();
+  testFixedSizeLandmarkBlock<5>();
+  testFixedSizeLandmarkBlock<6>();
+  testFixedSizeLandmarkBlock<7>();
+  testFixedSizeLandmarkBlock<8>();
+}
+#endif
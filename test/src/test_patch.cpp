@@ -0,0 +1,111 @@
+#include <limits>
+#include <random>
+
+#include <basalt/optical_flow/patch.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+template <typename T = uint16_t>
+basalt::ManagedImage<T> randomImage(size_t w, size_t h) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, std::numeric_limits<T>::max());
+
+  basalt::ManagedImage<T> img(w, h);
+  for (size_t y = 0; y < h; y++) {
+    for (size_t x = 0; x < w; x++) {
+      img(x, y) = dist(gen);
+    }
+  }
+  return img;
+}
+
+template <typename T>
+void expectBatchInterpMatchesImageInterp() {
+  const basalt::ManagedImage<T> img_managed = randomImage<T>(91, 67);
+  const basalt::Image<const T> img =
+      img_managed.template Reinterpret<const T>();
+
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> dist_x(2, img.w - 3.001);
+  std::uniform_real_distribution<float> dist_y(2, img.h - 3.001);
+
+  constexpr int N = 53;
+  Eigen::Matrix<float, 2, N> points;
+  for (int i = 0; i < N; i++) {
+    points.col(i) << dist_x(gen), dist_y(gen);
+  }
+  ASSERT_TRUE(basalt::patch_interp::patchInBounds(img, points, 2));
+
+  Eigen::Matrix<float, N, 1> val, val_grad, grad_x, grad_y;
+  basalt::patch_interp::interpPoints(img, points.data(), N, val.data());
+  basalt::patch_interp::interpGradPoints(img, points.data(), N,
+                                         val_grad.data(), grad_x.data(),
+                                         grad_y.data());
+
+  for (int i = 0; i < N; i++) {
+    const Eigen::Vector2f p = points.col(i);
+    const Eigen::Vector3f ref = img.template interpGrad<float>(p);
+
+    EXPECT_NEAR(img.template interp<float>(p), val[i], 1e-2);
+    EXPECT_NEAR(ref[0], val_grad[i], 1e-2);
+    EXPECT_NEAR(ref[1], grad_x[i], 1e-2);
+    EXPECT_NEAR(ref[2], grad_y[i], 1e-2);
+  }
+}
+
+}  // namespace
+
+TEST(PatchTestSuite, BatchInterpMatchesImageInterp) {
+  expectBatchInterpMatchesImageInterp<uint16_t>();
+}
+
+TEST(PatchTestSuite, BatchInterpMatchesImageInterp8Bit) {
+  expectBatchInterpMatchesImageInterp<uint8_t>();
+}
+
+TEST(PatchTestSuite, PatchIndependentOfBitDepth) {
+  using PatchT = basalt::OpticalFlowPatch<float, basalt::Pattern52<float>>;
+
+  const basalt::ManagedImage<uint8_t> img_u8 = randomImage<uint8_t>(91, 67);
+  basalt::ManagedImage<uint16_t> img_u16(img_u8.w, img_u8.h);
+  for (size_t y = 0; y < img_u8.h; y++) {
+    for (size_t x = 0; x < img_u8.w; x++) {
+      img_u16(x, y) = img_u8(x, y) << 8;
+    }
+  }
+
+  // inside, partly outside and fully inside close to the border
+  const std::vector<Eigen::Vector2f> positions = {
+      {45.3, 33.7}, {3.2, 30.1}, {84.6, 59.9}};
+
+  for (const Eigen::Vector2f& pos : positions) {
+    const PatchT p_u8(img_u8.Reinterpret<const uint8_t>(), pos);
+    const PatchT p_u16(img_u16.Reinterpret<const uint16_t>(), pos);
+
+    EXPECT_EQ(p_u8.valid, p_u16.valid);
+    EXPECT_EQ(p_u8.data, p_u16.data);
+    EXPECT_EQ(p_u8.H_se2_inv_J_se2_T, p_u16.H_se2_inv_J_se2_T);
+  }
+}
+
+TEST(PatchTestSuite, PatchInBounds) {
+  const basalt::ManagedImage<uint16_t> img_managed = randomImage(40, 30);
+  const basalt::Image<const uint16_t> img =
+      img_managed.Reinterpret<const uint16_t>();
+
+  Eigen::Matrix<float, 2, 3> points;
+  points << 2, 10, 36.9, 2, 20, 26.9;
+  EXPECT_TRUE(basalt::patch_interp::patchInBounds(img, points, 2));
+
+  points(0, 2) = 37;
+  EXPECT_FALSE(basalt::patch_interp::patchInBounds(img, points, 2));
+
+  points(0, 2) = 20;
+  points(1, 0) = 1.9;
+  EXPECT_FALSE(basalt::patch_interp::patchInBounds(img, points, 2));
+
+  points(1, 0) = std::numeric_limits<float>::quiet_NaN();
+  EXPECT_FALSE(basalt::patch_interp::patchInBounds(img, points, 2));
+}
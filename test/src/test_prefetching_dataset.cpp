@@ -0,0 +1,143 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <basalt/io/prefetching_dataset.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Dataset with 1x1 images that hold the index of the frame
+class CountingDataset : public basalt::VioDataset {
+ public:
+  explicit CountingDataset(size_t num_frames) {
+    for (size_t i = 0; i < num_frames; i++) {
+      timestamps.push_back(1000 + 50 * i);
+    }
+  }
+
+  size_t get_num_cams() const override { return 2; }
+
+  std::vector<int64_t> &get_image_timestamps() override { return timestamps; }
+
+  const Eigen::aligned_vector<basalt::AccelData> &get_accel_data()
+      const override {
+    return accel_data;
+  }
+  const Eigen::aligned_vector<basalt::GyroData> &get_gyro_data()
+      const override {
+    return gyro_data;
+  }
+  const std::vector<int64_t> &get_gt_timestamps() const override {
+    return timestamps;
+  }
+  const Eigen::aligned_vector<Sophus::SE3d> &get_gt_pose_data()
+      const override {
+    return gt_pose_data;
+  }
+  int64_t get_mocap_to_imu_offset_ns() const override { return 0; }
+
+  std::vector<basalt::ImageData> get_image_data(int64_t t_ns) override {
+    num_loads++;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+    std::vector<basalt::ImageData> res(get_num_cams());
+    for (size_t i = 0; i < res.size(); i++) {
+      res[i].img.reset(new basalt::ManagedImage<uint16_t>(1, 1));
+      (*res[i].img)(0, 0) = (t_ns - 1000) / 50 + 1000 * i;
+    }
+    return res;
+  }
+
+  std::atomic<int> num_loads = 0;
+
+ private:
+  std::vector<int64_t> timestamps;
+  Eigen::aligned_vector<basalt::AccelData> accel_data;
+  Eigen::aligned_vector<basalt::GyroData> gyro_data;
+  Eigen::aligned_vector<Sophus::SE3d> gt_pose_data;
+};
+
+void expectFrame(const std::vector<basalt::ImageData> &img_data, int idx) {
+  ASSERT_EQ(2u, img_data.size());
+  EXPECT_EQ(idx, (*img_data[0].img)(0, 0));
+  EXPECT_EQ(idx + 1000, (*img_data[1].img)(0, 0));
+}
+
+}  // namespace
+
+TEST(PrefetchingDatasetTestSuite, SequentialLoadsEveryFrameOnce) {
+  const size_t num_frames = 100;
+  auto dataset = std::make_shared<CountingDataset>(num_frames);
+  basalt::PrefetchingVioDataset prefetch(dataset, 3, 5);
+
+  for (size_t i = 0; i < num_frames; i++) {
+    const int64_t t_ns = prefetch.get_image_timestamps()[i];
+    expectFrame(prefetch.get_image_data(t_ns), i);
+  }
+
+  EXPECT_EQ(int(num_frames), dataset->num_loads);
+  EXPECT_EQ(1u, prefetch.numPrefetchMisses());
+  EXPECT_EQ(num_frames - 1, prefetch.numPrefetchHits());
+}
+
+TEST(PrefetchingDatasetTestSuite, RandomAccess) {
+  auto dataset = std::make_shared<CountingDataset>(50);
+  basalt::PrefetchingVioDataset prefetch(dataset, 2, 4);
+
+  const auto &timestamps = prefetch.get_image_timestamps();
+  for (int idx : {10, 11, 40, 3, 3, 49, 0, 20}) {
+    expectFrame(prefetch.get_image_data(timestamps[idx]), idx);
+  }
+
+  // not a frame timestamp, forwarded to the dataset
+  const std::vector<basalt::ImageData> img_data =
+      prefetch.get_image_data(1000 + 50 * 60);
+  expectFrame(img_data, 60);
+}
+
+TEST(PrefetchingDatasetTestSuite, LaggingReaderKeepsWindow) {
+  const size_t num_frames = 40, lag = 3;
+  auto dataset = std::make_shared<CountingDataset>(num_frames);
+  basalt::PrefetchingVioDataset prefetch(dataset, 2, 5);
+
+  const auto &timestamps = prefetch.get_image_timestamps();
+  for (size_t i = 0; i < num_frames; i++) {
+    expectFrame(prefetch.get_image_data(timestamps[i]), i);
+    if (i >= lag) {
+      expectFrame(prefetch.get_image_data(timestamps[i - lag]), i - lag);
+    }
+  }
+
+  // Every frame is prefetched once, the lagging reads are loaded directly
+  EXPECT_EQ(int(2 * num_frames - lag), dataset->num_loads);
+  EXPECT_EQ(num_frames - 1, prefetch.numPrefetchHits());
+  EXPECT_EQ(num_frames - lag + 1, prefetch.numPrefetchMisses());
+}
+
+TEST(PrefetchingDatasetTestSuite, ConcurrentReaders) {
+  const size_t num_frames = 60;
+  auto dataset = std::make_shared<CountingDataset>(num_frames);
+  basalt::PrefetchingVioDataset prefetch(dataset, 2, 8);
+
+  auto read = [&](size_t offset) {
+    for (size_t i = 0; i < num_frames; i++) {
+      const size_t idx = (i + offset) % num_frames;
+      expectFrame(
+          prefetch.get_image_data(prefetch.get_image_timestamps()[idx]), idx);
+    }
+  };
+
+  std::thread t1(read, 0), t2(read, 30);
+  t1.join();
+  t2.join();
+}
+
+TEST(PrefetchingDatasetTestSuite, NoThreads) {
+  auto dataset = std::make_shared<CountingDataset>(10);
+  basalt::PrefetchingVioDataset prefetch(dataset, 0, 4);
+
+  expectFrame(prefetch.get_image_data(prefetch.get_image_timestamps()[7]), 7);
+  EXPECT_EQ(1, dataset->num_loads);
+}